@@ -132,6 +132,8 @@ bool BusInterconnect::controller_request_cb(void *arg)
 	busQueueEntry->request = message->request;
 	message->request->incRefCounter();
 	busQueueEntry->hasData = message->hasData;
+	memoryHierarchy_->hold_line_data(busQueueEntry->data, message->data,
+			message->request->is_kernel());
 
 
 	if(!is_busy()) {
@@ -212,6 +214,7 @@ bool BusInterconnect::broadcast_cb(void *arg)
 	message.sender = this;
 	message.request = queueEntry->request;
 	message.hasData = queueEntry->hasData;
+	message.data = queueEntry->data.get();
 
 	Controller *controller = queueEntry->controllerQueue->controller;
 
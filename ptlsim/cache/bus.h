@@ -44,11 +44,13 @@ struct BusQueueEntry : public FixStateListObject
 	BusControllerQueue *controllerQueue;
 	bool hasData;
 	bool annuled;
+	LineDataBuffer data;
 
 	void init() {
 		request = NULL;
 		hasData = false;
 		annuled = false;
+		data.reset();
 	}
 
 	ostream& print(ostream& os) const {
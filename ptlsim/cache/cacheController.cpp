@@ -35,6 +35,7 @@
 
 #include <memoryHierarchy.h>
 #include <cacheController.h>
+#include <dynamicCacheLines.h>
 
 #include <machine.h>
 
@@ -56,14 +57,24 @@ CacheController::CacheController(W8 coreid, const char *name,
 	, type_(type)
 	, isLowestPrivate_(false)
     , wt_disabled_(true)
-	, prefetchEnabled_(false)
+	, prefetcher_(NULL)
 	, prefetchDelay_(1)
+	, profiler_(NULL)
+	, lineData_(NULL)
+	, lowerCont_(NULL)
+	, lowerSliceMap_(NULL)
     , new_stats(name, &memoryHierarchy->get_machine())
 {
     memoryHierarchy_->add_cache_controller(this);
 
     cacheLines_ = get_cachelines(type);
 
+    if(!configure_cache_geometry(name, cacheLines_)) {
+        ptl_logfile << "[ERROR] " << name << ": invalid cache geometry"
+                    << endl;
+        assert_fail(__STRING(0), __FILE__, __LINE__, __PRETTY_FUNCTION__);
+    }
+
     if(!memoryHierarchy_->get_machine().get_option(name, "last_private", isLowestPrivate_)) {
         isLowestPrivate_ = false;
     }
@@ -73,6 +84,14 @@ CacheController::CacheController(W8 coreid, const char *name,
 
 	cacheLines_->init();
 
+	cacheLines_->init_stats(&new_stats);
+
+    prefetcher_ = Prefetcher::create(memoryHierarchy_->get_machine(), name,
+            &new_stats, cacheLineBits_);
+
+    profiler_ = CacheProfiler::create(memoryHierarchy_->get_machine(), name,
+            &new_stats, cacheLineBits_);
+
     SET_SIGNAL_CB(name, "_Cache_Hit", cacheHit_, &CacheController::cache_hit_cb);
 
     SET_SIGNAL_CB(name, "_Cache_Miss", cacheMiss_, &CacheController::cache_miss_cb);
@@ -104,10 +123,22 @@ CacheController::CacheController(W8 coreid, const char *name,
         type_ = L1_I_CACHE;
     else if (( strstr(get_name(), "L1_D") !=NULL) )
         type_ = L1_D_CACHE;
+
+    lineData_ = memoryHierarchy_->get_line_data(
+            cacheLines_->get_line_size());
+    cacheLines_->set_line_data(lineData_);
+    if(lineData_ && type_ == L1_D_CACHE)
+        memoryHierarchy_->set_data_cache(idx, cacheLines_);
 }
 
 CacheController::~CacheController()
 {
+    if(prefetcher_)
+        delete prefetcher_;
+    if(profiler_)
+        delete profiler_;
+    if(lowerSliceMap_)
+        delete lowerSliceMap_;
 }
 
 CacheQueueEntry* CacheController::find_dependency(MemoryRequest *request)
@@ -202,6 +233,11 @@ bool CacheController::handle_interconnect_cb(void *arg)
 		queueEntry->request->incRefCounter();
 		ADD_HISTORY_ADD(queueEntry->request);
 
+		/* Keep the data of a writeback until it is written or sent on */
+		if(lineData_ && msg->hasData)
+			memoryHierarchy_->hold_line_data(queueEntry->data, msg->data,
+					msg->request->is_kernel());
+
         /*
 		 * We are going to access the cache later, to make
 		 * sure that this entry is not cleared enable the
@@ -231,6 +267,10 @@ bool CacheController::handle_interconnect_cb(void *arg)
 			dependsOn->dependsAddr = queueEntry->request->get_physical_address();
 			OP_TYPE type = queueEntry->request->get_type();
             bool kernel_req = queueEntry->request->is_kernel();
+			if(prefetcher_ && prefetcher_->is_pending(
+						msg->request->get_physical_address())) {
+				N_STAT_UPDATE(prefetcher_->stats.late, ++, kernel_req);
+			}
 			if(type == MEMORY_OP_READ) {
 				N_STAT_UPDATE(new_stats.cpurequest.stall.read.dependency, ++, kernel_req);
 			} else if(type == MEMORY_OP_WRITE) {
@@ -266,6 +306,11 @@ bool CacheController::handle_interconnect_cb(void *arg)
 
 				queueEntry->eventFlags[CACHE_WAIT_RESPONSE]--;
 
+				/* Line is inserted and sent up later */
+				if(lineData_)
+					memoryHierarchy_->hold_line_data(queueEntry->data,
+							msg->data, msg->request->is_kernel());
+
 				if(queueEntry->prefetch) {
 					/* In case of prefetch just wakeup the dependents entries */
 					queueEntry->prefetchCompleted = true;
@@ -317,6 +362,10 @@ bool CacheController::handle_interconnect_cb(void *arg)
 					newEntry->request->incRefCounter();
 					ADD_HISTORY_ADD(newEntry->request);
 
+					if(lineData_)
+						memoryHierarchy_->hold_line_data(newEntry->data,
+								msg->data, msg->request->is_kernel());
+
 					newEntry->eventFlags[CACHE_ACCESS_EVENT]++;
 
 					/* if its a L2 cache or L3 cache send to lower memory */
@@ -363,13 +412,16 @@ int CacheController::access_fast_path(Interconnect *interconnect,
 {
 	memdebug("Accessing Cache " << get_name() << " : Request: " << *request << endl);
 	bool hit = false;
+	CacheLine *line = NULL;
 
     if (find_dependency(request) != NULL) {
         return -1;
     }
 
-    if (request->get_type() != MEMORY_OP_WRITE)
-        hit = cacheLines_->probe(request);
+    if (request->get_type() != MEMORY_OP_WRITE) {
+        line = cacheLines_->probe(request);
+        hit = line;
+    }
 
 	// TESTING
     //	hit = true;
@@ -381,6 +433,12 @@ int CacheController::access_fast_path(Interconnect *interconnect,
 	if(hit && request->get_type() != MEMORY_OP_WRITE) {
         N_STAT_UPDATE(new_stats.cpurequest.count.hit.read.hit, ++,
                 request->is_kernel());
+		if(prefetcher_)
+			update_prefetcher(request, line);
+		if(profiler_)
+			profiler_->access(request->get_owner_rip(),
+					request->get_physical_address(), true,
+					request->is_kernel());
 		return cacheLines_->latency();
 	}
 
@@ -399,6 +457,7 @@ void CacheController::register_interconnect(Interconnect *interconnect,
             break;
         case INTERCONN_TYPE_LOWER:
             lowerInterconnect_ = interconnect;
+            find_lower_conts(interconnect);
             break;
         default:
             assert(0);
@@ -419,6 +478,47 @@ void CacheController::register_second_upper_interconnect(Interconnect
 void CacheController::register_lower_interconnect(Interconnect *interconnect)
 {
 	lowerInterconnect_ = interconnect;
+	find_lower_conts(interconnect);
+}
+
+void CacheController::find_lower_conts(Interconnect *interconn)
+{
+    BaseMachine &machine = memoryHierarchy_->get_machine();
+    foreach (i, machine.connections.count()) {
+        ConnectionDef *conn_def = machine.connections[i];
+
+        if (strcmp(conn_def->name.buf, interconn->get_name()) != 0)
+            continue;
+
+        foreach (j, conn_def->connections.count()) {
+            SingleConnection *sg = conn_def->connections[j];
+
+            if (sg->type == INTERCONN_TYPE_UPPER) {
+                Controller **cont = machine.controller_hash.get(
+                        sg->controller);
+                assert(cont);
+                lowerCont_ = *cont;
+                lowerSlices_.push(*cont);
+            }
+        }
+    }
+
+    lowerSliceMap_ = SliceMap::create_lower(machine, lowerSlices_,
+            cacheLineBits_);
+}
+
+/**
+ * @brief Lower level controller a request is sent to
+ *
+ * If lower level cache is sliced then pick the slice of requested line.
+ */
+Controller* CacheController::get_lower_cont(MemoryRequest *request)
+{
+    if(!lowerSliceMap_)
+        return lowerCont_;
+
+    return lowerSlices_[lowerSliceMap_->slice_of(
+            request->get_physical_address())];
 }
 
 bool CacheController::cache_hit_cb(void *arg)
@@ -494,13 +594,24 @@ bool CacheController::cache_insert_cb(void *arg)
 				oldTag);
 		if(oldTag != InvalidTag<W64>::INVALID && oldTag != (W64)-1) {
             if(wt_disabled_ && line->state == LINE_MODIFIED) {
-                send_update_message(queueEntry, oldTag);
+                send_update_message(queueEntry, oldTag, line);
+			}
+			if(prefetcher_) {
+				prefetcher_->line_dropped(line,
+						queueEntry->request->is_kernel());
 			}
 		}
 
         line->state = LINE_VALID;
         line->init(cacheLines_->tagOf(queueEntry->request->
                     get_physical_address()));
+        line->prefetched = queueEntry->prefetch;
+
+        if(lineData_) {
+            lineData_->fill(line, queueEntry->data.get(),
+                    queueEntry->request->is_kernel());
+            write_line_data(queueEntry, line);
+        }
 
 		queueEntry->eventFlags[CACHE_INSERT_COMPLETE_EVENT]++;
 		marss_add_event(&cacheInsertComplete_,
@@ -550,6 +661,17 @@ bool CacheController::cache_access_cb(void *arg)
 		bool kernel_req = queueEntry->request->is_kernel();
 		Signal *signal = NULL;
 		int delay;
+
+		if(prefetcher_ && !queueEntry->prefetch &&
+				(type == MEMORY_OP_READ || type == MEMORY_OP_WRITE)) {
+			update_prefetcher(queueEntry->request, hit ? line : NULL);
+		}
+		if(profiler_ && !queueEntry->prefetch &&
+				(type == MEMORY_OP_READ || type == MEMORY_OP_WRITE)) {
+			profiler_->access(queueEntry->request->get_owner_rip(),
+					queueEntry->request->get_physical_address(), hit,
+					kernel_req);
+		}
 		if(hit) {
 			if(type == MEMORY_OP_READ ||
 					type == MEMORY_OP_WRITE) {
@@ -571,10 +693,13 @@ bool CacheController::cache_access_cb(void *arg)
                  * send it to lower caches
                  */
 				if(type == MEMORY_OP_WRITE) {
+					if(lineData_)
+						write_line_data(queueEntry, line);
+
 					if(wt_disabled_) {
                         line->state = LINE_MODIFIED;
 					} else {
-						if(!send_update_message(queueEntry))
+						if(!send_update_message(queueEntry, -1, line))
 							goto retry_cache_access;
 					}
 				}
@@ -589,14 +714,20 @@ bool CacheController::cache_access_cb(void *arg)
                 line->state = LINE_MODIFIED;
                 queueEntry->eventFlags[CACHE_INSERT_COMPLETE_EVENT]++;
 
+                if(lineData_)
+                    lineData_->update(line, queueEntry->data.get(),
+                            kernel_req);
+
                 if(!wt_disabled_) {
-                    if(!send_update_message(queueEntry)) {
+                    if(!send_update_message(queueEntry, -1, line)) {
                         goto retry_cache_access;
                     }
                 }
 			} else if(type == MEMORY_OP_EVICT) {
                 if(is_private()) {
                     line->state = LINE_NOT_VALID;
+                    if(prefetcher_)
+                        prefetcher_->line_dropped(line, kernel_req);
                 }
                 /* Else its an evict message from any coherent cache
                  * so ignore that. */
@@ -620,9 +751,7 @@ bool CacheController::cache_access_cb(void *arg)
 					N_STAT_UPDATE(new_stats.cpurequest.count.miss.write, ++,
 							kernel_req);
 				}
-
-				if(!queueEntry->prefetch && type == MEMORY_OP_READ)
-					do_prefetch(queueEntry->request);
+				queueEntry->request->set_miss(type_);
 			}
             /* else its update and its a cache miss, so ignore that */
 			else {
@@ -687,6 +816,16 @@ bool CacheController::wait_interconnect_cb(void *arg)
          */
 		message.hasData = true;
 		message.dest = queueEntry->source;
+
+		/* Data of a response from below, else of the line */
+		if(lineData_) {
+			message.data = queueEntry->data.get();
+			CacheLine *line = cacheLines_->peek(
+					queueEntry->request->get_physical_address());
+			if(!message.data && line && line->state)
+				message.data = line->get_data();
+		}
+
 		memdebug("Sending message: " << message << endl);
 		success = queueEntry->sendTo->get_controller_request_signal()->
 			emit(&message);
@@ -703,10 +842,14 @@ bool CacheController::wait_interconnect_cb(void *arg)
 					delay, (void*)queueEntry);
 		}
 	} else {
-		if(queueEntry->request->get_type() == MEMORY_OP_UPDATE)
+		if(queueEntry->request->get_type() == MEMORY_OP_UPDATE) {
 			message.hasData = true;
+			message.data = queueEntry->data.get();
+		}
 
-		message.dest = queueEntry->dest;
+		message.dest = get_lower_cont(queueEntry->request);
+		if(!message.dest)
+			message.dest = queueEntry->dest;
 
 		success = lowerInterconnect_->
 			get_controller_request_signal()->emit(&message);
@@ -779,6 +922,10 @@ bool CacheController::clear_entry_cb(void *arg)
 					tmpEntry->dependsAddr = -1;
 				}
             }
+			if(prefetcher_ && queueEntry->prefetch) {
+				prefetcher_->remove_pending(
+						queueEntry->request->get_physical_address());
+			}
 			pendingRequests_.free(queueEntry);
 		}
 
@@ -807,8 +954,17 @@ void CacheController::annul_request(MemoryRequest *request)
 	}
 }
 
+/* Merge the bytes of a committed store into the L1 data line */
+void CacheController::write_line_data(CacheQueueEntry *queueEntry,
+		CacheLine *line)
+{
+	if(type_ == L1_D_CACHE &&
+			queueEntry->request->get_type() == MEMORY_OP_WRITE)
+		lineData_->write(line, queueEntry->request);
+}
+
 bool CacheController::send_update_message(CacheQueueEntry *queueEntry,
-		W64 tag)
+		W64 tag, CacheLine *line)
 {
 	MemoryRequest *request = memoryHierarchy_->get_free_request(
             queueEntry->request->get_coreid());
@@ -831,6 +987,13 @@ bool CacheController::send_update_message(CacheQueueEntry *queueEntry,
 		memoryHierarchy_->set_controller_full(this, true);
 	}
 
+	/* Written back data, taken before an evicted line is refilled. A
+	 * writeback of a line this cache does not hold sends the data it got */
+	if(lineData_)
+		memoryHierarchy_->hold_line_data(new_entry->data,
+				line ? line->get_data() : queueEntry->data.get(),
+				request->is_kernel());
+
 	new_entry->request = request;
 	new_entry->sender = NULL;
 	new_entry->sendTo = lowerInterconnect_;
@@ -845,11 +1008,27 @@ bool CacheController::send_update_message(CacheQueueEntry *queueEntry,
 	return true;
 }
 
-void CacheController::do_prefetch(MemoryRequest *request, int additional_delay)
+/**
+ * @brief Account demand access for prefetcher stats and train it
+ *
+ * @param request Demand request accessing this cache
+ * @param line Valid cache line found for this request, NULL on miss
+ */
+void CacheController::update_prefetcher(MemoryRequest *request,
+		CacheLine *line)
 {
-	if(!prefetchEnabled_)
-		return;
+	prefetcher_->demand_access(request->get_owner_rip(),
+			request->get_physical_address(), request->is_kernel(), line,
+			prefetchAddrs_);
 
+	foreach(i, prefetchAddrs_.size()) {
+		do_prefetch(request, prefetchAddrs_[i]);
+	}
+}
+
+void CacheController::do_prefetch(MemoryRequest *request, W64 address,
+		int additional_delay)
+{
     /*
 	 * Don't prefetch if our pending request queue is almost full
 	 * This makes sure that we have some space in queue for new requests
@@ -862,11 +1041,17 @@ void CacheController::do_prefetch(MemoryRequest *request, int additional_delay)
 	assert(new_request);
 
 	new_request->init(request);
+	new_request->set_physical_address(cacheLines_->tagOf(address));
+	new_request->set_op_type(MEMORY_OP_READ);
+	new_request->set_coreSignal(NULL, NULL, -1);
 
-	/* Now generate a new address for the prefetch */
-	W64 next_line_address = get_line_address(request);
-	next_line_address = (next_line_address + 1) << cacheLineBits_;
-	new_request->set_physical_address(next_line_address);
+	/* Skip lines that are already cached or requested */
+	if(find_dependency(new_request))
+		return;
+
+	CacheLine *line = cacheLines_->peek(new_request->get_physical_address());
+	if(line && line->state)
+		return;
 
 	CacheQueueEntry *new_entry = pendingRequests_.alloc();
 	assert(new_entry);
@@ -878,7 +1063,11 @@ void CacheController::do_prefetch(MemoryRequest *request, int additional_delay)
 	new_entry->annuled = false;
 	new_request->incRefCounter();
 	ADD_HISTORY_ADD(new_request);
+	prefetcher_->add_pending(new_request->get_physical_address());
+
+	N_STAT_UPDATE(prefetcher_->stats.issued, ++, new_request->is_kernel());
 
+	new_entry->eventFlags[CACHE_ACCESS_EVENT]++;
 	marss_add_event(&cacheAccess_, prefetchDelay_+additional_delay,
 		   new_entry);
 }
@@ -898,12 +1087,52 @@ void CacheController::dump_configuration(YAML::Emitter &out) const
 	YAML_KEY_VAL(out, "ways", cacheLines_->get_way_count());
 	YAML_KEY_VAL(out, "line_size", cacheLines_->get_line_size());
 	YAML_KEY_VAL(out, "latency", cacheLines_->get_access_latency());
+	YAML_KEY_VAL(out, "replacement", cacheLines_->get_replacement());
 	YAML_KEY_VAL(out, "pending_queue_size", pendingRequests_.size());
 	YAML_KEY_VAL(out, "config", (wt_disabled_ ? "writeback" : "writethrough"));
 
+	if(prefetcher_) {
+		YAML_KEY_VAL(out, "prefetcher", prefetcher_->get_type());
+		YAML_KEY_VAL(out, "prefetch_degree", prefetcher_->get_degree());
+		YAML_KEY_VAL(out, "prefetch_distance", prefetcher_->get_distance());
+	}
+
+	if(profiler_) {
+		YAML_KEY_VAL(out, "profile_rate", profiler_->get_rate());
+		YAML_KEY_VAL(out, "profile_lines", profiler_->get_max_lines());
+	}
+
 	out << YAML::EndMap;
 }
 
+void CacheController::update_stats()
+{
+	if(profiler_)
+		profiler_->update_stats();
+}
+
+/**
+ * @brief Save cache lines into micro-architectural checkpoint
+ *
+ * @param writer Checkpoint writer positioned in this cache's section
+ */
+void CacheController::save_state(UarchStateWriter& writer) const
+{
+	cacheLines_->save_state(writer);
+}
+
+/**
+ * @brief Restore cache lines from micro-architectural checkpoint
+ *
+ * @param reader Checkpoint reader positioned in this cache's section
+ *
+ * @return false if saved cache geometry does not match
+ */
+bool CacheController::restore_state(UarchStateReader& reader)
+{
+	return cacheLines_->restore_state(reader);
+}
+
 
 /* Cache Controller Builder */
 
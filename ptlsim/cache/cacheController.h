@@ -35,6 +35,9 @@
 #include <cacheConstants.h>
 #include <memoryStats.h>
 #include <cacheLines.h>
+#include <prefetcher.h>
+#include <cacheProfiler.h>
+#include <sliceMap.h>
 
 #include <statsBuilder.h>
 
@@ -81,6 +84,10 @@ struct CacheQueueEntry : public FixStateListObject
 		bool prefetch;
 		bool prefetchCompleted;
 
+		// Line data of a response or writeback this entry received or
+		// a writeback it sends
+		LineDataBuffer data;
+
 		void init() {
 			request = NULL;
 			sender = NULL;
@@ -93,6 +100,7 @@ struct CacheQueueEntry : public FixStateListObject
 			annuled = false;
 			prefetch = false;
 			prefetchCompleted = false;
+			data.reset();
 		}
 
 		ostream& print(ostream& os) const {
@@ -155,9 +163,16 @@ class CacheController : public Controller
 		// Flag to indicate if cache is write through or not
 		bool wt_disabled_;
 
-		// Prefetch related variables
-		bool prefetchEnabled_;
+		// Prefetch related variables, prefetcher_ is NULL if not enabled
+		Prefetcher *prefetcher_;
 		int prefetchDelay_;
+		dynarray<W64> prefetchAddrs_;
+
+		// Miss and reuse distance profiler, NULL if not enabled
+		CacheProfiler *profiler_;
+
+		// Line data pool, NULL if verify-cache is not enabled
+		LineDataPool *lineData_;
 
 		// This caches are connected to only two interconnects
 		// upper and lower interconnect.
@@ -167,6 +182,12 @@ class CacheController : public Controller
 		// caches where L2 is connected to L1i and L1d
 		Interconnect *upperInterconnect2_;
 
+		// Controller below this cache, if the lower cache is sliced
+		// lowerSlices_ holds all slices indexed by slice id
+		Controller *lowerCont_;
+		dynarray<Controller*> lowerSlices_;
+		SliceMap *lowerSliceMap_;
+
 
 		// All signals of cache
 		Signal clearEntry_;
@@ -192,9 +213,15 @@ class CacheController : public Controller
 		}
 
 		bool send_update_message(CacheQueueEntry *queueEntry,
-				W64 tag=-1);
+				W64 tag=-1, CacheLine *line=NULL);
 
-		void do_prefetch(MemoryRequest *request, int additional_delay=0);
+		void write_line_data(CacheQueueEntry *queueEntry, CacheLine *line);
+
+		void find_lower_conts(Interconnect *interconn);
+
+		void update_prefetcher(MemoryRequest *request, CacheLine *line);
+		void do_prefetch(MemoryRequest *request, W64 address,
+				int additional_delay=0);
 
 	public:
 		CacheController(W8 coreid, const char *name,
@@ -212,6 +239,9 @@ class CacheController : public Controller
 
 		void annul_request(MemoryRequest *request);
 		void dump_configuration(YAML::Emitter &out) const;
+		void update_stats();
+		void save_state(UarchStateWriter& writer) const;
+		bool restore_state(UarchStateReader& reader);
 
 		// Callback functions for signals of cache
 		bool cache_hit_cb(void *arg);
@@ -223,6 +253,8 @@ class CacheController : public Controller
 		bool wait_interconnect_cb(void *arg);
 		bool clear_entry_cb(void *arg);
 
+		Controller* get_lower_cont(MemoryRequest *request);
+
 		void set_lowest_private(bool flag) {
 			isLowestPrivate_ = flag;
 		}
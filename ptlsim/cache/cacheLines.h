@@ -29,24 +29,56 @@
 #define CACHE_LINES_H
 
 #include <logic.h>
+#include <uarch-checkpoint.h>
+#include <memoryStats.h>
+#include <replacement.h>
+#include <partition.h>
+#include <lineData.h>
 
 namespace Memory {
 
+    /*
+     * The CacheLine overloads below hide the superstl comma streaming
+     * from unqualified lookup in Memory, bring it back in scope.
+     */
+    using superstl::operator ,;
+
     struct CacheLine
     {
         W64 tag;
         /* This is a generic variable used by all caches to represent its
          * coherence state */
         W8 state;
+        /* Line was filled by a prefetch and not referenced yet */
+        bool prefetched;
+        /* Line data buffer with verify-cache, kept when the line is
+         * replaced. 'dataValid' is set only once a fill or a write gave it
+         * the data of 'tag' */
+        W8 *data;
+        bool dataValid;
+
+        CacheLine()
+            : tag(-1), state(0), prefetched(false)
+              , data(NULL), dataValid(false)
+        {}
 
         void init(W64 tag_t) {
             tag = tag_t;
+            prefetched = false;
+            dataValid = false;
             if (tag == (W64)-1) state = 0;
         }
 
         void reset() {
             tag = -1;
             state = 0;
+            prefetched = false;
+            dataValid = false;
+        }
+
+        /* Data of the line, NULL if it has none */
+        const W8* get_data() const {
+            return dataValid ? data : NULL;
         }
 
         void invalidate() { reset(); }
@@ -78,6 +110,8 @@ namespace Memory {
             virtual W64 tagOf(W64 address)=0;
             virtual int latency() const =0;
             virtual CacheLine* probe(MemoryRequest *request)=0;
+            /* Find the line of an address without side effects */
+            virtual CacheLine* peek(W64 address)=0;
             virtual CacheLine* insert(MemoryRequest *request,
                     W64& oldTag)=0;
             virtual int invalidate(MemoryRequest *request)=0;
@@ -89,9 +123,24 @@ namespace Memory {
 			virtual int get_set_count() const=0;
 			virtual int get_way_count() const=0;
 			virtual int get_line_size() const=0;
+            virtual const char* get_replacement() const=0;
+            virtual void init_stats(Statable *parent)=0;
+            virtual void set_partition(WayPartition *partition)=0;
+            virtual void save_state(UarchStateWriter& writer) const=0;
+            virtual bool restore_state(UarchStateReader& reader)=0;
+
+            /* Pool of line data buffers, only needed by lines that free
+             * their storage before the end of the simulation */
+            virtual void set_line_data(LineDataPool *pool) {}
+
+            /* Only caches with run time geometry can be resized */
+            virtual bool set_geometry(int sets, int ways, int latency) {
+                return false;
+            }
     };
 
-    template <int SET_COUNT, int WAY_COUNT, int LINE_SIZE, int LATENCY>
+    template <int SET_COUNT, int WAY_COUNT, int LINE_SIZE, int LATENCY,
+             int POLICY = REPL_NRU>
         class CacheLines : public CacheLinesBase,
         public AssociativeArray<W64, CacheLine, SET_COUNT,
         WAY_COUNT, LINE_SIZE>
@@ -103,6 +152,16 @@ namespace Memory {
             int writePorts_;
             W64 lastAccessCycle_;
 
+            typename ReplacementPolicy<POLICY, SET_COUNT,
+                     WAY_COUNT>::type policy_;
+
+            // Lines referenced since they were filled
+            bitvec<WAY_COUNT> reused_[SET_COUNT];
+
+            ReplacementStats *stats_;
+
+            WayPartition *partition_;
+
         public:
             typedef AssociativeArray<W64, CacheLine, SET_COUNT,
                     WAY_COUNT, LINE_SIZE> base_t;
@@ -115,10 +174,18 @@ namespace Memory {
             W64 tagOf(W64 address);
             int latency() const { return LATENCY; };
             CacheLine* probe(MemoryRequest *request);
+            CacheLine* peek(W64 address);
             CacheLine* insert(MemoryRequest *request, W64& oldTag);
             int invalidate(MemoryRequest *request);
             bool get_port(MemoryRequest *request);
             void print(ostream& os) const;
+            void init_stats(Statable *parent);
+            void set_partition(WayPartition *partition) {
+                assert(WAY_COUNT <= 64);
+                partition_ = partition;
+            }
+            void save_state(UarchStateWriter& writer) const;
+            bool restore_state(UarchStateReader& reader);
 
 			/**
 			 * @brief Get Cache Size
@@ -163,82 +230,191 @@ namespace Memory {
             int get_access_latency() const {
                 return LATENCY;
             }
+
+            const char* get_replacement() const {
+                return repl_policy_names[POLICY];
+            }
     };
 
-    template <int SET_COUNT, int WAY_COUNT, int LINE_SIZE, int LATENCY>
+    template <int SET_COUNT, int WAY_COUNT, int LINE_SIZE, int LATENCY, int POLICY>
         static inline ostream& operator <<(ostream& os, const
-                CacheLines<SET_COUNT, WAY_COUNT, LINE_SIZE, LATENCY>&
+                CacheLines<SET_COUNT, WAY_COUNT, LINE_SIZE, LATENCY, POLICY>&
                 cacheLines)
         {
             cacheLines.print(os);
             return os;
         }
 
-    template <int SET_COUNT, int WAY_COUNT, int LINE_SIZE, int LATENCY>
+    template <int SET_COUNT, int WAY_COUNT, int LINE_SIZE, int LATENCY, int POLICY>
         static inline ostream& operator ,(ostream& os, const
-                CacheLines<SET_COUNT, WAY_COUNT, LINE_SIZE, LATENCY>&
+                CacheLines<SET_COUNT, WAY_COUNT, LINE_SIZE, LATENCY, POLICY>&
                 cacheLines)
         {
             cacheLines.print(os);
             return os;
         }
 
-    template <int SET_COUNT, int WAY_COUNT, int LINE_SIZE, int LATENCY>
-        CacheLines<SET_COUNT, WAY_COUNT, LINE_SIZE, LATENCY>::CacheLines(int readPorts, int writePorts) :
+    template <int SET_COUNT, int WAY_COUNT, int LINE_SIZE, int LATENCY, int POLICY>
+        CacheLines<SET_COUNT, WAY_COUNT, LINE_SIZE, LATENCY, POLICY>::CacheLines(int readPorts, int writePorts) :
             readPorts_(readPorts)
             , writePorts_(writePorts)
     {
         lastAccessCycle_ = 0;
         readPortUsed_ = 0;
         writePortUsed_ = 0;
+        stats_ = NULL;
+        partition_ = NULL;
     }
 
-    template <int SET_COUNT, int WAY_COUNT, int LINE_SIZE, int LATENCY>
-        void CacheLines<SET_COUNT, WAY_COUNT, LINE_SIZE, LATENCY>::init()
+    template <int SET_COUNT, int WAY_COUNT, int LINE_SIZE, int LATENCY, int POLICY>
+        void CacheLines<SET_COUNT, WAY_COUNT, LINE_SIZE, LATENCY, POLICY>::init()
         {
             foreach(i, SET_COUNT) {
                 Set &set = base_t::sets[i];
                 foreach(j, WAY_COUNT) {
                     set.data[j].init(-1);
                 }
+                reused_[i] = 0;
             }
+            policy_.reset();
         }
 
-    template <int SET_COUNT, int WAY_COUNT, int LINE_SIZE, int LATENCY>
-        W64 CacheLines<SET_COUNT, WAY_COUNT, LINE_SIZE, LATENCY>::tagOf(W64 address)
+    template <int SET_COUNT, int WAY_COUNT, int LINE_SIZE, int LATENCY, int POLICY>
+        void CacheLines<SET_COUNT, WAY_COUNT, LINE_SIZE, LATENCY, POLICY>::init_stats(Statable *parent)
+        {
+            stats_ = new ReplacementStats(parent);
+        }
+
+    template <int SET_COUNT, int WAY_COUNT, int LINE_SIZE, int LATENCY, int POLICY>
+        W64 CacheLines<SET_COUNT, WAY_COUNT, LINE_SIZE, LATENCY, POLICY>::tagOf(W64 address)
         {
             return floor(address, LINE_SIZE);
         }
 
 
     // Return true if valid line is found, else return false
-    template <int SET_COUNT, int WAY_COUNT, int LINE_SIZE, int LATENCY>
-        CacheLine* CacheLines<SET_COUNT, WAY_COUNT, LINE_SIZE, LATENCY>::probe(MemoryRequest *request)
+    template <int SET_COUNT, int WAY_COUNT, int LINE_SIZE, int LATENCY, int POLICY>
+        CacheLine* CacheLines<SET_COUNT, WAY_COUNT, LINE_SIZE, LATENCY, POLICY>::probe(MemoryRequest *request)
         {
             W64 physAddress = request->get_physical_address();
-            CacheLine *line = base_t::probe(physAddress);
+            int setIdx = base_t::setof(physAddress);
+            Set &set = base_t::sets[setIdx];
+            int way = set.tags.match(base_t::tagof(physAddress));
+            bool kernel = request->is_kernel();
+
+            if(stats_)
+                N_STAT_UPDATE(stats_->accesses, ++, kernel);
 
-            return line;
+            if(partition_)
+                partition_->access(request->get_coreid(), setIdx,
+                        base_t::tagof(physAddress), way >= 0, kernel);
+
+            if(way < 0)
+                return NULL;
+
+            policy_.hit(setIdx, way);
+            reused_[setIdx][way] = 1;
+
+            if(stats_)
+                N_STAT_UPDATE(stats_->hits, ++, kernel);
+
+            return &set.data[way];
+        }
+
+    template <int SET_COUNT, int WAY_COUNT, int LINE_SIZE, int LATENCY, int POLICY>
+        CacheLine* CacheLines<SET_COUNT, WAY_COUNT, LINE_SIZE, LATENCY, POLICY>::peek(W64 address)
+        {
+            Set &set = base_t::sets[base_t::setof(address)];
+            int way = set.tags.match(base_t::tagof(address));
+
+            if(way < 0)
+                return NULL;
+
+            return &set.data[way];
         }
 
-    template <int SET_COUNT, int WAY_COUNT, int LINE_SIZE, int LATENCY>
-        CacheLine* CacheLines<SET_COUNT, WAY_COUNT, LINE_SIZE, LATENCY>::insert(MemoryRequest *request, W64& oldTag)
+    template <int SET_COUNT, int WAY_COUNT, int LINE_SIZE, int LATENCY, int POLICY>
+        CacheLine* CacheLines<SET_COUNT, WAY_COUNT, LINE_SIZE, LATENCY, POLICY>::insert(MemoryRequest *request, W64& oldTag)
         {
             W64 physAddress = request->get_physical_address();
-            CacheLine *line = base_t::select(physAddress, oldTag);
+            W64 tag = base_t::tagof(physAddress);
+            int setIdx = base_t::setof(physAddress);
+            Set &set = base_t::sets[setIdx];
+            bool kernel = request->is_kernel();
+
+            int way = set.tags.match(tag);
+            if(way >= 0) {
+                policy_.touch(setIdx, way);
+                return &set.data[way];
+            }
+
+            // Ways this request may allocate into
+            bitvec<WAY_COUNT> mask;
+            if(partition_)
+                mask = partition_->alloc_mask(request->get_coreid());
+            else
+                mask.setall();
+
+            int invalid = -1;
+            foreach(j, WAY_COUNT) {
+                if(mask[j] && set.tags[j] == set.tags.INVALID) {
+                    invalid = j;
+                    break;
+                }
+            }
 
-            return line;
+            way = policy_.victim(setIdx, invalid, mask);
+            oldTag = set.tags[way];
+
+            if(oldTag != set.tags.INVALID) {
+                policy_.evict(setIdx, way);
+                if(partition_)
+                    partition_->evict(setIdx, way, kernel);
+                if(stats_) {
+                    N_STAT_UPDATE(stats_->evictions, ++, kernel);
+                    if(!reused_[setIdx][way])
+                        N_STAT_UPDATE(stats_->dead_evictions, ++, kernel);
+                }
+            }
+
+            set.tags[way] = tag;
+            reused_[setIdx][way] = 0;
+            bool distant = policy_.fill(setIdx, way,
+                    request->get_owner_rip());
+
+            if(partition_)
+                partition_->fill(request->get_coreid(), setIdx, way, kernel);
+
+            if(stats_) {
+                N_STAT_UPDATE(stats_->fills, ++, kernel);
+                if(distant)
+                    N_STAT_UPDATE(stats_->distant_fills, ++, kernel);
+            }
+
+            return &set.data[way];
         }
 
-    template <int SET_COUNT, int WAY_COUNT, int LINE_SIZE, int LATENCY>
-        int CacheLines<SET_COUNT, WAY_COUNT, LINE_SIZE, LATENCY>::invalidate(MemoryRequest *request)
+    template <int SET_COUNT, int WAY_COUNT, int LINE_SIZE, int LATENCY, int POLICY>
+        int CacheLines<SET_COUNT, WAY_COUNT, LINE_SIZE, LATENCY, POLICY>::invalidate(MemoryRequest *request)
         {
-            return base_t::invalidate(request->get_physical_address());
+            W64 physAddress = request->get_physical_address();
+            int setIdx = base_t::setof(physAddress);
+            Set &set = base_t::sets[setIdx];
+            int way = set.tags.match(base_t::tagof(physAddress));
+
+            if(way < 0)
+                return -1;
+
+            set.invalidate_way(way);
+            policy_.invalidate(setIdx, way);
+            if(partition_)
+                partition_->evict(setIdx, way, request->is_kernel());
+            return way;
         }
 
 
-    template <int SET_COUNT, int WAY_COUNT, int LINE_SIZE, int LATENCY>
-        bool CacheLines<SET_COUNT, WAY_COUNT, LINE_SIZE, LATENCY>::get_port(MemoryRequest *request)
+    template <int SET_COUNT, int WAY_COUNT, int LINE_SIZE, int LATENCY, int POLICY>
+        bool CacheLines<SET_COUNT, WAY_COUNT, LINE_SIZE, LATENCY, POLICY>::get_port(MemoryRequest *request)
         {
             bool rc = false;
 
@@ -265,8 +441,8 @@ namespace Memory {
             return rc;
         }
 
-    template <int SET_COUNT, int WAY_COUNT, int LINE_SIZE, int LATENCY>
-        void CacheLines<SET_COUNT, WAY_COUNT, LINE_SIZE, LATENCY>::print(ostream& os) const
+    template <int SET_COUNT, int WAY_COUNT, int LINE_SIZE, int LATENCY, int POLICY>
+        void CacheLines<SET_COUNT, WAY_COUNT, LINE_SIZE, LATENCY, POLICY>::print(ostream& os) const
         {
             foreach(i, SET_COUNT) {
                 const Set &set = base_t::sets[i];
@@ -276,6 +452,98 @@ namespace Memory {
             }
         }
 
+    /**
+     * @brief Save tags, line states and replacement state of all sets
+     */
+    template <int SET_COUNT, int WAY_COUNT, int LINE_SIZE, int LATENCY, int POLICY>
+        void CacheLines<SET_COUNT, WAY_COUNT, LINE_SIZE, LATENCY, POLICY>::save_state(UarchStateWriter& writer) const
+        {
+            writer.put((W32)SET_COUNT);
+            writer.put((W32)WAY_COUNT);
+            writer.put((W32)LINE_SIZE);
+            writer.put((W32)POLICY);
+
+            foreach(i, SET_COUNT) {
+                const Set &set = base_t::sets[i];
+                foreach(j, WAY_COUNT) {
+                    writer.put((W64)set.tags.tags[j]);
+                    writer.put((W64)set.data[j].tag);
+                    writer.put((W8)set.data[j].state);
+                }
+                writer.put_bits(reused_[i]);
+            }
+
+            policy_.save_state(writer);
+        }
+
+    /**
+     * @brief Restore state saved by save_state()
+     *
+     * The section is read into temporary tables that replace the cache
+     * state only once everything was read.
+     *
+     * @return false if saved geometry does not match this cache or the
+     * section is truncated, in that case cache is left untouched
+     */
+    template <int SET_COUNT, int WAY_COUNT, int LINE_SIZE, int LATENCY, int POLICY>
+        bool CacheLines<SET_COUNT, WAY_COUNT, LINE_SIZE, LATENCY, POLICY>::restore_state(UarchStateReader& reader)
+        {
+            typedef typename ReplacementPolicy<POLICY, SET_COUNT,
+                    WAY_COUNT>::type policy_t;
+            W32 sets, ways, lineSize, policy;
+
+            if (!reader.get(sets) || !reader.get(ways) ||
+                    !reader.get(lineSize) || !reader.get(policy))
+                return false;
+
+            if (sets != SET_COUNT || ways != WAY_COUNT ||
+                    lineSize != LINE_SIZE || policy != POLICY)
+                return false;
+
+            int lines = SET_COUNT * WAY_COUNT;
+            W64 *tags = new W64[lines];
+            W64 *lineTags = new W64[lines];
+            W8 *states = new W8[lines];
+            bitvec<WAY_COUNT> *reused = new bitvec<WAY_COUNT>[SET_COUNT];
+            policy_t *savedPolicy = new policy_t;
+            bool rc = true;
+
+            for (int i = 0; rc && i < SET_COUNT; i++) {
+                for (int j = 0; rc && j < WAY_COUNT; j++) {
+                    int idx = i * WAY_COUNT + j;
+                    rc = reader.get(tags[idx]) && reader.get(lineTags[idx]) &&
+                        reader.get(states[idx]);
+                }
+                rc = rc && reader.get_bits(reused[i]);
+            }
+
+            rc = rc && savedPolicy->restore_state(reader);
+
+            if (rc) {
+                foreach(i, SET_COUNT) {
+                    Set &set = base_t::sets[i];
+                    foreach(j, WAY_COUNT) {
+                        int idx = i * WAY_COUNT + j;
+                        CacheLine &line = set.data[j];
+                        set.tags.tags[j] = tags[idx];
+                        line.init(lineTags[idx]);
+                        line.state = states[idx];
+                    }
+                    set.tags.evictmap = 0;
+                    reused_[i] = reused[i];
+                }
+                policy_ = *savedPolicy;
+            }
+
+            delete [] tags;
+            delete [] lineTags;
+            delete [] states;
+            delete [] reused;
+            delete savedPolicy;
+
+            return rc;
+        }
+
 };
 
 #endif // CACHE_LINES_H
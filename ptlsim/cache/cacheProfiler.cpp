@@ -0,0 +1,407 @@
+/*
+ * MARSSx86 : A Full System Computer-Architecture Simulator
+ *
+ * This code is released under GPL.
+ *
+ */
+
+#ifdef MEM_TEST
+#include <test.h>
+#else
+#include <ptlsim.h>
+#endif
+
+#include <cacheProfiler.h>
+#include <memoryStats.h>
+#include <machine.h>
+
+using namespace Memory;
+
+static const W64 INVALID_LINE = (W64)-1;
+
+ReuseSampler::ReuseSampler(int maxLines, int rate)
+    : maxLines_(maxLines)
+    , rate_(rate)
+    , count_(0)
+    , now_(0)
+{
+    assert(maxLines_ > 0 && rate_ >= 0 && rate_ <= MAX_RATE);
+
+    /* Half of the times are free after each renumbering */
+    timeCount_ = 2 * maxLines_;
+
+    /* Keep the hash table at most half full */
+    W64 tableSize = 1;
+    while (tableSize < (W64)timeCount_)
+        tableSize <<= 1;
+    tableMask_ = tableSize - 1;
+
+    table_ = new Entry[tableSize];
+    owner_ = new W64[timeCount_];
+    tree_ = new W32[timeCount_ + 1];
+
+    memset(table_, 0xff, sizeof(Entry) * tableSize);
+    memset(tree_, 0, sizeof(W32) * (timeCount_ + 1));
+}
+
+ReuseSampler::~ReuseSampler()
+{
+    delete [] table_;
+    delete [] owner_;
+    delete [] tree_;
+}
+
+/*
+ * 64 bit mix function, the top bits select sampled lines and the low bits
+ * index the table.
+ */
+W64 ReuseSampler::hash(W64 line)
+{
+    W64 x = line + 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+/*
+ * Linear probing, returns the entry of 'line' or the empty entry where it
+ * would be inserted. Entries are never removed one by one, rebuild() drops
+ * them all at once.
+ */
+ReuseSampler::Entry *ReuseSampler::find(W64 line, W64 hash)
+{
+    W64 index = hash & tableMask_;
+
+    while (table_[index].line != line &&
+            table_[index].line != INVALID_LINE) {
+        index = (index + 1) & tableMask_;
+    }
+
+    return &table_[index];
+}
+
+void ReuseSampler::tree_add(W32 time, int value)
+{
+    for (W32 i = time + 1; i <= timeCount_; i += i & -i)
+        tree_[i] += value;
+}
+
+/* Number of tracked lines last accessed at or before 'time' */
+W32 ReuseSampler::tree_count(W32 time) const
+{
+    W32 count = 0;
+
+    for (W32 i = time + 1; i > 0; i -= i & -i)
+        count += tree_[i];
+
+    return count;
+}
+
+/*
+ * Renumber the last access times of tracked lines from 0 in access order
+ * and drop the lines that are not sampled at the current rate.
+ */
+void ReuseSampler::rebuild()
+{
+    W32 live = 0;
+
+    foreach (i, now_) {
+        W64 line = owner_[i];
+        if (line == INVALID_LINE || !is_sampled(hash(line)))
+            continue;
+        owner_[live++] = line;
+    }
+
+    memset(table_, 0xff, sizeof(Entry) * (tableMask_ + 1));
+    memset(tree_, 0, sizeof(W32) * (timeCount_ + 1));
+
+    foreach (i, live) {
+        Entry *entry = find(owner_[i], hash(owner_[i]));
+        entry->line = owner_[i];
+        entry->time = i;
+        tree_[i + 1] = 1;
+    }
+
+    /* Linear time Fenwick tree build */
+    for (W32 node = 1; node <= timeCount_; node++) {
+        W32 parent = node + (node & -node);
+        if (parent <= timeCount_)
+            tree_[parent] += tree_[node];
+    }
+
+    count_ = live;
+    now_ = live;
+}
+
+bool ReuseSampler::access(W64 line, W64 &distance)
+{
+    W64 h = hash(line);
+
+    if (!is_sampled(h))
+        return false;
+
+    if (now_ == timeCount_)
+        rebuild();
+
+    Entry *entry = find(line, h);
+
+    if (entry->line == line) {
+        distance = (W64)(count_ - tree_count(entry->time)) << rate_;
+        tree_add(entry->time, -1);
+        owner_[entry->time] = INVALID_LINE;
+        count_--;
+    } else {
+        while (count_ == maxLines_) {
+            if (rate_ == MAX_RATE)
+                return false;
+
+            rate_++;
+            rebuild();
+
+            if (!is_sampled(h))
+                return false;
+        }
+
+        entry = find(line, h);
+        entry->line = line;
+        distance = COLD;
+    }
+
+    entry->time = now_;
+    owner_[now_] = line;
+    tree_add(now_, 1);
+    now_++;
+    count_++;
+
+    return true;
+}
+
+MissSketch::MissSketch(int widthBits)
+    : widthBits_(widthBits)
+    , topCount_(0)
+{
+    /* Each row uses its own 16 bits of one hash */
+    assert(widthBits_ > 0 && widthBits_ <= 16);
+
+    counts_ = new W64[ROWS << widthBits_];
+    memset(counts_, 0, sizeof(W64) * (ROWS << widthBits_));
+}
+
+MissSketch::~MissSketch()
+{
+    delete [] counts_;
+}
+
+W64& MissSketch::counter(int row, W64 hash) const
+{
+    W64 column = (hash >> (row * 16)) & ((1 << widthBits_) - 1);
+    return counts_[(row << widthBits_) + column];
+}
+
+W64 MissSketch::estimate(W64 key) const
+{
+    W64 h = ReuseSampler::hash(key);
+    W64 count = counter(0, h);
+
+    for (int row = 1; row < ROWS; row++)
+        count = min(count, counter(row, h));
+
+    return count;
+}
+
+void MissSketch::add(W64 key)
+{
+    W64 h = ReuseSampler::hash(key);
+    W64 count = estimate(key) + 1;
+
+    foreach (row, ROWS) {
+        W64 &c = counter(row, h);
+        if (c < count)
+            c = count;
+    }
+
+    int low = 0;
+    foreach (i, topCount_) {
+        if (top_[i].key == key) {
+            top_[i].count = count;
+            return;
+        }
+        if (top_[i].count < top_[low].count)
+            low = i;
+    }
+
+    if (topCount_ < TOP) {
+        low = topCount_++;
+    } else if (top_[low].count >= count) {
+        return;
+    }
+
+    top_[low].key = key;
+    top_[low].count = count;
+}
+
+int MissSketch::get_top(Top *top) const
+{
+    /* Insertion sort, the table is small */
+    foreach (i, topCount_) {
+        Top entry = top_[i];
+        int j = i;
+        while (j > 0 && top[j - 1].count < entry.count) {
+            top[j] = top[j - 1];
+            j--;
+        }
+        top[j] = entry;
+    }
+
+    return topCount_;
+}
+
+CacheProfiler::CacheProfiler(Statable *parent, int lineBits, int maxLines,
+        int rate)
+    : lineBits_(lineBits)
+    , reuse_(maxLines, rate)
+    , stats(parent)
+{
+    foreach (i, 2) {
+        pcs_[i] = new MissSketch(10);
+        pages_[i] = new MissSketch(10);
+    }
+}
+
+CacheProfiler::~CacheProfiler()
+{
+    foreach (i, 2) {
+        delete pcs_[i];
+        delete pages_[i];
+    }
+}
+
+void CacheProfiler::access(W64 pc, W64 address, bool hit, bool kernel)
+{
+    W64 distance;
+
+    if (reuse_.access(address >> lineBits_, distance)) {
+        W64 weight = 1ULL << reuse_.get_rate();
+
+        N_STAT_UPDATE(stats.sampled, ++, kernel);
+        N_STAT_UPDATE(stats.accesses, += weight, kernel);
+
+        if (distance == ReuseSampler::COLD) {
+            N_STAT_UPDATE(stats.cold, += weight, kernel);
+            foreach (i, CacheProfileStats::DISTANCES) {
+                N_STAT_UPDATE(stats.lru_misses, [i] += weight, kernel);
+            }
+        } else {
+            int bucket = distance ? min((int)msbindex64(distance) + 1,
+                    CacheProfileStats::DISTANCES - 1) : 0;
+            N_STAT_UPDATE(stats.distance, [bucket] += weight, kernel);
+
+            /* A cache of 2^i lines misses when 2^i <= distance */
+            for (int i = 0; i < CacheProfileStats::DISTANCES &&
+                    (1ULL << i) <= distance; i++) {
+                N_STAT_UPDATE(stats.lru_misses, [i] += weight, kernel);
+            }
+        }
+    }
+
+    if (!hit) {
+        pcs_[kernel]->add(pc);
+        pages_[kernel]->add(address & ~(W64)(PAGE_SIZE - 1));
+    }
+}
+
+/*
+ * Top keys of one mode, or of both for the global stats. Global counts
+ * add the estimates of both sketches for the top keys of either.
+ */
+void CacheProfiler::dump_top(MissSketch **sketches, int mode,
+        StatArray<W64, CacheProfileStats::TOP> &keys,
+        StatArray<W64, CacheProfileStats::TOP> &counts, Stats *stats)
+{
+    const int TOP = CacheProfileStats::TOP;
+    MissSketch::Top top[2 * TOP];
+    int n;
+
+    if (mode < 2) {
+        n = sketches[mode]->get_top(top);
+    } else {
+        n = sketches[0]->get_top(top);
+        int kernelCount = sketches[1]->get_top(top + n);
+
+        /* Merge duplicates and sort by the sum of both estimates */
+        int merged = 0;
+        foreach (i, n + kernelCount) {
+            W64 key = top[i].key;
+            bool seen = false;
+            foreach (j, merged) {
+                seen |= (top[j].key == key);
+            }
+            if (seen) continue;
+
+            MissSketch::Top entry;
+            entry.key = key;
+            entry.count = sketches[0]->estimate(key) +
+                sketches[1]->estimate(key);
+
+            int j = merged++;
+            while (j > 0 && top[j - 1].count < entry.count) {
+                top[j] = top[j - 1];
+                j--;
+            }
+            top[j] = entry;
+        }
+        n = min(merged, TOP);
+    }
+
+    foreach (i, TOP) {
+        keys(stats)[i] = (i < n) ? top[i].key : 0;
+        counts(stats)[i] = (i < n) ? top[i].count : 0;
+    }
+}
+
+void CacheProfiler::update_stats()
+{
+    Stats *modes[3] = { user_stats, kernel_stats, global_stats };
+
+    foreach (mode, 3) {
+        if (!modes[mode]) continue;
+
+        dump_top(pcs_, mode, stats.miss_pc, stats.miss_pc_count,
+                modes[mode]);
+        dump_top(pages_, mode, stats.miss_page, stats.miss_page_count,
+                modes[mode]);
+    }
+}
+
+/**
+ * @brief Create the profiler of a cache from its machine options
+ *
+ * @param machine Machine that owns the cache
+ * @param name Name of the cache, used to look up its options
+ * @param parent Stats object of the cache
+ * @param lineBits Number of bits in cache line offset
+ *
+ * @return NULL if profiling is not enabled for this cache
+ */
+CacheProfiler *CacheProfiler::create(BaseMachine &machine, const char *name,
+        Statable *parent, int lineBits)
+{
+    bool enabled;
+    int rate, maxLines;
+
+    if (!machine.get_option(name, "profile", enabled) || !enabled)
+        return NULL;
+
+    if (!machine.get_option(name, "profile_rate", rate))
+        rate = 6;
+    if (!machine.get_option(name, "profile_lines", maxLines))
+        maxLines = 8192;
+
+    if (rate < 0 || rate > ReuseSampler::MAX_RATE || maxLines <= 0) {
+        ptl_logfile << "[ERROR] ", name, ": invalid profile_rate or ",
+                    "profile_lines", endl;
+        assert_fail(__STRING(0), __FILE__, __LINE__, __PRETTY_FUNCTION__);
+    }
+
+    return new CacheProfiler(parent, lineBits, maxLines, rate);
+}
@@ -0,0 +1,229 @@
+/*
+ * MARSSx86 : A Full System Computer-Architecture Simulator
+ *
+ * This code is released under GPL.
+ *
+ */
+
+#ifndef CACHE_PROFILER_H
+#define CACHE_PROFILER_H
+
+#include <globals.h>
+#include <superstl.h>
+#include <statsBuilder.h>
+
+struct BaseMachine;
+
+namespace Memory {
+
+    /*
+     * Cache profile statistics, counts with a '~' are scaled by the
+     * sampling rate
+     *
+     *  sampled          : accesses that hit the sample filter
+     *  accesses       ~ : demand accesses
+     *  cold           ~ : first references to a line
+     *  distance       ~ : accesses by reuse distance, i.e. the number of
+     *                     distinct lines referenced since the previous
+     *                     access to the same line. Entry 0 counts distance
+     *                     0, entry 'i' distances in [2^(i-1), 2^i).
+     *  lru_misses     ~ : misses of a fully associative LRU cache of 2^i
+     *                     lines; lru_misses[i] / accesses is the miss
+     *                     ratio curve of the access stream of this cache
+     *  miss_pc          : PCs with the most misses in this cache
+     *  miss_pc_count    : estimated misses of each 'miss_pc'
+     *  miss_page        : physical page addresses with the most misses
+     *  miss_page_count  : estimated misses of each 'miss_page'
+     */
+    struct CacheProfileStats : public Statable
+    {
+        static const int DISTANCES = 32;
+        static const int TOP = 16;
+
+        StatObj<W64> sampled;
+        StatObj<W64> accesses;
+        StatObj<W64> cold;
+        StatArray<W64, DISTANCES> distance;
+        StatArray<W64, DISTANCES> lru_misses;
+        StatArray<W64, TOP> miss_pc;
+        StatArray<W64, TOP> miss_pc_count;
+        StatArray<W64, TOP> miss_page;
+        StatArray<W64, TOP> miss_page_count;
+
+        CacheProfileStats(Statable *parent)
+            : Statable("profile", parent)
+              , sampled("sampled", this)
+              , accesses("accesses", this)
+              , cold("cold", this)
+              , distance("distance", this)
+              , lru_misses("lru_misses", this)
+              , miss_pc("miss_pc", this)
+              , miss_pc_count("miss_pc_count", this)
+              , miss_page("miss_page", this)
+              , miss_page_count("miss_page_count", this)
+        {}
+    };
+
+    /**
+     * @brief Spatially sampled reuse distance tracker (SHARDS)
+     *
+     * A line is sampled when the top 'rate' bits of its hash are zero, so
+     * about one line in 2^rate is tracked and every access to a tracked
+     * line is seen. Distances between tracked lines are scaled up by
+     * 2^rate. At most 'maxLines' lines are tracked: when a new line would
+     * not fit the rate is raised by one, which drops about half of the
+     * tracked lines.
+     *
+     * Each tracked line keeps the time of its last access, a Fenwick tree
+     * over times counts the lines accessed after it. Times are renumbered
+     * when they run out, so memory is bounded by 'maxLines'.
+     */
+    class ReuseSampler
+    {
+        public:
+            static const W64 COLD = (W64)-1;
+            static const int MAX_RATE = 30;
+
+        private:
+            struct Entry {
+                W64 line;
+                W32 time;
+            };
+
+            int maxLines_;
+            int rate_;
+            int count_;
+            W32 now_;
+            W32 timeCount_;
+
+            Entry *table_;
+            W64 tableMask_;
+            W64 *owner_;
+            W32 *tree_;
+
+            bool is_sampled(W64 hash) const {
+                return rate_ == 0 || (hash >> (64 - rate_)) == 0;
+            }
+
+            Entry *find(W64 line, W64 hash);
+            void tree_add(W32 time, int value);
+            W32 tree_count(W32 time) const;
+            void rebuild();
+
+        public:
+            ReuseSampler(int maxLines, int rate);
+            ~ReuseSampler();
+
+            static W64 hash(W64 line);
+
+            /**
+             * @brief Observe an access to a line
+             *
+             * @param line Line address of the access
+             * @param distance Set to the scaled reuse distance or COLD
+             *
+             * @return false if the line is not sampled
+             */
+            bool access(W64 line, W64 &distance);
+
+            int get_rate() const { return rate_; }
+            int get_count() const { return count_; }
+            int get_max_lines() const { return maxLines_; }
+    };
+
+    /**
+     * @brief Heavy hitters of a stream of keys in bounded memory
+     *
+     * A count-min sketch estimates the count of any key and a small table
+     * keeps the keys with the highest estimates seen so far. Counters use
+     * conservative update, estimates only overcount by the hash collisions
+     * of the least collided row.
+     */
+    class MissSketch
+    {
+        public:
+            static const int ROWS = 4;
+            static const int TOP = CacheProfileStats::TOP;
+
+            struct Top {
+                W64 key;
+                W64 count;
+            };
+
+        private:
+            int widthBits_;
+            W64 *counts_;
+            Top top_[TOP];
+            int topCount_;
+
+            W64& counter(int row, W64 hash) const;
+
+        public:
+            MissSketch(int widthBits);
+            ~MissSketch();
+
+            void add(W64 key);
+            W64 estimate(W64 key) const;
+
+            /* Copy the top keys by decreasing count, returns their number */
+            int get_top(Top *top) const;
+    };
+
+    /**
+     * @brief Optional per cache miss and reuse distance profiler
+     *
+     * The cache controller shows every demand access to the profiler,
+     * which samples reuse distances of the lines and counts misses per PC
+     * and per physical page. One run gives the miss ratio of this access
+     * stream for all fully associative LRU cache sizes. Options of the
+     * cache:
+     *
+     *  profile       : true to enable the profiler
+     *  profile_rate  : initial sampling, one line in 2^rate (default 6)
+     *  profile_lines : maximum number of sampled lines (default 8192)
+     */
+    class CacheProfiler
+    {
+        private:
+            int lineBits_;
+            ReuseSampler reuse_;
+
+            /* User and kernel miss sketches */
+            MissSketch *pcs_[2];
+            MissSketch *pages_[2];
+
+            void dump_top(MissSketch **sketches, int mode,
+                    StatArray<W64, CacheProfileStats::TOP> &keys,
+                    StatArray<W64, CacheProfileStats::TOP> &counts,
+                    Stats *stats);
+
+        public:
+            CacheProfileStats stats;
+
+            CacheProfiler(Statable *parent, int lineBits, int maxLines,
+                    int rate);
+            ~CacheProfiler();
+
+            /**
+             * @brief Observe a demand access
+             *
+             * @param pc Address of instruction that made the access
+             * @param address Physical address of the access
+             * @param hit True if access hit in the cache
+             * @param kernel True for kernel mode accesses
+             */
+            void access(W64 pc, W64 address, bool hit, bool kernel);
+
+            /* Write the top miss tables into user, kernel and global stats */
+            void update_stats();
+
+            int get_rate() const { return reuse_.get_rate(); }
+            int get_max_lines() const { return reuse_.get_max_lines(); }
+
+            static CacheProfiler *create(BaseMachine &machine,
+                    const char *name, Statable *parent, int lineBits);
+    };
+
+};
+
+#endif // CACHE_PROFILER_H
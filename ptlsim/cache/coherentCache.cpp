@@ -35,6 +35,7 @@
 
 #include <memoryHierarchy.h>
 #include <coherentCache.h>
+#include <dynamicCacheLines.h>
 #include <mesiLogic.h>
 
 #include <machine.h>
@@ -50,13 +51,25 @@ CacheController::CacheController(W8 coreid, const char *name,
     , isLowestPrivate_(false)
     , directory_(NULL)
     , lowerCont_(NULL)
+    , lowerSliceMap_(NULL)
     , coherence_logic_(NULL)
+    , prefetcher_(NULL)
+    , profiler_(NULL)
+    , lineData_(NULL)
+    , sliceStats_(NULL)
+    , partition_(NULL)
 {
     memoryHierarchy_->add_cache_controller(this);
     new_stats = new MESIStats(name, &memoryHierarchy->get_machine());
 
     cacheLines_ = get_cachelines(type);
 
+    if(!configure_cache_geometry(name, cacheLines_)) {
+        ptl_logfile << "[ERROR] " << name << ": invalid cache geometry"
+                    << endl;
+        assert_fail(__STRING(0), __FILE__, __LINE__, __PRETTY_FUNCTION__);
+    }
+
     if(!memoryHierarchy_->get_machine().get_option(name, "last_private", isLowestPrivate_)) {
         isLowestPrivate_ = false;
     }
@@ -66,6 +79,36 @@ CacheController::CacheController(W8 coreid, const char *name,
 
     cacheLines_->init();
 
+    cacheLines_->init_stats(new_stats);
+
+    prefetcher_ = Prefetcher::create(memoryHierarchy_->get_machine(), name,
+            new_stats, cacheLineBits_);
+
+    profiler_ = CacheProfiler::create(memoryHierarchy_->get_machine(), name,
+            new_stats, cacheLineBits_);
+
+    lineData_ = memoryHierarchy_->get_line_data(
+            cacheLines_->get_line_size());
+    cacheLines_->set_line_data(lineData_);
+    if(lineData_ && type_ == L1_D_CACHE)
+        memoryHierarchy_->set_data_cache(idx, cacheLines_);
+
+    sliceMap_ = SliceMap::create(memoryHierarchy_->get_machine(), name,
+            cacheLineBits_);
+    if(sliceMap_) {
+        if(idx >= sliceMap_->count()) {
+            ptl_logfile << "[ERROR] ", name, ": slice id ", idx,
+                        " out of ", sliceMap_->count(), " slices", endl;
+            assert_fail(__STRING(0), __FILE__, __LINE__, __PRETTY_FUNCTION__);
+        }
+        sliceStats_ = new SliceStats(new_stats);
+    }
+
+    partition_ = WayPartition::create(memoryHierarchy_->get_machine(), name,
+            new_stats, cacheLines_->get_set_count(),
+            cacheLines_->get_way_count());
+    if(partition_)
+        cacheLines_->set_partition(partition_);
 
     SET_SIGNAL_CB(name, "_Cache_Hit", cacheHit_, &CacheController::cache_hit_cb);
 
@@ -92,6 +135,18 @@ CacheController::CacheController(W8 coreid, const char *name,
 
 CacheController::~CacheController()
 {
+    if(prefetcher_)
+        delete prefetcher_;
+    if(profiler_)
+        delete profiler_;
+    if(sliceMap_) {
+        delete sliceStats_;
+        delete sliceMap_;
+    }
+    if(lowerSliceMap_)
+        delete lowerSliceMap_;
+    if(partition_)
+        delete partition_;
     delete new_stats;
 }
 
@@ -165,6 +220,29 @@ bool CacheController::handle_upper_interconnect(Message &message)
     memdebug(get_name() <<
             " Received message from upper interconnect\n");
 
+    /* Slices on a broadcast interconnect see requests of all slices,
+     * answer the ones for other slices with a response without data as
+     * the split phase bus waits for a response from every controller. */
+    if(is_other_slice(message.request)) {
+        N_STAT_UPDATE(sliceStats_->filtered, ++,
+                message.request->is_kernel());
+
+        OP_TYPE type = message.request->get_type();
+        if(type == MEMORY_OP_READ || type == MEMORY_OP_WRITE) {
+            Message& response = *memoryHierarchy_->get_message();
+            response.sender   = this;
+            response.request  = message.request;
+            response.dest     = message.origin;
+            response.hasData  = false;
+            response.isShared = false;
+            response.arg      = NULL;
+            upperInterconnect_->get_controller_request_signal()->
+                emit(&response);
+            memoryHierarchy_->free_message(&response);
+        }
+        return true;
+    }
+
     /* set full flag if buffer is full */
     if(is_full()) {
         memoryHierarchy_->set_controller_full(this, true);
@@ -185,6 +263,11 @@ bool CacheController::handle_upper_interconnect(Message &message)
     queueEntry->dest    = (Controller*)message.dest;
     queueEntry->request->incRefCounter();
 
+    /* Keep the data of a writeback until it is written or sent on */
+    if(lineData_ && message.hasData)
+        memoryHierarchy_->hold_line_data(queueEntry->data, message.data,
+                message.request->is_kernel());
+
     queueEntry->eventFlags[CACHE_ACCESS_EVENT]++;
 
     /* Check dependency and access the cache */
@@ -197,6 +280,10 @@ bool CacheController::handle_upper_interconnect(Message &message)
         queueEntry->waitFor = dependsOn->idx;
         OP_TYPE type       = queueEntry->request->get_type();
         bool kernel_req    = queueEntry->request->is_kernel();
+        if(prefetcher_ && prefetcher_->is_pending(
+                    message.request->get_physical_address())) {
+            N_STAT_UPDATE(prefetcher_->stats.late, ++, kernel_req);
+        }
         if(type == MEMORY_OP_READ) {
             N_STAT_UPDATE(new_stats->cpurequest.stall.read.dependency, ++, kernel_req);
         } else if(type == MEMORY_OP_WRITE) {
@@ -277,11 +364,71 @@ bool CacheController::handle_lower_interconnect(Message &message)
 
 }
 
+bool CacheController::is_other_slice(MemoryRequest *request)
+{
+    return sliceMap_ &&
+        sliceMap_->slice_of(request->get_physical_address()) != idx;
+}
+
+/**
+ * @brief Extra latency of a request due to distance to this slice
+ */
+int CacheController::slice_hop_latency(CacheQueueEntry *queueEntry)
+{
+    if(!sliceMap_ || queueEntry->isSnoop || queueEntry->prefetch)
+        return 0;
+
+    bool kernel_req = queueEntry->request->is_kernel();
+    int coreid = queueEntry->request->get_coreid();
+    int hops = sliceMap_->hops(coreid, idx);
+    int latency = sliceMap_->hop_latency(coreid, idx);
+
+    N_STAT_UPDATE(sliceStats_->accesses, ++, kernel_req);
+    N_STAT_UPDATE(sliceStats_->hops, += hops, kernel_req);
+    N_STAT_UPDATE(sliceStats_->hop_cycles, += latency, kernel_req);
+
+    return latency;
+}
+
+/**
+ * @brief Lower level controller a request is sent to
+ *
+ * If lower level cache is sliced then pick the slice of requested line.
+ */
+Controller* CacheController::get_lower_cont(MemoryRequest *request)
+{
+    if(!lowerSliceMap_)
+        return lowerCont_;
+
+    return lowerSlices_[lowerSliceMap_->slice_of(
+            request->get_physical_address())];
+}
+
 bool CacheController::is_line_valid(CacheLine *line)
 {
     return coherence_logic_->is_line_valid(line);
 }
 
+/*
+ * Data of a line if it still holds 'address'. An inserted line keeps the
+ * evicted tag until its writeback is created.
+ */
+const W8* CacheController::get_line_data(CacheLine *line, W64 address)
+{
+    if(!line || line->tag != cacheLines_->tagOf(address))
+        return NULL;
+
+    return line->get_data();
+}
+
+/* Merge the bytes of a committed store into the L1 data line */
+void CacheController::write_line_data(CacheQueueEntry *queueEntry)
+{
+    if(type_ == L1_D_CACHE && queueEntry->line &&
+            queueEntry->request->get_type() == MEMORY_OP_WRITE)
+        lineData_->write(queueEntry->line, queueEntry->request);
+}
+
 void CacheController::send_message(CacheQueueEntry *queueEntry,
         Interconnect *interconn, OP_TYPE type, W64 tag)
 {
@@ -311,6 +458,10 @@ void CacheController::send_message(CacheQueueEntry *queueEntry,
     evictEntry->line    = queueEntry->line;
     evictEntry->request->incRefCounter();
 
+    if(lineData_ && type == MEMORY_OP_UPDATE)
+        memoryHierarchy_->hold_line_data(evictEntry->data,
+                get_line_data(evictEntry->line, tag), request->is_kernel());
+
     //memdebug("Created Evict message: ", *evictEntry, endl);
     ADD_HISTORY_ADD(evictEntry->request);
 
@@ -374,6 +525,12 @@ bool CacheController::complete_request(Message &message,
             oldTag = -1;
         }
 
+        if(prefetcher_ && oldTag != InvalidTag<W64>::INVALID &&
+                oldTag != (W64)-1) {
+            prefetcher_->line_dropped(line,
+                    queueEntry->request->is_kernel());
+        }
+
         queueEntry->line = line;
         handle_cache_insert(queueEntry, oldTag);
         queueEntry->line->init(cacheLines_->tagOf(queueEntry->
@@ -385,11 +542,23 @@ bool CacheController::complete_request(Message &message,
 
     coherence_logic_->complete_request(queueEntry, message);
 
+    if(lineData_) {
+        lineData_->fill(queueEntry->line, message.data,
+                queueEntry->request->is_kernel());
+        write_line_data(queueEntry);
+    }
+
     /* insert the updated line into cache */
     queueEntry->eventFlags[CACHE_INSERT_EVENT]++;
     marss_add_event(&cacheInsert_, 0,
             (void*)(queueEntry));
 
+    /* Prefetches have no requester to respond to */
+    if(queueEntry->prefetch) {
+        queueEntry->line->prefetched = true;
+        return true;
+    }
+
     /* send back the response */
     queueEntry->sendTo = queueEntry->sender;
     marss_add_event(&waitInterconnect_, 1, queueEntry);
@@ -436,6 +605,12 @@ int CacheController::access_fast_path(Interconnect *interconnect,
             request->get_type() != MEMORY_OP_WRITE) {
         N_STAT_UPDATE(new_stats->cpurequest.count.hit.read.hit, ++,
                 request->is_kernel());
+        if(prefetcher_)
+            update_prefetcher(request, line);
+        if(profiler_)
+            profiler_->access(request->get_owner_rip(),
+                    request->get_physical_address(), true,
+                    request->is_kernel());
         return cacheLines_->latency();
     }
 
@@ -496,6 +671,7 @@ void CacheController::get_directory(Interconnect *interconn)
                                 sg->controller);
                         assert(cont);
                         lowerCont_ = *cont;
+                        lowerSlices_.push(*cont);
                         break;
                     default:
                         break;
@@ -503,6 +679,9 @@ void CacheController::get_directory(Interconnect *interconn)
             }
         }
     }
+
+    lowerSliceMap_ = SliceMap::create_lower(machine, lowerSlices_,
+            cacheLineBits_);
 }
 
 void CacheController::register_upper_interconnect(Interconnect *interconnect)
@@ -536,9 +715,30 @@ bool CacheController::cache_hit_cb(void *arg)
              * free queue entries we delay this by 2 cycles */
             marss_add_event(&cacheHit_, 2, queueEntry);
         } else {
+            CacheLine *line = queueEntry->line;
+            bool kernel_req = queueEntry->request->is_kernel();
+
+            /* Snoop response carries the data the line has before the
+             * snoop changes its state */
+            if(lineData_)
+                memoryHierarchy_->hold_line_data(queueEntry->data,
+                        line ? line->get_data() : NULL, kernel_req);
+
             coherence_logic_->handle_interconn_hit(queueEntry);
+
+            /* Snoop invalidated a prefetched line before its first use */
+            if(prefetcher_ && line && !is_line_valid(line))
+                prefetcher_->line_dropped(line, kernel_req);
         }
     } else {
+        if(lineData_ && queueEntry->line) {
+            if(queueEntry->request->get_type() == MEMORY_OP_UPDATE)
+                lineData_->update(queueEntry->line, queueEntry->data.get(),
+                        queueEntry->request->is_kernel());
+            else
+                write_line_data(queueEntry);
+        }
+
         coherence_logic_->handle_local_hit(queueEntry);
     }
 
@@ -555,8 +755,12 @@ bool CacheController::cache_miss_cb(void *arg)
 
     if(queueEntry->request->get_type() == MEMORY_OP_EVICT &&
             !is_lowest_private()) {
-        if(queueEntry->line)
+        if(queueEntry->line) {
             coherence_logic_->invalidate_line(queueEntry->line);
+            if(prefetcher_)
+                prefetcher_->line_dropped(queueEntry->line,
+                        queueEntry->request->is_kernel());
+        }
         clear_entry_cb(queueEntry);
         return true;
     }
@@ -642,6 +846,30 @@ bool CacheController::cache_access_cb(void *arg)
         if(line) hit = true;
         else hit = false;
 
+        if(queueEntry->prefetch) {
+            /* Line arrived in the meantime, drop the prefetch */
+            if(hit && is_line_valid(line)) {
+                clear_entry_cb(queueEntry);
+                return true;
+            }
+            marss_add_event(&cacheMiss_, cacheAccessLatency_,
+                    (void*)queueEntry);
+            return true;
+        }
+
+        if(prefetcher_ && !queueEntry->isSnoop &&
+                (type == MEMORY_OP_READ || type == MEMORY_OP_WRITE)) {
+            update_prefetcher(queueEntry->request, line);
+        }
+
+        if(profiler_ && !queueEntry->isSnoop &&
+                (type == MEMORY_OP_READ || type == MEMORY_OP_WRITE)) {
+            profiler_->access(queueEntry->request->get_owner_rip(),
+                    queueEntry->request->get_physical_address(),
+                    hit && is_line_valid(line),
+                    queueEntry->request->is_kernel());
+        }
+
         // Testing 100 % L2 Hit
         // if(type_ == L2_CACHE)
         // hit = true;
@@ -676,8 +904,11 @@ bool CacheController::cache_access_cb(void *arg)
 					N_STAT_UPDATE(new_stats->cpurequest.count.miss.write, ++,
 							kernel_req);
 				}
+				queueEntry->request->set_miss(type_);
 			}
         }
+        delay += slice_hop_latency(queueEntry);
+
         marss_add_event(signal, delay,
                 (void*)queueEntry);
         return true;
@@ -729,6 +960,18 @@ bool CacheController::wait_interconnect_cb(void *arg)
          * previous request, so mark 'hasData' to true in message
          */
         message.hasData = true;
+        if(lineData_) {
+            message.data = queueEntry->data.get();
+            if(!message.data)
+                message.data = get_line_data(queueEntry->line,
+                        queueEntry->request->get_physical_address());
+        }
+
+        /* Request was addressed to us, send the response back to its
+         * origin for interconnects that route by destination */
+        if(message.dest == this && queueEntry->source)
+            message.dest = queueEntry->source;
+
         memdebug("Sending message: " << message << endl);
         success = queueEntry->sendTo->get_controller_request_signal()->
             emit(&message);
@@ -749,8 +992,14 @@ bool CacheController::wait_interconnect_cb(void *arg)
         else
             message.hasData = false;
 
+        if(lineData_ && message.hasData)
+            message.data = queueEntry->data.get();
+
         message.isShared = queueEntry->isShared;
 
+        if(lowerSliceMap_ && (!directory_ || queueEntry->dest != directory_))
+            message.dest = get_lower_cont(queueEntry->request);
+
         success = lowerInterconnect_->
             get_controller_request_signal()->emit(&message);
 
@@ -813,6 +1062,10 @@ bool CacheController::clear_entry_cb(void *arg)
                         queueEntry << endl);
             }
 
+            if(prefetcher_ && queueEntry->prefetch) {
+                prefetcher_->remove_pending(
+                        queueEntry->request->get_physical_address());
+            }
             pendingRequests_.free(queueEntry);
         }
 
@@ -852,6 +1105,10 @@ void CacheController::annul_request(MemoryRequest *request)
                 pendingRequests_[queueEntry->waitFor].depends = -1;
             }
 
+            if(prefetcher_ && queueEntry->prefetch) {
+                prefetcher_->remove_pending(
+                        queueEntry->request->get_physical_address());
+            }
             pendingRequests_.free(queueEntry);
             ADD_HISTORY_REM(queueEntry->request);
 
@@ -860,6 +1117,73 @@ void CacheController::annul_request(MemoryRequest *request)
     }
 }
 
+/**
+ * @brief Account demand access for prefetcher stats and train it
+ *
+ * @param request Demand request accessing this cache
+ * @param line Cache line found for this request, NULL on miss
+ */
+void CacheController::update_prefetcher(MemoryRequest *request,
+        CacheLine *line)
+{
+    if(line && !is_line_valid(line))
+        line = NULL;
+
+    prefetcher_->demand_access(request->get_owner_rip(),
+            request->get_physical_address(), request->is_kernel(), line,
+            prefetchAddrs_);
+
+    foreach(i, prefetchAddrs_.size()) {
+        issue_prefetch(request, prefetchAddrs_[i]);
+    }
+}
+
+/**
+ * @brief Send a prefetch request for given address to lower level
+ *
+ * Prefetches are dropped when the line is already cached or requested
+ * or when the pending queue is getting full, so demand requests always
+ * find free entries.
+ */
+void CacheController::issue_prefetch(MemoryRequest *trigger, W64 address)
+{
+    if(pendingRequests_.count() > pendingRequests_.size() * 0.7)
+        return;
+
+    MemoryRequest *request = memoryHierarchy_->get_free_request(
+            trigger->get_coreid());
+    assert(request);
+
+    request->init(trigger);
+    request->set_physical_address(cacheLines_->tagOf(address));
+    request->set_op_type(MEMORY_OP_READ);
+    request->set_coreSignal(NULL, NULL, -1);
+
+    if(find_dependency(request))
+        return;
+
+    CacheLine *line = cacheLines_->peek(request->get_physical_address());
+    if(line && is_line_valid(line))
+        return;
+
+    CacheQueueEntry *queueEntry = pendingRequests_.alloc();
+    assert(queueEntry);
+
+    queueEntry->request  = request;
+    queueEntry->prefetch = true;
+    queueEntry->sender   = NULL;
+    queueEntry->source   = this;
+    queueEntry->dest     = lowerCont_;
+    request->incRefCounter();
+    ADD_HISTORY_ADD(request);
+    prefetcher_->add_pending(request->get_physical_address());
+
+    N_STAT_UPDATE(prefetcher_->stats.issued, ++, request->is_kernel());
+
+    queueEntry->eventFlags[CACHE_ACCESS_EVENT]++;
+    marss_add_event(&cacheAccess_, 1, queueEntry);
+}
+
 CacheQueueEntry* CacheController::get_new_queue_entry()
 {
     CacheQueueEntry *queueEntry = pendingRequests_.alloc();
@@ -883,9 +1207,58 @@ void CacheController::dump_configuration(YAML::Emitter &out) const
 	YAML_KEY_VAL(out, "ways", cacheLines_->get_way_count());
 	YAML_KEY_VAL(out, "line_size", cacheLines_->get_line_size());
 	YAML_KEY_VAL(out, "latency", cacheLines_->get_access_latency());
+	YAML_KEY_VAL(out, "replacement", cacheLines_->get_replacement());
 	YAML_KEY_VAL(out, "pending_queue_size", pendingRequests_.size());
 
+	if(prefetcher_) {
+		YAML_KEY_VAL(out, "prefetcher", prefetcher_->get_type());
+		YAML_KEY_VAL(out, "prefetch_degree", prefetcher_->get_degree());
+		YAML_KEY_VAL(out, "prefetch_distance", prefetcher_->get_distance());
+	}
+
+	if(sliceMap_) {
+		YAML_KEY_VAL(out, "slices", sliceMap_->count());
+		YAML_KEY_VAL(out, "slice_hash", sliceMap_->hash_name());
+		YAML_KEY_VAL(out, "slice_hop_latency", sliceMap_->get_hop_latency());
+	}
+
+	if(partition_)
+		YAML_KEY_VAL(out, "partition", partition_->policy_name());
+
+	if(profiler_) {
+		YAML_KEY_VAL(out, "profile_rate", profiler_->get_rate());
+		YAML_KEY_VAL(out, "profile_lines", profiler_->get_max_lines());
+	}
+
 	coherence_logic_->dump_configuration(out);
 
 	out << YAML::EndMap;
 }
+
+void CacheController::update_stats()
+{
+	if(profiler_)
+		profiler_->update_stats();
+}
+
+/**
+ * @brief Save cache lines into micro-architectural checkpoint
+ *
+ * @param writer Checkpoint writer positioned in this cache's section
+ */
+void CacheController::save_state(UarchStateWriter& writer) const
+{
+	cacheLines_->save_state(writer);
+}
+
+/**
+ * @brief Restore cache lines from micro-architectural checkpoint
+ *
+ * @param reader Checkpoint reader positioned in this cache's section
+ *
+ * @return false if saved cache geometry does not match
+ */
+bool CacheController::restore_state(UarchStateReader& reader)
+{
+	return cacheLines_->restore_state(reader);
+}
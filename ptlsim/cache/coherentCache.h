@@ -36,6 +36,9 @@
 #include <memoryStats.h>
 #include <statsBuilder.h>
 #include <cacheLines.h>
+#include <prefetcher.h>
+#include <cacheProfiler.h>
+#include <sliceMap.h>
 
 namespace Memory {
 
@@ -81,6 +84,11 @@ namespace Memory {
                 bool isSnoop;
                 bool isShared;
                 bool responseData;
+                bool prefetch;
+
+                // Line data of a writeback or snoop response this entry
+                // sends, or of a writeback it received
+                LineDataBuffer data;
 
                 void init() {
                     request      = NULL;
@@ -96,9 +104,11 @@ namespace Memory {
                     isSnoop      = false;
                     isShared     = false;
                     responseData = false;
+                    prefetch     = false;
                     source       = NULL;
                     dest         = NULL;
                     eventFlags.reset();
+                    data.reset();
                 }
 
                 /* This is not created as copy constructor because
@@ -147,6 +157,7 @@ namespace Memory {
                     os << "] isSnoop[" << isSnoop;
                     os << "] isShared[" << isShared;
                     os << "] responseData[" << responseData;
+                    os << "] prefetch[" << prefetch;
                     os << "] ";
                     os << endl;
                     return os;
@@ -190,6 +201,11 @@ namespace Memory {
                 Controller *directory_;
                 Controller *lowerCont_;
 
+                // Slices of a sliced lower level cache, indexed by slice
+                // id, and the map used to pick one for each request
+                dynarray<Controller*> lowerSlices_;
+                SliceMap *lowerSliceMap_;
+
                 // All signals of cache
                 Signal clearEntry_;
                 Signal cacheHit_;
@@ -205,6 +221,24 @@ namespace Memory {
 
                 CoherenceLogic *coherence_logic_;
 
+                // Hardware prefetcher, NULL if not enabled
+                Prefetcher *prefetcher_;
+                dynarray<W64> prefetchAddrs_;
+
+                // Miss and reuse distance profiler, NULL if not enabled
+                CacheProfiler *profiler_;
+
+                // Line data pool, NULL if verify-cache is not enabled
+                LineDataPool *lineData_;
+
+                // Set when this cache is one slice of a sliced cache,
+                // NULL otherwise
+                SliceMap *sliceMap_;
+                SliceStats *sliceStats_;
+
+                // Class of service way masks, NULL if not partitioned
+                WayPartition *partition_;
+
                 CacheQueueEntry* find_dependency(MemoryRequest *request);
 
                 // This function is used to find pending request with either
@@ -223,12 +257,20 @@ namespace Memory {
                         W64 oldTag);
                 bool is_line_valid(CacheLine *line);
                 bool is_line_in_use(W64 tag);
+                const W8* get_line_data(CacheLine *line, W64 address);
+                void write_line_data(CacheQueueEntry *queueEntry);
 
                 bool complete_request(Message &message, CacheQueueEntry
                         *queueEntry);
 
                 void get_directory(Interconnect *interconn);
 
+                bool is_other_slice(MemoryRequest *request);
+                int  slice_hop_latency(CacheQueueEntry *queueEntry);
+
+                void update_prefetcher(MemoryRequest *request, CacheLine *line);
+                void issue_prefetch(MemoryRequest *trigger, W64 address);
+
             public:
                 CacheController(W8 coreid, const char *name,
                         MemoryHierarchy *memoryHierarchy, CacheType type);
@@ -274,6 +316,9 @@ namespace Memory {
 
                 void annul_request(MemoryRequest *request);
 				void dump_configuration(YAML::Emitter &out) const;
+				void update_stats();
+				void save_state(UarchStateWriter& writer) const;
+				bool restore_state(UarchStateReader& reader);
 
                 // Callback functions for signals of cache
                 virtual bool cache_hit_cb(void *arg);
@@ -302,6 +347,7 @@ namespace Memory {
                 Interconnect* get_lower_intrconn() { return lowerInterconnect_;}
                 Controller* get_directory() { return directory_; }
 				Controller* get_lower_cont() { return lowerCont_; }
+                Controller* get_lower_cont(MemoryRequest *request);
                 CacheQueueEntry* get_new_queue_entry();
 
         };
@@ -31,6 +31,7 @@
 #include <globals.h>
 #include <superstl.h>
 #include <memoryRequest.h>
+#include <uarch-checkpoint.h>
 
 namespace Memory {
 
@@ -44,6 +45,9 @@ struct Message : public FixStateListObject {
 	bool hasData;
 	bool isShared;
 	void *arg;
+	/* Line data with verify-cache, owned by the sender and only valid
+	 * while the message is delivered. NULL if it is not tracked. */
+	const W8 *data;
 
 	ostream& print(ostream& os) const {
 		if(sender == NULL) {
@@ -68,6 +72,7 @@ struct Message : public FixStateListObject {
 		hasData = false;
 		arg = NULL;
         isShared = 0;
+		data = NULL;
 	}
 };
 
@@ -123,6 +128,14 @@ class Controller
 		virtual void annul_request(MemoryRequest* request) = 0;
 		virtual void dump_configuration(YAML::Emitter &out) const = 0;
 
+		/* Write stats that are kept outside the stats database */
+		virtual void update_stats() {}
+
+		/* Micro-architectural checkpoint support, controllers that hold
+		 * warmable state (cache lines, row buffers...) override these */
+		virtual void save_state(UarchStateWriter& writer) const {}
+		virtual bool restore_state(UarchStateReader& reader) { return true; }
+
 		int flush() {
 			return 0;
 		}
@@ -269,6 +269,30 @@ CPUControllerQueueEntry* CPUController::find_dependency(
 	return NULL;
 }
 
+/**
+ * @brief Check for a store to a data cache line that did not reach L1 yet
+ *
+ * @param physaddr Physical address in the line
+ *
+ * @return true if a write to the line is still pending
+ */
+bool CPUController::is_write_pending(W64 physaddr)
+{
+	W64 lineAddr = physaddr >> dcacheLineBits_;
+
+	CPUControllerQueueEntry* queueEntry;
+	foreach_list_mutable(pendingRequests_.list(), queueEntry, entry_t,
+			prev_t) {
+		if(queueEntry->annuled || queueEntry->request->is_instruction())
+			continue;
+
+		if(queueEntry->request->get_type() == MEMORY_OP_WRITE &&
+				get_line_address(queueEntry->request) == lineAddr)
+			return true;
+	}
+	return false;
+}
+
 void CPUController::wakeup_dependents(CPUControllerQueueEntry *queueEntry)
 {
     /*
@@ -151,6 +151,7 @@ class CPUController : public Controller
 		void register_interconnect_L1_i(Interconnect *interconnect);
 		void print(ostream& os) const;
 		bool is_cache_availabe(bool is_icache);
+		bool is_write_pending(W64 physaddr);
 		void annul_request(MemoryRequest *request);
 		int flush();
 		void dump_configuration(YAML::Emitter &out) const;
@@ -0,0 +1,614 @@
+/*
+ * MARSSx86 : A Full System Computer-Architecture Simulator
+ *
+ * This code is released under GPL.
+ *
+ */
+
+#ifdef MEM_TEST
+#include <test.h>
+#else
+#include <ptlsim.h>
+#endif
+
+#include <memoryHierarchy.h>
+#include <dynamicCacheLines.h>
+
+using namespace Memory;
+
+static const W8 RRPV_MAX = 3;
+
+static inline bool power_of_two(int n)
+{
+    return n > 0 && (n & (n - 1)) == 0;
+}
+
+DynamicCacheLines::DynamicCacheLines(int sets, int ways, int lineSize,
+        int latency, int policy, int readPorts, int writePorts) :
+    setCount_(sets)
+    , wayCount_(ways)
+    , lineSize_(lineSize)
+    , latency_(latency)
+    , policy_(policy)
+    , readPortUsed_(0)
+    , writePortUsed_(0)
+    , readPorts_(readPorts)
+    , writePorts_(writePorts)
+    , lastAccessCycle_(0)
+    , tags_(NULL)
+    , lines_(NULL)
+    , repl_(NULL)
+    , mru_(NULL)
+    , reused_(NULL)
+    , stats_(NULL)
+    , partition_(NULL)
+    , lineData_(NULL)
+{
+    assert(supports_policy(policy));
+    assert(power_of_two(lineSize));
+
+    if (!set_geometry(sets, ways, latency)) {
+        ptl_logfile << "[ERROR] invalid cache geometry: " << sets
+                    << " sets " << ways << " ways" << endl;
+        assert_fail(__STRING(0), __FILE__, __LINE__, __PRETTY_FUNCTION__);
+    }
+}
+
+DynamicCacheLines::~DynamicCacheLines()
+{
+    release();
+}
+
+void DynamicCacheLines::allocate()
+{
+    int lines = setCount_ * wayCount_;
+
+    tags_ = new W64[lines];
+    lines_ = new CacheLine[lines];
+    repl_ = new W8[lines];
+    mru_ = new W64[setCount_];
+    reused_ = new W64[setCount_];
+}
+
+void DynamicCacheLines::release()
+{
+    if (lines_ && lineData_) {
+        foreach (i, setCount_ * wayCount_) {
+            if (lines_[i].data)
+                lineData_->free(lines_[i].data);
+        }
+    }
+
+    delete [] tags_;
+    delete [] lines_;
+    delete [] repl_;
+    delete [] mru_;
+    delete [] reused_;
+    tags_ = NULL;
+    lines_ = NULL;
+    repl_ = NULL;
+    mru_ = NULL;
+    reused_ = NULL;
+}
+
+/**
+ * @brief Change the geometry, line size and policy are kept
+ *
+ * @return false if the geometry is not supported, in that case the cache
+ * is left untouched
+ *
+ * Cache content is lost, so this must be called before init().
+ */
+bool DynamicCacheLines::set_geometry(int sets, int ways, int latency)
+{
+    if (!power_of_two(sets) || ways <= 0 || ways > MAX_WAYS ||
+            latency <= 0)
+        return false;
+
+    release();
+
+    setCount_ = sets;
+    wayCount_ = ways;
+    latency_ = latency;
+
+    setShift_ = msbindex32(lineSize_);
+    setMask_ = setCount_ - 1;
+    tagMask_ = ~(W64)(lineSize_ - 1);
+
+    allocate();
+    init();
+
+    return true;
+}
+
+void DynamicCacheLines::init()
+{
+    foreach (i, setCount_ * wayCount_) {
+        tags_[i] = InvalidTag<W64>::INVALID;
+        lines_[i].init(-1);
+        repl_[i] = 0;
+    }
+
+    foreach (i, setCount_) {
+        mru_[i] = 0;
+        reused_[i] = 0;
+        foreach (j, wayCount_) {
+            W8 &state = repl_[i * wayCount_ + j];
+            if (policy_ == REPL_LRU)
+                state = j;
+            else if (policy_ == REPL_SRRIP)
+                state = RRPV_MAX;
+        }
+    }
+}
+
+void DynamicCacheLines::init_stats(Statable *parent)
+{
+    stats_ = new ReplacementStats(parent);
+}
+
+void DynamicCacheLines::repl_hit(int set, int way)
+{
+    W8 *state = &repl_[set * wayCount_];
+
+    switch (policy_) {
+        case REPL_NRU:
+            mru_[set] |= (1ULL << way);
+            break;
+        case REPL_LRU:
+            {
+                W8 old = state[way];
+                foreach (j, wayCount_) {
+                    if (state[j] < old) state[j]++;
+                }
+                state[way] = 0;
+                break;
+            }
+        case REPL_SRRIP:
+            state[way] = 0;
+            break;
+    }
+}
+
+int DynamicCacheLines::repl_victim(int set, int invalid, W64 mask)
+{
+    W8 *state = &repl_[set * wayCount_];
+
+    assert(mask);
+
+    switch (policy_) {
+        case REPL_NRU:
+            {
+                W64 unused = mask & ~mru_[set];
+
+                /* All allowed ways were used, start a new round */
+                if (!unused) {
+                    mru_[set] &= ~mask;
+                    return lsbindex64(mask);
+                }
+                return lsbindex64(unused);
+            }
+        case REPL_LRU:
+            {
+                if (invalid >= 0) return invalid;
+
+                int way = -1;
+                foreach (j, wayCount_) {
+                    if (!bit(mask, j)) continue;
+                    if (way < 0 || state[j] > state[way]) way = j;
+                }
+                return way;
+            }
+        case REPL_SRRIP:
+            {
+                if (invalid >= 0) return invalid;
+
+                while (1) {
+                    foreach (j, wayCount_) {
+                        if (bit(mask, j) && state[j] == RRPV_MAX) return j;
+                    }
+                    foreach (j, wayCount_) {
+                        if (bit(mask, j)) state[j]++;
+                    }
+                }
+            }
+    }
+
+    assert(0);
+    return -1;
+}
+
+void DynamicCacheLines::repl_invalidate(int set, int way)
+{
+    if (policy_ == REPL_NRU)
+        mru_[set] &= ~(1ULL << way);
+    else if (policy_ == REPL_SRRIP)
+        repl_[set * wayCount_ + way] = RRPV_MAX;
+}
+
+CacheLine* DynamicCacheLines::probe(MemoryRequest *request)
+{
+    W64 physAddress = request->get_physical_address();
+    int setIdx = setof(physAddress);
+    W64 tag = tagof(physAddress);
+    int way = match(setIdx, tag);
+    bool kernel = request->is_kernel();
+
+    if(stats_)
+        N_STAT_UPDATE(stats_->accesses, ++, kernel);
+
+    if(partition_)
+        partition_->access(request->get_coreid(), setIdx, tag, way >= 0,
+                kernel);
+
+    if(way < 0)
+        return NULL;
+
+    repl_hit(setIdx, way);
+    reused_[setIdx] |= (1ULL << way);
+
+    if(stats_)
+        N_STAT_UPDATE(stats_->hits, ++, kernel);
+
+    return &lines_[setIdx * wayCount_ + way];
+}
+
+CacheLine* DynamicCacheLines::peek(W64 address)
+{
+    int setIdx = setof(address);
+    int way = match(setIdx, tagof(address));
+
+    if(way < 0)
+        return NULL;
+
+    return &lines_[setIdx * wayCount_ + way];
+}
+
+CacheLine* DynamicCacheLines::insert(MemoryRequest *request, W64& oldTag)
+{
+    W64 physAddress = request->get_physical_address();
+    W64 tag = tagof(physAddress);
+    int setIdx = setof(physAddress);
+    W64 *tags = &tags_[setIdx * wayCount_];
+    bool kernel = request->is_kernel();
+
+    int way = match(setIdx, tag);
+    if(way >= 0) {
+        repl_hit(setIdx, way);
+        return &lines_[setIdx * wayCount_ + way];
+    }
+
+    /* Ways this request may allocate into */
+    W64 mask;
+    if(partition_)
+        mask = partition_->alloc_mask(request->get_coreid());
+    else
+        mask = bitmask(wayCount_);
+
+    int invalid = -1;
+    foreach(j, wayCount_) {
+        if(bit(mask, j) && tags[j] == InvalidTag<W64>::INVALID) {
+            invalid = j;
+            break;
+        }
+    }
+
+    way = repl_victim(setIdx, invalid, mask);
+    oldTag = tags[way];
+
+    if(oldTag != InvalidTag<W64>::INVALID) {
+        if(partition_)
+            partition_->evict(setIdx, way, kernel);
+        if(stats_) {
+            N_STAT_UPDATE(stats_->evictions, ++, kernel);
+            if(!bit(reused_[setIdx], way))
+                N_STAT_UPDATE(stats_->dead_evictions, ++, kernel);
+        }
+    }
+
+    tags[way] = tag;
+    reused_[setIdx] &= ~(1ULL << way);
+
+    /* Fill priority matches CacheLines with the same policy */
+    W8 *state = &repl_[setIdx * wayCount_];
+    switch (policy_) {
+        case REPL_NRU:
+            mru_[setIdx] |= (1ULL << way);
+            if (mru_[setIdx] == bitmask(wayCount_))
+                mru_[setIdx] = (1ULL << way);
+            break;
+        case REPL_LRU:
+            repl_hit(setIdx, way);
+            break;
+        case REPL_SRRIP:
+            state[way] = RRPV_MAX - 1;
+            break;
+    }
+
+    if(partition_)
+        partition_->fill(request->get_coreid(), setIdx, way, kernel);
+
+    if(stats_)
+        N_STAT_UPDATE(stats_->fills, ++, kernel);
+
+    return &lines_[setIdx * wayCount_ + way];
+}
+
+int DynamicCacheLines::invalidate(MemoryRequest *request)
+{
+    W64 physAddress = request->get_physical_address();
+    int setIdx = setof(physAddress);
+    int way = match(setIdx, tagof(physAddress));
+
+    if(way < 0)
+        return -1;
+
+    tags_[setIdx * wayCount_ + way] = InvalidTag<W64>::INVALID;
+    lines_[setIdx * wayCount_ + way].reset();
+    repl_invalidate(setIdx, way);
+    if(partition_)
+        partition_->evict(setIdx, way, request->is_kernel());
+    return way;
+}
+
+bool DynamicCacheLines::get_port(MemoryRequest *request)
+{
+    bool rc = false;
+
+    if(lastAccessCycle_ < sim_cycle) {
+        lastAccessCycle_ = sim_cycle;
+        writePortUsed_ = 0;
+        readPortUsed_ = 0;
+    }
+
+    switch(request->get_type()) {
+        case MEMORY_OP_READ:
+            rc = (readPortUsed_ < readPorts_) ? ++readPortUsed_ : 0;
+            break;
+        case MEMORY_OP_WRITE:
+        case MEMORY_OP_UPDATE:
+        case MEMORY_OP_EVICT:
+            rc = (writePortUsed_ < writePorts_) ? ++writePortUsed_ : 0;
+            break;
+        default:
+            memdebug("Unknown type of memory request: " <<
+                    request->get_type() << endl);
+            assert(0);
+    };
+    return rc;
+}
+
+void DynamicCacheLines::print(ostream& os) const
+{
+    foreach(i, setCount_ * wayCount_) {
+        os << lines_[i];
+    }
+}
+
+/**
+ * @brief Save tags, line states and replacement state of all sets
+ *
+ * Same layout as CacheLines with nru, lru or srrip, so a checkpoint of
+ * either kind restores into a cache with the same geometry and policy.
+ */
+void DynamicCacheLines::save_state(UarchStateWriter& writer) const
+{
+    writer.put((W32)setCount_);
+    writer.put((W32)wayCount_);
+    writer.put((W32)lineSize_);
+    writer.put((W32)policy_);
+
+    foreach (i, setCount_) {
+        foreach (j, wayCount_) {
+            int idx = i * wayCount_ + j;
+            writer.put(tags_[idx]);
+            writer.put((W64)lines_[idx].tag);
+            writer.put((W8)lines_[idx].state);
+        }
+        put_way_bits(writer, reused_[i]);
+    }
+
+    switch (policy_) {
+        case REPL_NRU:
+            foreach (i, setCount_) {
+                put_way_bits(writer, mru_[i]);
+            }
+            break;
+        case REPL_LRU:
+        case REPL_SRRIP:
+            writer.put_array(repl_, setCount_ * wayCount_);
+            break;
+    }
+}
+
+/*
+ * Ways are written as a bitvec of the way count, like CacheLines does
+ */
+void DynamicCacheLines::put_way_bits(UarchStateWriter& writer,
+        W64 bits) const
+{
+    writer.put((W32)wayCount_);
+    for (int i = 0; i < wayCount_; i += 8)
+        writer.put((W8)(bits >> i));
+}
+
+bool DynamicCacheLines::get_way_bits(UarchStateReader& reader,
+        W64& bits) const
+{
+    W32 width;
+    if (!reader.get(width) || width != (W32)wayCount_)
+        return false;
+
+    bits = 0;
+    for (int i = 0; i < wayCount_; i += 8) {
+        W8 b;
+        if (!reader.get(b))
+            return false;
+        bits |= (W64)b << i;
+    }
+
+    if (wayCount_ < 64)
+        bits &= (1ULL << wayCount_) - 1;
+
+    return true;
+}
+
+/**
+ * @brief Restore state saved by save_state()
+ *
+ * @return false if saved geometry does not match this cache or the
+ * section is truncated, in that case cache is left untouched
+ */
+bool DynamicCacheLines::restore_state(UarchStateReader& reader)
+{
+    W32 sets, ways, lineSize, policy;
+    int lines = setCount_ * wayCount_;
+
+    if (!reader.get(sets) || !reader.get(ways) ||
+            !reader.get(lineSize) || !reader.get(policy))
+        return false;
+
+    if (sets != (W32)setCount_ || ways != (W32)wayCount_ ||
+            lineSize != (W32)lineSize_ || policy != (W32)policy_)
+        return false;
+
+    W64 *tags = new W64[lines];
+    W64 *lineTags = new W64[lines];
+    W8 *states = new W8[lines];
+    W8 *repl = new W8[lines];
+    W64 *mru = new W64[setCount_];
+    W64 *reused = new W64[setCount_];
+    bool rc = true;
+
+    memcpy(repl, repl_, lines);
+    memcpy(mru, mru_, setCount_ * sizeof(W64));
+
+    for (int i = 0; rc && i < setCount_; i++) {
+        for (int j = 0; rc && j < wayCount_; j++) {
+            int idx = i * wayCount_ + j;
+            rc = reader.get(tags[idx]) && reader.get(lineTags[idx]) &&
+                reader.get(states[idx]);
+        }
+        rc = rc && get_way_bits(reader, reused[i]);
+    }
+
+    switch (policy_) {
+        case REPL_NRU:
+            for (int i = 0; rc && i < setCount_; i++)
+                rc = get_way_bits(reader, mru[i]);
+            break;
+        case REPL_LRU:
+        case REPL_SRRIP:
+            rc = rc && reader.get_array(repl, lines);
+            break;
+    }
+
+    if (rc) {
+        foreach (i, lines) {
+            tags_[i] = tags[i];
+            lines_[i].init(lineTags[i]);
+            lines_[i].state = states[i];
+        }
+        memcpy(repl_, repl, lines);
+        memcpy(mru_, mru, setCount_ * sizeof(W64));
+        memcpy(reused_, reused, setCount_ * sizeof(W64));
+    }
+
+    delete [] tags;
+    delete [] lineTags;
+    delete [] states;
+    delete [] repl;
+    delete [] mru;
+    delete [] reused;
+
+    return rc;
+}
+
+/*
+ * Parse a size with an optional K or M suffix, returns 0 if malformed.
+ */
+static W64 parse_size(const char *str)
+{
+    char *end;
+    W64 size = strtoull(str, &end, 0);
+
+    if (end == str) return 0;
+
+    switch (*end) {
+        case 'k': case 'K': size <<= 10; end++; break;
+        case 'm': case 'M': size <<= 20; end++; break;
+    }
+
+    return (*end == '\0') ? size : 0;
+}
+
+/**
+ * @brief Apply '-cache-geometry' to one cache
+ *
+ * @param name Name of the cache controller, like 'L2_0'
+ * @param lines Cache lines of that controller
+ *
+ * The option is a comma separated list of <cache>=<size>:<ways>[:<latency>]
+ * where <cache> is a controller name or its prefix before '_', like 'L2'
+ * for all L2 caches.
+ */
+bool Memory::configure_cache_geometry(const char *name, CacheLinesBase *lines)
+{
+    if (!config.cache_geometry.size()) return true;
+
+    dynarray<stringbuf*> items;
+    bool rc = true;
+
+    stringbuf buf;
+    buf << config.cache_geometry;
+    buf.split(items, ",");
+
+    foreach (i, items.count()) {
+        char *item = items[i]->buf;
+        char *setting = strchr(item, '=');
+
+        if (!setting) {
+            rc = false;
+            break;
+        }
+
+        *setting++ = '\0';
+        int len = strlen(item);
+
+        if (strcmp(name, item) &&
+                (strncmp(name, item, len) || name[len] != '_'))
+            continue;
+
+        dynarray<stringbuf*> fields;
+        stringbuf geometry;
+        geometry << setting;
+        geometry.split(fields, ":");
+
+        rc = false;
+        if (fields.count() == 2 || fields.count() == 3) {
+            W64 size = parse_size(fields[0]->buf);
+            int ways = atoi(fields[1]->buf);
+            int latency = (fields.count() == 3) ? atoi(fields[2]->buf) :
+                lines->get_access_latency();
+            int lineSize = lines->get_line_size();
+
+            if (size && ways > 0 && size % (ways * lineSize) == 0)
+                rc = lines->set_geometry(size / (ways * lineSize), ways,
+                        latency);
+        }
+
+        foreach (j, fields.count()) delete fields[j];
+        break;
+    }
+
+    foreach (i, items.count()) delete items[i];
+
+    if (!rc) {
+        ptl_logfile << "[ERROR] can't apply cache geometry '"
+                    << config.cache_geometry << "' to " << name
+                    << ", it needs 'GEOMETRY: runtime' and a power of two "
+                    << "number of sets" << endl;
+    }
+
+    return rc;
+}
@@ -0,0 +1,150 @@
+/*
+ * MARSSx86 : A Full System Computer-Architecture Simulator
+ *
+ * This code is released under GPL.
+ *
+ */
+
+#ifndef DYNAMIC_CACHE_LINES_H
+#define DYNAMIC_CACHE_LINES_H
+
+#include <memoryRequest.h>
+#include <cacheLines.h>
+
+namespace Memory {
+
+    /*
+     * Cache lines with run time geometry
+     *
+     * CacheLines takes its geometry as template arguments from the machine
+     * configuration, so every size or associativity change needs a new
+     * build. A cache type with 'GEOMETRY: runtime' uses this class
+     * instead: the configuration gives its default geometry, which
+     * '-cache-geometry' can change before the machine is built. Set index
+     * and tag are computed with shifts and masks precomputed from the
+     * geometry, so the number of sets must be a power of two.
+     *
+     * Only policies with per way state are supported: nru, lru and srrip.
+     */
+    class DynamicCacheLines : public CacheLinesBase
+    {
+        public:
+            static const int MAX_WAYS = 64;
+
+        private:
+            int setCount_;
+            int wayCount_;
+            int lineSize_;
+            int latency_;
+            int policy_;
+
+            int setShift_;
+            W64 setMask_;
+            W64 tagMask_;
+
+            int readPortUsed_;
+            int writePortUsed_;
+            int readPorts_;
+            int writePorts_;
+            W64 lastAccessCycle_;
+
+            /* Per way tag, line and lru/srrip state, set by set */
+            W64 *tags_;
+            CacheLine *lines_;
+            W8 *repl_;
+
+            /* Per set nru bits and ways referenced since their fill */
+            W64 *mru_;
+            W64 *reused_;
+
+            ReplacementStats *stats_;
+
+            WayPartition *partition_;
+
+            /* Line data buffers go back here when lines are freed */
+            LineDataPool *lineData_;
+
+            void allocate();
+            void release();
+
+            int setof(W64 address) const {
+                return (address >> setShift_) & setMask_;
+            }
+
+            W64 tagof(W64 address) const {
+                return address & tagMask_;
+            }
+
+            /* Branch free like FullyAssociativeTags::match() */
+            int match(int set, W64 tag) const {
+                const W64 *tags = &tags_[set * wayCount_];
+                int way = 0;
+                foreach (j, wayCount_) {
+                    way += (tags[j] == tag) ? (j + 1) : 0;
+                }
+                return way - 1;
+            }
+
+            void repl_hit(int set, int way);
+            int repl_victim(int set, int invalid, W64 mask);
+            void repl_invalidate(int set, int way);
+
+            void put_way_bits(UarchStateWriter& writer, W64 bits) const;
+            bool get_way_bits(UarchStateReader& reader, W64& bits) const;
+
+        public:
+            DynamicCacheLines(int sets, int ways, int lineSize,
+                    int latency, int policy, int readPorts,
+                    int writePorts);
+            ~DynamicCacheLines();
+
+            bool set_geometry(int sets, int ways, int latency);
+
+            void init();
+            W64 tagOf(W64 address) { return tagof(address); }
+            int latency() const { return latency_; }
+            CacheLine* probe(MemoryRequest *request);
+            CacheLine* peek(W64 address);
+            CacheLine* insert(MemoryRequest *request, W64& oldTag);
+            int invalidate(MemoryRequest *request);
+            bool get_port(MemoryRequest *request);
+            void print(ostream& os) const;
+            void init_stats(Statable *parent);
+            void set_partition(WayPartition *partition) {
+                partition_ = partition;
+            }
+            void set_line_data(LineDataPool *pool) {
+                lineData_ = pool;
+            }
+            void save_state(UarchStateWriter& writer) const;
+            bool restore_state(UarchStateReader& reader);
+
+            int get_size() const {
+                return setCount_ * wayCount_ * lineSize_;
+            }
+
+            int get_set_count() const { return setCount_; }
+            int get_way_count() const { return wayCount_; }
+            int get_line_size() const { return lineSize_; }
+            int get_line_bits() const { return setShift_; }
+            int get_access_latency() const { return latency_; }
+
+            const char* get_replacement() const {
+                return repl_policy_names[policy_];
+            }
+
+            static bool supports_policy(int policy) {
+                return policy == REPL_NRU || policy == REPL_LRU ||
+                    policy == REPL_SRRIP;
+            }
+    };
+
+    /*
+     * Apply '-cache-geometry' to the lines of cache 'name', returns false
+     * if the option names this cache but its geometry can't be changed.
+     */
+    bool configure_cache_geometry(const char *name, CacheLinesBase *lines);
+
+};
+
+#endif // DYNAMIC_CACHE_LINES_H
@@ -19,6 +19,138 @@ static W64 get_line_addr(W64 addr)
 }
 
 
+int SharerSet::pointers   = 0;
+int SharerSet::groupShift = 0;
+
+/**
+ * @brief Select sharer representation of all directory entries
+ *
+ * @param pointers_ Number of sharer pointers, 0 for a vector
+ *
+ * Vector bits cover groups of cores that are large enough to map all
+ * simulated cores into 64 bits.
+ */
+void SharerSet::setup(int pointers_)
+{
+    assert(pointers_ >= 0 && pointers_ <= DIR_MAX_POINTERS);
+    assert(NUM_SIM_CORES <= 256);
+
+    pointers   = pointers_;
+    groupShift = 0;
+    while (((NUM_SIM_CORES - 1) >> groupShift) >= 64)
+        groupShift++;
+}
+
+bool SharerSet::test(int core) const
+{
+    if (vector)
+        return bit(bits, core >> groupShift);
+
+    foreach (i, count) {
+        if (pointer(i) == core)
+            return true;
+    }
+    return false;
+}
+
+void SharerSet::set(int core)
+{
+    if (vector) {
+        bits |= (1ULL << (core >> groupShift));
+        return;
+    }
+
+    if (test(core))
+        return;
+
+    if (count < pointers) {
+        set_pointer(count++, core);
+        return;
+    }
+
+    /* Out of pointers, switch to vector */
+    W64 cores = bits;
+    int n     = count;
+
+    bits   = 0;
+    count  = 0;
+    vector = true;
+
+    foreach (i, n) {
+        set((cores >> (i * 8)) & 0xff);
+    }
+    set(core);
+}
+
+void SharerSet::reset(int core)
+{
+    if (vector) {
+        /* A coarse bit can still have other sharers */
+        if (groupShift > 0)
+            return;
+
+        bits &= ~(1ULL << core);
+        if (bits == 0 && pointers > 0)
+            vector = false;
+        return;
+    }
+
+    foreach (i, count) {
+        if (pointer(i) == core) {
+            count--;
+            set_pointer(i, pointer(count));
+            set_pointer(count, 0);
+            return;
+        }
+    }
+}
+
+int SharerSet::popcount() const
+{
+    if (!vector)
+        return count;
+
+    if (groupShift == 0)
+        return popcount64(bits);
+
+    int n = 0;
+    foreach (i, NUM_SIM_CORES) {
+        if (test(i)) n++;
+    }
+    return n;
+}
+
+int SharerSet::lsb() const
+{
+    if (vector)
+        return (bits) ? (lsbindex64(bits) << groupShift) : -1;
+
+    int core = -1;
+    foreach (i, count) {
+        if (core < 0 || pointer(i) < core)
+            core = pointer(i);
+    }
+    return core;
+}
+
+ostream& SharerSet::print(ostream &os) const
+{
+    if (is_coarse()) {
+        os << "coarse:" << hexstring(bits, 64);
+        return os;
+    }
+
+    os << "{";
+    int n = 0;
+    foreach (i, NUM_SIM_CORES) {
+        if (!test(i)) continue;
+        if (n++) os << ",";
+        os << i;
+    }
+    os << "}";
+    return os;
+}
+
 /**
  * @brief Reset the directory entry
  */
@@ -40,15 +172,69 @@ void DirectoryEntry::init(W64 tag_)
     present.reset();
 }
 
-Directory::Directory()
+Directory::Directory(int sets, int ways)
+    : setCount_(sets)
+      , wayCount_(ways)
+{
+    entries = new DirectoryEntry[sets * ways];
+    mru_    = new W64[sets];
+
+    foreach (i, sets) {
+        mru_[i] = 0;
+    }
+}
+
+/**
+ * @brief Mark way as most recently used
+ *
+ * Once all ways of a set are marked, only the last one is kept.
+ */
+void Directory::touch(W64 addr, int way)
+{
+    W64 &mru = mru_[set_of(addr)];
+    W64 all  = (wayCount_ == 64) ? (W64)-1 : ((1ULL << wayCount_) - 1);
+
+    mru |= (1ULL << way);
+    if (mru == all)
+        mru = (1ULL << way);
+}
+
+int Directory::victim(W64 addr) const
 {
-    entries = new base_t();
+    DirectoryEntry *set = set_base(addr);
+
+    foreach (i, wayCount_) {
+        if (set[i].tag == InvalidTag<W64>::INVALID)
+            return i;
+    }
+
+    W64 mru = mru_[set_of(addr)];
+    foreach (i, wayCount_) {
+        if (!bit(mru, i))
+            return i;
+    }
+
+    return 0;
 }
 
 DirectoryEntry* Directory::insert(MemoryRequest *req, W64& old_tag)
 {
     W64 phys_addr = req->get_physical_address();
-    DirectoryEntry* entry = entries->select(phys_addr, old_tag);
+    W64 tag       = tag_of(phys_addr);
+
+    DirectoryEntry* entry = probe(req);
+    if (entry) {
+        old_tag = tag;
+        return entry;
+    }
+
+    int way = victim(phys_addr);
+    entry   = &set_base(phys_addr)[way];
+
+    /* Entry keeps old contents so caller can evict its sharers */
+    old_tag    = entry->tag;
+    entry->tag = tag;
+    touch(phys_addr, way);
 
     return entry;
 }
@@ -56,14 +242,108 @@ DirectoryEntry* Directory::insert(MemoryRequest *req, W64& old_tag)
 DirectoryEntry* Directory::probe(MemoryRequest *req)
 {
     W64 phys_addr = req->get_physical_address();
-    DirectoryEntry* entry = entries->probe(phys_addr);
+    W64 tag       = tag_of(phys_addr);
+    DirectoryEntry *set = set_base(phys_addr);
 
-    return entry;
+    foreach (i, wayCount_) {
+        if (set[i].tag == tag) {
+            touch(phys_addr, i);
+            return &set[i];
+        }
+    }
+
+    return NULL;
 }
 
 int Directory::invalidate(MemoryRequest *req)
 {
-    return entries->invalidate(req->get_physical_address());
+    W64 phys_addr = req->get_physical_address();
+    W64 tag       = tag_of(phys_addr);
+    DirectoryEntry *set = set_base(phys_addr);
+
+    foreach (i, wayCount_) {
+        if (set[i].tag == tag) {
+            set[i].reset();
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+/**
+ * @brief Save all directory entries into micro-architectural checkpoint
+ */
+void Directory::save_state(UarchStateWriter& writer) const
+{
+    writer.put((W32)setCount_);
+    writer.put((W32)wayCount_);
+    writer.put((W32)NUM_SIM_CORES);
+    writer.put((W32)SharerSet::pointers);
+
+    foreach (i, setCount_ * wayCount_) {
+        const DirectoryEntry &entry = entries[i];
+        writer.put(entry.tag);
+        writer.put(entry.present.bits);
+        writer.put(entry.present.count);
+        writer.put((W8)entry.present.vector);
+        writer.put((W8)entry.dirty);
+        writer.put(entry.owner);
+    }
+
+    writer.put_array(mru_, setCount_);
+}
+
+/**
+ * @brief Restore directory entries saved by save_state()
+ *
+ * Entries locked by in-flight requests at checkpoint time are unlocked
+ * because those requests are not part of the checkpoint. Directory is
+ * left untouched if the section does not match or is truncated.
+ */
+bool Directory::restore_state(UarchStateReader& reader)
+{
+    W32 sets, ways, cores, pointers;
+
+    if (!reader.get(sets) || !reader.get(ways) || !reader.get(cores) ||
+            !reader.get(pointers))
+        return false;
+
+    if (sets != (W32)setCount_ || ways != (W32)wayCount_ ||
+            cores != NUM_SIM_CORES || pointers != (W32)SharerSet::pointers)
+        return false;
+
+    int count = setCount_ * wayCount_;
+    DirectoryEntry *saved = new DirectoryEntry[count];
+    W64 *mru = new W64[setCount_];
+    bool rc = true;
+
+    for (int i = 0; rc && i < count; i++) {
+        DirectoryEntry &entry = saved[i];
+        W8 vector, dirty;
+
+        rc = reader.get(entry.tag) && reader.get(entry.present.bits) &&
+            reader.get(entry.present.count) && reader.get(vector) &&
+            reader.get(dirty) && reader.get(entry.owner);
+
+        entry.present.vector = vector;
+        entry.dirty = dirty;
+        entry.locked = 0;
+    }
+
+    rc = rc && reader.get_array(mru, setCount_);
+
+    if (rc) {
+        foreach (i, count) {
+            entries[i] = saved[i];
+        }
+        memcpy(mru_, mru, setCount_ * sizeof(W64));
+    }
+
+    delete [] saved;
+    delete [] mru;
+
+    return rc;
 }
 
 Directory* Directory::dir = NULL;
@@ -73,12 +353,39 @@ DirectoryController::pendingRequests_ = NULL;
 /**
  * @brief Get the global directory
  *
+ * @param machine Machine that owns the directory
+ * @param name Name of the controller, used to look up its options
+ *
  * @return reference to global Directory
+ *
+ * The directory is created on first call with the options of that
+ * controller.
  */
-Directory& Directory::get_directory()
+Directory& Directory::get_directory(BaseMachine &machine, const char *name)
 {
     if (dir == NULL) {
-        dir = new Directory();
+        int sets, ways, pointers;
+
+        if (!machine.get_option(name, "sets", sets))
+            sets = DIR_SET;
+        if (!machine.get_option(name, "ways", ways))
+            ways = DIR_WAY;
+        if (!machine.get_option(name, "sharer_pointers", pointers))
+            pointers = 0;
+
+        if (sets <= 0 || (sets & (sets - 1)) || ways <= 0 || ways > 64 ||
+                pointers < 0 || pointers > DIR_MAX_POINTERS) {
+            ptl_logfile << "[ERROR] ", name, ": invalid directory geometry ",
+                        "sets:", sets, " ways:", ways, " sharer_pointers:",
+                        pointers, endl;
+            cerr << "[ERROR] " << name << ": invalid directory geometry "
+                 << "sets:" << sets << " ways:" << ways
+                 << " sharer_pointers:" << pointers << endl;
+            assert_fail(__STRING(0), __FILE__, __LINE__, __PRETTY_FUNCTION__);
+        }
+
+        SharerSet::setup(pointers);
+        dir = new Directory(sets, ways);
         DirectoryController::pendingRequests_ =
             new FixStateList<DirContBufferEntry, REQ_Q_SIZE>();
     }
@@ -94,7 +401,8 @@ DirectoryController* DirectoryController::dir_controllers[NUM_SIM_CORES] = {0};
 DirectoryController::DirectoryController(W8 idx, const char *name,
         MemoryHierarchy *memoryHierarchy)
     : Controller(idx, name, memoryHierarchy)
-      , dir_(Directory::get_directory())
+      , dir_(Directory::get_directory(memoryHierarchy->get_machine(),
+                  name))
 {
     memoryHierarchy_->add_mem_controller(this);
 
@@ -329,7 +637,7 @@ bool DirectoryController::read_miss_cb(void *arg)
         return true;
     }
 
-    if (dir_entry->present.nonzero() &&
+    if (dir_entry->present.nonzero() && dir_entry->owner != (W8)-1 &&
             dir_controllers[dir_entry->owner] == this) {
         // Set Owner as responder if its in local group, else
         // set lower cache as responder
@@ -376,7 +684,7 @@ bool DirectoryController::write_miss_cb(void *arg)
     } else if (!dir_entry->present.test(cont_id)) {
         // Its not present in requested cache
         queueEntry->responder = lower_cont;
-        sig_dir               = dir_controllers[dir_entry->owner];
+        sig_dir               = owner_dir(dir_entry);
         marss_add_event(&sig_dir->send_evict,
                 DIR_ACCESS_DELAY, queueEntry);
         return true;
@@ -387,7 +695,7 @@ bool DirectoryController::write_miss_cb(void *arg)
         if (dir_entry->present.nonzero()) {
             // Send evict msg to other caches
             queueEntry->responder = lower_cont;
-            sig_dir               = dir_controllers[dir_entry->owner];
+            sig_dir               = owner_dir(dir_entry);
             marss_add_event(&sig_dir->send_evict,
                     DIR_ACCESS_DELAY, queueEntry);
             return true;
@@ -487,20 +795,23 @@ bool DirectoryController::evict_cb(void *arg)
         if (dir_entry->present.iszero()) {
             dir_entry->owner = -1;
             dir_entry->dirty = 0;
+        } else if (dir_entry->present.is_coarse()) {
+            /* Coarse vector can't name a core that still has the line,
+             * the owner wrote back any dirty data so memory responds */
+            dir_entry->owner = -1;
+            dir_entry->dirty = 0;
         } else {
             dir_entry->owner = dir_entry->present.lsb();
         }
     }
 
-    if (dir_entry->present.iszero() && queueEntry->origin != -1) {
-        // All cached lines are evicted.
-        // If origin is present means, this was a cache_miss request
+    if (queueEntry->origin != -1) {
+        // If origin is present means, this evict was sent by directory
+        // either for a cache_miss request or to replace an entry.
         DirContBufferEntry *origEntry = get_entry(queueEntry->origin);
-        if (origEntry) {
-            DirectoryController *sig_dir = dir_controllers[
-                origEntry->cont->idx];
-            marss_add_event(&sig_dir->send_response, 1,
-                    origEntry);
+        if (origEntry && origEntry->evicts > 0 &&
+                --origEntry->evicts == 0) {
+            evicts_completed(origEntry);
         }
     }
 
@@ -575,18 +886,20 @@ bool DirectoryController::send_evict_cb(void *arg)
 	/* While handling this request, if all other cache lines are
 	 * evicted then send response to this request. */
 	if (queueEntry->entry->present.iszero()) {
-		DirectoryController *sig_dir = dir_controllers[
-			queueEntry->cont->idx];
-		marss_add_event(&sig_dir->send_response, 1, queueEntry);
+		evicts_completed(queueEntry);
 		return true;
 	}
 
 	queueEntry->entry->locked = 1;
 
     /* Now for each cached entry, send evict message to that
-     * controller */
+     * controller. A coarse sharer set also names the requester, which
+     * must not get its own line evicted. */
+    int requester = (queueEntry->cont) ? queueEntry->cont->idx : -1;
+    queueEntry->evicts = 0;
+
     foreach (i, NUM_SIM_CORES) {
-        if (!queueEntry->entry->present.test(i))
+        if (!queueEntry->entry->present.test(i) || i == requester)
             continue;
 
         DirContBufferEntry *newEntry = pendingRequests_->alloc();
@@ -599,24 +912,67 @@ bool DirectoryController::send_evict_cb(void *arg)
         newEntry->request->incRefCounter();
         newEntry->request->set_op_type(MEMORY_OP_EVICT);
         newEntry->entry  = queueEntry->entry;
-        newEntry->origin = (queueEntry->cont) ? queueEntry->idx : -1;
+        newEntry->origin = queueEntry->idx;
 
         ADD_HISTORY_ADD(newEntry->request);
 
         newEntry->cont      = controllers[i];
         newEntry->responder = this;
         dir_controllers[i]->send_msg_cb(newEntry);
-    }
 
-    if (queueEntry->free_on_success) {
-        ADD_HISTORY_REM(queueEntry->request);
-        queueEntry->request->decRefCounter();
-        pendingRequests_->free(queueEntry);
+        queueEntry->evicts++;
     }
 
+    if (queueEntry->evicts == 0)
+        evicts_completed(queueEntry);
+
     return true;
 }
 
+/**
+ * @brief Directory controller of the group that owns a line
+ *
+ * @param entry Directory entry of the line
+ *
+ * @return this controller if the line has no known owner
+ */
+DirectoryController* DirectoryController::owner_dir(DirectoryEntry *entry)
+{
+    if (entry->owner == (W8)-1)
+        return this;
+
+    return dir_controllers[entry->owner];
+}
+
+/**
+ * @brief All caches have answered the EVICT messages of a queue entry
+ *
+ * @param queueEntry Entry that sent the EVICT messages
+ *
+ * Every core in the sharer set got an evict, so the set is cleared even
+ * if it was coarse. Then the original request gets its response, or the
+ * entry is freed when it was replacing a directory entry.
+ */
+void DirectoryController::evicts_completed(DirContBufferEntry *queueEntry)
+{
+    queueEntry->entry->present.reset();
+
+    if (queueEntry->cont) {
+        DirectoryController *sig_dir = dir_controllers[
+            queueEntry->cont->idx];
+        marss_add_event(&sig_dir->send_response, 1, queueEntry);
+        return;
+    }
+
+    /* Directory replacement, release dummy entry */
+    queueEntry->entry->locked = 0;
+
+    wakeup_dependent(queueEntry);
+    ADD_HISTORY_REM(queueEntry->request);
+    queueEntry->request->decRefCounter();
+    pendingRequests_->free(queueEntry);
+}
+
 bool DirectoryController::send_response_cb(void *arg)
 {
     DirContBufferEntry *queueEntry = (DirContBufferEntry*)arg;
@@ -815,7 +1171,6 @@ DirectoryEntry* DirectoryController::get_directory_entry(
             newEntry->request->set_physical_address(old_tag);
             newEntry->request->set_op_type(MEMORY_OP_EVICT);
             newEntry->entry = get_dummy_entry(entry, old_tag);
-            newEntry->free_on_success = 1;
 
             ADD_HISTORY_ADD(newEntry->request);
 
@@ -856,9 +1211,7 @@ DirectoryEntry* DirectoryController::get_dummy_entry(DirectoryEntry *entry,
             d_entry->tag   = old_tag;
             d_entry->dirty = entry->dirty;
             d_entry->owner = entry->owner;
-
-            foreach (j, NUM_SIM_CORES)
-                d_entry->present.assign(j, entry->present[j]);
+            d_entry->present = entry->present;
 
             return d_entry;
         }
@@ -965,14 +1318,36 @@ void DirectoryController::dump_configuration(YAML::Emitter &out) const
 	out << YAML::Key << get_name() << YAML::Value << YAML::BeginMap;
 
 	YAML_KEY_VAL(out, "type", "directory");
-	YAML_KEY_VAL(out, "size", DIR_SET * DIR_WAY);
+	YAML_KEY_VAL(out, "size", dir_.get_sets() * dir_.get_ways());
 	YAML_KEY_VAL(out, "line_size", DIR_LINE_SIZE);
-	YAML_KEY_VAL(out, "sets", DIR_SET);
-	YAML_KEY_VAL(out, "ways", DIR_WAY);
+	YAML_KEY_VAL(out, "sets", dir_.get_sets());
+	YAML_KEY_VAL(out, "ways", dir_.get_ways());
+	YAML_KEY_VAL(out, "sharer_pointers", SharerSet::pointers);
+	YAML_KEY_VAL(out, "sharer_group", 1 << SharerSet::groupShift);
 
 	out << YAML::EndMap;
 }
 
+/**
+ * @brief Save the global directory
+ *
+ * Directory is shared by all directory controllers so only the first
+ * controller saves and restores it.
+ */
+void DirectoryController::save_state(UarchStateWriter& writer) const
+{
+    if (idx == 0)
+        dir_.save_state(writer);
+}
+
+bool DirectoryController::restore_state(UarchStateReader& reader)
+{
+    if (idx == 0)
+        return dir_.restore_state(reader);
+
+    return true;
+}
+
 /**
  * @brief A Builder plugin for Global Directory Controller
  */
@@ -25,13 +25,73 @@ using namespace Memory;
 #define DIR_WAY 16
 #define DIR_LINE_SIZE 64
 #define DIR_ACCESS_DELAY 10
-#define REQ_Q_SIZE 128
+
+/* Queue must hold an evict message for every core at once */
+#define REQ_Q_SIZE ((NUM_SIM_CORES * 2 > 128) ? NUM_SIM_CORES * 2 + 16 : 128)
+
+/* Sharer pointers are packed as bytes in one 64 bit word */
+#define DIR_MAX_POINTERS 8
+
+/**
+ * @brief Set of cores that may have a cached copy of a line
+ *
+ * Sharers are kept in one 64 bit word so a directory entry has the same
+ * size for any number of simulated cores. With limited pointers the word
+ * holds up to 'pointers' core ids and the set is exact. When a line gets
+ * more sharers the set falls back to a coarse vector where each bit
+ * stands for a group of cores: test() is then true for every core of a
+ * marked group and reset() of a single core is ignored, so the set never
+ * misses a sharer but can contain cores that don't have the line. With
+ * 0 pointers the set is always a vector, which is exact up to 64 cores.
+ */
+struct SharerSet {
+    W64  bits;
+    W8   count;
+    bool vector;
+
+    static int pointers;
+    static int groupShift;
+
+    static void setup(int pointers_);
+
+    SharerSet() { reset(); }
+
+    void reset() {
+        bits   = 0;
+        count  = 0;
+        vector = (pointers == 0);
+    }
+
+    bool iszero() const { return vector ? (bits == 0) : (count == 0); }
+    bool nonzero() const { return !iszero(); }
+    bool is_coarse() const { return vector && groupShift > 0; }
+
+    bool test(int core) const;
+    void set(int core);
+    void reset(int core);
+    int  popcount() const;
+    int  lsb() const;
+
+    ostream& print(ostream &os) const;
+
+    private:
+        W8 pointer(int i) const { return (bits >> (i * 8)) & 0xff; }
+        void set_pointer(int i, W8 core) {
+            bits &= ~(0xffULL << (i * 8));
+            bits |= (W64)core << (i * 8);
+        }
+};
+
+static inline ostream& operator <<(ostream &os, const SharerSet &s)
+{
+    return s.print(os);
+}
 
 /**
  * @brief A Directory entry containing information for one line
  */
 struct DirectoryEntry {
-    bitvec<NUM_SIM_CORES> present;
+    SharerSet present;
     bool dirty;
     W64  tag;
     W8   owner;
@@ -59,33 +119,58 @@ static inline ostream& operator <<(ostream &os, const DirectoryEntry &e)
  * This is a singleton class so there is only one Global directory.
  * All directory controllers get access to this directory and should
  * simulate appropriate access delay. This directory is a set-assoc
- * structure. The size of the directory is statically set.
+ * structure with pseudo-LRU replacement, its geometry and sharer
+ * representation are set by the options of the first directory
+ * controller:
+ *
+ *   sets            : number of sets (power of 2)
+ *   ways            : number of ways, at most 64
+ *   sharer_pointers : sharer pointers per entry before falling back to a
+ *                     coarse vector, 0 keeps a bit vector
  *
  * TODO:
- *	- Allow configuration options to dynamically set directory size.
  *	- Simulate limited port access
  */
 class Directory {
     private:
-        Directory();
+        Directory(int sets, int ways);
         static Directory* dir;
 
-        typedef AssociativeArray<W64, DirectoryEntry, DIR_SET,
-                DIR_WAY, DIR_LINE_SIZE> base_t;
-        typedef FullyAssociativeArray<W64, DirectoryEntry, DIR_WAY,
-                NullAssociativeArrayStatisticsCollector<W64,
-                DirectoryEntry> > Set;
+        int setCount_;
+        int wayCount_;
+
+        /* Entries of set i are at [i * wayCount_, (i+1) * wayCount_) */
+        DirectoryEntry *entries;
 
-        base_t* entries;
+        /* Most recently used way bits of each set */
+        W64 *mru_;
+
+        int set_of(W64 addr) const {
+            return (addr >> log2(DIR_LINE_SIZE)) & (setCount_ - 1);
+        }
+
+        DirectoryEntry *set_base(W64 addr) const {
+            return &entries[set_of(addr) * wayCount_];
+        }
+
+        void touch(W64 addr, int way);
+        int  victim(W64 addr) const;
 
     public:
-        static Directory& get_directory();
+        static Directory& get_directory(BaseMachine &machine,
+                const char *name);
 
         DirectoryEntry *insert(MemoryRequest *req, W64&old_tag);
         DirectoryEntry *probe(MemoryRequest *req);
         int             invalidate(MemoryRequest *req);
 
-        W64 tag_of(W64 addr) { return base_t::tagof(addr); }
+        void save_state(UarchStateWriter& writer) const;
+        bool restore_state(UarchStateReader& reader);
+
+        int get_sets() const { return setCount_; }
+        int get_ways() const { return wayCount_; }
+
+        W64 tag_of(W64 addr) { return floor(addr, DIR_LINE_SIZE); }
 };
 
 struct DirContBufferEntry : public FixStateListObject
@@ -101,6 +186,7 @@ struct DirContBufferEntry : public FixStateListObject
     bool            hasData;
     int             depends;
     int             origin;
+    int             evicts;
 
     void init() {
         request         = NULL;
@@ -109,6 +195,7 @@ struct DirContBufferEntry : public FixStateListObject
         annuled         = 0;
         depends         = -1;
         origin          = -1;
+        evicts          = 0;
         shared          = 0;
         hasData         = 0;
         responder       = NULL;
@@ -130,6 +217,7 @@ struct DirContBufferEntry : public FixStateListObject
             os << "dirEntry[None] ";
         os << "depends[", depends, "] ";
         os << "origin[", origin, "] ";
+        os << "evicts[", evicts, "] ";
         os << "free_on_success[", free_on_success, "] ";
         os << "annuled[", annuled, "]";
         os << endl;
@@ -191,6 +279,8 @@ class DirectoryController : public Controller {
         bool is_full(bool flag=false) const;
         void annul_request(MemoryRequest *request);
 		void dump_configuration(YAML::Emitter &out) const;
+		void save_state(UarchStateWriter& writer) const;
+		bool restore_state(UarchStateReader& reader);
 
         bool handle_read_miss(Message *message);
         bool handle_write_miss(Message *message);
@@ -211,6 +301,8 @@ class DirectoryController : public Controller {
         DirContBufferEntry* find_entry(MemoryRequest *req);
         DirContBufferEntry* find_dependent_enry(MemoryRequest *req);
         void wakeup_dependent(DirContBufferEntry *queueEntry);
+        void evicts_completed(DirContBufferEntry *queueEntry);
+        DirectoryController* owner_dir(DirectoryEntry *entry);
 
         DirectoryEntry* get_directory_entry(MemoryRequest *req,
                 bool must_present=0);
@@ -29,6 +29,7 @@
 #define INTERCONNECT_H
 
 #include <controller.h>
+#include <lineData.h>
 
 namespace Memory {
 
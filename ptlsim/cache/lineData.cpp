@@ -0,0 +1,208 @@
+/*
+ * MARSSx86 : A Full System Computer-Architecture Simulator
+ *
+ * This code is released under GPL.
+ *
+ */
+
+#ifdef MEM_TEST
+#include <test.h>
+#else
+#include <ptlsim.h>
+#endif
+
+#include <ptl-qemu.h>
+
+#include <memoryHierarchy.h>
+#include <lineData.h>
+#include <cacheLines.h>
+
+using namespace Memory;
+
+LineDataPool::LineDataPool(Statable *parent, int lineSize, W64 limitBytes)
+    : lineSize_(lineSize)
+    , limitBytes_(limitBytes)
+    , allocBytes_(0)
+    , inUse_(0)
+    , limitReported_(false)
+    , chunks_(NULL)
+    , chunkNext_(NULL)
+    , chunkEnd_(NULL)
+    , freeList_(NULL)
+    , stats(parent)
+{
+    /* Free list and chunk links are stored in the buffers */
+    assert(lineSize_ >= (int)sizeof(W8*) && lineSize_ <= PAGE_SIZE);
+    assert((lineSize_ & (lineSize_ - 1)) == 0);
+}
+
+LineDataPool::~LineDataPool()
+{
+    while (chunks_) {
+        W8 *next = *(W8**)chunks_;
+        delete [] chunks_;
+        chunks_ = next;
+    }
+}
+
+W8 *LineDataPool::alloc()
+{
+    W8 *buf;
+
+    if (freeList_) {
+        buf = freeList_;
+        freeList_ = *(W8**)buf;
+        inUse_++;
+        return buf;
+    }
+
+    if (chunkNext_ == chunkEnd_) {
+        if (allocBytes_ + CHUNK_SIZE > limitBytes_) {
+            if (!limitReported_) {
+                ptl_logfile << "[WARNING] Cache line data reached ",
+                            "verify-cache-limit of ", limitBytes_,
+                            " bytes, new lines are not checked", endl;
+                limitReported_ = true;
+            }
+            return NULL;
+        }
+
+        /* First line of each chunk links to the previous chunk */
+        W8 *chunk = new W8[CHUNK_SIZE];
+        *(W8**)chunk = chunks_;
+        chunks_ = chunk;
+        chunkNext_ = chunk + lineSize_;
+        chunkEnd_ = chunk + CHUNK_SIZE;
+        allocBytes_ += CHUNK_SIZE;
+    }
+
+    buf = chunkNext_;
+    chunkNext_ += lineSize_;
+    inUse_++;
+
+    return buf;
+}
+
+void LineDataPool::free(W8 *buf)
+{
+    *(W8**)buf = freeList_;
+    freeList_ = buf;
+    inUse_--;
+}
+
+const W8* LineDataPool::read_memory(W64 address, bool kernel)
+{
+    /* Read guest RAM in place through the QEMU TLB mapping */
+    const W8 *src = ptl_guest_ram_ptr(address & ~(W64)(lineSize_ - 1));
+
+    if (src)
+        N_STAT_UPDATE(stats.memory_reads, ++, kernel);
+
+    return src;
+}
+
+void LineDataPool::hold(LineDataBuffer& held, const W8 *src, bool kernel)
+{
+    held.valid = false;
+
+    if (!src)
+        return;
+
+    if (!held.buf) {
+        held.buf = alloc();
+        if (!held.buf) {
+            N_STAT_UPDATE(stats.untracked, ++, kernel);
+            return;
+        }
+    }
+
+    memcpy(held.buf, src, lineSize_);
+    held.valid = true;
+}
+
+void LineDataPool::fill(CacheLine *line, const W8 *src, bool kernel)
+{
+    if (!src) {
+        if (!line->dataValid)
+            N_STAT_UPDATE(stats.untracked, ++, kernel);
+        return;
+    }
+
+    if (!line->data)
+        line->data = alloc();
+
+    if (!line->data) {
+        line->dataValid = false;
+        N_STAT_UPDATE(stats.untracked, ++, kernel);
+        return;
+    }
+
+    /* A line can be filled from its own data, as by a snoop response */
+    if (src != line->data)
+        memcpy(line->data, src, lineSize_);
+    line->dataValid = true;
+
+    N_STAT_UPDATE(stats.message_fills, ++, kernel);
+}
+
+void LineDataPool::update(CacheLine *line, const W8 *src, bool kernel)
+{
+    if (!src) {
+        line->dataValid = false;
+        N_STAT_UPDATE(stats.untracked, ++, kernel);
+        return;
+    }
+
+    fill(line, src, kernel);
+}
+
+void LineDataPool::write(CacheLine *line, MemoryRequest *request)
+{
+    W8 mask = request->get_store_mask();
+
+    if (!line->dataValid || !mask)
+        return;
+
+    W64 data = request->get_store_data();
+    W8 *word = line->data + (request->get_physical_address() &
+            (lineSize_ - 1) & ~7);
+
+    foreach (i, 8) {
+        if (mask & (1 << i))
+            word[i] = data >> (8 * i);
+    }
+
+    N_STAT_UPDATE(stats.store_writes, ++, request->is_kernel());
+}
+
+bool LineDataPool::check(CacheLine *line, W64 address, int bytes,
+        bool kernel)
+{
+    const W8 *ram = ptl_guest_ram_ptr(address);
+
+    if (!line->dataValid || !ram)
+        return true;
+
+    N_STAT_UPDATE(stats.checks, ++, kernel);
+
+    if (memcmp(line->data + (address & (lineSize_ - 1)), ram, bytes) == 0)
+        return true;
+
+    N_STAT_UPDATE(stats.mismatches, ++, kernel);
+
+    if (logable(5)) {
+        ptl_logfile << "Cache data mismatch at ", (void*)address,
+                    " cycle ", sim_cycle, endl;
+    }
+
+    return false;
+}
+
+void LineDataPool::update_stats()
+{
+    if (!global_stats)
+        return;
+
+    stats.arena_bytes(global_stats) = allocBytes_;
+    stats.buffers(global_stats) = inUse_;
+}
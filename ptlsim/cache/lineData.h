@@ -0,0 +1,188 @@
+/*
+ * MARSSx86 : A Full System Computer-Architecture Simulator
+ *
+ * This code is released under GPL.
+ *
+ */
+
+#ifndef LINE_DATA_H
+#define LINE_DATA_H
+
+#include <globals.h>
+#include <superstl.h>
+#include <statsBuilder.h>
+
+namespace Memory {
+
+    struct CacheLine;
+    class MemoryRequest;
+
+    /*
+     * Cache line data statistics, only collected with verify-cache
+     *
+     *  memory_reads   : line reads of memory controllers served from
+     *                   guest RAM
+     *  message_fills  : lines filled with the data of a response or
+     *                   writeback message
+     *  store_writes   : committed stores merged into L1 data lines
+     *  untracked      : fills without data in the message, or lines and
+     *                   messages left without data as the arena was full
+     *  checks         : committed loads compared against guest memory
+     *  skipped        : committed loads not compared as a store to the
+     *                   line was still in flight
+     *  mismatches     : committed loads whose L1 data differs from guest
+     *                   memory
+     *  arena_bytes    : bytes allocated for line and message buffers
+     *  buffers        : line and message buffers in use
+     */
+    struct LineDataStats : public Statable
+    {
+        StatObj<W64> memory_reads;
+        StatObj<W64> message_fills;
+        StatObj<W64> store_writes;
+        StatObj<W64> untracked;
+        StatObj<W64> checks;
+        StatObj<W64> skipped;
+        StatObj<W64> mismatches;
+        StatObj<W64> arena_bytes;
+        StatObj<W64> buffers;
+
+        LineDataStats(Statable *parent)
+            : Statable("cache_data", parent)
+              , memory_reads("memory_reads", this)
+              , message_fills("message_fills", this)
+              , store_writes("store_writes", this)
+              , untracked("untracked", this)
+              , checks("checks", this)
+              , skipped("skipped", this)
+              , mismatches("mismatches", this)
+              , arena_bytes("arena_bytes", this)
+              , buffers("buffers", this)
+        {}
+    };
+
+    /*
+     * Line data held by a queue entry of a cache or an interconnect until
+     * the message it came with is sent on. The buffer is kept when the
+     * entry is reused, 'valid' says if it holds data of the current
+     * message.
+     */
+    struct LineDataBuffer
+    {
+        W8 *buf;
+        bool valid;
+
+        LineDataBuffer() : buf(NULL), valid(false) {}
+
+        void reset() { valid = false; }
+
+        const W8* get() const { return valid ? buf : NULL; }
+    };
+
+    /**
+     * @brief Pooled data buffers of cache lines and queue entries
+     *
+     * Buffers of one line size are carved out of large chunks and never
+     * returned to the heap, a freed buffer goes to a free list. Memory is
+     * bounded by 'limitBytes': once it is reached lines are left without
+     * data and are not checked.
+     *
+     * Data moves only with messages: memory controllers read it from
+     * guest RAM, caches fill lines from response and writeback messages
+     * and L1 data caches merge the bytes of committed stores. Guest RAM is
+     * written by the functional model before a store commits, so it is
+     * both the memory image and the reference loads are checked against.
+     */
+    class LineDataPool
+    {
+        private:
+            int lineSize_;
+            W64 limitBytes_;
+            W64 allocBytes_;
+            W64 inUse_;
+            bool limitReported_;
+
+            /* Chunks are linked through their first word */
+            W8 *chunks_;
+            W8 *chunkNext_;
+            W8 *chunkEnd_;
+
+            /* Free buffers are linked through their first word */
+            W8 *freeList_;
+
+        public:
+            static const int CHUNK_SIZE = 1 << 20;
+
+            LineDataStats stats;
+
+            LineDataPool(Statable *parent, int lineSize, W64 limitBytes);
+            ~LineDataPool();
+
+            /* Returns NULL when the memory limit is reached */
+            W8 *alloc();
+            void free(W8 *buf);
+
+            /**
+             * @brief Data of a line read by a memory controller
+             *
+             * @return Guest RAM of the line, NULL if it is not mapped
+             */
+            const W8* read_memory(W64 address, bool kernel);
+
+            /**
+             * @brief Keep data of a received message in a queue entry
+             *
+             * @param held Buffer of the queue entry
+             * @param src Data of the message, NULL if it has none
+             */
+            void hold(LineDataBuffer& held, const W8 *src, bool kernel);
+
+            /**
+             * @brief Fill a line with the data of a response or writeback
+             *
+             * A message without data, like an upgrade response, leaves
+             * the data the line already has.
+             *
+             * @param line Line of the message address
+             * @param src Data of the message, NULL if it has none
+             */
+            void fill(CacheLine *line, const W8 *src, bool kernel);
+
+            /**
+             * @brief Write back the data of an upper cache into a line
+             *
+             * @param line Line of the writeback address
+             * @param src Data of the writeback, NULL if it has none, then
+             * the line has no valid data either
+             */
+            void update(CacheLine *line, const W8 *src, bool kernel);
+
+            /**
+             * @brief Merge the bytes of a committed store into a line
+             *
+             * @param line Line of the store address
+             * @param request Write request with its store data
+             */
+            void write(CacheLine *line, MemoryRequest *request);
+
+            /**
+             * @brief Compare data of a line with guest memory
+             *
+             * @return false if the bytes differ, true if they match or the
+             * line or its guest memory has no data
+             */
+            bool check(CacheLine *line, W64 address, int bytes,
+                    bool kernel);
+
+            int get_line_size() const { return lineSize_; }
+            W64 get_limit() const { return limitBytes_; }
+            W64 get_alloc_bytes() const { return allocBytes_; }
+            W64 get_in_use() const { return inUse_; }
+
+            /* Write arena usage into global stats */
+            void update_stats();
+    };
+
+};
+
+#endif // LINE_DATA_H
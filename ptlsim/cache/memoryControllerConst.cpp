@@ -161,6 +161,7 @@ bool MemoryControllerConst::handle_interconnect_cb(void *arg)
 	queueEntry->source = (Controller*)message->origin;
 
 	queueEntry->request->incRefCounter();
+	queueEntry->request->set_miss(MAIN_MEMORY);
 	ADD_HISTORY_ADD(queueEntry->request);
 
 	int bank_no = get_bank_id(message->request->
@@ -266,6 +267,10 @@ bool MemoryControllerConst::wait_interconnect_cb(void *arg)
 	message.dest = queueEntry->source;
 	message.request = queueEntry->request;
 	message.hasData = true;
+	/* Memory is guest RAM, writebacks need not update it */
+	message.data = memoryHierarchy_->read_memory_data(
+		queueEntry->request->get_physical_address(),
+		queueEntry->request->is_kernel());
 
 	memdebug("Memory sending message: ", message);
 	success = cacheInterconnect_->get_controller_request_signal()->
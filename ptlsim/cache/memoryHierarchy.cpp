@@ -40,6 +40,7 @@
 //#include <CacheConstants.h>
 #include <memoryStats.h>
 #include <memoryHierarchy.h>
+#include <cacheLines.h>
 #include <statelist.h>
 
 #include <cpuController.h>
@@ -52,12 +53,14 @@ using namespace Memory;
 MemoryHierarchy::MemoryHierarchy(BaseMachine& machine) :
     machine_(machine)
     , someStructIsFull_(false)
+    , lineData_(NULL)
 {
     coreNo_ = machine_.get_num_cores();
 
     foreach(i, NUM_SIM_CORES) {
         RequestPool* pool = new RequestPool();
         requestPool_.push(pool);
+        dataCaches_[i] = NULL;
     }
 }
 
@@ -68,6 +71,10 @@ MemoryHierarchy::~MemoryHierarchy()
         delete pool;
     }
     requestPool_.clear();
+
+    /* Request and line buffers are freed with the pool */
+    if(lineData_)
+        delete lineData_;
 }
 
 bool MemoryHierarchy::access_cache(MemoryRequest *request)
@@ -200,6 +207,82 @@ bool MemoryHierarchy::is_cache_available(W8 coreid, W8 threadid,
 	return !(cpuController->is_full());
 }
 
+/* Called when stats are dumped, after global stats are summed */
+void MemoryHierarchy::update_stats()
+{
+	foreach(i, allControllers_.count()) {
+		allControllers_[i]->update_stats();
+	}
+
+	if(lineData_)
+		lineData_->update_stats();
+}
+
+/**
+ * @brief Get the line data pool shared by all caches
+ *
+ * @param lineSize Line size of the calling cache, all caches must use the
+ * same line size
+ *
+ * @return NULL if verify-cache is not enabled
+ */
+LineDataPool* MemoryHierarchy::get_line_data(int lineSize)
+{
+	if(!config.verify_cache)
+		return NULL;
+
+	if(!lineData_) {
+		lineData_ = new LineDataPool(&machine_, lineSize,
+				config.verify_cache_limit << 20);
+	}
+
+	if(lineData_->get_line_size() != lineSize) {
+		ptl_logfile << "[ERROR] verify-cache needs the same line size in ",
+					"all caches", endl;
+		assert_fail(__STRING(0), __FILE__, __LINE__, __PRETTY_FUNCTION__);
+	}
+
+	return lineData_;
+}
+
+/**
+ * @brief Check line data of L1 data cache at commit
+ *
+ * Loads compare their bytes with guest memory. Committed stores write
+ * guest memory before they reach any cache, so lines with a store of any
+ * core still in flight are not checked.
+ *
+ * @param coreid Core committing the load
+ * @param physaddr 8 byte aligned physical address of the load
+ * @param bytemask Bytes loaded in the 8 byte word
+ * @param kernel True for kernel mode loads
+ */
+void MemoryHierarchy::verify_cache_data(W8 coreid, W64 physaddr,
+		W8 bytemask, bool kernel)
+{
+	CacheLinesBase *lines = dataCaches_[coreid];
+
+	if(!lineData_ || !lines || !bytemask)
+		return;
+
+	CacheLine *line = lines->peek(physaddr);
+	if(!line || !line->state)
+		return;
+
+	foreach(i, cpuControllers_.count()) {
+		CPUController *cpuController = (CPUController*)cpuControllers_[i];
+		if(cpuController->is_write_pending(physaddr)) {
+			N_STAT_UPDATE(lineData_->stats.skipped, ++, kernel);
+			return;
+		}
+	}
+
+	int offset = lsbindex32(bytemask);
+	int bytes = msbindex32(bytemask) - offset + 1;
+
+	lineData_->check(line, physaddr + offset, bytes, kernel);
+}
+
 void MemoryHierarchy::dump_info(ostream& os)
 {
 	os << "MemoryHierarchy info:\n";
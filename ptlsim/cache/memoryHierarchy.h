@@ -36,6 +36,7 @@
 #include <memoryRequest.h>
 #include <controller.h>
 #include <interconnect.h>
+#include <lineData.h>
 
 #include <statsBuilder.h>
 
@@ -86,6 +87,8 @@
 
 namespace Memory {
 
+  struct CacheLinesBase;
+
   class Event : public FixStateListObject
 	{
 		private:
@@ -209,6 +212,8 @@ namespace Memory {
 	// return the number of cycle used to flush the caches
     int flush(uint8_t coreid);
 
+    void update_stats();
+
 	// for debugging
     void dump_info(ostream& os);
 	void print_map(ostream& os);
@@ -254,6 +259,30 @@ namespace Memory {
         interconnectsFullFlags_.resize(allInterconnects_.count(), false);
     }
 
+    // line data of caches with verify-cache, NULL when disabled
+    LineDataPool* get_line_data(int lineSize);
+
+    void set_data_cache(W8 coreid, CacheLinesBase *lines) {
+        dataCaches_[coreid] = lines;
+    }
+
+    // keep line data of a received message until it is sent on
+    void hold_line_data(LineDataBuffer& held, const W8 *src, bool kernel) {
+        if(lineData_)
+            lineData_->hold(held, src, kernel);
+        else
+            held.reset();
+    }
+
+    // line data of a memory read, NULL without verify-cache
+    const W8* read_memory_data(W64 address, bool kernel) {
+        return lineData_ ? lineData_->read_memory(address, kernel) : NULL;
+    }
+
+    // compare a committed load with L1 line data
+    void verify_cache_data(W8 coreid, W64 physaddr, W8 bytemask,
+            bool kernel);
+
     bool grab_lock(W64 lockaddr, W8 ctx_id);
     bool probe_lock(W64 lockaddr, W8 ctx_id);
     void invalidate_lock(W64 lockaddr, W8 ctx_id);
@@ -285,6 +314,10 @@ namespace Memory {
 	// Message pool
 	FixStateList<Message, 128> messageQueue_;
 
+	// Line data with verify-cache and L1 data cache of each core
+	LineDataPool *lineData_;
+	CacheLinesBase *dataCaches_[NUM_SIM_CORES];
+
 	// Event Queue
 	FixStateList<Event, 2048> eventQueue_;
 
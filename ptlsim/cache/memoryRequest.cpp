@@ -63,6 +63,8 @@ void MemoryRequest::init(W8 coreId,
 	opType_ = opType;
 	isData_ = !isInstruction;
     isMapped_ = true; /* yclin */
+	missMask_ = 0;
+	storeMask_ = 0;
 
 	if(history) delete history;
 	history = new stringbuf();
@@ -83,6 +85,8 @@ void MemoryRequest::init(MemoryRequest *request)
 	opType_ = request->opType_;
 	isData_ = request->isData_;
     isMapped_ = request->isMapped_; /* yclin */
+	missMask_ = 0;
+	storeMask_ = 0;
 
 	if(history) delete history;
 	history = new stringbuf();
@@ -69,6 +69,9 @@ class MemoryRequest: public selfqueuelink
             coreSignal_ = NULL;
             coreSignal2_ = NULL; /* yclin */
             isMapped_ = true; /* yclin */
+			missMask_ = 0;
+			storeData_ = 0;
+			storeMask_ = 0;
 		}
 
 		void incRefCounter(){
@@ -180,6 +183,21 @@ class MemoryRequest: public selfqueuelink
 			return os;
 		}
 		
+        /* Caches that missed this request, one bit per CacheType */
+        W8 get_miss_mask() { return missMask_; }
+        void set_miss(CacheType type) { missMask_ |= (1 << type); }
+
+        /*
+         * Bytes of a committed store in the 8 byte word of the request
+         * address, only set with verify-cache
+         */
+        void set_store_data(W64 data, W8 mask) {
+            storeData_ = data;
+            storeMask_ = mask;
+        }
+        W64 get_store_data() { return storeData_; }
+        W8 get_store_mask() { return storeMask_; }
+
         /* yclin */
         bool is_mapped() {
             return isMapped_;
@@ -205,6 +223,9 @@ class MemoryRequest: public selfqueuelink
         Signal *coreSignal_;
         Signal *coreSignal2_; /* yclin */
         bool isMapped_; /* yclin */
+		W8 missMask_;
+		W64 storeData_;
+		W8 storeMask_;
 
 };
 
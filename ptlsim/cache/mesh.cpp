@@ -0,0 +1,595 @@
+/*
+ * MARSSx86 : A Full System Computer-Architecture Simulator
+ *
+ * This code is released under GPL.
+ *
+ */
+
+#include <mesh.h>
+
+using namespace Memory;
+using namespace Memory::MeshInterconnect;
+
+
+Mesh::Mesh(const char *name, MemoryHierarchy *memoryHierarchy)
+    : Interconnect(name, memoryHierarchy)
+      , tick_scheduled(false)
+      , network_built(false)
+      , in_flight(0)
+{
+    memoryHierarchy_->add_interconnect(this);
+
+    SET_SIGNAL_CB(name, "_tick", tick, &Mesh::tick_cb);
+
+    BaseMachine &machine = memoryHierarchy_->get_machine();
+
+    if (!machine.get_option(name, "rows", rows_))
+        rows_ = 0;
+    if (!machine.get_option(name, "cols", cols_))
+        cols_ = 0;
+    if (!machine.get_option(name, "torus", torus_))
+        torus_ = false;
+    if (!machine.get_option(name, "vcs", vcs_))
+        vcs_ = MESH_VCS;
+    if (!machine.get_option(name, "vc_depth", vc_depth_))
+        vc_depth_ = MESH_VC_DEPTH;
+    if (!machine.get_option(name, "router_stages", router_stages_))
+        router_stages_ = MESH_ROUTER_STAGES;
+    if (!machine.get_option(name, "link_latency", link_latency_))
+        link_latency_ = MESH_LINK_LATENCY;
+    if (!machine.get_option(name, "link_width", link_width_))
+        link_width_ = MESH_LINK_WIDTH;
+    if (!machine.get_option(name, "data_bytes", data_bytes_))
+        data_bytes_ = MESH_DATA_BYTES;
+    if (!machine.get_option(name, "queue_size", queue_size_))
+        queue_size_ = MESH_QUEUE_SIZE;
+
+    stringbuf tiles;
+    if (machine.get_option(name, "tiles", tiles))
+        parse_tiles(tiles.buf);
+
+    assert(link_width_ > 0);
+    assert(router_stages_ >= 0 && link_latency_ > 0);
+
+    /* Torus needs two VC classes to break the cyclic dependency of the
+     * rings, and every VC must hold the largest packet. */
+    if (torus_ && vcs_ < 2)
+        vcs_ = 2;
+    vcs_ = max(vcs_, 1);
+
+    int max_flits = 1 + ceil(data_bytes_, link_width_) / link_width_;
+    vc_depth_ = max(vc_depth_, max_flits);
+
+    new_stats = new MeshStats(name, &machine);
+}
+
+Mesh::~Mesh()
+{
+    foreach (i, routers.count()) {
+        delete routers[i];
+    }
+
+    foreach (i, packets.count()) {
+        delete packets[i];
+    }
+}
+
+/**
+ * @brief Parse the 'tiles' option, a comma separated list of tile numbers
+ */
+void Mesh::parse_tiles(const char *list)
+{
+    const char *p = list;
+
+    while (*p) {
+        char *end;
+        long tile = strtol(p, &end, 10);
+
+        if (end == p || tile < 0) {
+            ptl_logfile << "Mesh ", get_name(), " invalid tiles option '",
+                        list, "'\n";
+            assert_fail(__STRING(0), __FILE__, __LINE__,
+                    __PRETTY_FUNCTION__);
+        }
+
+        tiles_.push(tile);
+
+        for (p = end; *p == ',' || *p == ' '; p++) ;
+    }
+
+    if (cols_ <= 0) {
+        ptl_logfile << "Mesh ", get_name(),
+                    " needs the 'cols' option with 'tiles'\n";
+        assert_fail(__STRING(0), __FILE__, __LINE__, __PRETTY_FUNCTION__);
+    }
+}
+
+void Mesh::register_controller(Controller *controller)
+{
+    assert(!network_built);
+
+    int tile = routers.count();
+
+    if (tiles_.count() > 0) {
+        if (tile >= tiles_.count()) {
+            ptl_logfile << "Mesh ", get_name(), " has no tile for ",
+                        controller->get_name(), "\n";
+            assert_fail(__STRING(0), __FILE__, __LINE__,
+                    __PRETTY_FUNCTION__);
+        }
+        tile = tiles_[tile];
+    }
+
+    Router *router = new Router(tile, vcs_, vc_depth_);
+    router->controller = controller;
+    tile_of_.add((W64)controller, tile);
+
+    stringbuf st_name;
+    st_name << "router_" << router->id;
+    router->stats = new RouterStats(st_name, new_stats);
+
+    routers.push(router);
+}
+
+/**
+ * @brief Place the routers on the grid and connect them
+ *
+ * Grid dimensions are only known once all controllers are registered, so
+ * this is done on the first request. Tiles without a controller are
+ * filled with routers that only forward packets.
+ */
+void Mesh::build_network()
+{
+    int nodes = routers.count();
+    assert(nodes > 0);
+
+    if (cols_ <= 0) {
+        if (rows_ > 0)
+            cols_ = ceil(nodes, rows_) / rows_;
+        else
+            for (cols_ = 1; cols_ * cols_ < nodes; cols_++) ;
+    }
+
+    if (rows_ <= 0) {
+        int tiles = nodes;
+        foreach (i, tiles_.count()) {
+            tiles = max(tiles, tiles_[i] + 1);
+        }
+        rows_ = ceil(tiles, cols_) / cols_;
+    }
+
+    if (rows_ * cols_ < nodes) {
+        ptl_logfile << "Mesh ", get_name(), " has ", nodes,
+                    " controllers but only ", rows_, "x", cols_,
+                    " tiles\n";
+        assert_fail(__STRING(0), __FILE__, __LINE__, __PRETTY_FUNCTION__);
+    }
+
+    /* Routers are indexed by tile from here on */
+    dynarray<Router*> grid;
+    grid.resize(rows_ * cols_, NULL);
+
+    foreach (i, nodes) {
+        Router *router = routers[i];
+
+        if (router->id >= grid.count() || grid[router->id]) {
+            ptl_logfile << "Mesh ", get_name(), " can't place ",
+                        router->controller->get_name(), " on tile ",
+                        router->id, "\n";
+            assert_fail(__STRING(0), __FILE__, __LINE__,
+                    __PRETTY_FUNCTION__);
+        }
+
+        grid[router->id] = router;
+    }
+
+    foreach (i, grid.count()) {
+        if (!grid[i])
+            grid[i] = new Router(i, vcs_, vc_depth_);
+    }
+
+    routers.clear();
+    foreach (i, grid.count()) {
+        routers.push(grid[i]);
+    }
+
+    foreach (i, routers.count()) {
+        Router *router = routers[i];
+        router->x = i % cols_;
+        router->y = i / cols_;
+    }
+
+    foreach (i, routers.count()) {
+        Router *router = routers[i];
+        int x = router->x;
+        int y = router->y;
+
+        if (y > 0)
+            router->neighbors[PORT_NORTH] = routers[(y - 1) * cols_ + x];
+        else if (torus_ && rows_ > 1)
+            router->neighbors[PORT_NORTH] = routers[(rows_ - 1) * cols_ + x];
+
+        if (y < rows_ - 1)
+            router->neighbors[PORT_SOUTH] = routers[(y + 1) * cols_ + x];
+        else if (torus_ && rows_ > 1)
+            router->neighbors[PORT_SOUTH] = routers[x];
+
+        if (x > 0)
+            router->neighbors[PORT_WEST] = routers[y * cols_ + x - 1];
+        else if (torus_ && cols_ > 1)
+            router->neighbors[PORT_WEST] = routers[y * cols_ + cols_ - 1];
+
+        if (x < cols_ - 1)
+            router->neighbors[PORT_EAST] = routers[y * cols_ + x + 1];
+        else if (torus_ && cols_ > 1)
+            router->neighbors[PORT_EAST] = routers[y * cols_];
+    }
+
+    network_built = true;
+}
+
+Router* Mesh::get_router(Controller *cont)
+{
+    if (!network_built)
+        build_network();
+
+    int *tile = tile_of_.get((W64)cont);
+
+    assert(tile);
+    return routers[*tile];
+}
+
+int Mesh::access_fast_path(Controller *controller,
+        MemoryRequest *request)
+{
+    return -1;
+}
+
+MeshPacket* Mesh::alloc_packet()
+{
+    MeshPacket *packet;
+
+    if (free_packets.count() > 0) {
+        packet = free_packets.pop();
+    } else {
+        packet = new MeshPacket();
+        packets.push(packet);
+    }
+
+    packet->init();
+    return packet;
+}
+
+void Mesh::free_packet(MeshPacket *packet)
+{
+    if (!packet->annuled) {
+        packet->request->decRefCounter();
+        ADD_HISTORY_REM(packet->request);
+    }
+
+    packet->in_use = 0;
+    free_packets.push(packet);
+    in_flight--;
+}
+
+void Mesh::annul_request(MemoryRequest *request)
+{
+    /* Annuled packets are dropped by their router on the next tick so
+     * the credits they hold are returned upstream. */
+    foreach (i, packets.count()) {
+        MeshPacket *packet = packets[i];
+
+        if (packet->in_use && !packet->annuled &&
+                packet->request->is_same(request)) {
+            packet->annuled = true;
+            packet->request->decRefCounter();
+            ADD_HISTORY_REM(packet->request);
+        }
+    }
+}
+
+bool Mesh::controller_request_cb(void *arg)
+{
+    Message *msg = (Message*)arg;
+
+    if (!network_built)
+        build_network();
+
+    Router *src = get_router((Controller*)msg->sender);
+
+    if (src->inject.count >= queue_size_) {
+        new_stats->queue_full++;
+        return false;
+    }
+
+    MeshPacket *packet = alloc_packet();
+    *packet << *msg;
+    memoryHierarchy_->hold_line_data(packet->data, msg->data,
+            packet->request->is_kernel());
+    ADD_HISTORY_ADD(packet->request);
+
+    packet->dest_node    = get_router(packet->dest)->id;
+    packet->flits        = 1;
+    if (packet->has_data)
+        packet->flits   += ceil(data_bytes_, link_width_) / link_width_;
+    packet->inject_cycle = sim_cycle;
+    packet->ready_cycle  = sim_cycle + router_stages_;
+
+    src->inject.push(packet);
+    in_flight++;
+
+    new_stats->injected++;
+    new_stats->flits += packet->flits;
+
+    if (!tick_scheduled) {
+        marss_add_event(&tick, 1, NULL);
+        tick_scheduled = true;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Dimension-order (XY) route of a packet from given router
+ *
+ * @return Output port to use, PORT_LOCAL at the destination
+ */
+int Mesh::route(Router *router, MeshPacket *packet) const
+{
+    int dx = (packet->dest_node % cols_) - router->x;
+    int dy = (packet->dest_node / cols_) - router->y;
+
+    if (dx != 0) {
+        if (torus_) {
+            int forward = (dx + cols_) % cols_;
+            return (forward <= cols_ - forward) ? PORT_EAST : PORT_WEST;
+        }
+        return (dx > 0) ? PORT_EAST : PORT_WEST;
+    }
+
+    if (dy != 0) {
+        if (torus_) {
+            int forward = (dy + rows_) % rows_;
+            return (forward <= rows_ - forward) ? PORT_SOUTH : PORT_NORTH;
+        }
+        return (dy > 0) ? PORT_SOUTH : PORT_NORTH;
+    }
+
+    return PORT_LOCAL;
+}
+
+bool Mesh::crosses_wrap(Router *router, int port) const
+{
+    switch (port) {
+        case PORT_NORTH: return router->y == 0;
+        case PORT_SOUTH: return router->y == rows_ - 1;
+        case PORT_WEST:  return router->x == 0;
+        case PORT_EAST:  return router->x == cols_ - 1;
+    }
+    return false;
+}
+
+/**
+ * @brief Range of downstream VCs a packet can be allocated
+ *
+ * In a torus, packets use the lower half of the VCs until they cross
+ * the dateline (the wraparound link) of the current dimension.
+ */
+void Mesh::vc_range(MeshPacket *packet, int &start, int &end) const
+{
+    if (!torus_) {
+        start = 0;
+        end   = vcs_;
+        return;
+    }
+
+    int half = vcs_ / 2;
+    start = packet->dateline ? half : 0;
+    end   = packet->dateline ? vcs_ : half;
+}
+
+/**
+ * @brief Remove packet from the head of an input VC and return its
+ * credits to the upstream router
+ */
+void Mesh::release_input(Router *router, int port, MeshPacket *packet)
+{
+    if (port == PORT_LOCAL) {
+        router->inject.pop();
+        return;
+    }
+
+    router->inputs[port][packet->vc].pop();
+
+    Router *upstream = router->neighbors[port];
+    upstream->credits[opposite_port(port)][packet->vc] += packet->flits;
+}
+
+bool Mesh::eject(Router *router, MeshPacket *packet)
+{
+    Message *msg = memoryHierarchy_->get_message();
+    msg->sender  = this;
+    *msg << *packet;
+
+    bool success = router->controller->get_interconnect_signal()->
+        emit(msg);
+
+    memoryHierarchy_->free_message(msg);
+
+    memdebug("Mesh sending message success: " << success << endl);
+
+    return success;
+}
+
+/**
+ * @brief Switch allocation for one output port of a router
+ *
+ * Input VCs are scanned round-robin; the first ready packet routed to
+ * this port that can get a downstream VC wins the port for this cycle.
+ *
+ * @return true if a packet was sent through the port
+ */
+bool Mesh::schedule_output(Router *router, int port)
+{
+    int slots = NUM_PORTS * vcs_;
+
+    foreach (i, slots) {
+        int slot = (router->rr[port] + i) % slots;
+        int in_port = slot / vcs_;
+        int in_vc = slot % vcs_;
+
+        if (router->input_used[in_port] == sim_cycle)
+            continue;
+
+        PacketQueue &queue = (in_port == PORT_LOCAL) ?
+            router->inject : router->inputs[in_port][in_vc];
+
+        if (in_port == PORT_LOCAL && in_vc != 0)
+            continue;
+
+        MeshPacket *packet = queue.head;
+
+        if (!packet)
+            continue;
+
+        if (packet->annuled) {
+            release_input(router, in_port, packet);
+            free_packet(packet);
+            continue;
+        }
+
+        if (packet->ready_cycle > sim_cycle || route(router, packet) != port)
+            continue;
+
+        if (port == PORT_LOCAL) {
+            if (!eject(router, packet)) {
+                new_stats->eject_retries++;
+                continue;
+            }
+
+            release_input(router, in_port, packet);
+
+            new_stats->delivered++;
+            new_stats->hops += packet->hops;
+            new_stats->latency += sim_cycle - packet->inject_cycle;
+        } else {
+            int dim = (port == PORT_EAST || port == PORT_WEST) ? 0 : 1;
+            if (dim != packet->dim) {
+                packet->dim = dim;
+                packet->dateline = false;
+            }
+
+            bool wrap = crosses_wrap(router, port);
+            if (wrap)
+                packet->dateline = true;
+
+            int start, end;
+            vc_range(packet, start, end);
+
+            int out_vc = -1;
+            for (int v = start; v < end; v++) {
+                if (router->credits[port][v] >= packet->flits) {
+                    out_vc = v;
+                    break;
+                }
+            }
+
+            if (out_vc < 0) {
+                if (wrap)
+                    packet->dateline = false;
+                if (router->stats)
+                    router->stats->credit_stalls[port]++;
+                continue;
+            }
+
+            release_input(router, in_port, packet);
+
+            router->credits[port][out_vc] -= packet->flits;
+            packet->vc = out_vc;
+            packet->hops++;
+            packet->ready_cycle = sim_cycle + link_latency_ + router_stages_;
+
+            Router *next = router->neighbors[port];
+            next->inputs[opposite_port(port)][out_vc].push(packet);
+        }
+
+        router->input_used[in_port] = sim_cycle;
+        router->link_free[port] = sim_cycle + packet->flits;
+        router->rr[port] = (slot + 1) % slots;
+
+        if (router->stats) {
+            router->stats->link_flits[port] += packet->flits;
+            router->stats->link_packets[port]++;
+        }
+
+        if (port == PORT_LOCAL)
+            free_packet(packet);
+
+        return true;
+    }
+
+    return false;
+}
+
+bool Mesh::tick_cb(void *arg)
+{
+    foreach (i, routers.count()) {
+        Router *router = routers[i];
+
+        foreach (port, NUM_PORTS) {
+            if (router->link_free[port] > sim_cycle)
+                continue;
+
+            if (port != PORT_LOCAL && !router->neighbors[port])
+                continue;
+
+            schedule_output(router, port);
+        }
+    }
+
+    if (in_flight > 0) {
+        marss_add_event(&tick, 1, NULL);
+    } else {
+        tick_scheduled = false;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Dump Mesh Interconnect Configuration in YAML Format
+ *
+ * @param out YAML Object
+ */
+void Mesh::dump_configuration(YAML::Emitter &out) const
+{
+	out << YAML::Key << get_name() << YAML::Value << YAML::BeginMap;
+
+	YAML_KEY_VAL(out, "type", "interconnect");
+	YAML_KEY_VAL(out, "topology", (torus_ ? "torus" : "mesh"));
+	YAML_KEY_VAL(out, "rows", rows_);
+	YAML_KEY_VAL(out, "cols", cols_);
+	YAML_KEY_VAL(out, "vcs", vcs_);
+	YAML_KEY_VAL(out, "vc_depth", vc_depth_);
+	YAML_KEY_VAL(out, "router_stages", router_stages_);
+	YAML_KEY_VAL(out, "link_latency", link_latency_);
+	YAML_KEY_VAL(out, "link_width", link_width_);
+	YAML_KEY_VAL(out, "per_cont_queue_size", queue_size_);
+
+	out << YAML::EndMap;
+}
+
+struct MeshBuilder : public InterconnectBuilder
+{
+    MeshBuilder(const char *name) :
+        InterconnectBuilder(name)
+    { }
+
+    Interconnect* get_new_interconnect(MemoryHierarchy &mem,
+            const char *name)
+    {
+        return new Mesh(name, &mem);
+    }
+};
+
+MeshBuilder meshBuilder("mesh");
@@ -0,0 +1,406 @@
+/*
+ * MARSSx86 : A Full System Computer-Architecture Simulator
+ *
+ * This code is released under GPL.
+ *
+ */
+
+#ifndef MESH_H
+#define MESH_H
+
+#ifdef MEM_TEST
+#include <test.h>
+#else
+#include <ptlsim.h>
+#endif
+
+#include <cpuController.h>
+#include <memoryHierarchy.h>
+
+#include <statsBuilder.h>
+#include <machine.h>
+
+#define MESH_VCS           2
+#define MESH_VC_DEPTH      8  // in flits
+#define MESH_ROUTER_STAGES 2
+#define MESH_LINK_LATENCY  1
+#define MESH_LINK_WIDTH    16 // bytes per flit
+#define MESH_DATA_BYTES    64
+#define MESH_QUEUE_SIZE    16
+
+namespace Memory {
+
+namespace MeshInterconnect {
+
+    enum {
+        PORT_LOCAL = 0,
+        PORT_NORTH,
+        PORT_EAST,
+        PORT_SOUTH,
+        PORT_WEST,
+        NUM_PORTS
+    };
+
+    static const char* port_names[NUM_PORTS] = {
+        "local", "north", "east", "south", "west",
+    };
+
+    static inline int opposite_port(int port)
+    {
+        switch (port) {
+            case PORT_NORTH: return PORT_SOUTH;
+            case PORT_EAST:  return PORT_WEST;
+            case PORT_SOUTH: return PORT_NORTH;
+            case PORT_WEST:  return PORT_EAST;
+        }
+        return PORT_LOCAL;
+    }
+
+    /**
+     * @brief A message travelling through the mesh
+     *
+     * Packets are buffered as a whole in router input VCs (virtual
+     * cut-through), so each VC must have room for the largest packet.
+     */
+    struct MeshPacket
+    {
+        MemoryRequest *request;
+        Controller    *source;
+        Controller    *dest;
+        void          *m_arg;
+        bool           has_data;
+        bool           shared;
+        bool           annuled;
+        bool           in_use;
+
+        int  dest_node;
+        int  flits;
+        int  hops;
+        int  vc;
+        int  dim;
+        bool dateline;
+        W64  inject_cycle;
+        W64  ready_cycle;
+
+        MeshPacket *next;
+
+        /* Line data of the message, buffer is kept across reuse */
+        LineDataBuffer data;
+
+        void init() {
+            request      = NULL;
+            source       = NULL;
+            dest         = NULL;
+            m_arg        = NULL;
+            has_data     = 0;
+            shared       = 0;
+            annuled      = 0;
+            in_use       = 0;
+            dest_node    = -1;
+            flits        = 0;
+            hops         = 0;
+            vc           = 0;
+            dim          = 0;
+            dateline     = 0;
+            inject_cycle = 0;
+            ready_cycle  = 0;
+            next         = NULL;
+            data.reset();
+        }
+
+        void setup(const Message &msg) {
+            source   = (Controller*)msg.sender;
+            dest     = (Controller*)msg.dest;
+            request  = msg.request;
+            m_arg    = msg.arg;
+            has_data = msg.hasData;
+            shared   = msg.isShared;
+            in_use   = 1;
+            request->incRefCounter();
+        }
+
+        void fill(Message &msg) const {
+            msg.origin   = source;
+            msg.dest     = dest;
+            msg.request  = request;
+            msg.arg      = m_arg;
+            msg.hasData  = has_data;
+            msg.isShared = shared;
+            msg.data     = data.get();
+        }
+
+        ostream& print(ostream& os) const {
+            if (!in_use) {
+                os << "Free packet";
+                return os;
+            }
+
+            os << "request[", *request, "] ";
+            os << "source[", source->get_name(), "] ";
+            os << "dest[", dest->get_name(), "] ";
+            os << "flits[", flits, "] ";
+            os << "hops[", hops, "] ";
+            os << "vc[", vc, "] ";
+            os << "ready[", ready_cycle, "] ";
+            os << "annuled[", annuled, "]";
+            return os;
+        }
+    };
+
+    static inline ostream& operator <<(ostream& os, const MeshPacket
+            &packet) {
+        return packet.print(os);
+    }
+
+    static inline MeshPacket& operator <<(MeshPacket& packet, const
+            Message &msg) {
+        packet.setup(msg);
+        return packet;
+    }
+
+    static inline Message& operator <<(Message& msg, const
+            MeshPacket& packet) {
+        packet.fill(msg);
+        return msg;
+    }
+
+    /**
+     * @brief FIFO of packets, used for router input VCs and injection queues
+     */
+    struct PacketQueue {
+        MeshPacket *head;
+        MeshPacket *tail;
+        int         count;
+
+        PacketQueue() { reset(); }
+
+        void reset() {
+            head  = NULL;
+            tail  = NULL;
+            count = 0;
+        }
+
+        void push(MeshPacket *packet) {
+            packet->next = NULL;
+            if (tail) tail->next = packet;
+            else      head = packet;
+            tail = packet;
+            count++;
+        }
+
+        MeshPacket* pop() {
+            MeshPacket *packet = head;
+            if (!packet) return NULL;
+            head = packet->next;
+            if (!head) tail = NULL;
+            packet->next = NULL;
+            count--;
+            return packet;
+        }
+    };
+
+    struct RouterStats : public Statable
+    {
+        StatArray<W64, NUM_PORTS> link_flits;
+        StatArray<W64, NUM_PORTS> link_packets;
+        StatArray<W64, NUM_PORTS> credit_stalls;
+
+        RouterStats(stringbuf &name, Statable *parent)
+            : Statable(name, parent)
+              , link_flits("link_flits", this, port_names)
+              , link_packets("link_packets", this, port_names)
+              , credit_stalls("credit_stalls", this, port_names)
+        {}
+    };
+
+    struct MeshStats : public Statable
+    {
+        StatObj<W64> injected;
+        StatObj<W64> delivered;
+        StatObj<W64> flits;
+        StatObj<W64> hops;
+        StatObj<W64> latency;
+        StatObj<W64> queue_full;
+        StatObj<W64> eject_retries;
+
+        StatEquation<W64, double, StatObjFormulaDiv> avg_latency;
+        StatEquation<W64, double, StatObjFormulaDiv> avg_hops;
+
+        MeshStats(const char *name, Statable *parent)
+            : Statable(name, parent)
+              , injected("injected", this)
+              , delivered("delivered", this)
+              , flits("flits", this)
+              , hops("hops", this)
+              , latency("latency", this)
+              , queue_full("queue_full", this)
+              , eject_retries("eject_retries", this)
+              , avg_latency("avg_latency", this)
+              , avg_hops("avg_hops", this)
+        {
+            avg_latency.add_elem(&latency);
+            avg_latency.add_elem(&delivered);
+
+            avg_hops.add_elem(&hops);
+            avg_hops.add_elem(&delivered);
+        }
+    };
+
+    /**
+     * @brief A mesh router
+     *
+     * Each router has one input and one output port per direction plus a
+     * local port to its controller. Network input ports have 'vcs' virtual
+     * channels; the local input port is the controller's injection queue.
+     * Output ports keep a credit count, in flits, for each VC of the
+     * downstream input port.
+     */
+    struct Router {
+        int         id;
+        int         x, y;
+        Controller *controller;
+
+        Router     *neighbors[NUM_PORTS];
+        PacketQueue inject;
+        PacketQueue *inputs[NUM_PORTS];
+        int        *credits[NUM_PORTS];
+        W64         link_free[NUM_PORTS];
+        W64         input_used[NUM_PORTS];
+        int         rr[NUM_PORTS];
+
+        RouterStats *stats;
+
+        Router(int id_, int vcs, int vc_depth) {
+            id         = id_;
+            x          = 0;
+            y          = 0;
+            controller = NULL;
+            stats      = NULL;
+
+            foreach (p, NUM_PORTS) {
+                neighbors[p]  = NULL;
+                inputs[p]     = new PacketQueue[vcs];
+                credits[p]    = new int[vcs];
+                link_free[p]  = 0;
+                input_used[p] = -1;
+                rr[p]         = 0;
+
+                foreach (v, vcs) {
+                    credits[p][v] = vc_depth;
+                }
+            }
+        }
+
+        ~Router() {
+            foreach (p, NUM_PORTS) {
+                delete[] inputs[p];
+                delete[] credits[p];
+            }
+            if (stats) delete stats;
+        }
+    };
+
+    /**
+     * @brief Create a 2D mesh (or torus) Network-on-Chip
+     *
+     * Controllers are placed on tiles in the order they are registered,
+     * row by row, unless the 'tiles' option lists the tile of each
+     * controller in registration order (tile = y * cols + x, 'cols' must
+     * be given then). Packets are routed dimension-order (X then Y). Each hop
+     * costs 'router_stages' cycles of router pipeline plus 'link_latency'
+     * cycles of link traversal, and an output link is occupied for one
+     * cycle per flit. A packet moves to the next router only if one of
+     * the downstream VCs has enough credits for the whole packet. In a
+     * torus the VCs are split in two classes and packets move to the
+     * upper class after crossing the wraparound link of a dimension,
+     * which keeps the rings deadlock free.
+     */
+    class Mesh : public Interconnect
+    {
+        private:
+            dynarray<Router*> routers;
+            dynarray<int> tiles_;
+            Hashtable<W64, int, 16> tile_of_;
+            dynarray<MeshPacket*> packets;
+            dynarray<MeshPacket*> free_packets;
+
+            Signal tick;
+
+            bool tick_scheduled;
+            bool network_built;
+            int  in_flight;
+
+            int  rows_;
+            int  cols_;
+            bool torus_;
+            int  vcs_;
+            int  vc_depth_;
+            int  router_stages_;
+            int  link_latency_;
+            int  link_width_;
+            int  data_bytes_;
+            int  queue_size_;
+
+            MeshStats *new_stats;
+
+            void parse_tiles(const char *list);
+            void build_network();
+            int  route(Router *router, MeshPacket *packet) const;
+            bool crosses_wrap(Router *router, int port) const;
+            void vc_range(MeshPacket *packet, int &start, int &end) const;
+            void release_input(Router *router, int port, MeshPacket *packet);
+            bool schedule_output(Router *router, int port);
+            bool eject(Router *router, MeshPacket *packet);
+
+            MeshPacket* alloc_packet();
+            void free_packet(MeshPacket *packet);
+
+        public:
+            Mesh(const char *name, MemoryHierarchy *memoryHierarchy);
+            ~Mesh();
+
+            bool controller_request_cb(void *arg);
+            void register_controller(Controller *controller);
+            int  access_fast_path(Controller *controller,
+                    MemoryRequest *request);
+            void annul_request(MemoryRequest *request);
+            int  get_delay() { return router_stages_ + link_latency_; }
+            void dump_configuration(YAML::Emitter &out) const;
+
+            Router* get_router(Controller *cont);
+
+            bool tick_cb(void *arg);
+
+            void print(ostream& os) const {
+                os << "--Mesh-Interconnect: ", get_name(), endl;
+                os << "in_flight: ", in_flight, endl;
+                foreach (i, packets.count()) {
+                    if (packets[i]->in_use)
+                        os << *packets[i], endl;
+                }
+                os << "--End-Mesh-Interconnect\n";
+            }
+
+            void print_map(ostream& os) {
+                os << "Mesh Interconnect: ", get_name(), endl;
+                os << "\tconnected to: ", endl;
+
+                foreach (i, routers.count()) {
+                    if (!routers[i]->controller)
+                        continue;
+                    os << "\t\ttile[", routers[i]->x, ",", routers[i]->y;
+                    os << "]: ", routers[i]->controller->get_name(), endl;
+                }
+            }
+    };
+
+    static inline ostream& operator <<(ostream& os, const Mesh &mesh)
+    {
+        mesh.print(os);
+        return os;
+    }
+};
+
+};
+
+#endif // MESH_H
@@ -101,6 +101,7 @@ bool P2PInterconnect::controller_request_cb(void *arg)
 	message.request = msg->request;
 	message.hasData = msg->hasData;
 	message.arg = msg->arg;
+	message.data = msg->data;
 
 	bool ret_val;
 	ret_val = receiver->get_interconnect_signal()->emit((void *)&message);
@@ -0,0 +1,566 @@
+/*
+ * MARSSx86 : A Full System Computer-Architecture Simulator
+ *
+ * This code is released under GPL.
+ *
+ */
+
+#ifdef MEM_TEST
+#include <test.h>
+#else
+#include <ptlsim.h>
+#endif
+
+#include <partition.h>
+#include <memoryStats.h>
+#include <machine.h>
+
+using namespace Memory;
+
+const char* Memory::cos_names[MAX_COS] = {
+    "cos0", "cos1", "cos2", "cos3", "cos4", "cos5", "cos6", "cos7",
+    "cos8", "cos9", "cos10", "cos11", "cos12", "cos13", "cos14", "cos15",
+};
+
+dynarray<WayPartition*> WayPartition::partitions_;
+
+/* Invalid partition options of a cache stop the simulator */
+#define partition_error(name, msg) \
+    do { \
+        ptl_logfile << "[ERROR] " << name << ": " << msg << endl; \
+        cerr << "[ERROR] " << name << ": " << msg << endl; \
+        assert_fail(__STRING(0), __FILE__, __LINE__, __PRETTY_FUNCTION__); \
+    } while (0)
+
+/*
+ * Parse a comma separated list of numbers, returns the count or -1 if
+ * the list is malformed.
+ */
+static int parse_list(const char *str, W64 *values, int max)
+{
+    int count = 0;
+    const char *p = str;
+
+    while (*p) {
+        char *end;
+        W64 value = strtoull(p, &end, 0);
+
+        if (end == p || count == max)
+            return -1;
+
+        values[count++] = value;
+        p = end;
+        if (*p == ',') p++;
+        else if (*p) return -1;
+    }
+
+    return count;
+}
+
+WayPartition::WayPartition(const char *name, Statable *parent, int sets,
+        int ways, int cosCount, bool ucp)
+    : sets_(sets)
+    , ways_(ways)
+    , cosCount_(cosCount)
+    , ucp_(ucp)
+    , umonTags_(NULL)
+    , umonHits_(NULL)
+    , stats(parent)
+{
+    name_ << name;
+
+    assert(ways_ <= 64);
+    assert(cosCount_ > 0 && cosCount_ <= MAX_COS);
+
+    foreach (i, MAX_COS) {
+        masks_[i] = bitmask(ways_);
+        occupancy_[i] = 0;
+    }
+    foreach (i, NUM_SIM_CORES) {
+        coreCos_[i] = i % cosCount_;
+    }
+
+    owner_ = new W8[sets_ * ways_];
+    foreach (i, sets_ * ways_) owner_[i] = (W8)-1;
+
+    sampleSets_ = 0;
+    sampleStride_ = 1;
+    interval_ = 0;
+    nextRepartition_ = 0;
+
+    partitions_.push(this);
+}
+
+WayPartition::~WayPartition()
+{
+    partitions_.remove(this);
+
+    delete [] owner_;
+    if (umonTags_) delete [] umonTags_;
+    if (umonHits_) delete [] umonHits_;
+}
+
+WayPartition *WayPartition::create(BaseMachine &machine, const char *name,
+        Statable *parent, int sets, int ways)
+{
+    stringbuf type, list;
+    W64 values[NUM_SIM_CORES > MAX_COS ? NUM_SIM_CORES : MAX_COS];
+    int cosCount, masks = 0;
+    bool ucp;
+
+    if (!machine.get_option(name, "partition", type) ||
+            !strcmp(type.buf, "none"))
+        return NULL;
+
+    if (!strcmp(type.buf, "ucp")) {
+        ucp = true;
+    } else if (!strcmp(type.buf, "static")) {
+        ucp = false;
+    } else {
+        partition_error(name, "unknown partition policy '" << type << "'");
+    }
+
+    if (ways > 64)
+        partition_error(name, "can't partition more than 64 ways");
+
+    if (machine.get_option(name, "cos_masks", list)) {
+        masks = parse_list(list.buf, values, MAX_COS);
+        if (masks <= 0)
+            partition_error(name, "invalid cos_masks '" << list << "'");
+    }
+
+    if (!machine.get_option(name, "cos_count", cosCount)) {
+        cosCount = masks ? masks :
+            (ucp ? min((int)machine.get_num_cores(), MAX_COS) : 1);
+    }
+
+    if (cosCount <= 0 || cosCount > MAX_COS)
+        partition_error(name, "cos_count " << cosCount << " is not in 1.."
+                << MAX_COS);
+
+    /* An empty mask would leave a class of service no victim way */
+    if (ucp && cosCount > ways)
+        partition_error(name, "UCP needs at least one way per class of "
+                << "service, " << cosCount << " classes for " << ways
+                << " ways");
+
+    WayPartition *partition = new WayPartition(name, parent, sets, ways,
+            cosCount, ucp);
+
+    if (ucp) {
+        /* Start from an even split */
+        int start = 0;
+        foreach (i, cosCount) {
+            int count = ways / cosCount + (i < ways % cosCount);
+            partition->masks_[i] = bitmask(count) << start;
+            start += count;
+        }
+
+        if (!machine.get_option(name, "ucp_sample_sets",
+                    partition->sampleSets_))
+            partition->sampleSets_ = 32;
+
+        int interval;
+        if (!machine.get_option(name, "ucp_interval", interval))
+            interval = 5000000;
+
+        if (partition->sampleSets_ <= 0 || interval <= 0)
+            partition_error(name, "ucp_sample_sets and ucp_interval must "
+                    << "be positive");
+
+        partition->sampleSets_ = min(partition->sampleSets_, sets);
+        partition->sampleStride_ = sets / partition->sampleSets_;
+        partition->interval_ = interval;
+        partition->nextRepartition_ = interval;
+
+        partition->umonTags_ =
+            new W64[cosCount * partition->sampleSets_ * ways];
+        partition->umonHits_ = new W64[cosCount * ways];
+        foreach (i, cosCount * partition->sampleSets_ * ways)
+            partition->umonTags_[i] = (W64)-1;
+        foreach (i, cosCount * ways)
+            partition->umonHits_[i] = 0;
+    }
+
+    foreach (i, min(masks, cosCount)) {
+        if (!partition->set_mask(i, values[i]))
+            partition_error(name, "invalid cos_masks '" << list << "'");
+    }
+
+    if (machine.get_option(name, "core_cos", list)) {
+        int count = parse_list(list.buf, values, NUM_SIM_CORES);
+        if (count <= 0)
+            partition_error(name, "invalid core_cos '" << list << "'");
+
+        foreach (i, count) {
+            if (!partition->set_core_cos(i, values[i]))
+                partition_error(name, "invalid core_cos '" << list << "'");
+        }
+    }
+
+    partition->print(ptl_logfile);
+
+    return partition;
+}
+
+bool WayPartition::set_mask(int cos, W64 mask)
+{
+    if (cos < 0 || cos >= cosCount_ || !mask || (mask & ~bitmask(ways_))) {
+        ptl_logfile << "[ERROR] ", name_, ": invalid mask ",
+                    hexstring(mask, 64), " for cos", cos, endl;
+        return false;
+    }
+
+    masks_[cos] = mask;
+    return true;
+}
+
+bool WayPartition::set_core_cos(int coreid, int cos)
+{
+    if (coreid < 0 || coreid >= NUM_SIM_CORES || cos < 0 ||
+            cos >= cosCount_) {
+        ptl_logfile << "[ERROR] ", name_, ": invalid cos", cos,
+                    " for core ", coreid, endl;
+        return false;
+    }
+
+    coreCos_[coreid] = cos;
+    return true;
+}
+
+/*
+ * Apply one 'cos<n>=<mask>' or 'core<n>=<cos>' setting.
+ */
+bool WayPartition::apply(const char *cmd)
+{
+    char *end;
+    W64 value;
+    int index;
+
+    if (!strncmp(cmd, "cos", 3)) {
+        index = strtol(cmd + 3, &end, 10);
+        if (end == cmd + 3 || *end != '=') return false;
+
+        value = strtoull(end + 1, &end, 0);
+        if (*end) return false;
+
+        return set_mask(index, value);
+    }
+
+    if (!strncmp(cmd, "core", 4)) {
+        index = strtol(cmd + 4, &end, 10);
+        if (end == cmd + 4 || *end != '=') return false;
+
+        value = strtoull(end + 1, &end, 0);
+        if (*end) return false;
+
+        return set_core_cos(index, value);
+    }
+
+    return false;
+}
+
+bool WayPartition::command(const char *cmd)
+{
+    dynarray<stringbuf*> items;
+    bool rc = true;
+
+    stringbuf buf;
+    buf << cmd;
+    buf.split(items, ",");
+
+    foreach (i, items.count()) {
+        char *item = items[i]->buf;
+        char *setting = strchr(item, ':');
+        bool found = false;
+
+        if (!setting) {
+            rc = false;
+            continue;
+        }
+
+        *setting++ = '\0';
+        int len = strlen(item);
+
+        foreach (j, partitions_.count()) {
+            WayPartition *partition = partitions_[j];
+            const char *name = partition->name_.buf;
+
+            if (strcmp(name, item) &&
+                    (strncmp(name, item, len) || name[len] != '_'))
+                continue;
+
+            found = true;
+            if (!partition->apply(setting)) {
+                rc = false;
+                break;
+            }
+            partition->print(ptl_logfile);
+        }
+
+        if (!found) rc = false;
+    }
+
+    foreach (i, items.count()) delete items[i];
+
+    if (!rc) {
+        ptl_logfile << "[ERROR] invalid cache partition command '", cmd,
+                    "'", endl;
+    }
+
+    return rc;
+}
+
+/*
+ * Update the LRU stack of a sampled set in the monitor of 'cos'
+ */
+void WayPartition::monitor(int cos, int set, W64 tag)
+{
+    if (set % sampleStride_) return;
+
+    int sample = set / sampleStride_;
+    if (sample >= sampleSets_) return;
+
+    int pos;
+    for (pos = 0; pos < ways_ - 1; pos++) {
+        if (umon_tag(cos, sample, pos) == tag) break;
+    }
+
+    if (umon_tag(cos, sample, pos) == tag)
+        umon_hits(cos, pos)++;
+
+    for (; pos > 0; pos--) {
+        umon_tag(cos, sample, pos) = umon_tag(cos, sample, pos - 1);
+    }
+    umon_tag(cos, sample, 0) = tag;
+}
+
+/**
+ * @brief Lookahead way allocation of utility-based cache partitioning
+ *
+ * Every class gets one way, then the remaining ways go one block at a
+ * time to the class with the highest hits per way for that block.
+ */
+void WayPartition::repartition(bool kernel)
+{
+    int alloc[MAX_COS];
+    int balance = ways_ - cosCount_;
+
+    foreach (i, cosCount_) alloc[i] = 1;
+
+    while (balance > 0) {
+        double bestUtility = -1;
+        int winner = 0;
+        int winnerWays = 1;
+
+        foreach (i, cosCount_) {
+            W64 hits = 0;
+            for (int k = 1; k <= balance; k++) {
+                hits += umon_hits(i, alloc[i] + k - 1);
+                double utility = double(hits) / k;
+                if (utility > bestUtility) {
+                    bestUtility = utility;
+                    winner = i;
+                    winnerWays = k;
+                }
+            }
+        }
+
+        alloc[winner] += winnerWays;
+        balance -= winnerWays;
+    }
+
+    int start = 0;
+    foreach (i, cosCount_) {
+        masks_[i] = bitmask(alloc[i]) << start;
+        start += alloc[i];
+    }
+
+    /* Age the monitors so the next interval counts more */
+    foreach (i, cosCount_ * ways_) umonHits_[i] >>= 1;
+
+    N_STAT_UPDATE(stats.repartitions, ++, kernel);
+}
+
+void WayPartition::access(int coreid, int set, W64 tag, bool hit,
+        bool kernel)
+{
+    int cos = cos_of(coreid);
+
+    if (hit) {
+        N_STAT_UPDATE(stats.hits, [cos]++, kernel);
+    } else {
+        N_STAT_UPDATE(stats.misses, [cos]++, kernel);
+    }
+
+    if (!ucp_) return;
+
+    monitor(cos, set, tag);
+
+    if (sim_cycle >= nextRepartition_) {
+        repartition(kernel);
+        nextRepartition_ = sim_cycle + interval_;
+    }
+}
+
+void WayPartition::fill(int coreid, int set, int way, bool kernel)
+{
+    int cos = cos_of(coreid);
+
+    owner_[set * ways_ + way] = cos;
+    occupancy_[cos]++;
+
+    N_STAT_UPDATE(stats.fills, [cos]++, kernel);
+    N_STAT_UPDATE(stats.occupancy, [cos] = occupancy_[cos], kernel);
+}
+
+void WayPartition::evict(int set, int way, bool kernel)
+{
+    W8 &owner = owner_[set * ways_ + way];
+
+    if (owner == (W8)-1) return;
+
+    occupancy_[owner]--;
+    N_STAT_UPDATE(stats.occupancy, [owner] = occupancy_[owner], kernel);
+    owner = (W8)-1;
+}
+
+void WayPartition::print(ostream& os) const
+{
+    os << name_, ": ", policy_name(), " partition";
+    foreach (i, cosCount_) {
+        os << " cos", i, "=", hexstring(masks_[i], ways_);
+    }
+    os << " cores";
+    foreach (i, NUM_SIM_CORES) {
+        os << " ", (int)coreCos_[i];
+    }
+    os << endl;
+}
+
+void WayPartition::save_all(UarchStateWriter& writer)
+{
+    stringbuf section;
+
+    foreach (i, partitions_.count()) {
+        section.reset();
+        section << partitions_[i]->name_, ".partition";
+        writer.begin_section(section.buf);
+        partitions_[i]->save_state(writer);
+        writer.end_section();
+    }
+}
+
+void WayPartition::restore_all(UarchStateReader& reader, int& restored,
+        int& skipped)
+{
+    stringbuf section;
+
+    foreach (i, partitions_.count()) {
+        section.reset();
+        section << partitions_[i]->name_, ".partition";
+        if (reader.find_section(section.buf) &&
+                partitions_[i]->restore_state(reader)) {
+            restored++;
+        } else {
+            ptl_logfile << "uarch checkpoint: skipping ", section, endl;
+            skipped++;
+        }
+    }
+}
+
+/**
+ * @brief Write masks, core classes, line owners and UCP monitors
+ */
+void WayPartition::save_state(UarchStateWriter& writer) const
+{
+    writer.put((W32)sets_);
+    writer.put((W32)ways_);
+    writer.put((W32)cosCount_);
+    writer.put((W8)ucp_);
+
+    writer.put_array(masks_, cosCount_);
+    writer.put_array(coreCos_, NUM_SIM_CORES);
+    writer.put_array(owner_, sets_ * ways_);
+
+    if (ucp_) {
+        writer.put((W32)sampleSets_);
+        writer.put(nextRepartition_);
+        writer.put_array(umonTags_, cosCount_ * sampleSets_ * ways_);
+        writer.put_array(umonHits_, cosCount_ * ways_);
+    }
+}
+
+/**
+ * @brief Restore state saved by save_state()
+ *
+ * @return false if saved partition doesn't match this one or the section
+ * is truncated, in that case the partition is left untouched
+ */
+bool WayPartition::restore_state(UarchStateReader& reader)
+{
+    W32 sets, ways, cosCount, sampleSets = 0;
+    W8 ucp;
+
+    if (!reader.get(sets) || !reader.get(ways) || !reader.get(cosCount) ||
+            !reader.get(ucp))
+        return false;
+
+    if (sets != (W32)sets_ || ways != (W32)ways_ ||
+            cosCount != (W32)cosCount_ || ucp != (W8)ucp_)
+        return false;
+
+    int lines = sets_ * ways_;
+    int tags = cosCount_ * sampleSets_ * ways_;
+    W64 masks[MAX_COS];
+    W8 coreCos[NUM_SIM_CORES];
+    W8 *owner = new W8[lines];
+    W64 *umonTags = new W64[tags ? tags : 1];
+    W64 *umonHits = new W64[cosCount_ * ways_];
+    W64 nextRepartition = nextRepartition_;
+
+    bool rc = reader.get_array(masks, cosCount_) &&
+        reader.get_array(coreCos, NUM_SIM_CORES) &&
+        reader.get_array(owner, lines);
+
+    if (rc && ucp_) {
+        rc = reader.get(sampleSets) && sampleSets == (W32)sampleSets_ &&
+            reader.get(nextRepartition) &&
+            reader.get_array(umonTags, tags) &&
+            reader.get_array(umonHits, cosCount_ * ways_);
+    }
+
+    foreach (i, cosCount_) {
+        rc = rc && masks[i] && !(masks[i] & ~bitmask(ways_));
+    }
+    foreach (i, NUM_SIM_CORES) {
+        rc = rc && coreCos[i] < cosCount_;
+    }
+    foreach (i, lines) {
+        rc = rc && (owner[i] == (W8)-1 || owner[i] < cosCount_);
+    }
+
+    if (rc) {
+        memcpy(masks_, masks, cosCount_ * sizeof(W64));
+        memcpy(coreCos_, coreCos, sizeof(coreCos_));
+        memcpy(owner_, owner, lines);
+
+        foreach (i, MAX_COS) occupancy_[i] = 0;
+        foreach (i, lines) {
+            if (owner_[i] != (W8)-1)
+                occupancy_[owner_[i]]++;
+        }
+
+        if (ucp_) {
+            memcpy(umonTags_, umonTags, tags * sizeof(W64));
+            memcpy(umonHits_, umonHits, cosCount_ * ways_ * sizeof(W64));
+            nextRepartition_ = nextRepartition;
+        }
+    }
+
+    delete [] owner;
+    delete [] umonTags;
+    delete [] umonHits;
+
+    return rc;
+}
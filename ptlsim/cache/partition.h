@@ -0,0 +1,180 @@
+/*
+ * MARSSx86 : A Full System Computer-Architecture Simulator
+ *
+ * This code is released under GPL.
+ *
+ */
+
+#ifndef PARTITION_H
+#define PARTITION_H
+
+#include <globals.h>
+#include <superstl.h>
+#include <statsBuilder.h>
+#include <uarch-checkpoint.h>
+
+struct BaseMachine;
+
+namespace Memory {
+
+    const int MAX_COS = 16;
+
+    extern const char* cos_names[MAX_COS];
+
+    /*
+     * Per class of service statistics of a way partitioned cache
+     *
+     *  occupancy    : lines currently allocated by each class
+     *  hits, misses : tag lookups of each class
+     *  fills        : lines allocated by each class
+     *  repartitions : way masks recomputed by the UCP policy
+     */
+    struct PartitionStats : public Statable
+    {
+        StatArray<W64, MAX_COS> occupancy;
+        StatArray<W64, MAX_COS> hits;
+        StatArray<W64, MAX_COS> misses;
+        StatArray<W64, MAX_COS> fills;
+        StatObj<W64> repartitions;
+
+        PartitionStats(Statable *parent)
+            : Statable("partition", parent)
+              , occupancy("occupancy", this, cos_names)
+              , hits("hits", this, cos_names)
+              , misses("misses", this, cos_names)
+              , fills("fills", this, cos_names)
+              , repartitions("repartitions", this)
+        {}
+    };
+
+    /**
+     * @brief Class of service way masks of a shared cache
+     *
+     * Each core belongs to a class of service (CoS) and each CoS has a mask
+     * of the ways it may allocate into, like Intel CAT. Lookups hit in any
+     * way, only the victim search is limited to the mask. Options of the
+     * cache:
+     *
+     *  partition     : 'static' or 'ucp', partitioning is off without it
+     *  cos_count     : number of classes, defaults to the number of
+     *                  'cos_masks' entries ('ucp': number of cores)
+     *  cos_masks     : comma separated way masks, e.g. "0xff0,0x00f",
+     *                  default is all ways ('ucp': an even split)
+     *  core_cos      : comma separated CoS of each core, default is
+     *                  core 'n' in CoS 'n % cos_count'
+     *  ucp_interval  : cycles between UCP repartitions (default 5M)
+     *  ucp_sample_sets : sets shadowed by each UCP monitor (default 32)
+     *
+     * With 'ucp' each CoS has a utility monitor: an LRU tag directory of
+     * sampled sets that counts hits at each LRU stack position, i.e. the
+     * hits the CoS would get with that many ways. Every interval the
+     * lookahead algorithm of Qureshi and Patt splits the ways by marginal
+     * utility and gives each CoS a contiguous mask.
+     *
+     * Masks and core classes can be changed at run time, also from the
+     * guest with ptlcall_single, with
+     * "-cache-partition <cache>:cos<n>=<mask>,<cache>:core<n>=<cos>".
+     * '<cache>' is a cache name like "L3_0" or its type like "L3" for
+     * all instances. With 'ucp' masks set this way last until the next
+     * repartition.
+     */
+    class WayPartition
+    {
+        private:
+            stringbuf name_;
+            int sets_;
+            int ways_;
+            int cosCount_;
+            bool ucp_;
+
+            W64 masks_[MAX_COS];
+            W8 coreCos_[NUM_SIM_CORES];
+
+            // CoS that allocated each line, -1 if unknown
+            W8 *owner_;
+            int occupancy_[MAX_COS];
+
+            // UCP utility monitors
+            int sampleStride_;
+            int sampleSets_;
+            W64 interval_;
+            W64 nextRepartition_;
+            W64 *umonTags_;
+            W64 *umonHits_;
+
+            PartitionStats stats;
+
+            static dynarray<WayPartition*> partitions_;
+
+            W64& umon_tag(int cos, int sample, int pos) {
+                return umonTags_[(cos * sampleSets_ + sample) * ways_ +
+                    pos];
+            }
+
+            W64& umon_hits(int cos, int pos) {
+                return umonHits_[cos * ways_ + pos];
+            }
+
+            void monitor(int cos, int set, W64 tag);
+            void repartition(bool kernel);
+            bool set_mask(int cos, W64 mask);
+            bool set_core_cos(int coreid, int cos);
+            bool apply(const char *cmd);
+
+        public:
+            WayPartition(const char *name, Statable *parent, int sets,
+                    int ways, int cosCount, bool ucp);
+            ~WayPartition();
+
+            /*
+             * Read partition options of cache 'name', returns NULL if the
+             * cache is not partitioned.
+             */
+            static WayPartition* create(BaseMachine &machine,
+                    const char *name, Statable *parent, int sets, int ways);
+
+            /*
+             * Apply a '-cache-partition' command to all matching caches,
+             * returns false if any part of it is invalid.
+             */
+            static bool command(const char *cmd);
+
+            /*
+             * Save or restore all partitions in uarch checkpoints, each in
+             * a '<cache>.partition' section. Restore counts the sections
+             * it restored and the ones it skipped.
+             */
+            static void save_all(UarchStateWriter& writer);
+            static void restore_all(UarchStateReader& reader, int& restored,
+                    int& skipped);
+
+            void save_state(UarchStateWriter& writer) const;
+            bool restore_state(UarchStateReader& reader);
+
+            int cos_of(int coreid) const {
+                return coreCos_[coreid];
+            }
+
+            W64 alloc_mask(int coreid) const {
+                return masks_[cos_of(coreid)];
+            }
+
+            int occupancy(int cos) const {
+                return occupancy_[cos];
+            }
+
+            void access(int coreid, int set, W64 tag, bool hit,
+                    bool kernel);
+            void fill(int coreid, int set, int way, bool kernel);
+            void evict(int set, int way, bool kernel);
+
+            const char* policy_name() const {
+                return ucp_ ? "ucp" : "static";
+            }
+
+            void print(ostream& os) const;
+    };
+
+};
+
+#endif // PARTITION_H
@@ -0,0 +1,386 @@
+/*
+ * MARSSx86 : A Full System Computer-Architecture Simulator
+ *
+ * This code is released under GPL.
+ *
+ * Copyright 2011 Avadh Patel <apatel@cs.binghamton.edu>
+ *
+ */
+
+#ifdef MEM_TEST
+#include <test.h>
+#else
+#include <ptlsim.h>
+#endif
+
+#include <memoryHierarchy.h>
+#include <prefetcher.h>
+#include <cacheLines.h>
+#include <machine.h>
+
+using namespace Memory;
+
+static const W64 NO_LINE = (W64)-1;
+
+Prefetcher::Prefetcher(const char *type, Statable *parent, int lineBits,
+        int degree, int distance, int tableSize)
+    : pendingCount_(0)
+    , lineBits_(lineBits)
+    , degree_(degree)
+    , distance_(distance)
+    , tableSize_(tableSize)
+    , stats(parent)
+{
+    type_ << type;
+
+    foreach (i, PENDING_SLOTS) {
+        pending_[i].line = NO_LINE;
+        pending_[i].count = 0;
+    }
+}
+
+static inline int pending_slot(W64 line, int slots)
+{
+    return (int)((line * 0x9e3779b97f4a7c15ULL) >> 55) & (slots - 1);
+}
+
+int Prefetcher::find_pending(W64 line) const
+{
+    int slot = pending_slot(line, PENDING_SLOTS);
+
+    while (pending_[slot].line != NO_LINE) {
+        if (pending_[slot].line == line)
+            return slot;
+        slot = (slot + 1) & (PENDING_SLOTS - 1);
+    }
+
+    return -1;
+}
+
+void Prefetcher::add_pending(W64 address)
+{
+    W64 line = line_of(address);
+    int slot = pending_slot(line, PENDING_SLOTS);
+
+    while (pending_[slot].line != NO_LINE && pending_[slot].line != line)
+        slot = (slot + 1) & (PENDING_SLOTS - 1);
+
+    if (pending_[slot].line == NO_LINE) {
+        /* Controller queues are smaller than half of the table */
+        assert(pendingCount_ < PENDING_SLOTS / 2);
+        pending_[slot].line = line;
+        pendingCount_++;
+    }
+
+    pending_[slot].count++;
+}
+
+/*
+ * Remove one prefetch of a line, emptied slots are refilled by shifting
+ * back the entries that probed past them.
+ */
+void Prefetcher::remove_pending(W64 address)
+{
+    int slot = find_pending(line_of(address));
+
+    if (slot < 0 || --pending_[slot].count > 0)
+        return;
+
+    pendingCount_--;
+
+    int hole = slot;
+    int next = (hole + 1) & (PENDING_SLOTS - 1);
+
+    while (pending_[next].line != NO_LINE) {
+        int home = pending_slot(pending_[next].line, PENDING_SLOTS);
+
+        /* Move the entry if its home is not in (hole, next] */
+        if (((next - home) & (PENDING_SLOTS - 1)) >=
+                ((next - hole) & (PENDING_SLOTS - 1))) {
+            pending_[hole] = pending_[next];
+            hole = next;
+        }
+        next = (next + 1) & (PENDING_SLOTS - 1);
+    }
+
+    pending_[hole].line = NO_LINE;
+    pending_[hole].count = 0;
+}
+
+void Prefetcher::demand_access(W64 pc, W64 address, bool kernel,
+        CacheLine *line, dynarray<W64> &prefetches)
+{
+    if (line && line->prefetched) {
+        line->prefetched = false;
+        N_STAT_UPDATE(stats.useful, ++, kernel);
+        N_STAT_UPDATE(stats.misses, ++, kernel);
+    } else if (!line) {
+        N_STAT_UPDATE(stats.misses, ++, kernel);
+    }
+
+    prefetches.clear();
+    train(pc, address, line != NULL, prefetches);
+}
+
+void Prefetcher::line_dropped(CacheLine *line, bool kernel)
+{
+    if (!line->prefetched)
+        return;
+
+    line->prefetched = false;
+    N_STAT_UPDATE(stats.useless, ++, kernel);
+}
+
+/*
+ * Next-line prefetcher: on a miss fetch the following 'degree' lines.
+ */
+class NextLinePrefetcher : public Prefetcher
+{
+    public:
+        NextLinePrefetcher(Statable *parent, int lineBits, int degree,
+                int distance, int tableSize)
+            : Prefetcher("next_line", parent, lineBits, degree, distance,
+                    tableSize)
+        {}
+
+        void train(W64 pc, W64 address, bool hit, dynarray<W64> &prefetches)
+        {
+            if (hit) return;
+
+            W64 line = line_of(address);
+            for (int i = 1; i <= degree_; i++)
+                add_line(line + i, prefetches);
+        }
+};
+
+/*
+ * PC-indexed stride prefetcher: each load/store PC has a table entry with
+ * last address and stride. Once the same stride is seen twice 'degree'
+ * lines starting 'distance' strides ahead are prefetched.
+ */
+class StridePrefetcher : public Prefetcher
+{
+    private:
+        struct Entry {
+            W64 pc;
+            W64 lastAddress;
+            W64s stride;
+            int confidence;
+        };
+
+        Entry *table_;
+
+    public:
+        StridePrefetcher(Statable *parent, int lineBits, int degree,
+                int distance, int tableSize)
+            : Prefetcher("stride", parent, lineBits, degree, distance,
+                    tableSize)
+        {
+            table_ = new Entry[tableSize_];
+            memset(table_, 0, sizeof(Entry) * tableSize_);
+        }
+
+        ~StridePrefetcher()
+        {
+            delete [] table_;
+        }
+
+        void train(W64 pc, W64 address, bool hit, dynarray<W64> &prefetches)
+        {
+            Entry &entry = table_[pc % tableSize_];
+
+            if (entry.pc != pc) {
+                entry.pc = pc;
+                entry.lastAddress = address;
+                entry.stride = 0;
+                entry.confidence = 0;
+                return;
+            }
+
+            W64s stride = address - entry.lastAddress;
+            entry.lastAddress = address;
+
+            if (stride == 0) return;
+
+            if (stride == entry.stride) {
+                entry.confidence = min(entry.confidence + 1, 3);
+            } else if (entry.confidence > 0) {
+                entry.confidence -= 1;
+            } else {
+                entry.stride = stride;
+            }
+
+            if (entry.confidence < 2) return;
+
+            W64 lastLine = line_of(address);
+            for (int i = 0; i < degree_; i++) {
+                W64 line = line_of(address + entry.stride * (distance_ + i));
+                if (line == lastLine) continue;
+                add_line(line, prefetches);
+                lastLine = line;
+            }
+        }
+};
+
+/*
+ * Stream prefetcher: misses allocate streams, following accesses within
+ * 'distance' lines of a stream train its direction. Confirmed streams
+ * fetch 'degree' lines 'distance' lines ahead of the last access.
+ */
+class StreamPrefetcher : public Prefetcher
+{
+    private:
+        struct Stream {
+            W64 lastLine;
+            int direction;
+            int confidence;
+            W64 lastUse;
+            bool valid;
+        };
+
+        Stream *streams_;
+        W64 useCounter_;
+
+        Stream *find_stream(W64 line)
+        {
+            foreach (i, tableSize_) {
+                Stream &stream = streams_[i];
+                if (!stream.valid) continue;
+
+                W64s delta = line - stream.lastLine;
+                if (delta >= -distance_ && delta <= distance_)
+                    return &stream;
+            }
+            return NULL;
+        }
+
+        Stream *alloc_stream()
+        {
+            Stream *victim = &streams_[0];
+            foreach (i, tableSize_) {
+                Stream &stream = streams_[i];
+                if (!stream.valid) return &stream;
+                if (stream.lastUse < victim->lastUse) victim = &stream;
+            }
+            return victim;
+        }
+
+    public:
+        StreamPrefetcher(Statable *parent, int lineBits, int degree,
+                int distance, int tableSize)
+            : Prefetcher("stream", parent, lineBits, degree, distance,
+                    tableSize)
+            , useCounter_(0)
+        {
+            streams_ = new Stream[tableSize_];
+            memset(streams_, 0, sizeof(Stream) * tableSize_);
+        }
+
+        ~StreamPrefetcher()
+        {
+            delete [] streams_;
+        }
+
+        void train(W64 pc, W64 address, bool hit, dynarray<W64> &prefetches)
+        {
+            W64 line = line_of(address);
+            Stream *stream = find_stream(line);
+
+            if (!stream) {
+                if (hit) return;
+
+                stream = alloc_stream();
+                stream->valid = true;
+                stream->lastLine = line;
+                stream->direction = 0;
+                stream->confidence = 0;
+                stream->lastUse = useCounter_++;
+                return;
+            }
+
+            stream->lastUse = useCounter_++;
+            if (line == stream->lastLine) return;
+
+            int direction = (line > stream->lastLine) ? 1 : -1;
+            if (direction == stream->direction) {
+                stream->confidence = min(stream->confidence + 1, 3);
+            } else {
+                stream->direction = direction;
+                stream->confidence = 0;
+            }
+            stream->lastLine = line;
+
+            if (stream->confidence < 1) return;
+
+            for (int i = 0; i < degree_; i++)
+                add_line(line + direction * (distance_ + i), prefetches);
+        }
+};
+
+/**
+ * @brief Create a prefetcher of given type
+ *
+ * @return NULL if type is unknown
+ */
+Prefetcher *Prefetcher::create(const char *type, Statable *parent,
+        int lineBits, int degree, int distance, int tableSize)
+{
+    if (!strcmp(type, "next_line"))
+        return new NextLinePrefetcher(parent, lineBits, degree, distance,
+                tableSize);
+    if (!strcmp(type, "stride"))
+        return new StridePrefetcher(parent, lineBits, degree, distance,
+                tableSize);
+    if (!strcmp(type, "stream"))
+        return new StreamPrefetcher(parent, lineBits, degree, distance,
+                tableSize);
+
+    return NULL;
+}
+
+/**
+ * @brief Create prefetcher of a cache from machine configuration
+ *
+ * @param machine Machine that owns the cache
+ * @param name Name of the cache, used to look up its options
+ * @param parent Stats object of the cache
+ * @param lineBits Number of bits in cache line offset
+ *
+ * @return NULL if prefetching is not enabled for this cache
+ */
+Prefetcher *Prefetcher::create(BaseMachine &machine, const char *name,
+        Statable *parent, int lineBits)
+{
+    stringbuf type;
+    int degree, distance, tableSize;
+
+    if (!machine.get_option(name, "prefetcher", type) ||
+            !strcmp(type.buf, "none"))
+        return NULL;
+
+    if (!machine.get_option(name, "prefetch_degree", degree))
+        degree = 2;
+    if (!machine.get_option(name, "prefetch_distance", distance))
+        distance = 4;
+    if (!machine.get_option(name, "prefetch_table", tableSize))
+        tableSize = 64;
+
+    if (degree <= 0 || distance <= 0 || tableSize <= 0) {
+        ptl_logfile << "[ERROR] " << name << ": prefetch degree, distance "
+                    << "and table size must be positive" << endl;
+        cerr << "[ERROR] " << name << ": prefetch degree, distance "
+             << "and table size must be positive" << endl;
+        assert_fail(__STRING(0), __FILE__, __LINE__, __PRETTY_FUNCTION__);
+    }
+
+    Prefetcher *prefetcher = create(type.buf, parent, lineBits, degree,
+            distance, tableSize);
+    if (prefetcher)
+        return prefetcher;
+
+    ptl_logfile << "[ERROR] " << name << ": unknown prefetcher '" << type
+                << "'" << endl;
+    cerr << "[ERROR] " << name << ": unknown prefetcher '" << type << "'"
+         << endl;
+    assert_fail(__STRING(0), __FILE__, __LINE__, __PRETTY_FUNCTION__);
+}
@@ -0,0 +1,167 @@
+/*
+ * MARSSx86 : A Full System Computer-Architecture Simulator
+ *
+ * This code is released under GPL.
+ *
+ * Copyright 2011 Avadh Patel <apatel@cs.binghamton.edu>
+ *
+ */
+
+#ifndef PREFETCHER_H
+#define PREFETCHER_H
+
+#include <globals.h>
+#include <superstl.h>
+#include <statsBuilder.h>
+
+struct BaseMachine;
+
+namespace Memory {
+
+    struct CacheLine;
+
+    /*
+     * Prefetcher statistics
+     *
+     *  issued    : prefetch requests sent to lower level
+     *  useful    : prefetched lines referenced by a demand access
+     *  late      : demand accesses that found their prefetch in flight
+     *  useless   : prefetched lines evicted or invalidated before any demand
+     *              access
+     *  misses    : demand misses plus useful prefetches, i.e. the misses
+     *              this cache would have without prefetching
+     *  accuracy  : useful / issued
+     *  coverage  : useful / misses
+     */
+    struct PrefetchStats : public Statable
+    {
+        StatObj<W64> issued;
+        StatObj<W64> useful;
+        StatObj<W64> late;
+        StatObj<W64> useless;
+        StatObj<W64> misses;
+        StatEquation<W64, double, StatObjFormulaDiv> accuracy;
+        StatEquation<W64, double, StatObjFormulaDiv> coverage;
+
+        PrefetchStats(Statable *parent)
+            : Statable("prefetch", parent)
+              , issued("issued", this)
+              , useful("useful", this)
+              , late("late", this)
+              , useless("useless", this)
+              , misses("misses", this)
+              , accuracy("accuracy", this)
+              , coverage("coverage", this)
+        {
+            accuracy.add_elem(&useful);
+            accuracy.add_elem(&issued);
+
+            coverage.add_elem(&useful);
+            coverage.add_elem(&misses);
+        }
+    };
+
+    /*
+     * Hardware prefetcher plug-in
+     *
+     * A cache controller shows every demand access to its prefetcher with
+     * the PC of the instruction and the physical address. The prefetcher
+     * returns the addresses of lines to fetch, the controller drops the
+     * ones that are already cached or pending and sends the others to the
+     * lower level. Accounting of useful, late and useless prefetches is
+     * shared by all cache controllers through this class. Prefetchers are
+     * enabled per cache with these options:
+     *
+     *   prefetcher        : none, next_line, stride or stream
+     *   prefetch_degree   : lines prefetched per trigger
+     *   prefetch_distance : how far ahead of the access stream to fetch
+     *   prefetch_table    : entries of the stride or stream table
+     */
+    class Prefetcher
+    {
+        private:
+            /*
+             * Lines with a prefetch in flight, open addressing on the line
+             * address. Entries hold the number of prefetches of the line.
+             */
+            struct Pending {
+                W64 line;
+                int count;
+            };
+
+            static const int PENDING_SLOTS = 1024;
+            Pending pending_[PENDING_SLOTS];
+            int pendingCount_;
+
+            int find_pending(W64 line) const;
+
+        protected:
+            stringbuf type_;
+            int lineBits_;
+            int degree_;
+            int distance_;
+            int tableSize_;
+
+            W64 line_of(W64 address) const {
+                return address >> lineBits_;
+            }
+
+            void add_line(W64 line, dynarray<W64> &prefetches) {
+                prefetches.push(line << lineBits_);
+            }
+
+        public:
+            PrefetchStats stats;
+
+            Prefetcher(const char *type, Statable *parent, int lineBits,
+                    int degree, int distance, int tableSize);
+            virtual ~Prefetcher() {}
+
+            /**
+             * @brief Observe a demand access
+             *
+             * @param pc Address of instruction that made the access
+             * @param address Physical address of the access
+             * @param hit True if access hit in the cache
+             * @param prefetches Filled with addresses to prefetch
+             */
+            virtual void train(W64 pc, W64 address, bool hit,
+                    dynarray<W64> &prefetches)=0;
+
+            /**
+             * @brief Account a demand access and train the prefetcher
+             *
+             * @param pc Address of instruction that made the access
+             * @param address Physical address of the access
+             * @param kernel True for kernel mode accesses
+             * @param line Valid line found by the access, NULL on a miss.
+             * A prefetched line counts as useful on its first use.
+             * @param prefetches Filled with addresses to prefetch
+             */
+            void demand_access(W64 pc, W64 address, bool kernel,
+                    CacheLine *line, dynarray<W64> &prefetches);
+
+            /* Line is evicted or invalidated, useless if never used */
+            void line_dropped(CacheLine *line, bool kernel);
+
+            /* Prefetches in flight, kept up to date by the controller */
+            void add_pending(W64 address);
+            void remove_pending(W64 address);
+            bool is_pending(W64 address) const {
+                return find_pending(line_of(address)) >= 0;
+            }
+            int get_pending_count() const { return pendingCount_; }
+
+            const char *get_type() const { return type_.buf; }
+            int get_degree() const { return degree_; }
+            int get_distance() const { return distance_; }
+
+            static Prefetcher *create(const char *type, Statable *parent,
+                    int lineBits, int degree, int distance, int tableSize);
+            static Prefetcher *create(BaseMachine &machine, const char *name,
+                    Statable *parent, int lineBits);
+    };
+
+};
+
+#endif // PREFETCHER_H
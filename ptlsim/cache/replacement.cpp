@@ -0,0 +1,20 @@
+/*
+ * MARSSx86 : A Full System Computer-Architecture Simulator
+ *
+ * This code is released under GPL.
+ *
+ */
+
+#ifdef MEM_TEST
+#include <test.h>
+#else
+#include <ptlsim.h>
+#endif
+
+#include <replacement.h>
+
+using namespace Memory;
+
+const char* const Memory::repl_policy_names[NUM_REPL_POLICIES] = {
+    "nru", "lru", "plru", "srrip", "drrip", "ship",
+};
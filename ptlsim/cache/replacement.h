@@ -0,0 +1,535 @@
+/*
+ * MARSSx86 : A Full System Computer-Architecture Simulator
+ *
+ * This code is released under GPL.
+ *
+ */
+
+#ifndef REPLACEMENT_H
+#define REPLACEMENT_H
+
+#include <globals.h>
+#include <superstl.h>
+#include <statsBuilder.h>
+#include <uarch-checkpoint.h>
+
+namespace Memory {
+
+    /*
+     * Cache replacement policies
+     *
+     * A policy is selected per cache type with the 'REPLACEMENT' parameter
+     * and compiled into CacheLines as a template argument, so there is no
+     * virtual call per access. Each policy keeps its own per set state and
+     * implements:
+     *
+     *  hit(set, way)          : line was referenced by a demand access
+     *  touch(set, way)        : line was inserted again while present,
+     *                           updates recency without training
+     *                           predictors
+     *  victim(set, invalid, mask)
+     *                         : way to replace among the ways set in
+     *                           'mask', which must not be empty,
+     *                           'invalid' is the first invalid way in the
+     *                           mask or -1
+     *  fill(set, way, pc)     : new line was inserted, returns true if it
+     *                           was inserted with lowest priority
+     *  evict(set, way)        : valid line is being replaced
+     *  invalidate(set, way)   : line was invalidated
+     *  save_state(writer)     : write state into a uarch checkpoint
+     *  restore_state(reader)  : read it back, the policy is overwritten
+     *                           even on failure
+     */
+    enum {
+        REPL_NRU = 0,
+        REPL_LRU,
+        REPL_PLRU,
+        REPL_SRRIP,
+        REPL_DRRIP,
+        REPL_SHIP,
+        NUM_REPL_POLICIES
+    };
+
+    extern const char* const repl_policy_names[NUM_REPL_POLICIES];
+
+    /*
+     * Replacement statistics
+     *
+     *  accesses       : tag lookups
+     *  hits           : lookups that found the line
+     *  fills          : lines inserted
+     *  evictions      : valid lines replaced
+     *  dead_evictions : lines replaced without any hit since their fill
+     *  distant_fills  : lines inserted with lowest priority (RRIP family)
+     */
+    struct ReplacementStats : public Statable
+    {
+        StatObj<W64> accesses;
+        StatObj<W64> hits;
+        StatObj<W64> fills;
+        StatObj<W64> evictions;
+        StatObj<W64> dead_evictions;
+        StatObj<W64> distant_fills;
+        StatEquation<W64, double, StatObjFormulaDiv> hit_rate;
+        StatEquation<W64, double, StatObjFormulaDiv> dead_ratio;
+
+        ReplacementStats(Statable *parent)
+            : Statable("replacement", parent)
+              , accesses("accesses", this)
+              , hits("hits", this)
+              , fills("fills", this)
+              , evictions("evictions", this)
+              , dead_evictions("dead_evictions", this)
+              , distant_fills("distant_fills", this)
+              , hit_rate("hit_rate", this)
+              , dead_ratio("dead_ratio", this)
+        {
+            hit_rate.add_elem(&hits);
+            hit_rate.add_elem(&accesses);
+
+            dead_ratio.add_elem(&dead_evictions);
+            dead_ratio.add_elem(&evictions);
+        }
+    };
+
+    /**
+     * @brief Not-recently-used, the policy of FullyAssociativeTags
+     *
+     * One MRU bit per way, the victim is the first way without its bit
+     * set and all bits are cleared when they are all set.
+     */
+    template <int SETS, int WAYS>
+    struct NRUReplacement
+    {
+        bitvec<WAYS> evictmap[SETS];
+
+        void reset() {
+            foreach (i, SETS) evictmap[i] = 0;
+        }
+
+        void hit(int set, int way) {
+            evictmap[set][way] = 1;
+        }
+
+        void touch(int set, int way) { hit(set, way); }
+
+        int victim(int set, int invalid, const bitvec<WAYS>& mask) {
+            assert(mask.nonzero());
+
+            bitvec<WAYS> &map = evictmap[set];
+            bitvec<WAYS> unused = mask & ~map;
+
+            if (unused.iszero()) {
+                map = map & ~mask;
+                return mask.lsb();
+            }
+            return unused.lsb();
+        }
+
+        bool fill(int set, int way, W64 pc) {
+            bitvec<WAYS> &map = evictmap[set];
+            map[way] = 1;
+            if (map.allset()) {
+                map = 0;
+                map[way] = 1;
+            }
+            return false;
+        }
+
+        void evict(int set, int way) { }
+
+        void invalidate(int set, int way) {
+            evictmap[set][way] = 0;
+        }
+
+        void save_state(UarchStateWriter& writer) const {
+            foreach (i, SETS) writer.put_bits(evictmap[i]);
+        }
+
+        bool restore_state(UarchStateReader& reader) {
+            foreach (i, SETS) {
+                if (!reader.get_bits(evictmap[i])) return false;
+            }
+            return true;
+        }
+    };
+
+    /**
+     * @brief True LRU with an age per way
+     */
+    template <int SETS, int WAYS>
+    struct LRUReplacement
+    {
+        W8 age[SETS][WAYS];
+
+        void reset() {
+            foreach (i, SETS) {
+                foreach (j, WAYS) age[i][j] = j;
+            }
+        }
+
+        void hit(int set, int way) {
+            W8 old = age[set][way];
+            foreach (j, WAYS) {
+                if (age[set][j] < old) age[set][j]++;
+            }
+            age[set][way] = 0;
+        }
+
+        void touch(int set, int way) { hit(set, way); }
+
+        int victim(int set, int invalid, const bitvec<WAYS>& mask) {
+            assert(mask.nonzero());
+            if (invalid >= 0) return invalid;
+
+            int way = -1;
+            foreach (j, WAYS) {
+                if (!mask[j]) continue;
+                if (way < 0 || age[set][j] > age[set][way]) way = j;
+            }
+            return way;
+        }
+
+        bool fill(int set, int way, W64 pc) {
+            hit(set, way);
+            return false;
+        }
+
+        void evict(int set, int way) { }
+
+        void invalidate(int set, int way) { }
+
+        void save_state(UarchStateWriter& writer) const {
+            writer.put_array(&age[0][0], SETS * WAYS);
+        }
+
+        bool restore_state(UarchStateReader& reader) {
+            return reader.get_array(&age[0][0], SETS * WAYS);
+        }
+    };
+
+    /**
+     * @brief Tree pseudo-LRU, needs a power of two number of ways
+     *
+     * Node 'n' of the tree has children '2n' and '2n+1', root is node 1.
+     * A set node bit means the victim is in the right subtree.
+     */
+    template <int SETS, int WAYS>
+    struct PLRUReplacement
+    {
+        bitvec<WAYS * 2> tree[SETS];
+
+        /* Fails to compile for other way counts, config_gen.py rejects them */
+        typedef char ways_power_of_two[((WAYS & (WAYS - 1)) == 0) ? 1 : -1];
+
+        void reset() {
+            foreach (i, SETS) tree[i] = 0;
+        }
+
+        void hit(int set, int way) {
+            int node = 1;
+            for (int span = WAYS / 2; span > 0; span /= 2) {
+                bool right = (way & span) != 0;
+                tree[set][node] = !right;
+                node = node * 2 + right;
+            }
+        }
+
+        void touch(int set, int way) { hit(set, way); }
+
+        int victim(int set, int invalid, const bitvec<WAYS>& mask) {
+            assert(mask.nonzero());
+            if (invalid >= 0) return invalid;
+
+            int node = 1;
+            int way = 0;
+            for (int span = WAYS / 2; span > 0; span /= 2) {
+                bool right = tree[set][node];
+
+                /* Take the other subtree if no way of this one is allowed */
+                int first = way + (right ? span : 0);
+                bool allowed = false;
+                for (int j = first; j < first + span; j++)
+                    allowed |= mask[j];
+                if (!allowed) right = !right;
+
+                if (right) way |= span;
+                node = node * 2 + right;
+            }
+            return way;
+        }
+
+        bool fill(int set, int way, W64 pc) {
+            hit(set, way);
+            return false;
+        }
+
+        void evict(int set, int way) { }
+
+        void invalidate(int set, int way) { }
+
+        void save_state(UarchStateWriter& writer) const {
+            foreach (i, SETS) writer.put_bits(tree[i]);
+        }
+
+        bool restore_state(UarchStateReader& reader) {
+            foreach (i, SETS) {
+                if (!reader.get_bits(tree[i])) return false;
+            }
+            return true;
+        }
+    };
+
+    /**
+     * @brief Static re-reference interval prediction (2-bit RRPV)
+     *
+     * Hits predict near re-reference, new lines are inserted with a long
+     * re-reference interval so lines that are never reused (scans) are
+     * replaced before older reused ones.
+     */
+    template <int SETS, int WAYS>
+    struct SRRIPReplacement
+    {
+        static const W8 RRPV_MAX = 3;
+
+        W8 rrpv[SETS][WAYS];
+
+        void reset() {
+            foreach (i, SETS) {
+                foreach (j, WAYS) rrpv[i][j] = RRPV_MAX;
+            }
+        }
+
+        void hit(int set, int way) {
+            rrpv[set][way] = 0;
+        }
+
+        void touch(int set, int way) { hit(set, way); }
+
+        int victim(int set, int invalid, const bitvec<WAYS>& mask) {
+            assert(mask.nonzero());
+            if (invalid >= 0) return invalid;
+
+            while (1) {
+                foreach (j, WAYS) {
+                    if (mask[j] && rrpv[set][j] == RRPV_MAX) return j;
+                }
+                foreach (j, WAYS) {
+                    if (mask[j]) rrpv[set][j]++;
+                }
+            }
+        }
+
+        bool insert(int set, int way, bool distant) {
+            rrpv[set][way] = distant ? RRPV_MAX : RRPV_MAX - 1;
+            return distant;
+        }
+
+        bool fill(int set, int way, W64 pc) {
+            return insert(set, way, false);
+        }
+
+        void evict(int set, int way) { }
+
+        void invalidate(int set, int way) {
+            rrpv[set][way] = RRPV_MAX;
+        }
+
+        void save_state(UarchStateWriter& writer) const {
+            writer.put_array(&rrpv[0][0], SETS * WAYS);
+        }
+
+        bool restore_state(UarchStateReader& reader) {
+            return reader.get_array(&rrpv[0][0], SETS * WAYS);
+        }
+    };
+
+    /**
+     * @brief Dynamic RRIP, set dueling between SRRIP and bimodal RRIP
+     *
+     * Every 'stride' sets one set always uses SRRIP and the next always
+     * uses BRRIP. Misses in these leader sets move the PSEL counter and
+     * all other sets follow the policy with fewer misses. BRRIP inserts
+     * with the long interval only once every BRRIP_EPSILON fills.
+     */
+    template <int SETS, int WAYS>
+    struct DRRIPReplacement : public SRRIPReplacement<SETS, WAYS>
+    {
+        typedef SRRIPReplacement<SETS, WAYS> base_t;
+
+        static const int PSEL_MAX = 1023;
+        static const int BRRIP_EPSILON = 32;
+        static const int LEADER_STRIDE = (SETS / 32 > 4) ? SETS / 32 : 4;
+
+        enum { FOLLOWER = 0, SRRIP_LEADER, BRRIP_LEADER };
+
+        int psel;
+        int brripCount;
+
+        void reset() {
+            base_t::reset();
+            psel = PSEL_MAX / 2;
+            brripCount = 0;
+        }
+
+        static int set_type(int set) {
+            switch (set % LEADER_STRIDE) {
+                case 0: return SRRIP_LEADER;
+                case 1: return BRRIP_LEADER;
+            }
+            return FOLLOWER;
+        }
+
+        bool fill(int set, int way, W64 pc) {
+            int type = set_type(set);
+
+            /* Each fill is a miss of this set */
+            if (type == SRRIP_LEADER && psel < PSEL_MAX) psel++;
+            if (type == BRRIP_LEADER && psel > 0) psel--;
+
+            bool brrip = (type == BRRIP_LEADER) ||
+                (type == FOLLOWER && psel > PSEL_MAX / 2);
+
+            if (!brrip)
+                return base_t::insert(set, way, false);
+
+            brripCount = (brripCount + 1) % BRRIP_EPSILON;
+            return base_t::insert(set, way, brripCount != 0);
+        }
+
+        void save_state(UarchStateWriter& writer) const {
+            base_t::save_state(writer);
+            writer.put((W32)psel);
+            writer.put((W32)brripCount);
+        }
+
+        bool restore_state(UarchStateReader& reader) {
+            W32 savedPsel, savedCount;
+            if (!base_t::restore_state(reader) || !reader.get(savedPsel) ||
+                    !reader.get(savedCount))
+                return false;
+            psel = savedPsel;
+            brripCount = savedCount;
+            return true;
+        }
+    };
+
+    /**
+     * @brief Signature-based hit predictor (SHiP-PC) on top of SRRIP
+     *
+     * Each line remembers a signature of the instruction that caused its
+     * fill. A table of saturating counters indexed by signature learns
+     * whether lines filled by that instruction are reused; lines whose
+     * signature counter is zero are inserted with the long interval.
+     */
+    template <int SETS, int WAYS>
+    struct SHiPReplacement : public SRRIPReplacement<SETS, WAYS>
+    {
+        typedef SRRIPReplacement<SETS, WAYS> base_t;
+
+        static const int SHCT_BITS = 14;
+        static const int SHCT_SIZE = 1 << SHCT_BITS;
+        static const W8  SHCT_MAX = 7;
+
+        W8  shct[SHCT_SIZE];
+        W16 signature[SETS][WAYS];
+        bitvec<WAYS> outcome[SETS];
+
+        void reset() {
+            base_t::reset();
+            foreach (i, SHCT_SIZE) shct[i] = 1;
+            foreach (i, SETS) {
+                outcome[i] = 0;
+                foreach (j, WAYS) signature[i][j] = 0;
+            }
+        }
+
+        static W16 signature_of(W64 pc) {
+            return (pc ^ (pc >> SHCT_BITS) ^ (pc >> (2 * SHCT_BITS))) &
+                (SHCT_SIZE - 1);
+        }
+
+        void hit(int set, int way) {
+            base_t::hit(set, way);
+
+            W8 &ctr = shct[signature[set][way]];
+            if (ctr < SHCT_MAX) ctr++;
+            outcome[set][way] = 1;
+        }
+
+        bool fill(int set, int way, W64 pc) {
+            W16 sig = signature_of(pc);
+            signature[set][way] = sig;
+            outcome[set][way] = 0;
+
+            return base_t::insert(set, way, shct[sig] == 0);
+        }
+
+        void evict(int set, int way) {
+            W8 &ctr = shct[signature[set][way]];
+            if (!outcome[set][way] && ctr > 0) ctr--;
+        }
+
+        void save_state(UarchStateWriter& writer) const {
+            base_t::save_state(writer);
+            writer.put_array(shct, SHCT_SIZE);
+            writer.put_array(&signature[0][0], SETS * WAYS);
+            foreach (i, SETS) writer.put_bits(outcome[i]);
+        }
+
+        bool restore_state(UarchStateReader& reader) {
+            if (!base_t::restore_state(reader) ||
+                    !reader.get_array(shct, SHCT_SIZE) ||
+                    !reader.get_array(&signature[0][0], SETS * WAYS))
+                return false;
+
+            foreach (i, SETS) {
+                if (!reader.get_bits(outcome[i])) return false;
+                /* Signatures index the counter table */
+                foreach (j, WAYS) {
+                    if (signature[i][j] >= SHCT_SIZE) return false;
+                }
+            }
+            return true;
+        }
+    };
+
+    /**
+     * @brief Map REPL_* id to its policy type
+     */
+    template <int POLICY, int SETS, int WAYS>
+    struct ReplacementPolicy;
+
+    template <int SETS, int WAYS>
+    struct ReplacementPolicy<REPL_NRU, SETS, WAYS> {
+        typedef NRUReplacement<SETS, WAYS> type;
+    };
+
+    template <int SETS, int WAYS>
+    struct ReplacementPolicy<REPL_LRU, SETS, WAYS> {
+        typedef LRUReplacement<SETS, WAYS> type;
+    };
+
+    template <int SETS, int WAYS>
+    struct ReplacementPolicy<REPL_PLRU, SETS, WAYS> {
+        typedef PLRUReplacement<SETS, WAYS> type;
+    };
+
+    template <int SETS, int WAYS>
+    struct ReplacementPolicy<REPL_SRRIP, SETS, WAYS> {
+        typedef SRRIPReplacement<SETS, WAYS> type;
+    };
+
+    template <int SETS, int WAYS>
+    struct ReplacementPolicy<REPL_DRRIP, SETS, WAYS> {
+        typedef DRRIPReplacement<SETS, WAYS> type;
+    };
+
+    template <int SETS, int WAYS>
+    struct ReplacementPolicy<REPL_SHIP, SETS, WAYS> {
+        typedef SHiPReplacement<SETS, WAYS> type;
+    };
+
+};
+
+#endif // REPLACEMENT_H
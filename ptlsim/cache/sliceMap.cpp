@@ -0,0 +1,127 @@
+/*
+ * MARSSx86 : A Full System Computer-Architecture Simulator
+ *
+ * This code is released under GPL.
+ *
+ */
+
+#ifdef MEM_TEST
+#include <test.h>
+#else
+#include <ptlsim.h>
+#endif
+
+#include <sliceMap.h>
+#include <controller.h>
+#include <machine.h>
+
+using namespace Memory;
+
+SliceMap::SliceMap(int slices, int hash, int hopLatency, int cols,
+        int lineBits)
+    : slices_(slices)
+    , hash_(hash)
+    , hopLatency_(hopLatency)
+    , cols_(cols)
+    , lineBits_(lineBits)
+{
+    if (cols_ <= 0)
+        for (cols_ = 1; cols_ * cols_ < slices_; cols_++) ;
+}
+
+SliceMap *SliceMap::create(BaseMachine &machine, const char *name,
+        int lineBits)
+{
+    stringbuf hash;
+    int slices, hopLatency, cols;
+
+    if (!machine.get_option(name, "slices", slices) || slices <= 1)
+        return NULL;
+
+    if (!machine.get_option(name, "slice_hop_latency", hopLatency))
+        hopLatency = 0;
+    if (!machine.get_option(name, "slice_cols", cols))
+        cols = 0;
+
+    if (hopLatency < 0) {
+        ptl_logfile << "[ERROR] ", name, ": negative slice_hop_latency ",
+                    hopLatency, endl;
+        assert_fail(__STRING(0), __FILE__, __LINE__, __PRETTY_FUNCTION__);
+    }
+
+    if (!machine.get_option(name, "slice_hash", hash) ||
+            !strcmp(hash.buf, "xor"))
+        return new SliceMap(slices, SLICE_HASH_XOR, hopLatency, cols,
+                lineBits);
+    if (!strcmp(hash.buf, "mod"))
+        return new SliceMap(slices, SLICE_HASH_MOD, hopLatency, cols,
+                lineBits);
+
+    ptl_logfile << "[ERROR] ", name, ": unknown slice hash '", hash, "'",
+                endl;
+    cerr << "[ERROR] " << name << ": unknown slice hash '" << hash << "'"
+         << endl;
+    assert_fail(__STRING(0), __FILE__, __LINE__, __PRETTY_FUNCTION__);
+}
+
+SliceMap *SliceMap::create_lower(BaseMachine &machine,
+        dynarray<Controller*> &conts, int lineBits)
+{
+    if (conts.count() <= 1)
+        return NULL;
+
+    /* More than one controller below, they must be slices of one cache */
+    SliceMap *map = create(machine, conts[0]->get_name(), lineBits);
+
+    if (!map || map->count() != conts.count()) {
+        ptl_logfile << "[ERROR] ", conts[0]->get_name(), ": ",
+                    (map ? map->count() : 1), " slices but ", conts.count(),
+                    " controllers on its upper interconnect", endl;
+        assert_fail(__STRING(0), __FILE__, __LINE__, __PRETTY_FUNCTION__);
+    }
+
+    /* Index them by slice id */
+    dynarray<Controller*> slices;
+    slices.resize(conts.count(), NULL);
+    foreach (i, conts.count()) {
+        int slice = conts[i]->idx;
+        if (slice >= slices.count() || slices[slice]) {
+            ptl_logfile << "[ERROR] ", conts[i]->get_name(),
+                        ": no free slice id ", slice, endl;
+            assert_fail(__STRING(0), __FILE__, __LINE__,
+                    __PRETTY_FUNCTION__);
+        }
+        slices[slice] = conts[i];
+    }
+
+    foreach (i, slices.count()) {
+        conts[i] = slices[i];
+    }
+
+    return map;
+}
+
+int SliceMap::slice_of(W64 physaddr) const
+{
+    W64 line = physaddr >> lineBits_;
+
+    if (hash_ == SLICE_HASH_XOR) {
+        line ^= (line >> 7) ^ (line >> 13) ^ (line >> 19);
+    }
+
+    return line % slices_;
+}
+
+/**
+ * @brief Manhattan distance between a core's tile and a slice
+ *
+ * Core 'n' sits on the tile of slice 'n % slices', tiles are numbered
+ * row by row.
+ */
+int SliceMap::hops(int coreid, int slice) const
+{
+    int tile = coreid % slices_;
+
+    return abs((tile % cols_) - (slice % cols_)) +
+        abs((tile / cols_) - (slice / cols_));
+}
@@ -0,0 +1,127 @@
+/*
+ * MARSSx86 : A Full System Computer-Architecture Simulator
+ *
+ * This code is released under GPL.
+ *
+ */
+
+#ifndef SLICE_MAP_H
+#define SLICE_MAP_H
+
+#include <globals.h>
+#include <superstl.h>
+#include <statsBuilder.h>
+
+struct BaseMachine;
+
+namespace Memory {
+
+    /*
+     * Per slice statistics of a sliced last level cache
+     *
+     *  accesses  : requests from upper level handled by this slice
+     *  hops      : total hop distance of those requests
+     *  hop_cycles: latency added to those requests for hop distance
+     *  filtered  : broadcast messages dropped because they map to
+     *              another slice
+     */
+    struct SliceStats : public Statable
+    {
+        StatObj<W64> accesses;
+        StatObj<W64> hops;
+        StatObj<W64> hop_cycles;
+        StatObj<W64> filtered;
+        StatEquation<W64, double, StatObjFormulaDiv> avg_hops;
+
+        SliceStats(Statable *parent)
+            : Statable("slice", parent)
+              , accesses("accesses", this)
+              , hops("hops", this)
+              , hop_cycles("hop_cycles", this)
+              , filtered("filtered", this)
+              , avg_hops("avg_hops", this)
+        {
+            avg_hops.add_elem(&hops);
+            avg_hops.add_elem(&accesses);
+        }
+    };
+
+    enum {
+        SLICE_HASH_MOD = 0,
+        SLICE_HASH_XOR,
+    };
+
+    class Controller;
+
+    /**
+     * @brief Map physical lines to the slices of a last level cache
+     *
+     * A sliced cache is configured as one cache instance per slice, each
+     * with its own queue and tag array, and all instances share these
+     * options:
+     *
+     *  slices            : number of slices (equal to 'insts')
+     *  slice_hash        : 'xor' (default) or 'mod'
+     *  slice_hop_latency : cycles added per hop between the requesting
+     *                      core's tile and the slice, 0 disables it
+     *  slice_cols        : columns of the tile grid used for hop distance
+     *
+     * 'mod' takes the line address modulo the slice count. With a power
+     * of two slice count those are also set index bits, so each slice uses
+     * only part of its sets. 'xor' folds higher address bits into the
+     * slice index to avoid that.
+     *
+     * Upper level caches address each request to the slice of its line,
+     * so connect them to the slices with an interconnect that routes by
+     * destination (mesh or switch). On a broadcast interconnect every
+     * slice sees every request and drops the ones of other slices; use
+     * split_bus there, as that bus collects a response from each slice.
+     */
+    class SliceMap
+    {
+        private:
+            int slices_;
+            int hash_;
+            int hopLatency_;
+            int cols_;
+            int lineBits_;
+
+        public:
+            SliceMap(int slices, int hash, int hopLatency, int cols,
+                    int lineBits);
+
+            /*
+             * Read slice options of cache 'name', returns NULL if the
+             * cache is not sliced.
+             */
+            static SliceMap* create(BaseMachine &machine, const char *name,
+                    int lineBits);
+
+            /*
+             * Map for the controllers below an upper level cache, returns
+             * NULL if there is only one. 'conts' is reordered so that
+             * conts[slice_of(addr)] is the owner of 'addr'.
+             */
+            static SliceMap* create_lower(BaseMachine &machine,
+                    dynarray<Controller*> &conts, int lineBits);
+
+            int count() const { return slices_; }
+
+            int slice_of(W64 physaddr) const;
+
+            int hops(int coreid, int slice) const;
+
+            int hop_latency(int coreid, int slice) const {
+                return hopLatency_ * hops(coreid, slice);
+            }
+
+            const char* hash_name() const {
+                return (hash_ == SLICE_HASH_XOR) ? "xor" : "mod";
+            }
+
+            int get_hop_latency() const { return hopLatency_; }
+    };
+
+};
+
+#endif // SLICE_MAP_H
@@ -162,6 +162,8 @@ bool BusInterconnect::controller_request_cb(void *arg)
             /* If response has data mark this controller */
             if(message->hasData) {
                 pendingEntry->controllerWithData = sender;
+                memoryHierarchy_->hold_line_data(pendingEntry->data,
+                        message->data, kernel);
             }
 
             if(sender->is_private()) {
@@ -224,6 +226,8 @@ bool BusInterconnect::controller_request_cb(void *arg)
     busQueueEntry->request = message->request;
     message->request->incRefCounter();
     busQueueEntry->hasData = message->hasData;
+    memoryHierarchy_->hold_line_data(busQueueEntry->data, message->data,
+            kernel);
 
 
     if(!is_busy()) {
@@ -367,6 +371,7 @@ bool BusInterconnect::broadcast_completed_cb(void *arg)
     message.sender = this;
     message.request = queueEntry->request;
     message.hasData = queueEntry->hasData;
+    message.data = queueEntry->data.get();
     message.origin = NULL;
 
     Controller *controller = queueEntry->controllerQueue->controller;
@@ -495,6 +500,7 @@ bool BusInterconnect::data_broadcast_completed_cb(void *arg)
     message.request = pendingEntry->request;
     message.hasData = true;
     message.isShared = pendingEntry->shared;
+    message.data = pendingEntry->data.get();
     message.origin = NULL;
 
     foreach(i, controllers.count()) {
@@ -47,11 +47,13 @@ struct BusQueueEntry : public FixStateListObject
 	BusControllerQueue *controllerQueue;
 	bool hasData;
 	bool annuled;
+	LineDataBuffer data;
 
 	void init() {
 		request = NULL;
 		hasData = false;
 		annuled = false;
+		data.reset();
 	}
 
 	ostream& print(ostream& os) const {
@@ -81,6 +83,7 @@ struct PendingQueueEntry : public FixStateListObject
 	dynarray<bool> responseReceived;
 	bool annuled;
     W64 initCycle;
+    LineDataBuffer data;
 
 	void init() {
 		request = NULL;
@@ -89,6 +92,7 @@ struct PendingQueueEntry : public FixStateListObject
 		annuled = false;
         initCycle = sim_cycle;
         controllerWithData = NULL;
+        data.reset();
 	}
 
 	void set_num_controllers(int no) {
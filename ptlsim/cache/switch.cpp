@@ -84,6 +84,8 @@ bool Switch::controller_request_cb(void *arg)
     }
 
     *queueEntry << *msg;
+    memoryHierarchy_->hold_line_data(queueEntry->data, msg->data,
+            queueEntry->request->is_kernel());
     ADD_HISTORY_ADD(queueEntry->request);
 
     if (!cq->queue_in_use) {
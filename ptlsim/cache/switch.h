@@ -35,6 +35,7 @@ namespace SwitchInterconnect {
         bool           in_use;
         bool           has_data;
         bool           shared;
+        LineDataBuffer data;
 
         void init() {
             request  = NULL;
@@ -45,6 +46,7 @@ namespace SwitchInterconnect {
             in_use   = 0;
             has_data = 0;
             shared   = 0;
+            data.reset();
         }
 
         void setup(const Message &msg) {
@@ -64,6 +66,7 @@ namespace SwitchInterconnect {
             msg.arg      = m_arg;
             msg.hasData  = has_data;
             msg.isShared = shared;
+            msg.data     = data.get();
         }
 
         ostream& print(ostream& os) const {
@@ -16,6 +16,7 @@
 #include <machine.h>
 #include <statsBuilder.h>
 #include <memoryHierarchy.h>
+#include <uarch-checkpoint.h>
 
 namespace Core {
 
@@ -35,6 +36,10 @@ namespace Core {
             virtual void flush_pipeline() = 0;
 		    virtual void dump_configuration(YAML::Emitter &out) const = 0;
 
+            /* Micro-architectural checkpoint support */
+            virtual void save_state(UarchStateWriter& writer) const {}
+            virtual bool restore_state(UarchStateReader& reader) { return true; }
+
             void update_memory_hierarchy_ptr();
 
             BaseMachine& machine;
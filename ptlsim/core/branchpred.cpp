@@ -76,6 +76,14 @@ struct BTBEntry {
     target = 0;
   }
 
+  void save_state(UarchStateWriter& writer) const {
+    writer.put(target);
+  }
+
+  bool restore_state(UarchStateReader& reader) {
+    return reader.get(target);
+  }
+
   ostream& print(ostream& os, W64 tag) const {
     os << (void*)(Waddr)target;
     return os;
@@ -84,6 +92,7 @@ struct BTBEntry {
 
 template <int SETCOUNT, int WAYCOUNT>
 struct BranchTargetBuffer: public AssociativeArray<W64, BTBEntry, SETCOUNT, WAYCOUNT, 1> {
+  typedef AssociativeArray<W64, BTBEntry, SETCOUNT, WAYCOUNT, 1> base_t;
   W8 coreid;
   W8 threadid;
   void reset(){
@@ -251,7 +260,9 @@ struct CombinedPredictor {
   BimodalPredictor<BIMODSIZE> bimodal;
   BimodalPredictor<METASIZE> meta;
 
-  BranchTargetBuffer<BTBSETS, BTBWAYS> btb;
+  typedef BranchTargetBuffer<BTBSETS, BTBWAYS> BTB;
+
+  BTB btb;
   ReturnAddressStack<RASSIZE> ras;
   W8 coreid;
   W8 threadid; 
@@ -434,6 +445,7 @@ struct BranchPredictorImplementation: public CombinedPredictor<65536, 65536, 1,
  };
 
 void BranchPredictorInterface::destroy() {
+  discard_state();
   if (impl) delete impl;
   impl = NULL;
 }
@@ -468,6 +480,66 @@ void BranchPredictorInterface::annulras(const PredictorUpdate& predinfo) {
 
 void BranchPredictorInterface::flush() { }
 
+//
+// Save direction tables and BTB for micro-architectural checkpoints.
+// The RAS only holds speculative state and is not saved.
+//
+void BranchPredictorInterface::save_state(UarchStateWriter& writer) const {
+  writer.put_array((const W32*)impl->twolevel.shiftregs.data,
+      impl->twolevel.shiftregs.length);
+  writer.put_array(impl->twolevel.L2table.data, impl->twolevel.L2table.length);
+  writer.put_array(impl->bimodal.table.data, impl->bimodal.table.length);
+  writer.put_array(impl->meta.table.data, impl->meta.table.length);
+  writer.put_associative(impl->btb);
+}
+
+//
+// Read saved tables into a staged predictor, the running one is only
+// changed by commit_state()
+//
+bool BranchPredictorInterface::read_state(UarchStateReader& reader) {
+  discard_state();
+  staged = new BranchPredictorImplementation(impl->coreid, impl->threadid);
+  staged->reset();
+
+  bool rc = reader.get_array((W32*)staged->twolevel.shiftregs.data,
+      staged->twolevel.shiftregs.length) &&
+    reader.get_array(staged->twolevel.L2table.data,
+        staged->twolevel.L2table.length) &&
+    reader.get_array(staged->bimodal.table.data,
+        staged->bimodal.table.length) &&
+    reader.get_array(staged->meta.table.data, staged->meta.table.length) &&
+    reader.get_associative(staged->btb);
+
+  if (!rc) discard_state();
+
+  return rc;
+}
+
+void BranchPredictorInterface::commit_state() {
+  assert(staged);
+
+  impl->twolevel.shiftregs = staged->twolevel.shiftregs;
+  impl->twolevel.L2table = staged->twolevel.L2table;
+  impl->bimodal.table = staged->bimodal.table;
+  impl->meta.table = staged->meta.table;
+  *(BranchPredictorImplementation::BTB::base_t*)&impl->btb = staged->btb;
+
+  discard_state();
+}
+
+void BranchPredictorInterface::discard_state() {
+  if (staged) delete staged;
+  staged = NULL;
+}
+
+bool BranchPredictorInterface::restore_state(UarchStateReader& reader) {
+  if (!read_state(reader)) return false;
+
+  commit_state();
+  return true;
+}
+
 ostream& operator <<(ostream& os, const BranchPredictorInterface& branchpred) {
   os << branchpred.impl->ras;
   return os;
@@ -12,6 +12,7 @@
 #define _BRANCHPRED_H_
 
 #include <ptlsim.h>
+#include <uarch-checkpoint.h>
 
 
 #define BRANCH_HINT_UNCOND      0
@@ -62,8 +63,10 @@ struct BranchPredictorImplementation;
 struct BranchPredictorInterface {
   // Pointer to private implementation:
   BranchPredictorImplementation* impl;
+  // Tables read from a checkpoint, not installed yet:
+  BranchPredictorImplementation* staged;
 
-  BranchPredictorInterface() { impl = NULL; }
+  BranchPredictorInterface() { impl = NULL; staged = NULL; }
   //  void init();
   void init(W8 coreid, W8 threadid);
   void reset();
@@ -73,6 +76,12 @@ struct BranchPredictorInterface {
   void updateras(PredictorUpdate& predinfo, W64 branchaddr);
   void annulras(const PredictorUpdate& predinfo);
   void flush();
+  void save_state(UarchStateWriter& writer) const;
+  bool restore_state(UarchStateReader& reader);
+  // Two step restore for callers that restore several objects at once:
+  bool read_state(UarchStateReader& reader);
+  void commit_state();
+  void discard_state();
 };
 
 ostream& operator <<(ostream& os, const BranchPredictorInterface& branchpred);
@@ -0,0 +1,104 @@
+/*
+ * MARSSx86 : A Full System Computer-Architecture Simulator
+ *
+ * This code is released under GPL.
+ *
+ */
+
+#ifndef INORDER_COMMON_H
+#define INORDER_COMMON_H
+
+#include <ptlsim.h>
+#include <ptlhwdef.h>
+
+/*
+ * Register tables and helpers shared by the cores that execute uops in
+ * order against the architectural state (atom and interval). The ooo core
+ * renames registers and has its own versions.
+ */
+
+/**
+ * @brief Map for Register visibility
+ */
+static const bool archdest_is_visible[TRANSREG_COUNT] = {
+    // Integer registers
+    1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1,
+    // SSE registers, low 64 bits
+    1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1,
+    // SSE registers, high 64 bits
+    1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1,
+    // x87 FP / special
+    1, 1, 1, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0,
+    // MMX registers
+    1, 1, 1, 1, 1, 1, 1, 1,
+    // AVX registers, upper 128 bits
+    1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1,
+    // The following are temporary registers
+    0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0,
+};
+
+static const byte archreg_remap_table[TRANSREG_COUNT] = {
+  REG_rax,  REG_rcx,  REG_rdx,  REG_rbx,  REG_rsp,  REG_rbp,  REG_rsi,  REG_rdi,
+  REG_r8,  REG_r9,  REG_r10,  REG_r11,  REG_r12,  REG_r13,  REG_r14,  REG_r15,
+
+  REG_xmml0,  REG_xmmh0,  REG_xmml1,  REG_xmmh1,  REG_xmml2,  REG_xmmh2,  REG_xmml3,  REG_xmmh3,
+  REG_xmml4,  REG_xmmh4,  REG_xmml5,  REG_xmmh5,  REG_xmml6,  REG_xmmh6,  REG_xmml7,  REG_xmmh7,
+
+  REG_xmml8,  REG_xmmh8,  REG_xmml9,  REG_xmmh9,  REG_xmml10,  REG_xmmh10,  REG_xmml11,  REG_xmmh11,
+  REG_xmml12,  REG_xmmh12,  REG_xmml13,  REG_xmmh13,  REG_xmml14,  REG_xmmh14,  REG_xmml15,  REG_xmmh15,
+
+  REG_fptos,  REG_fpsw,  REG_fptags,  REG_fpstack,  REG_msr,  REG_dlptr,  REG_trace, REG_ctx,
+
+  REG_rip,  REG_flags,  REG_dlend, REG_selfrip, REG_nextrip, REG_ar1, REG_ar2, REG_zero,
+
+  REG_mmx0, REG_mmx1, REG_mmx2, REG_mmx3, REG_mmx4, REG_mmx5, REG_mmx6, REG_mmx7,
+
+  REG_ymmhl0,  REG_ymmhh0,  REG_ymmhl1,  REG_ymmhh1,  REG_ymmhl2,  REG_ymmhh2,  REG_ymmhl3,  REG_ymmhh3,
+  REG_ymmhl4,  REG_ymmhh4,  REG_ymmhl5,  REG_ymmhh5,  REG_ymmhl6,  REG_ymmhh6,  REG_ymmhl7,  REG_ymmhh7,
+
+  REG_ymmhl8,  REG_ymmhh8,  REG_ymmhl9,  REG_ymmhh9,  REG_ymmhl10,  REG_ymmhh10,  REG_ymmhl11,  REG_ymmhh11,
+  REG_ymmhl12,  REG_ymmhh12,  REG_ymmhl13,  REG_ymmhh13,  REG_ymmhl14,  REG_ymmhh14,  REG_ymmhl15,  REG_ymmhh15,
+
+  REG_temp0,  REG_temp1,  REG_temp2,  REG_temp3,  REG_temp4,  REG_temp5,  REG_temp6,  REG_temp7,
+
+  // Notice how these (REG_zf, REG_cf, REG_of) are all mapped to REG_flags in an in-order processor:
+  REG_flags,  REG_flags,  REG_flags,  REG_imm,  REG_mem,  REG_temp8,  REG_temp9,  REG_temp10,
+};
+
+
+/**
+* @brief Extract specific bytes from given 64bit value
+*
+* @param target source to get selected bytes
+* @param SIZESHIFT number of bytes to select
+* @param SIGNEXT signextend flag
+*
+* @return extracted data
+*/
+static inline W64 extract_bytes(byte* target, int SIZESHIFT, bool SIGNEXT) {
+    W64 data;
+    switch (SIZESHIFT) {
+        case 0:
+            data = (SIGNEXT) ? (W64s)(*(W8s*)target) : (*(W8*)target); break;
+        case 1:
+            data = (SIGNEXT) ? (W64s)(*(W16s*)target) : (*(W16*)target); break;
+        case 2:
+            data = (SIGNEXT) ? (W64s)(*(W32s*)target) : (*(W32*)target); break;
+        case 3:
+            data = *(W64*)target; break;
+        default:
+            ptl_logfile << "Invalid sizeshift in extract_bytes\n";
+            data = 0xdeadbeefdeadbeef;
+    }
+    return data;
+}
+
+#endif // INORDER_COMMON_H
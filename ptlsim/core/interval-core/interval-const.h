@@ -0,0 +1,36 @@
+/*
+ * MARSSx86 : A Full System Computer-Architecture Simulator
+ *
+ * This code is released under GPL.
+ *
+ */
+
+#ifndef INTERVAL_CONST_H
+#define INTERVAL_CONST_H
+
+// Max number of uops dispatched per cycle
+#ifndef INTERVAL_DISPATCH_WIDTH
+#define INTERVAL_DISPATCH_WIDTH 4
+#endif
+
+// Reorder window in uops, shared among all threads of the core
+#ifndef INTERVAL_ROB_SIZE
+#define INTERVAL_ROB_SIZE 128
+#endif
+
+// Cycles to refill the frontend after a redirect
+#ifndef INTERVAL_FRONTEND_STAGES
+#define INTERVAL_FRONTEND_STAGES 7
+#endif
+
+// Cycles from dispatch of a mispredicted branch to its resolution
+#ifndef INTERVAL_BRANCH_RESOLVE_CYCLES
+#define INTERVAL_BRANCH_RESOLVE_CYCLES 5
+#endif
+
+// Max number of outstanding L1-D load misses per thread
+#ifndef INTERVAL_MISS_QUEUE_SIZE
+#define INTERVAL_MISS_QUEUE_SIZE 10
+#endif
+
+#endif
@@ -0,0 +1,1581 @@
+/*
+ * MARSSx86 : A Full System Computer-Architecture Simulator
+ *
+ * This code is released under GPL.
+ *
+ */
+
+#include <intervalcore.h>
+#include <globals.h>
+#include <ptlsim.h>
+#include <branchpred.h>
+#include <decode.h>
+#include <memoryHierarchy.h>
+#include <inorder-common.h>
+
+using namespace INTERVAL_CORE_MODEL;
+using namespace Memory;
+
+
+//---------------------------------------------//
+//   IntervalThread
+//---------------------------------------------//
+
+IntervalThread::IntervalThread(IntervalCore& core, W8 threadid, Context& ctx)
+    : Statable("thread", &core)
+      , threadid(threadid)
+      , core(core)
+      , ctx(ctx)
+      /* Initialize Statistics structures*/
+      , st_dispatch(this)
+      , st_commit(this)
+      , st_branch_predictions(this)
+      , st_dcache("dcache", this)
+      , st_icache("icache", this)
+      , st_long_latency(this)
+      , st_cycles("cycles", this)
+      , assists("assists", this, assist_names)
+      , lassists("lassists", this, light_assist_names)
+{
+    stringbuf th_name;
+    th_name << "thread_" << threadid;
+    update_name(th_name.buf);
+
+    // Set decoder stats
+    set_decoder_stats(this, ctx.cpu_index);
+
+    // Setup the signals
+    stringbuf sig_name;
+    sig_name << "Core" << core.get_coreid() << "-Th" << threadid << "-dcache-wakeup";
+    dcache_signal.set_name(sig_name.buf);
+    dcache_signal.connect(signal_mem_ptr(*this,
+            &IntervalThread::dcache_wakeup));
+
+    sig_name.reset();
+    sig_name << "Core" << core.get_coreid() << "-Th" << threadid << "-icache-wakeup";
+    icache_signal.set_name(sig_name.buf);
+    icache_signal.connect(signal_mem_ptr(*this,
+            &IntervalThread::icache_wakeup));
+
+    branchpred.init(core.get_coreid(), threadid);
+
+    fetch_uuid = 0;
+    dispatch_seq = 0;
+    last_commit_cycle = 0;
+    queued_mem_lock_count = 0;
+
+    handle_interrupt_at_next_eom = 0;
+    current_bb = NULL;
+
+    reset();
+
+    // Set Stat Equations
+    st_commit.ipc.add_elem(&st_commit.insns);
+    st_commit.ipc.add_elem(&st_cycles);
+
+    st_commit.uipc.add_elem(&st_commit.uops);
+    st_commit.uipc.add_elem(&st_cycles);
+
+    st_dcache.miss_ratio.add_elem(&st_dcache.misses);
+    st_dcache.miss_ratio.add_elem(&st_dcache.accesses);
+
+    st_icache.miss_ratio.add_elem(&st_icache.misses);
+    st_icache.miss_ratio.add_elem(&st_icache.accesses);
+
+    st_long_latency.mlp.add_elem(&st_long_latency.outstanding);
+    st_long_latency.mlp.add_elem(&st_long_latency.miss_cycles);
+}
+
+/**
+ * @brief Reset the thread
+ *
+ * Drops the current basic-block, all outstanding miss events and the
+ * speculative flags. Architectural state lives in Context only, so nothing
+ * else needs to be recovered.
+ */
+void IntervalThread::reset()
+{
+    bb_transop_index = 0;
+    if(current_bb) {
+        current_bb->release();
+    }
+    current_bb = NULL;
+    bb_insn_rip = 0;
+
+    fetchrip = ctx.eip;
+    forwarded_flags = ctx.reg_flags & (setflags_to_x86_flags[7] | FLAG_IF);
+    internal_flags = forwarded_flags;
+
+    waiting_for_icache_miss = 0;
+    current_icache_block = 0;
+    icache_miss_addr = 0;
+    itlb_exception = 0;
+
+    frontend_stall = 0;
+    frontend_stall_reason = STALL_FLUSH;
+    wait_for_miss_resolve = 0;
+    stall_reason = -1;
+
+    miss_count = 0;
+    miss_dependent.reset();
+    flags_dependent = 0;
+
+    foreach(i, 11) {
+        temp_registers[i] = 0xdeadbeefdeadbeef;
+    }
+
+    setzero(register_flags);
+    register_flags[REG_flags] = ctx.reg_flags;
+}
+
+/**
+ * @brief Dispatch instructions of this thread for one cycle
+ *
+ * @param width Dispatch width left in this cycle, in uops
+ *
+ * @return DISPATCH_EXIT if exit to qemu is needed
+ */
+int IntervalThread::dispatch(int& width)
+{
+    int rc = DISPATCH_OK;
+    W64 start_seq = dispatch_seq;
+
+    if(sim_cycle > (last_commit_cycle + 1024*1024)) {
+        ptl_logfile << "Core has not progressed since cycle ",
+                    last_commit_cycle, " dumping all information\n";
+        core.machine.dump_state(ptl_logfile);
+        ptl_logfile << flush;
+        assert(0);
+    }
+
+    stall_reason = -1;
+
+    if(waiting_for_icache_miss) {
+        stall_reason = STALL_ICACHE;
+    } else if(wait_for_miss_resolve && miss_count > 0) {
+        stall_reason = STALL_MISS_RESOLVE;
+    } else if(frontend_stall > 0) {
+        frontend_stall--;
+        stall_reason = frontend_stall_reason;
+    } else {
+        wait_for_miss_resolve = false;
+
+        while(width > 0) {
+            rc = dispatch_insn(width);
+
+            if(rc != DISPATCH_OK) {
+                break;
+            }
+        }
+    }
+
+    if(stall_reason >= 0) {
+        st_dispatch.stall[stall_reason]++;
+    }
+
+    st_dispatch.width[min(dispatch_seq - start_seq, (W64)DISPATCH_WIDTH)]++;
+
+    return rc;
+}
+
+/**
+ * @brief Fetch, execute and commit one x86 instruction
+ *
+ * @param width Dispatch width left in this cycle, the uops of the
+ * instruction are subtracted from it
+ *
+ * @return Dispatch result
+ */
+int IntervalThread::dispatch_insn(int& width)
+{
+    if(handle_interrupt_at_next_eom) {
+        return handle_interrupt() ? DISPATCH_EXIT : DISPATCH_STALL;
+    }
+
+    if unlikely ((ctx.eip == config.start_log_at_rip) &&
+            (ctx.eip != 0xffffffffffffffffULL)) {
+        config.start_log_at_iteration = 0;
+        logenable = 1;
+    }
+
+    if(!fetch_check_current_bb() || !fetch_from_icache()) {
+        if(itlb_exception) {
+            ctx.exception = EXCEPTION_PageFaultOnExec;
+            ctx.error_code = 0;
+            ctx.page_fault_addr = itlb_exception_addr;
+            return handle_exception() ? DISPATCH_EXIT : DISPATCH_STALL;
+        }
+
+        return DISPATCH_STALL;
+    }
+
+    /* Copy the uops of this instruction from the basic-block */
+    int count = 0;
+    int loads = 0;
+    bool mem = false;
+
+    do {
+        assert(count < MAX_UOPS_PER_INSN);
+        assert(bb_transop_index + count < current_bb->count);
+
+        uops[count] = current_bb->transops[bb_transop_index + count];
+        synthops[count] = current_bb->synthops[bb_transop_index + count];
+
+        TransOp& uop = uops[count];
+        if(isload(uop.opcode) && !uop.internal) {
+            loads++;
+        }
+        mem |= isload(uop.opcode) | isstore(uop.opcode);
+
+        count++;
+    } while(!uops[count-1].eom);
+
+    if(window_full(count)) {
+        stall_reason = STALL_ROB_FULL;
+        return DISPATCH_STALL;
+    }
+
+    if(miss_count + loads > MISS_QUEUE_SIZE) {
+        stall_reason = STALL_MISS_QUEUE_FULL;
+        return DISPATCH_STALL;
+    }
+
+    if(mem && !core.memoryHierarchy->is_cache_available(
+                core.get_coreid(), threadid, false)) {
+        stall_reason = STALL_CACHE_BUSY;
+        return DISPATCH_STALL;
+    }
+
+    if(!execute_insn(count)) {
+        abort_insn();
+
+        if(exception) {
+            ctx.exception = exception;
+            ctx.error_code = error_code;
+            ctx.page_fault_addr = page_fault_addr;
+            return handle_exception() ? DISPATCH_EXIT : DISPATCH_STALL;
+        }
+
+        stall_reason = STALL_MEM_LOCK;
+        return DISPATCH_STALL;
+    }
+
+    commit_insn(count);
+
+    width -= count;
+
+    if(isclass(uops[count-1].opcode, OPCLASS_BARRIER)) {
+        return handle_barrier() ? DISPATCH_EXIT : DISPATCH_STALL;
+    }
+
+    if(predict_branch(count)) {
+        /*
+         * Mispredicted branch: the frontend is redirected once the branch
+         * resolves and then has to refill. If the branch depends on an
+         * outstanding miss it can't resolve before the miss returns.
+         */
+        frontend_stall = core.branch_resolve_cycles + FRONTEND_STAGES;
+        frontend_stall_reason = STALL_MISPREDICT;
+        wait_for_miss_resolve = branch_dependent;
+        return DISPATCH_STALL;
+    }
+
+    return DISPATCH_OK;
+}
+
+/**
+ * @brief Setup current basic-block from the context's rip
+ *
+ * @return true if basic-block is successfully setup
+ */
+bool IntervalThread::fetch_check_current_bb()
+{
+    if(current_bb && bb_transop_index < current_bb->count &&
+            bb_insn_rip == ctx.eip) {
+        return true;
+    }
+
+    if(current_bb) {
+        current_bb->release();
+        current_bb = NULL;
+    }
+
+    fetchrip = ctx.eip;
+    fetchrip.update(ctx);
+
+    BasicBlock *bb = bbcache[ctx.cpu_index](fetchrip);
+
+    if likely (bb) {
+        current_bb = bb;
+    } else {
+        current_bb = bbcache[ctx.cpu_index].translate(ctx, fetchrip);
+
+        if unlikely (!current_bb) {
+            // Its a page fault in I-Cache
+            itlb_exception = true;
+            itlb_exception_addr = ctx.exec_fault_addr;
+            INTERVALTHLOG1("ITLB Execption addr ",
+                    hexstring(itlb_exception_addr,48), " fetchrip ",
+                    hexstring(fetchrip.rip,48));
+            return false;
+        }
+    }
+
+    // acquire a lock on this basic block so its not flushed out
+    current_bb->acquire();
+    current_bb->use(sim_cycle);
+
+    if(!current_bb->synthops) {
+        synth_uops_for_bb(*current_bb);
+    }
+
+    bb_transop_index = 0;
+    bb_insn_rip = ctx.eip;
+
+    st_dispatch.bbs++;
+
+    return true;
+}
+
+/**
+ * @brief Access I-Cache for instruction fetch
+ *
+ * @return True for i-cache hit
+ */
+bool IntervalThread::fetch_from_icache()
+{
+    PageFaultErrorCode pfec;
+    int exception_ = 0;
+    int mmio = 0;
+
+    Waddr physaddr = ctx.check_and_translate(fetchrip, 3,
+            false, false, exception_, mmio, pfec, true);
+
+    W64 req_icache_block = floor(physaddr, ICACHE_FETCH_GRANULARITY);
+
+    if(exception_) {
+        if(!ctx.try_handle_fault(fetchrip, 2)) {
+            itlb_exception = true;
+            itlb_exception_addr = fetchrip.rip;
+            INTERVALTHLOG1("ITLB Execption addr ",
+                    hexstring(itlb_exception_addr,48), " fetchrip ",
+                    hexstring(fetchrip.rip,48));
+            return false;
+        }
+    }
+
+    if ((!current_bb->invalidblock) &&
+            (req_icache_block != current_icache_block)) {
+
+        bool cache_available = core.memoryHierarchy->
+            is_cache_available(core.get_coreid(), threadid, true);
+
+        if(!cache_available){
+            stall_reason = STALL_CACHE_BUSY;
+            return false;
+        }
+
+        bool hit;
+        assert(!waiting_for_icache_miss);
+
+        Memory::MemoryRequest *request = core.memoryHierarchy->
+            get_free_request(core.get_coreid());
+        assert(request != NULL);
+
+        request->init(core.get_coreid(), threadid, physaddr, 0, sim_cycle,
+                true, fetchrip.rip, 0, Memory::MEMORY_OP_READ);
+        request->set_coreSignal(&icache_signal, NULL, -1);
+
+        hit = core.memoryHierarchy->access_cache(request);
+
+        st_icache.accesses++;
+
+        hit |= config.perfect_cache;
+        if unlikely (!hit) {
+            waiting_for_icache_miss = 1;
+            icache_miss_addr = req_icache_block;
+            st_icache.misses++;
+            stall_reason = STALL_ICACHE;
+            return false;
+        }
+
+        current_icache_block = req_icache_block;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Check if the reorder window behind the oldest miss is full
+ *
+ * @param count Number of uops to dispatch
+ *
+ * @return true if dispatching 'count' more uops overflows the window
+ */
+bool IntervalThread::window_full(int count)
+{
+    if(miss_count == 0) {
+        return false;
+    }
+
+    W64 window = ROB_SIZE / core.threadcount;
+
+    return (dispatch_seq + count - misses[0].seq) > window;
+}
+
+/**
+ * @brief Execute all uops of the current instruction
+ *
+ * @param count Number of uops in the instruction
+ *
+ * @return false if the instruction has to be aborted
+ *
+ * Results are kept in the instruction buffers and only written to the
+ * Context by commit_insn, so an aborted instruction leaves no
+ * architectural side effects.
+ */
+bool IntervalThread::execute_insn(int count)
+{
+    insn_rip = ctx.eip;
+    store_count = 0;
+    new_miss_count = 0;
+    lock_count = 0;
+    branch_dependent = false;
+    exception = 0;
+    error_code = 0;
+    page_fault_addr = 0;
+
+    foreach(i, count) {
+        if(!execute_uop(i)) {
+            return false;
+        }
+    }
+
+    /* Check for FPU not available */
+    foreach(i, count) {
+        TransOp& uop = uops[i];
+        if unlikely ((uop.is_sse|uop.is_x87) &&
+                ((ctx.cr[0] & CR0_TS_MASK) |
+                 (uop.is_x87 & (ctx.cr[0] & CR0_EM_MASK)))) {
+            exception = EXCEPTION_FloatingPointNotAvailable;
+            error_code = 0;
+            page_fault_addr = -1;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief Find the uop of the current instruction that last wrote 'reg'
+ *
+ * @param reg Remapped register index
+ * @param idx Index of the reading uop
+ *
+ * @return uop index or -1 if the register was not written
+ */
+int IntervalThread::find_producer(W16 reg, int idx)
+{
+    for(int i = idx-1; i >= 0; i--) {
+        if(uops[i].rd == reg) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+/**
+ * @brief Read a source register of a uop
+ *
+ * @param reg Register index
+ * @param idx Index of the reading uop
+ *
+ * @return Register data, forwarded from an older uop of the same
+ * instruction if it wrote the register
+ */
+W64 IntervalThread::read_reg(W16 reg, int idx)
+{
+    reg = archreg_remap_table[reg];
+
+    /* If reg is REG_flags then forward temporary flags */
+    if(reg == REG_flags) {
+        return internal_flags;
+    }
+
+    int producer = find_producer(reg, idx);
+    if(producer >= 0) {
+        return dest_values[producer];
+    }
+
+    if(reg >= REG_temp0 && reg <= REG_temp7) {
+        return temp_registers[reg - REG_temp0];
+    } else if(reg >= REG_temp8 && reg <= REG_temp10) {
+        return temp_registers[reg - REG_temp8 + 7];
+    }
+
+    return ctx.get(reg);
+}
+
+/**
+ * @brief Check if a source register depends on an outstanding miss
+ *
+ * @param reg Register index
+ * @param idx Index of the reading uop
+ *
+ * @return true if the register value is produced by a missing load
+ */
+bool IntervalThread::source_dependent(W16 reg, int idx)
+{
+    reg = archreg_remap_table[reg];
+
+    if(reg == REG_flags) {
+        return flags_dependent;
+    }
+
+    int producer = find_producer(reg, idx);
+    if(producer >= 0) {
+        return dest_dependent[producer];
+    }
+
+    return miss_dependent[reg];
+}
+
+/**
+ * @brief Write temporary registers
+ *
+ * @param reg Register index
+ * @param data new data of register
+ */
+void IntervalThread::write_temp_reg(W16 reg, W64 data)
+{
+    if(reg >= REG_temp0 && reg <= REG_temp7) {
+        temp_registers[reg - REG_temp0] = data;
+    } else if(reg >= REG_temp8 && reg <= REG_temp10) {
+        temp_registers[reg - REG_temp8 + 7] = data;
+    }
+}
+
+/**
+ * @brief Execute one uop of the current instruction
+ *
+ * @param idx Index into uops array
+ *
+ * @return false if the instruction has to be aborted
+ */
+bool IntervalThread::execute_uop(int idx)
+{
+    TransOp& uop = uops[idx];
+    IssueState state;
+    W16 raflags, rbflags, rcflags;
+
+    W64 radata = read_reg(uop.ra, idx);
+    W64 rbdata = (uop.rb == REG_imm) ? uop.rbimm : read_reg(uop.rb, idx);
+    W64 rcdata = (uop.rc == REG_imm) ? uop.rcimm : read_reg(uop.rc, idx);
+
+    raflags = register_flags[archreg_remap_table[uop.ra]];
+    rbflags = register_flags[archreg_remap_table[uop.rb]];
+    rcflags = register_flags[archreg_remap_table[uop.rc]];
+
+    bool dependent = source_dependent(uop.ra, idx) ||
+        (uop.rb != REG_imm && source_dependent(uop.rb, idx)) ||
+        (uop.rc != REG_imm && source_dependent(uop.rc, idx));
+
+    setzero(state);
+    dest_flags[idx] = 0;
+
+    bool ld = isload(uop.opcode);
+    bool st = isstore(uop.opcode);
+
+    INTERVALTHLOG2("Executing Uop ", uop, " radata: ", (void*)radata,
+            " rbdata: ", (void*)rbdata, " rcdata: ", (void*)rcdata);
+
+    if(ld) {
+        if(!execute_load(uop, idx, state, radata, rbdata, dependent)) {
+            return false;
+        }
+    } else if(st) {
+        state.reg.rddata = rcdata;
+
+        if(uop.opcode != OP_mf &&
+                !execute_store(uop, radata, rbdata, rcdata)) {
+            return false;
+        }
+    } else if(uop.opcode == OP_ast) {
+        execute_ast(uop, state, radata, rbdata, rcdata);
+    } else {
+        if(isbranch(uop.opcode)) {
+            state.brreg.riptaken = uop.riptaken;
+            state.brreg.ripseq = uop.ripseq;
+            branch_dependent = dependent;
+        }
+
+        synthops[idx](state, radata, rbdata, rcdata, raflags, rbflags,
+                rcflags);
+    }
+
+    /* Check if there was any exception or not */
+    if(uop.opcode != OP_ast && (state.reg.rdflags & FLAG_INV)) {
+        exception = LO32(state.reg.rddata);
+        error_code = HI32(state.reg.rddata);
+
+        if(isclass(uop.opcode, OPCLASS_CHECK) &&
+                (exception == EXCEPTION_SkipBlock)) {
+            chk_recovery_rip = insn_rip + uop.bytes;
+        }
+
+        INTERVALTHLOG1("Found exception in executing uop ", uop);
+        return false;
+    }
+
+    /* Update flags and save dest reg data */
+    if((!ld && !st && uop.setflags) || uop.opcode == OP_ast) {
+        W64 flagmask = setflags_to_x86_flags[uop.setflags];
+
+        if(uop.opcode == OP_ast) {
+            flagmask |= IF_MASK;
+        }
+
+        dest_flags[idx] = (forwarded_flags & ~flagmask) |
+            (state.reg.rdflags & flagmask);
+
+        internal_flags = dest_flags[idx];
+        register_flags[uop.rd] = dest_flags[idx];
+
+        if(!uop.nouserflags) {
+            forwarded_flags = dest_flags[idx];
+            register_flags[REG_flags] = dest_flags[idx];
+        }
+
+        flags_dependent = dependent;
+    }
+
+    dest_values[idx] = state.reg.rddata;
+    if(!ld) {
+        dest_dependent[idx] = dependent;
+    }
+
+    if(!archdest_is_visible[uop.rd]) {
+        write_temp_reg(uop.rd, state.reg.rddata);
+    }
+
+    return true;
+}
+
+/**
+ * @brief Execute light-assist function
+ *
+ * @param uop Assist uop
+ * @param state Issue state to fill
+ */
+void IntervalThread::execute_ast(TransOp& uop, IssueState& state,
+        W64 radata, W64 rbdata, W64 rcdata)
+{
+    W64 assistid = uop.riptaken;
+
+    light_assist_func_t assist_func = light_assistid_to_func[assistid];
+
+    W16 flags = internal_flags;
+    W16 new_flags = flags;
+
+    state.reg.rddata = assist_func(ctx, radata, rbdata, rcdata,
+            flags, flags, flags, new_flags);
+
+    state.reg.rdflags = new_flags;
+
+    lassists[assistid]++;
+}
+
+/**
+ * @brief Execute one load uop
+ *
+ * @param uop Load uop
+ * @param idx Index of the uop in the instruction
+ * @param state Issue state to fill
+ * @param dependent true if the address depends on an outstanding miss
+ *
+ * @return false if the instruction has to be aborted
+ *
+ * The data is always read functionally. The timing access to the L1-D is
+ * sent right away, unless the address depends on an outstanding miss: in
+ * that case the access is queued until the older misses are resolved.
+ */
+bool IntervalThread::execute_load(TransOp& uop, int idx, IssueState& state,
+        W64 radata, W64 rbdata, bool dependent)
+{
+    int op_size = 1 << uop.size;
+    int aligntype = uop.cond;
+
+    W64 virtaddr = (aligntype == LDST_ALIGN_NORMAL) ? (radata + rbdata) :
+        radata;
+    virtaddr = (W64)signext64(virtaddr, 48);
+    virtaddr &= ctx.virt_addr_mask;
+
+    W64 addr = get_phys_address(uop, false, virtaddr);
+
+    /* If access is crossing page boundires, check next page */
+    if unlikely ((lowbits(virtaddr, 12) + (op_size - 1)) >> 12) {
+        get_phys_address(uop, false, virtaddr + (op_size - 1));
+    }
+
+    if(exception) {
+        return false;
+    }
+
+    if(!core.memoryHierarchy->probe_lock(addr & ~(0x3), ctx.cpu_index)) {
+        return false;
+    }
+
+    if(uop.locked) {
+        if(!core.memoryHierarchy->grab_lock(addr & ~(0x3),
+                    ctx.cpu_index)) {
+            return false;
+        }
+        lock_list[lock_count++] = addr;
+    }
+
+    state.reg.rddata = get_load_data(uop, addr, virtaddr);
+    state.reg.rdflags = 0;
+    dest_dependent[idx] = false;
+
+    if(uop.internal) {
+        return true;
+    }
+
+    MissEntry& miss = new_misses[new_miss_count];
+    miss.uuid = fetch_uuid++;
+    miss.addr = addr;
+    miss.rip = insn_rip;
+    miss.seq = dispatch_seq + idx;
+    miss.issued = true;
+
+    if(dependent && (miss_count + new_miss_count) > 0) {
+        miss.issued = false;
+    } else if(access_dcache(addr, insn_rip, Memory::MEMORY_OP_READ,
+                miss.uuid)) {
+        return true;
+    }
+
+    new_miss_count++;
+    dest_dependent[idx] = true;
+
+    return true;
+}
+
+/**
+ * @brief Get data for given address
+ *
+ * @param uop Load uop that requested the data
+ * @param addr Physical address of the load
+ * @param virtaddr Virtual address of the load
+ *
+ * @return data
+ *
+ * Loads the data from RAM and merges the older stores of the same
+ * instruction into it.
+ */
+W64 IntervalThread::get_load_data(TransOp& uop, W64 addr, W64 virtaddr)
+{
+    W64 data = (uop.internal) ? ctx.loadphys(addr, true, uop.size) :
+        ctx.loadvirt(virtaddr, uop.size);
+
+    foreach(i, store_count) {
+        PendingStore& buf = stores[i];
+
+        if(uop.internal || buf.internal) {
+            if(uop.internal && buf.internal && buf.virtaddr == virtaddr) {
+                data = buf.data;
+            }
+            continue;
+        }
+
+        /* Check if the store address and load address overlap */
+        int addr_diff = buf.addr - addr;
+        if(-1 <= (addr_diff >> 3) && (addr_diff >> 3) <= 1) {
+            W64 fwd_data = buf.data;
+            W8  fwd_mask = buf.bytemask;
+            if(addr < buf.addr) {
+                fwd_data <<= (addr_diff * 8);
+                fwd_mask <<= addr_diff;
+            } else {
+                fwd_data >>= (addr_diff * 8);
+                fwd_mask >>= addr_diff;
+            }
+
+            if(fwd_mask == 0) { continue ; }
+
+            W64 sel = expand_8bit_to_64bit_lut[fwd_mask];
+            data = mux64(sel, data, fwd_data);
+        }
+    }
+
+    if(uop.internal) {
+        return data;
+    }
+
+    /* Now extract only requested bytes and signextend if needed */
+    bool signextend = (uop.opcode == OP_ldx);
+
+    return extract_bytes((byte*)&data, uop.size, signextend);
+}
+
+/**
+ * @brief Execute one store uop
+ *
+ * @param uop Store uop
+ *
+ * @return false if the instruction has to be aborted
+ */
+bool IntervalThread::execute_store(TransOp& uop, W64 radata, W64 rbdata,
+        W64 rcdata)
+{
+    int op_size = 1 << uop.size;
+
+    W64 virtaddr = (W64)signext64(radata + rbdata, 48);
+    virtaddr &= ctx.virt_addr_mask;
+
+    W64 addr = get_phys_address(uop, true, virtaddr);
+
+    if unlikely ((lowbits(virtaddr, 12) + (op_size - 1)) >> 12) {
+        get_phys_address(uop, true, virtaddr + (op_size - 1));
+    }
+
+    if(exception) {
+        return false;
+    }
+
+    if(!core.memoryHierarchy->probe_lock(addr & ~(0x3), ctx.cpu_index)) {
+        return false;
+    }
+
+    PendingStore& buf = stores[store_count++];
+    buf.addr = (uop.internal) ? -1 : addr;
+    buf.virtaddr = virtaddr;
+    buf.data = rcdata;
+    buf.bytemask = ((1 << (1 << uop.size))-1);
+    buf.size = uop.size;
+    buf.internal = uop.internal;
+
+    return true;
+}
+
+/**
+ * @brief Generate physical address for given virtual address
+ *
+ * @param uop Load or Store uop
+ * @param is_st Flag to indicate load/store
+ * @param virtaddr Virtual address
+ *
+ * @return Physical address if no exception, else INVALID_PHYSADDR
+ */
+W64 IntervalThread::get_phys_address(TransOp& uop, bool is_st,
+        Waddr virtaddr)
+{
+    int mmio = 0;
+    int exception_t = 0;
+    PageFaultErrorCode pfec = 0;
+
+    W64 physaddr = ctx.check_and_translate(virtaddr, (int)uop.size,
+            is_st, (bool)uop.internal, exception_t, mmio, pfec);
+
+    if(exception_t) {
+        /* Try to handle fault without causing any isse because of ping-pong
+         * effect in the QEMU TLB */
+        bool handled = ctx.try_handle_fault(virtaddr, is_st);
+
+        if(handled) {
+            exception_t = 0;
+            physaddr = ctx.check_and_translate(virtaddr, (int)uop.size,
+                    is_st, (bool)uop.internal, exception_t, mmio, pfec);
+        }
+    }
+
+    if(exception_t) {
+        exception = (is_st) ? EXCEPTION_PageFaultOnWrite :
+            EXCEPTION_PageFaultOnRead;
+        error_code = 0;
+        page_fault_addr = virtaddr;
+
+        INTERVALTHLOG1("Exception ", exception_names[exception], " addr: ",
+                hexstring(page_fault_addr, 48));
+    }
+
+    return ((exception_t) ? INVALID_PHYSADDR : physaddr);
+}
+
+/**
+ * @brief Discard the results of the current instruction
+ *
+ * Flags and memory locks are the only state touched before commit, so
+ * restore the flags from Context and release the locks.
+ */
+void IntervalThread::abort_insn()
+{
+    foreach(i, lock_count) {
+        core.memoryHierarchy->invalidate_lock(lock_list[i] & ~(0x3),
+                ctx.cpu_index);
+    }
+    lock_count = 0;
+
+    forwarded_flags = ctx.reg_flags & (setflags_to_x86_flags[7] | FLAG_IF);
+    internal_flags = forwarded_flags;
+    flags_dependent = miss_dependent[REG_flags];
+
+    setzero(register_flags);
+    register_flags[REG_flags] = ctx.reg_flags;
+}
+
+/**
+ * @brief Write the results of the current instruction to Context
+ *
+ * @param count Number of uops in the instruction
+ */
+void IntervalThread::commit_insn(int count)
+{
+    bool flush_locks = false;
+
+    foreach(i, count) {
+        TransOp& uop = uops[i];
+        bool ld = isload(uop.opcode);
+        bool st = isstore(uop.opcode);
+
+        if(!st && uop.rd != REG_rip && uop.rd != REG_zero) {
+            ctx.set_reg(uop.rd, dest_values[i]);
+
+            W16 reg = archreg_remap_table[uop.rd];
+            miss_dependent[reg] = dest_dependent[i];
+        }
+
+        if(!ld && !st && !uop.nouserflags) {
+            W64 flagmask = setflags_to_x86_flags[uop.setflags];
+
+            if(uop.opcode == OP_ast) {
+                flagmask |= IF_MASK;
+            }
+
+            ctx.reg_flags = (ctx.reg_flags & ~flagmask) |
+                (dest_flags[i] & flagmask);
+        }
+
+        if(uop.opcode == OP_mf && (uop.eom || !uop.som)) {
+            flush_locks = true;
+        }
+
+        st_dispatch.opclass[opclassof(uop.opcode)]++;
+    }
+
+    miss_dependent[REG_flags] = flags_dependent;
+
+    foreach(i, store_count) {
+        PendingStore& buf = stores[i];
+
+        if(buf.internal) {
+            ctx.store_internal(buf.virtaddr, buf.data, buf.bytemask);
+            continue;
+        }
+
+        access_dcache(buf.addr, insn_rip, Memory::MEMORY_OP_WRITE,
+                fetch_uuid++);
+        ctx.storemask_virt(buf.virtaddr, buf.data, buf.bytemask, buf.size);
+    }
+
+    foreach(i, lock_count) {
+        assert(queued_mem_lock_count < 4);
+        queued_mem_lock_list[queued_mem_lock_count++] = lock_list[i];
+    }
+    lock_count = 0;
+
+    if(flush_locks) {
+        flush_mem_locks();
+    }
+
+    foreach(i, new_miss_count) {
+        misses[miss_count++] = new_misses[i];
+
+        if(new_misses[i].issued) {
+            st_long_latency.misses++;
+        } else {
+            st_long_latency.dependent++;
+        }
+    }
+
+    /* Update rip */
+    TransOp& last_uop = uops[count-1];
+    assert(last_uop.eom);
+
+    if(last_uop.rd == REG_rip) {
+        ctx.eip = dest_values[count-1];
+    } else {
+        ctx.eip += last_uop.bytes;
+    }
+
+    bb_transop_index += count;
+    bb_insn_rip = insn_rip + last_uop.bytes;
+
+    dispatch_seq += count;
+    last_commit_cycle = sim_cycle;
+
+    st_commit.insns++;
+    st_commit.uops += count;
+    total_insns_committed++;
+    total_uops_committed += count;
+
+    INTERVALTHLOG2("Commited.. new eip:0x", hexstring(ctx.eip, 48));
+}
+
+/**
+ * @brief Check the branch predictor against the committed instruction
+ *
+ * @param count Number of uops in the instruction
+ *
+ * @return true if the branch of the instruction was mispredicted
+ *
+ * The committed target is known at this point, so the prediction and the
+ * predictor update are done back to back.
+ */
+bool IntervalThread::predict_branch(int count)
+{
+    TransOp& op = uops[count-1];
+
+    if(!isbranch(op.opcode) || isclass(op.opcode, OPCLASS_BARRIER)) {
+        return false;
+    }
+
+    PredictorUpdate predinfo;
+    setzero(predinfo);
+
+    int bptype =
+        (isclass(op.opcode, OPCLASS_COND_BRANCH) <<
+         log2(BRANCH_HINT_COND)) |
+        (isclass(op.opcode, OPCLASS_INDIR_BRANCH) <<
+         log2(BRANCH_HINT_INDIRECT)) |
+        (bit(op.extshift, log2(BRANCH_HINT_PUSH_RAS)) <<
+         log2(BRANCH_HINT_CALL)) |
+        (bit(op.extshift, log2(BRANCH_HINT_POP_RAS)) <<
+         log2(BRANCH_HINT_RET));
+
+    predinfo.uuid = dispatch_seq;
+    predinfo.ctxid = ctx.cpu_index;
+
+    W64 ripafter = insn_rip + op.bytes;
+    W64 predrip = branchpred.predict(predinfo, bptype, ripafter,
+            op.riptaken);
+
+    st_branch_predictions.predictions++;
+
+    /*
+     * Branchpredictor should never give the predicted address in different
+     * address space then rip. If its different, discard it.
+     */
+    if unlikely (bits(insn_rip, 43, (64 - 43)) != bits(predrip, 43, (64-43))) {
+        predrip = op.riptaken;
+    }
+
+    if unlikely (bptype & (BRANCH_HINT_CALL|BRANCH_HINT_RET)) {
+        branchpred.updateras(predinfo, ripafter);
+    }
+
+    branchpred.update(predinfo, ripafter, ctx.eip);
+    st_branch_predictions.updates++;
+
+    if(predrip != ctx.eip) {
+        st_branch_predictions.fail++;
+        return true;
+    }
+
+    return false;
+}
+
+/**
+ * @brief Send a request to the L1-D cache
+ *
+ * @return true on L1 hit
+ */
+bool IntervalThread::access_dcache(Waddr addr, W64 rip, W8 type, W64 uuid)
+{
+    Memory::MemoryRequest *request = core.memoryHierarchy->get_free_request(
+            core.get_coreid());
+    assert(request);
+
+    request->init(core.get_coreid(), threadid, addr, 0,
+            sim_cycle, false, rip, uuid, (Memory::OP_TYPE)type);
+    request->set_coreSignal(&dcache_signal, NULL, -1);
+
+    st_dcache.accesses++;
+    bool hit = core.memoryHierarchy->access_cache(request);
+
+    hit |= config.perfect_cache;
+    if(!hit) {
+        st_dcache.misses++;
+    }
+
+    return hit;
+}
+
+/**
+ * @brief Remove an entry from the outstanding miss queue
+ *
+ * @param idx Index of the entry
+ */
+void IntervalThread::remove_miss(int idx)
+{
+    for(int i = idx; i < miss_count - 1; i++) {
+        misses[i] = misses[i+1];
+    }
+
+    miss_count--;
+
+    if(miss_count == 0) {
+        miss_dependent.reset();
+        flags_dependent = 0;
+    }
+}
+
+/**
+ * @brief Send queued dependent loads whose older misses are resolved
+ *
+ * Also samples the number of outstanding misses for the MLP stats.
+ */
+void IntervalThread::issue_deferred_misses()
+{
+    while(miss_count > 0 && !misses[0].issued) {
+        if(!core.memoryHierarchy->is_cache_available(
+                    core.get_coreid(), threadid, false)) {
+            break;
+        }
+
+        MissEntry& miss = misses[0];
+
+        if(access_dcache(miss.addr, miss.rip, Memory::MEMORY_OP_READ,
+                    miss.uuid)) {
+            remove_miss(0);
+            continue;
+        }
+
+        miss.issued = true;
+        st_long_latency.misses++;
+    }
+
+    int outstanding = 0;
+    foreach(i, miss_count) {
+        outstanding += misses[i].issued;
+    }
+
+    if(outstanding) {
+        st_long_latency.miss_cycles++;
+        st_long_latency.outstanding += outstanding;
+    }
+}
+
+/**
+ * @brief Callback function for dcache access
+ *
+ * @param arg MemoryRequest* containing information of original request
+ *
+ * @return indicating if callback is executed without any issue or not
+ */
+bool IntervalThread::dcache_wakeup(void *arg)
+{
+    MemoryRequest* req = (MemoryRequest*)arg;
+
+    if(req->get_type() == Memory::MEMORY_OP_WRITE) {
+        return true;
+    }
+
+    W64 uuid = req->get_owner_uuid();
+
+    foreach(i, miss_count) {
+        if(misses[i].issued && misses[i].uuid == uuid) {
+            remove_miss(i);
+            break;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief Callback function for icache access
+ *
+ * @param arg MemoryRequest* containing information of original request
+ *
+ * @return indicating if callback is executed without any issue or not
+ */
+bool IntervalThread::icache_wakeup(void *arg)
+{
+    MemoryRequest* req = (MemoryRequest*)arg;
+
+    W64 addr = req->get_physical_address();
+
+    if(waiting_for_icache_miss &&
+            icache_miss_addr == floor(addr, ICACHE_FETCH_GRANULARITY)) {
+        waiting_for_icache_miss = 0;
+        icache_miss_addr = 0;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Handle an Exception in Thread
+ *
+ * @return true if exit to qemu needed
+ */
+bool IntervalThread::handle_exception()
+{
+    INTERVALTHLOG1("handle_exception()");
+    assert(ctx.exception > 0);
+
+    flush_pipeline();
+
+    if(ctx.exception == EXCEPTION_SkipBlock) {
+        ctx.eip = chk_recovery_rip;
+        flush_pipeline();
+        return false;
+    }
+
+    int write_exception = 0;
+
+    switch(ctx.exception) {
+        case EXCEPTION_PageFaultOnRead:
+            write_exception = 0;
+            goto handle_page_fault;
+        case EXCEPTION_PageFaultOnWrite:
+            write_exception = 1;
+            goto handle_page_fault;
+        case EXCEPTION_PageFaultOnExec:
+            write_exception = 2;
+            goto handle_page_fault;
+handle_page_fault:
+            {
+                INTERVALTHLOG1("Page fault: ", exception_names[ctx.exception],
+                        " addr: ", hexstring(ctx.page_fault_addr, 48));
+
+                int old_exception = ctx.exception_index;
+                assert(ctx.page_fault_addr != 0);
+                ctx.handle_interrupt = 1;
+                ctx.handle_page_fault(ctx.page_fault_addr, write_exception);
+
+                flush_pipeline();
+                ctx.exception = 0;
+                ctx.exception_index = old_exception;
+                ctx.exception_is_int = 0;
+                return false;
+            }
+        case EXCEPTION_FloatingPoint:
+            ctx.exception_index = EXCEPTION_x86_fpu;
+            break;
+        case EXCEPTION_FloatingPointNotAvailable:
+            ctx.exception_index = EXCEPTION_x86_fpu_not_avail;
+            break;
+        default:
+            ptl_logfile << "Unsupported internal exception type ",
+                        exception_name(ctx.exception), endl, flush;
+            assert(0);
+    }
+
+    ctx.propagate_x86_exception(ctx.exception_index, ctx.error_code,
+            ctx.page_fault_addr);
+
+    flush_pipeline();
+
+    return false;
+}
+
+/**
+ * @brief Handle interrupt in Thread
+ *
+ * @return true if exit to qemu needed
+ */
+bool IntervalThread::handle_interrupt()
+{
+    ctx.event_upcall();
+    handle_interrupt_at_next_eom = 0;
+
+    INTERVALTHLOG1("Handling interrupt ", ctx.interrupt_request, " exit ",
+            ctx.exit_request, " elfags ", hexstring(ctx.eflags,32),
+            " handle-interrupt ", ctx.handle_interrupt);
+
+    flush_pipeline();
+
+    return true;
+}
+
+/**
+ * @brief Handle internal Barrier instruction
+ *
+ * @return true if exit to qemu needed
+ */
+bool IntervalThread::handle_barrier()
+{
+    int assistid = ctx.eip;
+    assist_func_t assist = (assist_func_t)(Waddr)assistid_to_func[assistid];
+
+    if(assistid == ASSIST_WRITE_CR3) {
+        flush_pipeline();
+    }
+
+    INTERVALTHLOG1("Executing Assist Function ", assist_name(assist));
+
+    bool flush_required = assist(ctx);
+
+    assists[assistid]++;
+
+    if(flush_required) {
+        flush_pipeline();
+    }
+
+    return false;
+}
+
+/**
+ * @brief Flush the thread
+ *
+ * Resets the thread and charges a frontend refill for restarting at the
+ * new rip.
+ */
+void IntervalThread::flush_pipeline()
+{
+    INTERVALTHLOG1("flush_pipeline()");
+
+    reset();
+
+    frontend_stall = FRONTEND_STAGES;
+    frontend_stall_reason = STALL_FLUSH;
+}
+
+/**
+ * @brief Release all Memory cache address locks
+ *
+ * This function is called on commit of OP_mf uops.
+ */
+void IntervalThread::flush_mem_locks()
+{
+    foreach (i, queued_mem_lock_count) {
+        W64 lock_addr = queued_mem_lock_list[i];
+        core.memoryHierarchy->invalidate_lock(lock_addr & ~(0x3),
+                ctx.cpu_index);
+    }
+
+    queued_mem_lock_count = 0;
+}
+
+ostream& IntervalThread::print(ostream& os) const
+{
+    os << "Thread: ", (int)threadid;
+    os << " eip: ", hexstring(ctx.eip, 48);
+    os << " dispatch_seq: ", dispatch_seq;
+    os << " frontend_stall: ", frontend_stall;
+    os << " icache_miss: ", waiting_for_icache_miss, endl;
+
+    os << " Outstanding misses:\n";
+    foreach(i, miss_count) {
+        const MissEntry& miss = misses[i];
+        os << "  [", i, "] uuid: ", miss.uuid, " addr: ",
+           hexstring(miss.addr, 48), " rip: ", hexstring(miss.rip, 48), " seq: ",
+           miss.seq, (miss.issued ? "" : " deferred"), endl;
+    }
+
+    return os;
+}
+
+//---------------------------------------------//
+//   IntervalCore
+//---------------------------------------------//
+
+IntervalCore::IntervalCore(BaseMachine& machine, const char* name)
+    : BaseCore(machine, name)
+{
+    int th_count;
+    if(!machine.get_option(name, "threads", th_count)) {
+        th_count = 1;
+    }
+    threadcount = th_count;
+
+    if(!machine.get_option(name, "branch_resolve_cycles",
+                branch_resolve_cycles)) {
+        branch_resolve_cycles = BRANCH_RESOLVE_CYCLES;
+    }
+
+    threads = (IntervalThread**)qemu_mallocz(
+            threadcount*sizeof(IntervalThread*));
+
+    stringbuf sg_name;
+    sg_name << name << "-run-cycle";
+    run_cycle.set_name(sg_name.buf);
+    run_cycle.connect(signal_mem_ptr(*this, &IntervalCore::runcycle));
+    marss_register_per_cycle_event(&run_cycle);
+
+    foreach(i, threadcount) {
+        Context& ctx = machine.get_next_context();
+
+        IntervalThread* thread = new IntervalThread(*this, i, ctx);
+        threads[i] = thread;
+    }
+
+    reset();
+}
+
+IntervalCore::~IntervalCore()
+{
+}
+
+/**
+ * @brief Simulate one cycle of the core
+ *
+ * Threads share the dispatch width and take turns in being the first to
+ * dispatch. Instructions with more uops than the remaining width are
+ * dispatched anyway and the excess is taken from the next cycles.
+ *
+ * @return true if exit to qemu is needed
+ */
+bool IntervalCore::runcycle(void* none)
+{
+    dispatch_credit = min(dispatch_credit + DISPATCH_WIDTH, DISPATCH_WIDTH);
+
+    INTERVALCORELOG("Cycle: ", sim_cycle);
+
+    foreach(i, threadcount) {
+        IntervalThread* thread = threads[add_index_modulo(next_thread, i,
+                threadcount)];
+
+        thread->handle_interrupt_at_next_eom = thread->ctx.check_events();
+
+        if(thread->ctx.kernel_mode) {
+            thread->set_default_stats(kernel_stats);
+        } else {
+            thread->set_default_stats(user_stats);
+        }
+
+        thread->st_cycles++;
+
+        thread->issue_deferred_misses();
+
+        if(thread->dispatch(dispatch_credit) == DISPATCH_EXIT) {
+            INTERVALCORELOG("Exit to qemu requested");
+            machine.ret_qemu_env = &thread->ctx;
+            return true;
+        }
+    }
+
+    next_thread = add_index_modulo(next_thread, +1, threadcount);
+
+    return false;
+}
+
+/**
+ * @brief Reset the core and its threads
+ */
+void IntervalCore::reset()
+{
+    foreach(i, threadcount) {
+        threads[i]->reset();
+    }
+
+    next_thread = 0;
+    dispatch_credit = DISPATCH_WIDTH;
+}
+
+/**
+ * @brief Flush a Context specific TLB entries
+ *
+ * The interval core doesn't model TLBs, translation is done through the
+ * Context at dispatch.
+ */
+void IntervalCore::flush_tlb(Context& ctx)
+{
+}
+
+void IntervalCore::flush_tlb_virt(Context& ctx, Waddr virtaddr)
+{
+}
+
+void IntervalCore::dump_state(ostream& os)
+{
+    os << *this;
+}
+
+void IntervalCore::update_stats()
+{
+}
+
+/**
+ * @brief Flush all threads
+ */
+void IntervalCore::flush_pipeline()
+{
+    foreach(i, threadcount) {
+        threads[i]->flush_pipeline();
+    }
+
+    dispatch_credit = DISPATCH_WIDTH;
+}
+
+/**
+ * @brief Call CPU Context for changes in IP and flush pipeline if needed
+ */
+void IntervalCore::check_ctx_changes()
+{
+    foreach(i, threadcount) {
+        threads[i]->ctx.handle_interrupt = 0;
+
+        if(threads[i]->ctx.eip != threads[i]->ctx.old_eip) {
+            // IP Address has changed, so flush the pipeline
+            INTERVALCORELOG("Thread flush old_eip: ",
+                    hexstring(threads[i]->ctx.old_eip, 48), " new-eip: ",
+                    hexstring(threads[i]->ctx.eip, 48));
+            threads[i]->flush_pipeline();
+        }
+    }
+}
+
+ostream& IntervalCore::print(ostream& os) const
+{
+    os << "Interval-Core: ", int(get_coreid()), endl;
+    os << " Dispatch credit: ", dispatch_credit, endl;
+
+    foreach(i, threadcount) {
+        os << *threads[i], endl;
+    }
+
+    return os;
+}
+
+/**
+ * @brief Dump Interval core configuration
+ *
+ * @param out YAML object to dump configuration parameters
+ */
+void IntervalCore::dump_configuration(YAML::Emitter &out) const
+{
+    out << YAML::Key << get_name();
+    out << YAML::Value << YAML::BeginMap;
+
+    YAML_KEY_VAL(out, "type", "core");
+    YAML_KEY_VAL(out, "model", "interval");
+    YAML_KEY_VAL(out, "threads", threadcount);
+    YAML_KEY_VAL(out, "dispatch_width", DISPATCH_WIDTH);
+    YAML_KEY_VAL(out, "rob_size", ROB_SIZE);
+    YAML_KEY_VAL(out, "frontend_stages", FRONTEND_STAGES);
+    YAML_KEY_VAL(out, "branch_resolve_cycles", branch_resolve_cycles);
+    YAML_KEY_VAL(out, "miss_queue_size", MISS_QUEUE_SIZE);
+
+    out << YAML::EndMap;
+}
+
+IntervalCoreBuilder::IntervalCoreBuilder(const char* name)
+    : CoreBuilder(name)
+{
+}
+
+BaseCore* IntervalCoreBuilder::get_new_core(BaseMachine& machine,
+        const char* name)
+{
+    IntervalCore* core = new IntervalCore(machine, name);
+    return core;
+}
+
+namespace INTERVAL_CORE_MODEL {
+    IntervalCoreBuilder intervalBuilder(INTERVAL_CORE_NAME);
+};
@@ -0,0 +1,401 @@
+/*
+ * MARSSx86 : A Full System Computer-Architecture Simulator
+ *
+ * This code is released under GPL.
+ *
+ */
+
+#ifndef MARSS_INTERVAL_CORE_H
+#define MARSS_INTERVAL_CORE_H
+
+#include <basecore.h>
+#include <branchpred.h>
+#include <decode.h>
+
+#include <statsBuilder.h>
+
+#include <interval-const.h>
+
+/* Logging Macros */
+// Base Logging Level
+#define INTERVAL_BASE_LL 5
+
+#define INTERVALLOG1(...) if(logable(INTERVAL_BASE_LL)) { ptl_logfile << __VA_ARGS__ ; }
+#define INTERVALLOG2(...) if(logable(INTERVAL_BASE_LL+1)) { ptl_logfile << __VA_ARGS__ ; }
+
+#define INTERVALCORELOG(...) INTERVALLOG1("Core:", get_coreid(), " ", \
+        __VA_ARGS__, endl)
+#define INTERVALTHLOG1(...) INTERVALLOG1("Core:", core.get_coreid(), \
+        " Th:", threadid, " ", __VA_ARGS__, endl)
+#define INTERVALTHLOG2(...) INTERVALLOG2("Core:", core.get_coreid(), \
+        " Th:", threadid, " ", __VA_ARGS__, endl)
+
+/*
+ * Interval core model
+ *
+ * This core does not model individual pipeline stages. It executes the
+ * uops of each x86 instruction functionally at dispatch and accounts for
+ * time with an interval model: instructions flow through the core at the
+ * dispatch width until a miss event disrupts the flow. Three kinds of miss
+ * events are modeled:
+ *
+ *  - I-Cache misses stall dispatch until the line is returned.
+ *  - Branch mispredictions stall dispatch for the branch resolution time
+ *    plus the frontend refill time.
+ *  - L1-D load misses don't stall dispatch directly. Dispatch continues
+ *    until the reorder window behind the oldest outstanding miss is full,
+ *    so independent misses in the window overlap (memory level
+ *    parallelism). Loads whose address depends on an outstanding miss are
+ *    serialized behind it.
+ *
+ * Compared to the ooo core, issue queue and functional unit contention,
+ * load/store queue ordering, TLB misses and wrong-path execution are not
+ * modeled, and dependences between instructions only matter through
+ * outstanding misses. IPC of compute bound code with long dependence
+ * chains is overestimated, and programs dominated by the three miss
+ * events above track the ooo core best. In exchange there is no
+ * per-uop pipeline state to update each cycle, so simulation is faster
+ * than ooo. The model has not been calibrated against ooo for any machine
+ * in config/; run both on a representative slice of the workload before
+ * trusting absolute numbers from this core.
+ */
+namespace INTERVAL_CORE_MODEL {
+
+    using namespace superstl;
+    using namespace Core;
+
+    /* Constants */
+    const int DISPATCH_WIDTH = INTERVAL_DISPATCH_WIDTH;
+
+    const int ROB_SIZE = INTERVAL_ROB_SIZE;
+
+    const int FRONTEND_STAGES = INTERVAL_FRONTEND_STAGES;
+
+    const int BRANCH_RESOLVE_CYCLES = INTERVAL_BRANCH_RESOLVE_CYCLES;
+
+    const int MISS_QUEUE_SIZE = INTERVAL_MISS_QUEUE_SIZE;
+
+    const int MAX_UOPS_PER_INSN = MAX_TRANSOPS_PER_USER_INSN;
+
+    const W8 ICACHE_FETCH_GRANULARITY = 16;
+
+    enum {
+        DISPATCH_OK = 0,    // Instruction dispatched
+        DISPATCH_STALL,     // Dispatch stopped for this cycle
+        DISPATCH_EXIT,      // Exit to QEMU requested
+    };
+
+    enum {
+        STALL_ICACHE = 0,
+        STALL_MISPREDICT,
+        STALL_MISS_RESOLVE,
+        STALL_ROB_FULL,
+        STALL_MISS_QUEUE_FULL,
+        STALL_CACHE_BUSY,
+        STALL_MEM_LOCK,
+        STALL_FLUSH,
+        NUM_STALL_REASONS
+    };
+
+    static const char* stall_names[NUM_STALL_REASONS] = {
+        "icache", "mispredict", "miss_resolve", "rob_full",
+        "miss_queue_full", "cache_busy", "mem_lock", "flush",
+    };
+
+    struct IntervalCore;
+
+    /**
+     * @brief Store of the instruction being dispatched
+     *
+     * Stores are buffered until all uops of the instruction have executed
+     * and written to memory when the instruction commits.
+     */
+    struct PendingStore {
+        W64  addr;
+        W64  virtaddr;
+        W64  data;
+        W8   bytemask;
+        W8   size;
+        bool internal;
+    };
+
+    /**
+     * @brief Outstanding L1-D load miss
+     *
+     * 'seq' is the dispatch sequence number of the load, used to find when
+     * the reorder window behind the miss is full. Loads that depend on an
+     * outstanding miss are queued with 'issued' cleared and sent to the
+     * cache once all older misses are resolved.
+     */
+    struct MissEntry {
+        W64  uuid;
+        W64  addr;
+        W64  rip;
+        W64  seq;
+        bool issued;
+    };
+
+    /**
+     * @brief A hardware thread of the interval core
+     */
+    struct IntervalThread : public Statable {
+        IntervalThread(IntervalCore& core, W8 threadid, Context& ctx);
+
+        void reset();
+
+        int  dispatch(int& width);
+        int  dispatch_insn(int& width);
+        bool fetch_check_current_bb();
+        bool fetch_from_icache();
+        bool window_full(int count);
+
+        bool execute_insn(int count);
+        bool execute_uop(int idx);
+        void execute_ast(TransOp& uop, IssueState& state, W64 radata,
+                W64 rbdata, W64 rcdata);
+        bool execute_load(TransOp& uop, int idx, IssueState& state,
+                W64 radata, W64 rbdata, bool dependent);
+        bool execute_store(TransOp& uop, W64 radata, W64 rbdata,
+                W64 rcdata);
+        W64  get_phys_address(TransOp& uop, bool is_st, Waddr virtaddr);
+        W64  get_load_data(TransOp& uop, W64 addr, W64 virtaddr);
+        void abort_insn();
+        void commit_insn(int count);
+        bool predict_branch(int count);
+
+        bool access_dcache(Waddr addr, W64 rip, W8 type, W64 uuid);
+        void issue_deferred_misses();
+        void remove_miss(int idx);
+
+        bool dcache_wakeup(void *arg);
+        bool icache_wakeup(void *arg);
+
+        bool handle_exception();
+        bool handle_interrupt();
+        bool handle_barrier();
+        void flush_pipeline();
+        void flush_mem_locks();
+
+        int  find_producer(W16 reg, int idx);
+        bool source_dependent(W16 reg, int idx);
+        void write_temp_reg(W16 reg, W64 data);
+        W64  read_reg(W16 reg, int idx);
+
+        ostream& print(ostream& os) const;
+
+        W8  threadid;
+        W64 fetch_uuid;
+        W64 dispatch_seq;
+        W64 last_commit_cycle;
+
+        IntervalCore& core;
+        Context&      ctx;
+
+        BasicBlock* current_bb;
+        RIPVirtPhys fetchrip;
+        W8          bb_transop_index;
+        W64         bb_insn_rip;
+
+        bool  waiting_for_icache_miss;
+        W64   current_icache_block;
+        Waddr icache_miss_addr;
+        bool  itlb_exception;
+        W64   itlb_exception_addr;
+
+        /* Miss event state */
+        int  frontend_stall;
+        int  frontend_stall_reason;
+        bool wait_for_miss_resolve;
+        int  stall_reason;
+
+        MissEntry misses[MISS_QUEUE_SIZE];
+        int       miss_count;
+
+        /*
+         * Registers whose value depends on an outstanding load miss.
+         * Cleared once all outstanding misses are resolved.
+         */
+        bitvec<TRANSREG_COUNT> miss_dependent;
+        bool                   flags_dependent;
+
+        BranchPredictorInterface branchpred;
+
+        bool handle_interrupt_at_next_eom;
+
+        W16 forwarded_flags;
+        W16 internal_flags;
+        W16 register_flags[TRANSREG_COUNT];
+        W64 temp_registers[11];
+        W64 chk_recovery_rip;
+
+        W8  queued_mem_lock_count;
+        W64 queued_mem_lock_list[4];
+
+        /* State of the instruction being dispatched */
+        TransOp        uops[MAX_UOPS_PER_INSN];
+        uopimpl_func_t synthops[MAX_UOPS_PER_INSN];
+        W64            dest_values[MAX_UOPS_PER_INSN];
+        W16            dest_flags[MAX_UOPS_PER_INSN];
+        bool           dest_dependent[MAX_UOPS_PER_INSN];
+        PendingStore   stores[MAX_UOPS_PER_INSN];
+        MissEntry      new_misses[MAX_UOPS_PER_INSN];
+        W64            lock_list[MAX_UOPS_PER_INSN];
+        W64            insn_rip;
+        int            store_count;
+        int            new_miss_count;
+        int            lock_count;
+        bool           branch_dependent;
+        W32            exception;
+        W32            error_code;
+        W64            page_fault_addr;
+
+        /*
+         * Cache Access
+         */
+        Signal dcache_signal;
+        Signal icache_signal;
+
+        /* Stats Collection */
+        struct st_dispatch : public Statable
+        {
+            StatObj<W64> bbs;
+
+            StatArray<W64, OPCLASS_COUNT> opclass;
+            StatArray<W64, DISPATCH_WIDTH+1> width;
+            StatArray<W64, NUM_STALL_REASONS> stall;
+
+            st_dispatch(Statable *parent)
+                : Statable("dispatch", parent)
+                  , bbs("bbs", this)
+                  , opclass("opclass", this, opclass_names)
+                  , width("width", this)
+                  , stall("stall", this, stall_names)
+            {}
+        } st_dispatch;
+
+        struct st_commit : public Statable
+        {
+            StatObj<W64> insns;
+            StatObj<W64> uops;
+
+            StatEquation<W64, double, StatObjFormulaDiv> ipc;
+            StatEquation<W64, double, StatObjFormulaDiv> uipc;
+
+            st_commit(Statable *parent)
+                : Statable("commit", parent)
+                  , insns("insns", this)
+                  , uops("uops", this)
+                  , ipc("ipc", this)
+                  , uipc("uipc", this)
+            {
+                ipc.enable_summary();
+            }
+        } st_commit;
+
+        struct st_branch_predictions : public Statable
+        {
+            StatObj<W64> predictions;
+            StatObj<W64> updates;
+            StatObj<W64> fail;
+
+            st_branch_predictions(Statable *parent)
+                : Statable("branch_predictions", parent)
+                  , predictions("predictions", this)
+                  , updates("updates", this)
+                  , fail("fail", this)
+            {}
+        } st_branch_predictions;
+
+        struct cache_access : public Statable
+        {
+            StatObj<W64> accesses;
+            StatObj<W64> misses;
+
+            StatEquation<W64, double, StatObjFormulaDiv> miss_ratio;
+
+            cache_access(const char* name, Statable *parent)
+                : Statable(name, parent)
+                  , accesses("accesses", this)
+                  , misses("misses", this)
+                  , miss_ratio("miss_ratio", this)
+            {}
+        };
+
+        cache_access st_dcache, st_icache;
+
+        struct st_long_latency : public Statable
+        {
+            StatObj<W64> misses;
+            StatObj<W64> dependent;
+            StatObj<W64> miss_cycles;
+            StatObj<W64> outstanding;
+
+            StatEquation<W64, double, StatObjFormulaDiv> mlp;
+
+            st_long_latency(Statable *parent)
+                : Statable("long_latency", parent)
+                  , misses("misses", this)
+                  , dependent("dependent", this)
+                  , miss_cycles("miss_cycles", this)
+                  , outstanding("outstanding", this)
+                  , mlp("mlp", this)
+            {}
+        } st_long_latency;
+
+        StatObj<W64> st_cycles;
+
+        StatArray<W64, ASSIST_COUNT> assists;
+        StatArray<W64, L_ASSIST_COUNT> lassists;
+    };
+
+    static inline ostream& operator <<(ostream& os, const IntervalThread& th)
+    {
+        return th.print(os);
+    }
+
+    struct IntervalCore : public BaseCore {
+
+        IntervalCore(BaseMachine& machine, const char* name=NULL);
+        ~IntervalCore();
+
+        void reset();
+        bool runcycle(void*);
+        void check_ctx_changes();
+        void flush_tlb(Context& ctx);
+        void flush_tlb_virt(Context& ctx, Waddr virtaddr);
+        void dump_state(ostream& os);
+        void update_stats();
+        void flush_pipeline();
+        void dump_configuration(YAML::Emitter &out) const;
+
+        ostream& print(ostream& os) const;
+
+        W8  threadcount;
+        W8  next_thread;
+        int dispatch_credit;
+
+        /*
+         * Misprediction penalty before the frontend refill, set with the
+         * 'branch_resolve_cycles' core option. Defaults to
+         * BRANCH_RESOLVE_CYCLES.
+         */
+        int branch_resolve_cycles;
+
+        IntervalThread** threads;
+
+        Signal run_cycle;
+    };
+
+    static inline ostream& operator <<(ostream& os, const IntervalCore& core)
+    {
+        return core.print(os);
+    }
+
+    struct IntervalCoreBuilder : public CoreBuilder {
+        IntervalCoreBuilder(const char* name);
+        BaseCore* get_new_core(BaseMachine& machine, const char* name);
+    };
+
+};
+
+#endif // MARSS_INTERVAL_CORE_H
@@ -196,6 +196,9 @@ namespace OOO_CORE_MODEL {
     const int FETCH_QUEUE_SIZE = OOO_FETCH_Q_SIZE;
     const int FETCH_WIDTH = OOO_FETCH_WIDTH;
 
+    /* Entries in the per-thread next basic block cache (power of 2) */
+    const int NEXT_BLOCK_CACHE_SIZE = 64;
+
     /*
      * Frontend (Rename and Decode)
      */
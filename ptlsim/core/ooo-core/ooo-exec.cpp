@@ -57,6 +57,7 @@ void IssueQueue<size, operandcount>::reset(W8 coreid, OooCore* core_) {
 
     OooCore& core = getcore();
 
+    capacity = min(size, core.iq_size);
     count = 0;
     valid = 0;
     issued = 0;
@@ -652,6 +653,7 @@ int ReorderBufferEntry::issue() {
 
             if unlikely (mispredicted) {
 
+                sample_flags |= SAMPLE_FLAG_MISPRED;
                 thread.thread_stats.branchpred.summary[MISPRED]++;
                 thread.thread_stats.branchpred.ret[MISPRED]+=ret;
                 thread.thread_stats.branchpred.indir[MISPRED]+= (indir & !ret) ;
@@ -1908,6 +1910,7 @@ bool ReorderBufferEntry::probetlb(LoadStoreQueueEntry& state, Waddr& origaddr, W
         changestate(thread.rob_tlb_miss_list);
         tlb_miss_init_cycle = sim_cycle;
         tlb_walk_level = thread.ctx.page_table_level_count();
+        sample_flags |= SAMPLE_FLAG_TLB_MISS;
         thread.thread_stats.dcache.dtlb.misses++;
 
         return false;
@@ -2092,8 +2095,8 @@ rob_cont:
  */
 void ThreadContext::tlbwalk() {
 
-    ReorderBufferEntry* rob;
-    foreach_list_mutable(rob_tlb_miss_list, rob, entry, nextentry) {
+    foreach_slot_by_age(rob_tlb_miss_list, ROB.head, idx) {
+        ReorderBufferEntry* rob = &ROB[idx];
         rob->tlbwalk();
         // logfuncwith(rob->tlbwalk(), 6);
     }
@@ -2228,6 +2231,9 @@ bool OooCore::dcache_wakeup(void *arg) {
         return true;
     }
 
+    if unlikely (sleeping)
+        wakeup_pending = 1;
+
     int idx = request->get_robid();
     W64 physaddr = request->get_physical_address();
     ThreadContext* thread = threads[request->get_threadid()];
@@ -2239,6 +2245,14 @@ bool OooCore::dcache_wakeup(void *arg) {
             rob.current_state_list == &thread->rob_cache_miss_list){
         if(logable(6)) ptl_logfile << " rob ", rob, endl;
 
+        W8 missed = request->get_miss_mask();
+        rob.sample_flags |=
+            (bit(missed, Memory::L1_D_CACHE) ? SAMPLE_FLAG_L1_MISS : 0) |
+            (bit(missed, Memory::L2_CACHE) ? SAMPLE_FLAG_L2_MISS : 0) |
+            (bit(missed, Memory::L3_CACHE) ? SAMPLE_FLAG_L3_MISS : 0) |
+            (bit(missed, Memory::MAIN_MEMORY) ? SAMPLE_FLAG_DRAM : 0);
+        rob.mem_latency = sim_cycle - request->get_init_cycles();
+
         /*
          * Because of QEMU's in-order execution and Simulator's
          * out-of-order execution we may have page fault at this point
@@ -2866,6 +2880,7 @@ W64 ReorderBufferEntry::annul(bool keep_misspec_uop, bool return_first_annulled_
         ROB.annul(annulrob);
         annulrob.changestate(thread.rob_free_list);
         annulcount++;
+        thread.thread_stats.topdown.bad_speculation.annulled++;
 
         if (idx == startidx) break;
         idx = add_index_modulo(idx, -1, ROB_SIZE);
@@ -2880,7 +2895,6 @@ W64 ReorderBufferEntry::annul(bool keep_misspec_uop, bool return_first_annulled_
  * @brief Re-dispatch specified ROB entries
  *
  * @param dependent_operands List of operands that are found 'dependent'
- * @param prevrob Pointer to previous ROB entry
  *
  * Return the specified uop back to the ready_to_dispatch state.
  * All structures allocated to the uop are reset to the same state
@@ -2898,11 +2912,10 @@ W64 ReorderBufferEntry::annul(bool keep_misspec_uop, bool return_first_annulled_
  * consumers must also be re-dispatched. The redispatch_dependents()
  * function automatically does this.
  *
- * The <prevrob> argument should be the previous ROB, in program
- * order, before this one. If this is the first ROB being
- * re-dispatched, <prevrob> should be NULL.
+ * Dispatch visits ready uops oldest first, so re-dispatched uops keep
+ * their program order.
  */
-void ReorderBufferEntry::redispatch(const bitvec<MAX_OPERANDS>& dependent_operands, ReorderBufferEntry* prevrob) {
+void ReorderBufferEntry::redispatch(const bitvec<MAX_OPERANDS>& dependent_operands) {
     OooCore& core = getcore();
     ThreadContext& thread = getthread();
 
@@ -2970,7 +2983,7 @@ void ReorderBufferEntry::redispatch(const bitvec<MAX_OPERANDS>& dependent_operan
     cycles_left = 0;
     forward_cycle = 0;
     load_store_second_phase = 0;
-    changestate(thread.rob_ready_to_dispatch_list, true, prevrob);
+    changestate(thread.rob_ready_to_dispatch_list);
 }
 
 /**
@@ -2997,8 +3010,6 @@ void ReorderBufferEntry::redispatch_dependents(bool inclusive) {
 
     int count = 0;
 
-    ReorderBufferEntry* prevrob = NULL;
-
     foreach_forward_from(ROB, this, robidx) {
         ReorderBufferEntry& reissuerob = ROB[robidx];
 
@@ -3031,8 +3042,7 @@ void ReorderBufferEntry::redispatch_dependents(bool inclusive) {
         if unlikely (dep) {
             count++;
             depmap[reissuerob.index()] = 1;
-            reissuerob.redispatch(dependent_operands, prevrob);
-            prevrob = &reissuerob;
+            reissuerob.redispatch(dependent_operands);
         }
     }
 
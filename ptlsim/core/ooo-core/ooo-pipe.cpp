@@ -45,6 +45,10 @@ bool OooCore::icache_wakeup(void *arg) {
 
     W64 physaddr = request->get_physical_address();
     if(logable(99)) ptl_logfile << " icache_wakeup addr ", (void*) physaddr, endl;
+
+    if unlikely (sleeping)
+        wakeup_pending = 1;
+
     foreach (i, threadcount) {
         ThreadContext* thread = threads[i];
         if unlikely (thread
@@ -188,6 +192,7 @@ static W32 phys_reg_files_writable_by_uop(const TransOp& uop) {
         ((c & OPCLASS_FP) |
          inrange((int)uop.rd, REG_xmml0, REG_xmmh15) |
          inrange((int)uop.rd, REG_mmx0, REG_mmx7) |
+         inrange((int)uop.rd, REG_ymmhl0, REG_ymmhh15) |
          inrange((int)uop.rd, REG_fptos, REG_ctx)) ?
         OooCore::PHYS_REG_FILE_MASK_FP : OooCore::PHYS_REG_FILE_MASK_INT;
 #endif
@@ -235,6 +240,8 @@ void ThreadContext::flush_pipeline() {
 
     core.machine.memoryHierarchyPtr->flush(core.get_coreid());
 
+    thread_stats.topdown.bad_speculation.machine_clears += (W64)ROB.count;
+
     annul_fetchq();
 
     foreach_forward(ROB, i) {
@@ -248,27 +255,24 @@ void ThreadContext::flush_pipeline() {
 
         flush_mem_lock_release_list();
         rob.physreg->reset(threadid); /* free all register allocated by rob */
+
+        /* Charge its miss stall slots, ROB.reset() below drops them */
+        rob.reset();
     }
 
     /* free all register in arch state: */
     foreach (i, PHYS_REG_FILE_COUNT){
         StateList& list = core.physregfiles[i].states[PHYSREG_ARCH];
-        PhysicalRegister* obj;
-        int n = 0;
-        foreach_list_mutable( list, obj, entry, nextentry) {
-            n++;
-            obj->reset(threadid);
+        foreach_slot(list, idx) {
+            core.physregfiles[i][idx].reset(threadid);
         }
     }
 
     /* free all register in arch state: */
     foreach (i, PHYS_REG_FILE_COUNT){
         StateList& list = core.physregfiles[i].states[PHYSREG_PENDINGFREE];
-        PhysicalRegister* obj;
-        int n = 0;
-        foreach_list_mutable( list, obj, entry, nextentry) {
-            n++;
-            obj->reset(threadid);
+        foreach_slot(list, idx) {
+            core.physregfiles[i][idx].reset(threadid);
         }
     }
 
@@ -319,6 +323,7 @@ void ThreadContext::reset_fetch_unit(W64 realrip) {
     fetchrip = realrip;
     fetchrip.update(ctx);
     stall_frontend = 0;
+    resteer = 1;
     waiting_for_icache_fill = 0;
     itlb_walk_level = 0;
     fetchq.reset();
@@ -370,7 +375,8 @@ void ThreadContext::external_to_core_state() {
 #ifdef UNIFIED_INT_FP_PHYS_REG_FILE
         int rfid = (i == REG_rip) ? PHYS_REG_FILE_BR : PHYS_REG_FILE_INT;
 #else
-        bool fp = inrange((int)i, REG_xmml0, REG_xmmh15) | (inrange((int)i, REG_fptos, REG_ctx)) | (inrange((int)i, REG_mmx0, REG_mmx1));
+        bool fp = inrange((int)i, REG_xmml0, REG_xmmh15) | (inrange((int)i, REG_fptos, REG_ctx)) | (inrange((int)i, REG_mmx0, REG_mmx1)) |
+            inrange((int)i, REG_ymmhl0, REG_ymmhh15);
         int rfid = (fp) ? core.PHYS_REG_FILE_FP : (i == REG_rip) ? core.PHYS_REG_FILE_BR : core.PHYS_REG_FILE_INT;
 #endif
         PhysicalRegisterFile& rf = core.physregfiles[rfid];
@@ -458,7 +464,6 @@ void ThreadContext::redispatch_deadlock_recovery() {
     // deadlock-free operation in every configuration.
     //
 
-    ReorderBufferEntry* prevrob = NULL;
     bitvec<MAX_OPERANDS> noops = 0;
 
     foreach_forward(ROB, robidx) {
@@ -473,8 +478,7 @@ void ThreadContext::redispatch_deadlock_recovery() {
     bool recovery_required = 1; // for now, just to be safe
 
     if (recovery_required) {
-    rob.redispatch(noops, prevrob);
-    prevrob = &rob;
+    rob.redispatch(noops);
     per_context_ooocore_stats_update(threadid, dispatch.redispatch.deadlock_uops_flushed++);
     }
     }
@@ -521,8 +525,13 @@ bool ThreadContext::fetch() {
         return true;
     }
 
+    if unlikely (halted()) {
+        thread_stats.fetch.stop.halted++;
+        return true;
+    }
+
     while ((fetchcount < FETCH_WIDTH) && (taken_branch_count == 0)) {
-        if unlikely (!fetchq.remaining()) {
+        if unlikely (fetchq.count >= core.fetchq_size) {
             thread_stats.fetch.stop.fetchq_full++;
             break;
         }
@@ -767,20 +776,53 @@ bool ThreadContext::fetch() {
  */
 BasicBlock* ThreadContext::fetch_or_translate_basic_block(const RIPVirtPhys& rvp) {
 
-    if likely (current_basic_block) {
+    BasicBlockCache& cache = bbcache[ctx.cpu_index];
+    BasicBlock* prev = current_basic_block;
+    NextBlockEntry* next = NULL;
+    BasicBlock* bb = NULL;
+
+    if likely (prev) {
+        next = &next_block_cache[next_block_slot(prev,
+                rvp.rip != prev->rip_not_taken)];
+
+        thread_stats.fetch.next_block.lookups++;
+        if likely (next->from == prev &&
+                next->generation == cache.generation &&
+                next->to->rip.rip == rvp.rip &&
+                next->to->rip.use64 == rvp.use64 &&
+                next->to->rip.kernel == rvp.kernel &&
+                next->to->rip.df == rvp.df) {
+            bb = next->to;
+            thread_stats.fetch.next_block.hits++;
+        }
+
         /* Release our ref to the old basic block being fetched */
-        current_basic_block->release();
+        prev->release();
         current_basic_block = NULL;
     }
 
-    BasicBlock* bb = bbcache[ctx.cpu_index](rvp);
-
     if likely (bb) {
         current_basic_block = bb;
     } else {
-        current_basic_block = bbcache[ctx.cpu_index].translate(ctx, rvp);
-        if (current_basic_block == NULL) return NULL;
-        assert(current_basic_block);
+        bb = cache(rvp);
+
+        if likely (bb) {
+            current_basic_block = bb;
+        } else {
+            current_basic_block = cache.translate(ctx, rvp);
+            if (current_basic_block == NULL) return NULL;
+            assert(current_basic_block);
+        }
+
+        /*
+         * Translation may have reclaimed the previous block, but the
+         * entry can still be filled: hits only dereference 'to'.
+         */
+        if likely (next) {
+            next->from = prev;
+            next->to = current_basic_block;
+            next->generation = cache.generation;
+        }
     }
 
      /*
@@ -807,15 +849,18 @@ BasicBlock* ThreadContext::fetch_or_translate_basic_block(const RIPVirtPhys& rvp
 void ThreadContext::rename() {
 
     int prepcount = 0;
+    int stall = RENAME_STALL_NONE;
 
     while (prepcount < FRONTEND_WIDTH) {
         if unlikely (fetchq.empty()) {
             thread_stats.frontend.status.fetchq_empty++;
+            stall = RENAME_STALL_FETCHQ_EMPTY;
             break;
         }
 
-        if unlikely (!ROB.remaining()) {
+        if unlikely (ROB.count >= core.rob_size) {
             thread_stats.frontend.status.rob_full++;
+            stall = RENAME_STALL_ROB_FULL;
             break;
         }
 
@@ -834,6 +879,7 @@ void ThreadContext::rename() {
 
         if (phys_reg_file < 0) {
             thread_stats.frontend.status.physregs_full++;
+            stall = RENAME_STALL_PHYSREGS_FULL;
             break;
         }
 
@@ -841,17 +887,20 @@ void ThreadContext::rename() {
         bool st = isstore(fetchbuf.opcode);
         bool br = isbranch(fetchbuf.opcode);
 
-        if unlikely (ld && (loads_in_flight >= LDQ_SIZE)) {
+        if unlikely (ld && (loads_in_flight >= core.ldq_size)) {
             thread_stats.frontend.status.ldq_full++;
+            stall = RENAME_STALL_LSQ_FULL;
             break;
         }
 
-        if unlikely (st && (stores_in_flight >= STQ_SIZE)) {
+        if unlikely (st && (stores_in_flight >= core.stq_size)) {
             thread_stats.frontend.status.stq_full++;
+            stall = RENAME_STALL_LSQ_FULL;
             break;
         }
 
         if unlikely ((ld|st) && (!LSQ.remaining())) {
+            stall = RENAME_STALL_LSQ_FULL;
             break;
         }
 
@@ -868,6 +917,7 @@ void ThreadContext::rename() {
         rob.uop = transop;
         rob.entry_valid = 1;
         rob.cycles_left = FRONTEND_STAGES;
+        rob.rename_cycle = sim_cycle;
         rob.lsq = NULL;
         if unlikely (ld|st) {
             rob.lsq = &lsq;
@@ -1021,6 +1071,84 @@ void ThreadContext::rename() {
     }
 
     thread_stats.frontend.width[prepcount]++;
+    account_rename_slots(prepcount, stall);
+}
+
+/**
+ * @brief Top-down accounting of this cycle's rename slots
+ *
+ * @param renamed Number of uops renamed this cycle
+ * @param stall Reason rename stopped, RENAME_STALL_*
+ *
+ * Renamed slots are counted as retiring or annulled when their uops leave
+ * the ROB, so only the empty slots are classified here.
+ */
+void ThreadContext::account_rename_slots(int renamed, int stall) {
+    if unlikely (ctx.halted) return;
+
+    TopDownStats& topdown = thread_stats.topdown;
+    W64 empty = FRONTEND_WIDTH - renamed;
+
+    topdown.slots += (W64)FRONTEND_WIDTH;
+
+    if (renamed) resteer = 0;
+    if (!empty) return;
+
+    if (stall == RENAME_STALL_FETCHQ_EMPTY) {
+        if (resteer)
+            topdown.bad_speculation.resteer += empty;
+        else if (itlb_walk_level > 0)
+            topdown.frontend.itlb += empty;
+        else if (waiting_for_icache_fill)
+            topdown.frontend.icache += empty;
+        else
+            topdown.frontend.other += empty;
+        return;
+    }
+
+    /* Backend bound: look at what holds up the oldest uop first */
+    if likely (!ROB.empty()) {
+        ReorderBufferEntry& head = ROB[ROB.head];
+
+        if (head.current_state_list == &rob_cache_miss_list) {
+            head.stall_slots += empty;
+            return;
+        }
+
+        if (head.current_state_list == &rob_tlb_miss_list) {
+            topdown.backend.memory.dtlb += empty;
+            return;
+        }
+
+        if (head.current_state_list == &rob_ready_to_commit_queue &&
+                isstore(head.uop.opcode)) {
+            topdown.backend.memory.store += empty;
+            return;
+        }
+
+        if (head.current_state_list == &head.get_ready_to_issue_list()) {
+            topdown.backend.core.fu_contention += empty;
+            return;
+        }
+    }
+
+    switch (stall) {
+        case RENAME_STALL_ROB_FULL:
+            if (dispatch_iq_full)
+                topdown.backend.core.iq_full += empty;
+            else
+                topdown.backend.core.rob_full += empty;
+            break;
+        case RENAME_STALL_LSQ_FULL:
+            topdown.backend.core.lsq_full += empty;
+            break;
+        case RENAME_STALL_PHYSREGS_FULL:
+            topdown.backend.core.physreg_full += empty;
+            break;
+        default:
+            topdown.backend.core.rob_full += empty;
+            break;
+    }
 }
 
 /**
@@ -1028,8 +1156,8 @@ void ThreadContext::rename() {
  */
 void ThreadContext::frontend() {
 
-    ReorderBufferEntry* rob;
-    foreach_list_mutable(rob_frontend_list, rob, entry, nextentry) {
+    foreach_slot_by_age(rob_frontend_list, ROB.head, idx) {
+        ReorderBufferEntry* rob = &ROB[idx];
         if unlikely (rob->cycles_left <= 0) {
             rob->cycles_left = -1;
             rob->changestate(rob_ready_to_dispatch_list);
@@ -1320,8 +1448,10 @@ int ReorderBufferEntry::select_cluster() {
  */
 int ThreadContext::dispatch() {
 
-    ReorderBufferEntry* rob;
-    foreach_list_mutable(rob_ready_to_dispatch_list, rob, entry, nextentry) {
+    dispatch_iq_full = 0;
+
+    foreach_slot_by_age(rob_ready_to_dispatch_list, ROB.head, idx) {
+        ReorderBufferEntry* rob = &ROB[idx];
         if unlikely (core.dispatchcount >= DISPATCH_WIDTH) break;
 
         /* All operands start out as valid, then get put on wait queues if they are not actually ready. */
@@ -1336,6 +1466,7 @@ int ThreadContext::dispatch() {
          */
 
         if unlikely (rob->cluster < 0) {
+            dispatch_iq_full = 1;
 #ifdef MULTI_IQ
             continue; /* try the next uop to avoid deadlock on re-dispatches */
 #else
@@ -1351,6 +1482,7 @@ int ThreadContext::dispatch() {
             issueq_operation_on_cluster_with_result(core, rob->cluster, empty, shared_empty());
             if (empty) {
 				/* no shared entries left, stop dispatch */
+                dispatch_iq_full = 1;
                 continue;
             } else {
                 /* one or more shared entries left, continue dispatch */
@@ -1367,6 +1499,7 @@ int ThreadContext::dispatch() {
             issueq_operation_on_cluster_with_result(core, rob->cluster, empty, shared_empty());
             if (empty) {
                 /* no shared entries left, stop dispatch */
+                dispatch_iq_full = 1;
                 continue;
             } else {
                 /* one or more shared entries left, continue dispatch */
@@ -1428,7 +1561,6 @@ int ThreadContext::dispatch() {
 int ThreadContext::complete(int cluster) {
 
     int completecount = 0;
-    ReorderBufferEntry* rob;
 
 
     /*
@@ -1436,7 +1568,8 @@ int ThreadContext::complete(int cluster) {
      * for writeback and forwarding), move it to rob_completed_list.
      */
 
-    foreach_list_mutable(rob_issued_list[cluster], rob, entry, nextentry) {
+    foreach_slot_by_age(rob_issued_list[cluster], ROB.head, idx) {
+        ReorderBufferEntry* rob = &ROB[idx];
         rob->cycles_left--;
 
         if unlikely (rob->cycles_left <= 0) {
@@ -1461,8 +1594,8 @@ int ThreadContext::complete(int cluster) {
  */
 int ThreadContext::transfer(int cluster) {
 
-    ReorderBufferEntry* rob;
-    foreach_list_mutable(rob_completed_list[cluster], rob, entry, nextentry) {
+    foreach_slot_by_age(rob_completed_list[cluster], ROB.head, idx) {
+        ReorderBufferEntry* rob = &ROB[idx];
         rob->forward();
         rob->forward_cycle++;
         if unlikely (rob->forward_cycle > MAX_FORWARDING_LATENCY) {
@@ -1486,8 +1619,8 @@ int ThreadContext::transfer(int cluster) {
 int ThreadContext::writeback(int cluster) {
 
     int wakeupcount = 0;
-    ReorderBufferEntry* rob;
-    foreach_list_mutable(rob_ready_to_writeback_list[cluster], rob, entry, nextentry) {
+    foreach_slot_by_age(rob_ready_to_writeback_list[cluster], ROB.head, idx) {
+        ReorderBufferEntry* rob = &ROB[idx];
         if unlikely (core.writecount >= WRITEBACK_WIDTH) break;
 
         /*
@@ -1699,6 +1832,46 @@ namespace OOO_CORE_MODEL {
     }
 };
 
+/**
+ * @brief Count sampled events of a committing uop and record a sample
+ * for each event whose countdown expired
+ */
+void ReorderBufferEntry::sample_commit() {
+    ThreadContext& thread = getthread();
+    SampleCountdown& samples = thread.samples;
+    W32 fired = 0;
+
+    fired |= samples.tick(SAMPLE_UOPS) << SAMPLE_UOPS;
+    if unlikely (sample_flags & SAMPLE_FLAG_L2_MISS)
+        fired |= samples.tick(SAMPLE_L2_MISS) << SAMPLE_L2_MISS;
+    if unlikely (sample_flags & SAMPLE_FLAG_MISPRED)
+        fired |= samples.tick(SAMPLE_BRANCH_MISS) << SAMPLE_BRANCH_MISS;
+    if unlikely (sample_flags & SAMPLE_FLAG_TLB_MISS)
+        fired |= samples.tick(SAMPLE_TLB_MISS) << SAMPLE_TLB_MISS;
+
+    if likely (!fired)
+        return;
+
+    SampleRecord record;
+    memset(&record, 0, sizeof(record));
+    record.cycle = sim_cycle;
+    record.rip = uop.rip.rip;
+    record.addr = lsq ? lsq->virtaddr : 0;
+    record.cr3 = thread.ctx.cr[3];
+    record.latency = sim_cycle - rename_cycle;
+    record.mem_latency = mem_latency;
+    record.flags = sample_flags | (uop.rip.kernel ? SAMPLE_FLAG_KERNEL : 0);
+    record.coreid = coreid;
+    record.threadid = threadid;
+
+    foreach (i, SAMPLE_EVENT_COUNT) {
+        if (bit(fired, i)) {
+            record.event = i;
+            sampler_record(record);
+        }
+    }
+}
+
 /**
  * @brief commit ROB entery
  *
@@ -2189,6 +2362,19 @@ int ReorderBufferEntry::commit() {
                     Memory::MEMORY_OP_WRITE);
             request->set_coreSignal(&core.dcache_signal, &core.mem_signal, lsq->virtaddr);
 
+            /* Store bytes in this request's word for L1 line data */
+            if unlikely (config.verify_cache) {
+                int offset = lowbits(lsq->virtaddr, 3);
+                int bytes = 1 << uop.size;
+                if(uop.cond == LDST_ALIGN_HI) {
+                    request->set_store_data(lsq->data >> (8 * (8 - offset)),
+                            bitmask(offset + bytes - 8));
+                } else {
+                    request->set_store_data(lsq->data << (8 * offset),
+                            bitmask(min(bytes, 8 - offset)) << offset);
+                }
+            }
+
             assert(core.memoryHierarchy->access_cache(request));
             assert(lsq->virtaddr > 0xfff);
             if(config.checker_enabled && !ctx.kernel_mode) {
@@ -2209,6 +2395,16 @@ int ReorderBufferEntry::commit() {
         reset_checker_stores();
     }
 
+    if unlikely (thread.samples.enabled)
+        sample_commit();
+
+    /* Compare L1 line data of loads with guest memory */
+    if unlikely (config.verify_cache && ld && !uop.internal &&
+            !lsq->mmio) {
+        core.memoryHierarchy->verify_cache_data(core.get_coreid(),
+                lsq->physaddr << 3, lsq->bytemask, ctx.kernel_mode);
+    }
+
      /*
       * Free physical registers, load/store queue entries, etc.
       */
@@ -2294,6 +2490,7 @@ int ReorderBufferEntry::commit() {
 
     total_uops_committed++;
     thread.thread_stats.commit.uops++;
+    thread.thread_stats.topdown.retiring++;
     thread.total_uops_committed++;
 
     bool uop_is_eom = uop.eom;
@@ -2337,6 +2534,11 @@ namespace OOO_CORE_MODEL {
         0, 0, 0, 0, 0, 0, 0, 0,
         /* MMX registers */
         1, 1, 1, 1, 1, 1, 1, 1,
+        /* AVX registers, upper 128 bits */
+        1, 1, 1, 1, 1, 1, 1, 1,
+        1, 1, 1, 1, 1, 1, 1, 1,
+        1, 1, 1, 1, 1, 1, 1, 1,
+        1, 1, 1, 1, 1, 1, 1, 1,
         /* The following are ONLY used during the translation and renaming process: */
         0, 0, 0, 0, 0, 0, 0, 0,
         0, 0, 0, 0, 0, 0, 0, 0,
@@ -2357,6 +2559,11 @@ namespace OOO_CORE_MODEL {
         1, 1, 1, 1, 1, 1, 1, 0,
         /* MMX registers */
         1, 1, 1, 1, 1, 1, 1, 1,
+        /* AVX registers, upper 128 bits */
+        1, 1, 1, 1, 1, 1, 1, 1,
+        1, 1, 1, 1, 1, 1, 1, 1,
+        1, 1, 1, 1, 1, 1, 1, 1,
+        1, 1, 1, 1, 1, 1, 1, 1,
         /* The following are ONLY used during the translation and renaming process: */
         1, 1, 1, 1, 1, 1, 1, 1,
         1, 1, 1, 1, 1, 1, 1, 1,
@@ -19,6 +19,225 @@
 
 namespace OOO_CORE_MODEL {
 
+    /**
+     * @brief Cycles per instruction of a group of rename slots
+     *
+     * Sum of all elements but the last, in slots, divided by the slots per
+     * cycle and by the instructions in the last element.
+     */
+    template <int WIDTH>
+    struct StatObjFormulaSlotCPI {
+        typedef dynarray<StatObj<W64>* > elems_t;
+
+        static double compute(Stats* stats, const elems_t& elems)
+        {
+            W64 slots = 0;
+
+            foreach(i, elems.count() - 1) {
+                slots += (*elems[i])(stats);
+            }
+
+            double insns = double((*elems[elems.count() - 1])(stats));
+            if(insns == 0)
+                return 0;
+
+            return double(slots) / WIDTH / insns;
+        }
+    };
+
+    typedef StatEquation<W64, W64, StatObjFormulaAdd> StatSlotSum;
+    typedef StatEquation<W64, double, StatObjFormulaSlotCPI<FRONTEND_WIDTH> >
+        StatSlotCPI;
+
+    /**
+     * @brief Top-down accounting of rename slots
+     *
+     * Each cycle a running thread has FRONTEND_WIDTH rename slots. A slot
+     * that renames a uop which later commits is retiring, one whose uop
+     * is annulled or flushed is bad speculation. Empty slots are frontend
+     * bound when the fetch queue is empty, else backend bound, split by
+     * the state of the oldest uop and the resource that stopped rename.
+     * Slots stalled on a cache miss are added to the level that served
+     * the miss when the uop leaves the ROB.
+     *
+     * 'cpi' splits the thread CPI into the same groups.
+     */
+    struct TopDownStats : public Statable
+    {
+        struct bad_speculation : public Statable
+        {
+            StatObj<W64> annulled;
+            StatObj<W64> machine_clears;
+            StatObj<W64> resteer;
+            StatSlotSum total;
+
+            bad_speculation(Statable *parent)
+                : Statable("bad_speculation", parent)
+                  , annulled("annulled", this)
+                  , machine_clears("machine_clears", this)
+                  , resteer("resteer", this)
+                  , total("total", this)
+            {
+                total.add_elem(&annulled);
+                total.add_elem(&machine_clears);
+                total.add_elem(&resteer);
+            }
+        } bad_speculation;
+
+        struct frontend : public Statable
+        {
+            StatObj<W64> icache;
+            StatObj<W64> itlb;
+            StatObj<W64> other;
+            StatSlotSum total;
+
+            frontend(Statable *parent)
+                : Statable("frontend", parent)
+                  , icache("icache", this)
+                  , itlb("itlb", this)
+                  , other("other", this)
+                  , total("total", this)
+            {
+                total.add_elem(&icache);
+                total.add_elem(&itlb);
+                total.add_elem(&other);
+            }
+        } frontend;
+
+        struct backend : public Statable
+        {
+            struct memory : public Statable
+            {
+                StatObj<W64> dtlb;
+                StatObj<W64> l1;
+                StatObj<W64> l2;
+                StatObj<W64> l3;
+                StatObj<W64> dram;
+                StatObj<W64> store;
+                StatSlotSum total;
+
+                memory(Statable *parent)
+                    : Statable("memory", parent)
+                      , dtlb("dtlb", this)
+                      , l1("l1", this)
+                      , l2("l2", this)
+                      , l3("l3", this)
+                      , dram("dram", this)
+                      , store("store", this)
+                      , total("total", this)
+                {
+                    total.add_elem(&dtlb);
+                    total.add_elem(&l1);
+                    total.add_elem(&l2);
+                    total.add_elem(&l3);
+                    total.add_elem(&dram);
+                    total.add_elem(&store);
+                }
+            } memory;
+
+            struct core : public Statable
+            {
+                StatObj<W64> rob_full;
+                StatObj<W64> iq_full;
+                StatObj<W64> lsq_full;
+                StatObj<W64> physreg_full;
+                StatObj<W64> fu_contention;
+                StatSlotSum total;
+
+                core(Statable *parent)
+                    : Statable("core", parent)
+                      , rob_full("rob_full", this)
+                      , iq_full("iq_full", this)
+                      , lsq_full("lsq_full", this)
+                      , physreg_full("physreg_full", this)
+                      , fu_contention("fu_contention", this)
+                      , total("total", this)
+                {
+                    total.add_elem(&rob_full);
+                    total.add_elem(&iq_full);
+                    total.add_elem(&lsq_full);
+                    total.add_elem(&physreg_full);
+                    total.add_elem(&fu_contention);
+                }
+            } core;
+
+            backend(Statable *parent)
+                : Statable("backend", parent)
+                  , memory(this)
+                  , core(this)
+            {}
+        } backend;
+
+        struct cpi : public Statable
+        {
+            StatSlotCPI retiring;
+            StatSlotCPI bad_speculation;
+            StatSlotCPI frontend;
+            StatSlotCPI memory;
+            StatSlotCPI core;
+            StatSlotCPI total;
+
+            cpi(Statable *parent)
+                : Statable("cpi", parent)
+                  , retiring("retiring", this)
+                  , bad_speculation("bad_speculation", this)
+                  , frontend("frontend", this)
+                  , memory("memory", this)
+                  , core("core", this)
+                  , total("total", this)
+            {}
+        } cpi;
+
+        StatObj<W64> slots;
+        StatObj<W64> retiring;
+
+        TopDownStats(Statable *parent)
+            : Statable("topdown", parent)
+              , bad_speculation(this)
+              , frontend(this)
+              , backend(this)
+              , cpi(this)
+              , slots("slots", this)
+              , retiring("retiring", this)
+        {}
+
+        /* Connect 'cpi' equations, 'insns' are committed instructions */
+        void init_cpi(StatObj<W64> *insns)
+        {
+            cpi.retiring.add_elem(&retiring);
+
+            cpi.bad_speculation.add_elem(&bad_speculation.annulled);
+            cpi.bad_speculation.add_elem(&bad_speculation.machine_clears);
+            cpi.bad_speculation.add_elem(&bad_speculation.resteer);
+
+            cpi.frontend.add_elem(&frontend.icache);
+            cpi.frontend.add_elem(&frontend.itlb);
+            cpi.frontend.add_elem(&frontend.other);
+
+            cpi.memory.add_elem(&backend.memory.dtlb);
+            cpi.memory.add_elem(&backend.memory.l1);
+            cpi.memory.add_elem(&backend.memory.l2);
+            cpi.memory.add_elem(&backend.memory.l3);
+            cpi.memory.add_elem(&backend.memory.dram);
+            cpi.memory.add_elem(&backend.memory.store);
+
+            cpi.core.add_elem(&backend.core.rob_full);
+            cpi.core.add_elem(&backend.core.iq_full);
+            cpi.core.add_elem(&backend.core.lsq_full);
+            cpi.core.add_elem(&backend.core.physreg_full);
+            cpi.core.add_elem(&backend.core.fu_contention);
+
+            cpi.total.add_elem(&slots);
+
+            cpi.retiring.add_elem(insns);
+            cpi.bad_speculation.add_elem(insns);
+            cpi.frontend.add_elem(insns);
+            cpi.memory.add_elem(insns);
+            cpi.core.add_elem(insns);
+            cpi.total.add_elem(insns);
+        }
+    };
+
     struct OooCoreThreadStats : public Statable
     {
         struct fetch : public Statable
@@ -35,6 +254,7 @@ namespace OOO_CORE_MODEL {
                 StatObj<W64> full_width;
                 StatObj<W64> icache_stalled;
                 StatObj<W64> invalid_blocks;
+                StatObj<W64> halted;
 
                 stop(Statable *parent)
                     : Statable("stop", parent)
@@ -48,9 +268,27 @@ namespace OOO_CORE_MODEL {
                       , full_width("full_width", this)
                       , icache_stalled("icache_stalled", this)
                       , invalid_blocks("invalid_blocks", this)
+                      , halted("halted", this)
                 {}
             } stop;
 
+            struct next_block : public Statable
+            {
+                StatObj<W64> lookups;
+                StatObj<W64> hits;
+                StatEquation<W64, double, StatObjFormulaDiv> hit_rate;
+
+                next_block(Statable *parent)
+                    : Statable("next_block", parent)
+                      , lookups("lookups", this)
+                      , hits("hits", this)
+                      , hit_rate("hit_rate", this)
+                {
+                    hit_rate.add_elem(&hits);
+                    hit_rate.add_elem(&lookups);
+                }
+            } next_block;
+
             StatArray<W64, OPCLASS_COUNT> opclass;
             StatArray<W64, FETCH_WIDTH+1> width;
 
@@ -61,6 +299,7 @@ namespace OOO_CORE_MODEL {
             fetch(Statable *parent)
                 : Statable("fetch", parent)
                   , stop(this)
+                  , next_block(this)
                   , opclass("opclass", this, opclass_names)
                   , width("width", this)
                   , blocks("blocks", this)
@@ -520,6 +759,8 @@ namespace OOO_CORE_MODEL {
             {}
         } dcache;
 
+        TopDownStats topdown;
+
         StatObj<W64> interrupt_requests;
         StatObj<W64> cpu_exit_requests;
         StatObj<W64> cycles_in_pause;
@@ -552,6 +793,7 @@ namespace OOO_CORE_MODEL {
 			  , commit(this)
 			  , branchpred(this)
 			  , dcache(this)
+			  , topdown(this)
 			  , interrupt_requests("interrupt_requests", this)
 			  , cpu_exit_requests("cpu_exit_requests", this)
 			  , cycles_in_pause("cycles_in_pause", this)
@@ -697,6 +939,7 @@ namespace OOO_CORE_MODEL {
         } commit;
 
         StatObj<W64> cycles;
+        StatObj<W64> sleep_cycles;
 
 		StatObj<W64> iq_reads;
 		StatObj<W64> iq_writes;
@@ -709,6 +952,7 @@ namespace OOO_CORE_MODEL {
 			  , writeback(parent)
 			  , commit(parent)
 			  , cycles("cycles", parent)
+			  , sleep_cycles("sleep_cycles", parent)
 			  , iq_reads("iq_reads", parent)
 			  , iq_writes("iq_writes", parent)
 			  , iq_fp_reads("iq_fp_reads", parent)
@@ -132,6 +132,8 @@ ThreadContext::ThreadContext(OooCore& core_, W8 threadid_, Context& ctx_)
     thread_stats.commit.ipc.add_elem(&core_.core_stats.cycles);
     /* thread_stats.commit.ipc.enable_periodic_dump(); */
 
+    thread_stats.topdown.init_cpi(&thread_stats.commit.insns);
+
     thread_stats.set_default_stats(user_stats);
     reset();
 }
@@ -146,7 +148,10 @@ void ThreadContext::reset() {
     setzero(fetchrip);
     current_basic_block = NULL;
     current_basic_block_transop_index = -1;
+    setzero(next_block_cache);
     stall_frontend = false;
+    resteer = false;
+    dispatch_iq_full = false;
     waiting_for_icache_fill = false;
     waiting_for_icache_fill_physaddr = 0;
     fetch_uuid = 0;
@@ -221,6 +226,10 @@ void ThreadContext::init() {
     rob_memory_fence_list("memory-fence", rob_states, 0);
     rob_ready_to_commit_queue("ready-to-commit", rob_states, ROB_STATE_READY);
 
+    foreach (i, rob_states.count) {
+        rob_states[i]->track_slots(ROB_SIZE);
+    }
+
     /* Setup TLB of each thread */
     setupTLB();
 
@@ -230,17 +239,81 @@ void ThreadContext::init() {
 
 STLB OooCore::stlb = STLB();
 
+/**
+ * @brief Size of a core queue, per core
+ *
+ * @param machine Machine of the core
+ * @param name Name of the core
+ * @param coreid Core id, selects the entry of the -ooo-*-size option
+ * @param option Value of the -ooo-*-size option, empty if not set
+ * @param opt_name Core option with the size, like 'rob_size'
+ * @param max Compile time size of the queue
+ *
+ * The -ooo-*-size option is a comma separated list of sizes by core id,
+ * the last one is used for the remaining cores. Without it the core option
+ * from the machine configuration is used, and then the compile time size.
+ *
+ * @return Size to use, at most 'max'
+ */
+static int queue_size(BaseMachine& machine, const char* name, W8 coreid,
+        const stringbuf& option, const char* opt_name, int max)
+{
+    int size = 0;
+
+    if (option.size()) {
+        dynarray<stringbuf*> sizes;
+        stringbuf buf;
+        buf << option;
+        buf.split(sizes, ",");
+
+        if (sizes.count())
+            size = atoi(sizes[min((int)coreid, sizes.count() - 1)]->buf);
+
+        foreach (i, sizes.count()) delete sizes[i];
+    } else {
+        machine.get_option(name, opt_name, size);
+    }
+
+    if (size <= 0) return max;
+
+    if (size > max) {
+        ptl_logfile << "[WARNING] core ", coreid, " ", opt_name, " ", size,
+                    " is above the configured size ", max, ", using ",
+                    max, endl;
+        return max;
+    }
+
+    return size;
+}
+
 OooCore::OooCore(BaseMachine& machine_, W8 num_threads,
         const char* name)
 : BaseCore(machine_, name)
+    , idle_user_stats(this)
+    , idle_kernel_stats(this)
     , core_stats("core", this)
 {
     if(!machine_.get_option(name, "threads", threadcount)) {
         threadcount = 1;
     }
 
+    rob_size = queue_size(machine_, name, get_coreid(),
+            config.ooo_rob_size, "rob_size", ROB_SIZE);
+    iq_size = queue_size(machine_, name, get_coreid(),
+            config.ooo_iq_size, "iq_size", ISSUE_QUEUE_SIZE);
+    ldq_size = queue_size(machine_, name, get_coreid(),
+            config.ooo_ldq_size, "ldq_size", LDQ_SIZE);
+    stq_size = queue_size(machine_, name, get_coreid(),
+            config.ooo_stq_size, "stq_size", STQ_SIZE);
+    fetchq_size = queue_size(machine_, name, get_coreid(),
+            config.ooo_fetchq_size, "fetchq_size", FETCH_QUEUE_SIZE);
+
     setzero(threads);
 
+    sleeping = 0;
+    wakeup_pending = 0;
+    sleep_start_cycle = 0;
+
     assert(num_threads > 0 && "Core has atleast 1 thread");
 
     /* Rename the stats */
@@ -307,22 +380,22 @@ void OooCore::reset() {
 
 #ifndef MULTI_IQ
     int reserved_iq_entries_per_thread = (int)sqrt(
-            ISSUE_QUEUE_SIZE / threadcount);
+            iq_size / threadcount);
     reserved_iq_entries = reserved_iq_entries_per_thread * \
                           threadcount;
     assert(reserved_iq_entries && reserved_iq_entries < \
-            ISSUE_QUEUE_SIZE);
+            iq_size);
 
     foreach_issueq(set_reserved_entries(reserved_iq_entries));
 #else
     int reserved_iq_entries_per_thread = (int)sqrt(
-            ISSUE_QUEUE_SIZE / threadcount);
+            iq_size / threadcount);
 
     for_each_cluster(cluster){
         reserved_iq_entries[cluster] = reserved_iq_entries_per_thread * \
                                        threadcount;
         assert(reserved_iq_entries[cluster] && reserved_iq_entries[cluster] < \
-                ISSUE_QUEUE_SIZE);
+                iq_size);
     }
 
     foreach_issueq(set_reserved_entries(
@@ -340,17 +413,15 @@ void OooCore::init_generic() {
     reset();
 }
 
-template <typename T>
 static void OOO_CORE_MODEL::print_list_of_state_lists(ostream& os, const ListOfStateLists& lol, const char* title) {
     os << title, ":", endl;
     foreach (i, lol.count) {
         StateList& list = *lol[i];
         os << list.name, " (", list.count, " entries):", endl;
         int n = 0;
-        T* obj;
-        foreach_list_mutable(list, obj, entry, nextentry) {
+        foreach_slot(list, idx) {
             if ((n % 16) == 0) os << " ";
-            os << " ", intstring(obj->index(), -3);
+            os << " ", intstring(idx, -3);
             if (((n % 16) == 15) || (n == list.count-1)) os << endl;
             n++;
         }
@@ -377,6 +448,7 @@ void PhysicalRegisterFile::init(const char* name, W8 coreid, int rfid, int size,
         stringbuf sb;
         sb << name, "-", physreg_state_names[i];
         states[i].init(sb, getcore().physreg_states);
+        states[i].track_slots(size);
     }
 
     foreach (i, size) {
@@ -388,8 +460,9 @@ void PhysicalRegisterFile::init(const char* name, W8 coreid, int rfid, int size,
  * @brief Allocate physical register to be used in the rename stage
  */
 PhysicalRegister* PhysicalRegisterFile::alloc(W8 threadid, int r) {
-    PhysicalRegister* physreg = (PhysicalRegister*)((r == 0) ? &(*this)[r] : states[PHYSREG_FREE].peek());
-    if unlikely (!physreg) return NULL;
+    int idx = (r == 0) ? r : states[PHYSREG_FREE].next_slot(0, size);
+    if unlikely (idx < 0) return NULL;
+    PhysicalRegister* physreg = &(*this)[idx];
     physreg->changestate(PHYSREG_WAITING);
     physreg->flags = FLAG_WAIT;
     physreg->threadid = threadid;
@@ -430,10 +503,10 @@ void PhysicalRegisterFile::reset(W8 threadid) {
  */
 bool PhysicalRegisterFile::cleanup() {
     int freed = 0;
-    PhysicalRegister* physreg;
     StateList& statelist = this->states[PHYSREG_PENDINGFREE];
 
-    foreach_list_mutable(statelist, physreg, entry, nextentry) {
+    foreach_slot(statelist, idx) {
+        PhysicalRegister* physreg = &(*this)[idx];
         if unlikely (!physreg->referenced()) {
             physreg->free();
             freed++;
@@ -530,6 +603,20 @@ int ThreadContext::get_priority() const {
 bool OooCore::runcycle(void* none) {
     bool exiting = 0;
 
+    if unlikely (sleeping) {
+        if likely (!wakeup_pending && idle())
+            return exiting;
+        wakeup();
+    }
+
+    /*
+     * A core that starts the cycle idle records the stats this cycle
+     * adds, in case it goes to sleep at the end of it.
+     */
+    bool idle_cycle = config.core_sleep && idle();
+    if unlikely (idle_cycle)
+        begin_idle_cycle();
+
      /*
       * Detect edge triggered transition from 0->1 for
       * pending interrupt events, then wait for current
@@ -638,6 +725,21 @@ bool OooCore::runcycle(void* none) {
         ThreadContext* thread = threads[tid];
         if unlikely (!thread->ctx.running) continue;
 
+        /*
+         * A halted thread with work to do leaves the halt. With its
+         * pipeline drained it sits right after the hlt, so a pending
+         * interrupt is taken now instead of at the next EOM.
+         */
+        if unlikely (thread->halted() && thread->ROB.empty() &&
+                qemu_cpu_has_work(&thread->ctx)) {
+            thread->ctx.halted = 0;
+            thread->last_commit_at_cycle = sim_cycle;
+            if(thread->handle_interrupt_at_next_eom) {
+                commitrc[tid] = COMMIT_RESULT_INTERRUPT;
+                continue;
+            }
+        }
+
         if (thread->pause_counter > 0) {
             thread->pause_counter--;
             if(thread->handle_interrupt_at_next_eom) {
@@ -923,6 +1025,12 @@ bool OooCore::runcycle(void* none) {
         ThreadContext* thread = threads[i];
         if unlikely (!thread->ctx.running) break;
 
+        /* Halted threads do not commit anything until woken up */
+        if unlikely (thread->halted()) {
+            thread->last_commit_at_cycle = sim_cycle;
+            continue;
+        }
+
         if unlikely ((sim_cycle - thread->last_commit_at_cycle) > (W64)1024*1024*threadcount) {
             stringbuf sb;
             sb << "[vcpu ", thread->ctx.cpu_index, "] thread ", thread->threadid, ": WARNING: At cycle ",
@@ -940,9 +1048,94 @@ bool OooCore::runcycle(void* none) {
 
     core_stats.cycles++;
 
+    if unlikely (idle_cycle && !exiting && idle())
+        sleep();
+
     return exiting;
 }
 
+/**
+ * @brief Check if a thread has nothing to do until it is woken up
+ *
+ * @return true if the thread is not running, or is halted with an empty
+ * pipeline and no interrupt or exit request pending
+ */
+bool ThreadContext::idle() {
+    if unlikely (!ctx.running)
+        return true;
+
+    return halted() && ROB.empty() && fetchq.empty() &&
+        !waiting_for_icache_fill && !pause_counter &&
+        !ctx.check_events() && !qemu_cpu_has_work(&ctx);
+}
+
+/**
+ * @brief Check if all threads of the core are idle
+ */
+bool OooCore::idle() {
+    foreach (i, threadcount) {
+        if likely (!threads[i]->idle())
+            return false;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Start recording the user and kernel stats of an idle cycle,
+ * sleep() ends the recording
+ */
+void OooCore::begin_idle_cycle() {
+    idle_user_stats.begin(*user_stats);
+    idle_kernel_stats.begin(*kernel_stats);
+}
+
+/**
+ * @brief Put the core to sleep after an idle cycle
+ */
+void OooCore::sleep() {
+    idle_user_stats.end(*user_stats);
+    idle_kernel_stats.end(*kernel_stats);
+
+    if (logable(5))
+        ptl_logfile << get_name(), " sleeping at cycle ", sim_cycle, endl;
+
+    sleeping = 1;
+    wakeup_pending = 0;
+    sleep_start_cycle = sim_cycle + 1;
+}
+
+/**
+ * @brief Add the stats of the cycles skipped since sleep_start_cycle
+ *
+ * Each skipped cycle would have added the idle cycle stats again.
+ */
+void OooCore::account_sleep_cycles() {
+    W64 count = sim_cycle - sleep_start_cycle;
+
+    if (!count)
+        return;
+
+    idle_user_stats.add(*user_stats, count);
+    idle_kernel_stats.add(*kernel_stats, count);
+
+    core_stats.sleep_cycles += count;
+    sleep_start_cycle = sim_cycle;
+}
+
+/**
+ * @brief Wake the core up and account for the cycles it skipped
+ */
+void OooCore::wakeup() {
+    account_sleep_cycles();
+
+    if (logable(5))
+        ptl_logfile << get_name(), " woke up at cycle ", sim_cycle, endl;
+
+    sleeping = 0;
+    wakeup_pending = 0;
+}
+
 /*
  * ReorderBufferEntry
  */
@@ -957,6 +1150,7 @@ void ReorderBufferEntry::init(int idx) {
     entry_valid = 0;
     selfqueuelink::reset();
     current_state_list = NULL;
+    stall_slots = 0;
     reset();
 }
 
@@ -965,6 +1159,22 @@ void ReorderBufferEntry::init(int idx) {
  * zero when allocating a new ROB entry.
  */
 void ReorderBufferEntry::reset() {
+    /* Charge miss stall slots to the level that served the miss */
+    if unlikely (stall_slots) {
+        TopDownStats& topdown = getthread().thread_stats.topdown;
+        StatObj<W64>* level = &topdown.backend.memory.l1;
+
+        if (sample_flags & SAMPLE_FLAG_DRAM)
+            level = &topdown.backend.memory.dram;
+        else if (sample_flags & SAMPLE_FLAG_L2_MISS)
+            level = &topdown.backend.memory.l3;
+        else if (sample_flags & SAMPLE_FLAG_L1_MISS)
+            level = &topdown.backend.memory.l2;
+
+        *level += (W64)stall_slots;
+        stall_slots = 0;
+    }
+
     /* Deallocate ROB entry */
     entry_valid = false;
     cycles_left = 0;
@@ -985,6 +1195,8 @@ void ReorderBufferEntry::reset() {
     issued = 0;
     generated_addr = original_addr = cache_data = 0;
     annul_flag = 0;
+    mem_latency = 0;
+    sample_flags = 0;
 }
 
 bool ReorderBufferEntry::ready_to_issue() const {
@@ -1173,12 +1385,12 @@ void ThreadContext::dump_smt_state(ostream& os) {
 void OooCore::dump_state(ostream& os) {
     os << "dump_state for core[",get_coreid(),"]: SMT common structures:", endl;
 
-    print_list_of_state_lists<PhysicalRegister>(os, physreg_states, "Physical register states");
+    print_list_of_state_lists(os, physreg_states, "Physical register states");
     foreach (i, PHYS_REG_FILE_COUNT) {
         os << physregfiles[i];
     }
 
-    print_list_of_state_lists<ReorderBufferEntry>(os, rob_states, "ROB entry states");
+    print_list_of_state_lists(os, rob_states, "ROB entry states");
     os << "Issue Queues:", endl;
     foreach_issueq(print(os));
     // caches.print(os);
@@ -1279,9 +1491,9 @@ void OooCore::check_rob() {
         ThreadContext* thread = threads[i];
         foreach (i, rob_states.count) {
             StateList& list = *(thread->rob_states[i]);
-            ReorderBufferEntry* rob;
-            foreach_list_mutable(list, rob, entry, nextentry) {
-                assert(inrange(rob->index(), 0, ROB_SIZE-1));
+            assert(list.slot_popcount() == list.count);
+            foreach_slot(list, idx) {
+                ReorderBufferEntry* rob = &thread->ROB[idx];
                 assert(rob->current_state_list == &list);
                 if (!((rob->current_state_list != &thread->rob_free_list) ? rob->entry_valid : (!rob->entry_valid))) {
                     ptl_logfile << "ROB ", rob->index(), " list = ", rob->current_state_list->name, " entry_valid ", rob->entry_valid, endl, flush;
@@ -1582,6 +1794,10 @@ void OooCore::flush_tlb_virt(Context& ctx, Waddr virtaddr) {
 
 void OooCore::check_ctx_changes()
 {
+    /* QEMU may have changed any context, so look again */
+    if unlikely (sleeping)
+        wakeup();
+
     foreach(i, threadcount) {
         Context& ctx = threads[i]->ctx;
         ctx.handle_interrupt = 0;
@@ -1602,6 +1818,8 @@ void OooCore::check_ctx_changes()
 
 void OooCore::update_stats()
 {
+    if unlikely (sleeping)
+        account_sleep_cycles();
 }
 
 /**
@@ -1620,7 +1838,7 @@ void OooCore::dump_configuration(YAML::Emitter &out) const
 
 	YAML_KEY_VAL(out, "type", "core");
 	YAML_KEY_VAL(out, "threads", threadcount);
-	YAML_KEY_VAL(out, "iq_size", ISSUE_QUEUE_SIZE);
+	YAML_KEY_VAL(out, "iq_size", iq_size);
 	YAML_KEY_VAL(out, "phys_reg_files", PHYS_REG_FILE_COUNT);
 #ifdef UNIFIED_INT_FP_PHYS_REG_FILE
 	YAML_KEY_VAL(out, "phys_reg_file_int_fp_size", PHYS_REG_FILE_SIZE);
@@ -1631,7 +1849,7 @@ void OooCore::dump_configuration(YAML::Emitter &out) const
 	YAML_KEY_VAL(out, "phys_reg_file_st_size", STQ_SIZE * threadcount);
 	YAML_KEY_VAL(out, "phys_reg_file_br_size", MAX_BRANCHES_IN_FLIGHT *
 			threadcount);
-	YAML_KEY_VAL(out, "fetch_q_size", FETCH_QUEUE_SIZE);
+	YAML_KEY_VAL(out, "fetch_q_size", fetchq_size);
 	YAML_KEY_VAL(out, "frontend_stages", FRONTEND_STAGES);
 	YAML_KEY_VAL(out, "itlb_size", ITLB_SIZE);
     YAML_KEY_VAL(out, "dtlb_size", DTLB_SIZE);
@@ -1652,14 +1870,78 @@ void OooCore::dump_configuration(YAML::Emitter &out) const
 
 	out << YAML::Key << "per_thread" << YAML::Value << YAML::BeginMap;
 
-	YAML_KEY_VAL(out, "rob_size", ROB_SIZE);
+	YAML_KEY_VAL(out, "rob_size", rob_size);
 	YAML_KEY_VAL(out, "lsq_size", LSQ_SIZE);
+	YAML_KEY_VAL(out, "ldq_size", ldq_size);
+	YAML_KEY_VAL(out, "stq_size", stq_size);
 
 	out << YAML::EndMap;
 
 	out << YAML::EndMap;
 }
 
+/**
+ * @brief Save warmable core state into micro-architectural checkpoint
+ *
+ * @param writer Checkpoint writer positioned in this core's section
+ *
+ * Saves the branch predictor of each thread. The STLB is shared by all
+ * cores so it is saved only by the first core.
+ */
+void OooCore::save_state(UarchStateWriter& writer) const
+{
+    writer.put((W32)threadcount);
+    foreach (i, threadcount) {
+        threads[i]->branchpred.save_state(writer);
+    }
+
+    if (get_coreid() == 0) {
+        writer.put_associative(stlb);
+    }
+}
+
+/**
+ * @brief Restore core state saved by save_state()
+ *
+ * @param reader Checkpoint reader positioned in this core's section
+ *
+ * @return false if saved state does not match this core, in that case
+ * no predictor or TLB is changed
+ */
+bool OooCore::restore_state(UarchStateReader& reader)
+{
+    W32 threads_saved;
+    STLB::base_t *savedStlb = NULL;
+    bool rc = true;
+
+    if (!reader.get(threads_saved) || threads_saved != (W32)threadcount)
+        return false;
+
+    for (int i = 0; rc && i < threadcount; i++) {
+        rc = threads[i]->branchpred.read_state(reader);
+    }
+
+    if (rc && get_coreid() == 0) {
+        savedStlb = new STLB::base_t();
+        rc = reader.get_associative(*savedStlb);
+    }
+
+    foreach (i, threadcount) {
+        if (rc)
+            threads[i]->branchpred.commit_state();
+        else
+            threads[i]->branchpred.discard_state();
+    }
+
+    if (rc && savedStlb) {
+        *(STLB::base_t*)&stlb = *savedStlb;
+    }
+
+    delete savedStlb;
+
+    return rc;
+}
+
 OooCoreBuilder::OooCoreBuilder(const char* name)
     : CoreBuilder(name)
 {
@@ -19,6 +19,7 @@
 #include <statelist.h>
 #include <statsBuilder.h>
 #include <decode.h>
+#include <sampler.h>
 
 #include <ooo-const.h>
 #include <ooo-stats.h>
@@ -370,6 +371,7 @@ namespace OOO_CORE_MODEL {
             OooCore* core;
             int shared_free_entries;
             int reserved_entries;
+            int capacity; /* entries in use, up to 'size' */
             int issueq_id;
             static int issueq_id_seq;
 
@@ -378,7 +380,7 @@ namespace OOO_CORE_MODEL {
             }
             void set_reserved_entries(int num) { reserved_entries = num; }
             bool reset_shared_entries() {
-                shared_free_entries = size - reserved_entries;
+                shared_free_entries = capacity - reserved_entries;
                 return true;
             }
             bool alloc_shared_entry() {
@@ -387,8 +389,8 @@ namespace OOO_CORE_MODEL {
                 return true;
             }
             bool free_shared_entry() {
-                if(logable(99)) ptl_logfile << "shared_free_entries: ", shared_free_entries, " size: ",  size, " reserved_entries: ",  reserved_entries, endl;
-                assert(shared_free_entries < size - reserved_entries);
+                if(logable(99)) ptl_logfile << "shared_free_entries: ", shared_free_entries, " size: ",  capacity, " reserved_entries: ",  reserved_entries, endl;
+                assert(shared_free_entries < capacity - reserved_entries);
                 shared_free_entries++;
                 return true;
             }
@@ -396,7 +398,7 @@ namespace OOO_CORE_MODEL {
                 return (shared_free_entries == 0);
             }
 
-            bool remaining() const { return (size - count); }
+            bool remaining() const { return (capacity - count); }
             bool empty() const { return (!count); }
             bool full() const { return (!remaining()); }
 
@@ -461,7 +463,6 @@ namespace OOO_CORE_MODEL {
             return issueq.print(os);
         }
 
-    template <typename T>
         static void print_list_of_state_lists(ostream& os, const ListOfStateLists& lol, const char* title);
 
      /*
@@ -533,14 +534,22 @@ namespace OOO_CORE_MODEL {
         byte annul_flag;
         byte tlb_walk_level;
 
+        /* Event sampling */
+        W64  rename_cycle;
+        W32  mem_latency;
+        byte sample_flags;
+
+        /* Rename slots lost while this uop blocked the ROB head on a miss */
+        W32  stall_slots;
+
         int index() const { return idx; }
         void validate() { entry_valid = true; }
 
-        void changestate(StateList& newqueue, bool place_at_head = false, ReorderBufferEntry* prevrob = NULL) {
+        void changestate(StateList& newqueue) {
             if (current_state_list)
-                current_state_list->remove(this);
+                current_state_list->remove_slot(idx);
             current_state_list = &newqueue;
-            if (place_at_head) newqueue.enqueue_after(this, prevrob); else newqueue.enqueue(this);
+            newqueue.add_slot(idx);
         }
 
         void init(int idx);
@@ -568,10 +577,11 @@ namespace OOO_CORE_MODEL {
         W64 annul_after() { return annul(true); }
         W64 annul_after_and_including() { return annul(false); }
         int commit();
+        void sample_commit();
         void replay();
         void replay_locked();
         int pseudocommit();
-        void redispatch(const bitvec<MAX_OPERANDS>& dependent_operands, ReorderBufferEntry* prevrob);
+        void redispatch(const bitvec<MAX_OPERANDS>& dependent_operands);
         void redispatch_dependents(bool inclusive = true);
         void loadwakeup();
         void fencewakeup();
@@ -687,9 +697,10 @@ namespace OOO_CORE_MODEL {
         StateList& get_state_list() const { return get_state_list(this->state); }
 
         void changestate(int newstate) {
-            if likely (state != PHYSREG_NONE) get_state_list(state).remove(this);
+            if likely (state != PHYSREG_NONE)
+                get_state_list(state).remove_slot(idx);
             state = newstate;
-            get_state_list(state).enqueue(this);
+            get_state_list(state).add_slot(idx);
         }
 
         void init(W8 coreid, int rfid, int idx, OooCore* core) {
@@ -894,6 +905,15 @@ namespace OOO_CORE_MODEL {
         void reset() {
             counter = 0;
         }
+        void save_state(UarchStateWriter& writer) const {
+            writer.put((W32)counter);
+        }
+        bool restore_state(UarchStateReader& reader) {
+            W32 saved;
+            if (!reader.get(saved)) return false;
+            counter = saved;
+            return true;
+        }
         ostream& print(ostream &os, const W64 tag) const {
             os << (void*)tag, ": ", counter;
             return os;
@@ -1028,6 +1048,7 @@ namespace OOO_CORE_MODEL {
         W8 coreid;
         Context& ctx;
         BranchPredictorInterface branchpred;
+        SampleCountdown samples;
 
         Queue<FetchBufferEntry, FETCH_QUEUE_SIZE> fetchq;
 
@@ -1038,6 +1059,11 @@ namespace OOO_CORE_MODEL {
           * Each ROB's state can be linked into at most one of the
           * following rob_xxx_list lists at any given time; the ROB's
           * current_state_list points back to the list it belongs to.
+          *
+          * The lists only track their members in a bitmap indexed by
+          * ROB index, entries are not linked. The pipeline stages scan
+          * these bitmaps in age order starting at ROB.head
+          * (foreach_slot_by_age).
           */
 
         StateList rob_free_list;                             // Free ROB entyry
@@ -1073,7 +1099,30 @@ namespace OOO_CORE_MODEL {
         RIPVirtPhys fetchrip;
         BasicBlock* current_basic_block;
         int current_basic_block_transop_index;
+
+        /*
+         * Next basic block cache: the block fetched after a given block
+         * on its taken and not-taken paths, so loops skip the bbcache
+         * lookup. An entry is only used while the bbcache generation it
+         * was filled in is current (no block has been freed since) and
+         * the successor still matches the fetch RIP and mode.
+         */
+        struct NextBlockEntry {
+            BasicBlock* from;
+            BasicBlock* to;
+            W64 generation;
+        };
+        NextBlockEntry next_block_cache[NEXT_BLOCK_CACHE_SIZE];
+
+        static int next_block_slot(const BasicBlock* bb, bool taken) {
+            W64 key = (Waddr)bb;
+            key ^= key >> 17;
+            return (lowbits(key >> 6, log2(NEXT_BLOCK_CACHE_SIZE) - 1) << 1) | taken;
+        }
+
         bool stall_frontend;
+        bool resteer;
+        bool dispatch_iq_full;
         bool waiting_for_icache_fill;
         Waddr waiting_for_icache_fill_physaddr;
         byte itlb_walk_level;
@@ -1134,6 +1183,16 @@ namespace OOO_CORE_MODEL {
         bool fetch();
         void tlbwalk();
 
+        /* Reason rename stopped before using all its slots */
+        enum {
+            RENAME_STALL_NONE,
+            RENAME_STALL_FETCHQ_EMPTY,
+            RENAME_STALL_ROB_FULL,
+            RENAME_STALL_PHYSREGS_FULL,
+            RENAME_STALL_LSQ_FULL,
+        };
+        void account_rename_slots(int renamed, int stall);
+
         bool handle_barrier();
         bool handle_exception();
         bool handle_interrupt();
@@ -1148,6 +1207,10 @@ namespace OOO_CORE_MODEL {
         void flush_mem_lock_release_list(int start = 0);
         int get_priority() const;
 
+        /* With -core-sleep a thread stops fetching after hlt */
+        bool halted() const { return config.core_sleep && ctx.halted; }
+        bool idle();
+
         void dump_smt_state(ostream& os);
         void print_smt_state(ostream& os);
         void print_rob(ostream& os);
@@ -1180,6 +1243,16 @@ namespace OOO_CORE_MODEL {
 
         int threadcount;
         ThreadContext** threads;
+
+        /*
+         * Queue sizes in use, the compile time sizes are the maxima and
+         * -ooo-*-size options can lower them without rebuilding
+         */
+        int rob_size;
+        int iq_size;
+        int ldq_size;
+        int stq_size;
+        int fetchq_size;
         
         static STLB stlb;
 
@@ -1340,6 +1413,31 @@ namespace OOO_CORE_MODEL {
         void flush_tlb(Context& ctx);
         void flush_tlb_virt(Context& ctx, Waddr virtaddr);
 
+        /*
+         * Core sleep (-core-sleep): once every thread is halted and
+         * drained, runcycle() skips the core until an interrupt, a cache
+         * fill or a context change wakes it up. The stats of the last idle
+         * cycle are kept in idle_user_stats and idle_kernel_stats and
+         * added once per skipped cycle on wakeup, so totals match a core
+         * that ran.
+         *
+         * A core stalled on a miss with a full ROB is not put to sleep:
+         * it still changes state every cycle (the head's stall_slots,
+         * issue queue clocking, replays), which a stats delta can't
+         * repeat.
+         */
+        bool sleeping;
+        bool wakeup_pending;
+        W64 sleep_start_cycle;
+        StatsDelta idle_user_stats;
+        StatsDelta idle_kernel_stats;
+
+        bool idle();
+        void begin_idle_cycle();
+        void sleep();
+        void wakeup();
+        void account_sleep_cycles();
+
 		/* Cache Signals and Callbacks */
         Signal dcache_signal;
         Signal icache_signal;
@@ -1364,6 +1462,10 @@ namespace OOO_CORE_MODEL {
         void check_ctx_changes();
 
 		void dump_configuration(YAML::Emitter &out) const;
+
+        /* Micro-architectural checkpoints */
+        void save_state(UarchStateWriter& writer) const;
+        bool restore_state(UarchStateReader& reader);
     };
 
     /**
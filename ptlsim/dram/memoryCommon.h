@@ -43,6 +43,7 @@ struct BankData {
     int supplyCount;
     int rowBuffer;
     int hitCount;
+    bool conflicted; // open row was closed for a transaction to an other row
     int *mapping;
 };
 
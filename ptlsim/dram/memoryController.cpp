@@ -14,17 +14,24 @@
 
 using namespace DRAM;
 
-MemoryController::MemoryController(Config &config, AddressMapping &mapping, Policy &policy) :
-    mapping(mapping), policy(policy)
+MemoryController::MemoryController(Config &config, AddressMapping &mapping, Policy &policy,
+        stringbuf &name, Statable *parent, BankStats &totalStats) :
+    Statable(name, parent), mapping(mapping), policy(policy),
+    totalStats(totalStats)
 {
     rankcount = config.rankcount;
     bankcount = config.bankcount;
+    rowcount = config.rowcount;
     refresh_interval = config.rank_timing.refresh_interval;
     channel = new Channel(&config);
+    scheduler = Scheduler::create(policy.scheduler.buf, config, channel,
+            policy);
     
     Coordinates coordinates = {0};
     int refresh_step = refresh_interval/rankcount;
     
+    bankStats = new BankStats*[rankcount*bankcount];
+    
     for (coordinates.rank=0; coordinates.rank<rankcount; ++coordinates.rank) {
         // initialize rank
         RankData &rank = channel->getRankData(coordinates);
@@ -38,16 +45,27 @@ MemoryController::MemoryController(Config &config, AddressMapping &mapping, Poli
             BankData &bank = channel->getBankData(coordinates);
             bank.demandCount = 0;
             bank.rowBuffer = -1;
+            bank.conflicted = false;
             bank.mapping = new int[config.rowcount];
             for (int i=0; i<config.rowcount; ++i) {
               bank.mapping[i] = i;
             }
+            
+            stringbuf bankName;
+            bankName << "rank", coordinates.rank, "_bank", coordinates.bank;
+            bankStats[coordinates.rank*bankcount + coordinates.bank] =
+                new BankStats(bankName, this);
         }
     }
 }
 
 MemoryController::~MemoryController()
 {
+    for (int i=0; i<rankcount*bankcount; ++i) {
+        delete bankStats[i];
+    }
+    delete [] bankStats;
+    delete scheduler;
     delete channel;
 }
 
@@ -62,17 +80,12 @@ bool MemoryController::addTransaction(long clock, RequestEntry *request)
     }
 
     queueEntry->request = request;
-    
-    /** Address mapping scheme goes here. */
+    queueEntry->arrival = clock;
     
     W64 address = request->request->get_physical_address();
     Coordinates &coordinates = queueEntry->coordinates;
     
-    coordinates.channel = mapping.channel.value(address);
-    coordinates.rank    = mapping.rank.value(address);
-    coordinates.bank    = mapping.bank.value(address);
-    coordinates.row     = mapping.row.value(address);
-    coordinates.column  = mapping.column.value(address);
+    mapping.decode(address, coordinates);
     
     RankData &rank = channel->getRankData(coordinates);
     BankData &bank = channel->getBankData(coordinates);
@@ -163,8 +176,10 @@ void MemoryController::doScheduling(long clock, Signal &accessCompleted_)
     
     // Schedule policy
     {
-        TransactionEntry *transaction;
-        foreach_list_mutable(pendingTransactions_.list(), transaction, entry, nextentry) {
+        scheduler->order(clock, pendingTransactions_.list(), scheduleQueue);
+        
+        foreach (i, scheduleQueue.size()) {
+            TransactionEntry *transaction = scheduleQueue[i];
             Coordinates *coordinates = &transaction->coordinates;
             RankData &rank = channel->getRankData(*coordinates);
             BankData &bank = channel->getBankData(*coordinates);
@@ -183,6 +198,8 @@ void MemoryController::doScheduling(long clock, Signal &accessCompleted_)
                 bank.hitCount >= policy.max_row_hits)) {
                 if (bank.rowBuffer != coordinates->row && bank.supplyCount > 0) continue;
                 if (!addCommand(clock, COMMAND_precharge, coordinates, NULL)) continue;
+                if (bank.rowBuffer != coordinates->row)
+                    bank.conflicted = true;
                 rank.activeCount -= 1;
                 bank.rowBuffer = -1;
             }
@@ -190,10 +207,13 @@ void MemoryController::doScheduling(long clock, Signal &accessCompleted_)
             // Activate
             if (bank.rowBuffer == -1) {
                 if (!addCommand(clock, COMMAND_activate, coordinates, NULL)) continue;
+                transaction->activated = true;
+                transaction->precharged = bank.conflicted;
                 rank.activeCount += 1;
                 bank.rowBuffer = coordinates->row;
                 bank.hitCount = 0;
                 bank.supplyCount = 0;
+                bank.conflicted = false;
                 
                 TransactionEntry *transaction2;
                 foreach_list_mutable(pendingTransactions_.list(), transaction2, entry2, nextentry2) {
@@ -217,6 +237,8 @@ void MemoryController::doScheduling(long clock, Signal &accessCompleted_)
             bank.supplyCount -= 1;
             bank.hitCount += 1;
             
+            scheduler->issued(clock, transaction);
+            update_stats(transaction);
             pendingTransactions_.free(transaction);
         }
     }
@@ -280,8 +302,222 @@ void MemoryController::doScheduling(long clock, Signal &accessCompleted_)
     }
 }
 
+/**
+ * @brief Account row buffer outcome of a transaction issued to its bank
+ */
+void MemoryController::update_stats(TransactionEntry *transaction)
+{
+    Coordinates &coordinates = transaction->coordinates;
+    BankStats &stats = *bankStats[coordinates.rank*bankcount + coordinates.bank];
+    bool kernel = transaction->request->request->is_kernel();
+
+    if (transaction->precharged) {
+        N_STAT_UPDATE(stats.row_conflict, ++, kernel);
+        N_STAT_UPDATE(totalStats.row_conflict, ++, kernel);
+    } else if (transaction->activated) {
+        N_STAT_UPDATE(stats.row_miss, ++, kernel);
+        N_STAT_UPDATE(totalStats.row_miss, ++, kernel);
+    } else {
+        N_STAT_UPDATE(stats.row_hit, ++, kernel);
+        N_STAT_UPDATE(totalStats.row_hit, ++, kernel);
+    }
+}
+
+/**
+ * @brief Save open rows and row remapping tables of all banks
+ */
+void MemoryController::save_state(UarchStateWriter &writer)
+{
+    writer.put((W32)rankcount);
+    writer.put((W32)bankcount);
+    writer.put((W32)rowcount);
+
+    Coordinates coordinates = {0};
+    for (coordinates.rank=0; coordinates.rank<rankcount; ++coordinates.rank) {
+        for (coordinates.bank=0; coordinates.bank<bankcount; ++coordinates.bank) {
+            BankData &bank = channel->getBankData(coordinates);
+            writer.put((W32)bank.rowBuffer);
+            writer.put((W32)bank.hitCount);
+            writer.put_array((const W32*)bank.mapping, rowcount);
+        }
+    }
+}
+
+/**
+ * @brief Read bank state saved by save_state()
+ *
+ * @return false if the saved organization does not match or the section
+ * is truncated, banks are not changed by this function
+ */
+bool MemoryController::read_state(UarchStateReader &reader,
+        SavedBankState &state)
+{
+    W32 ranks, banks, rows;
+
+    if (!reader.get(ranks) || !reader.get(banks) || !reader.get(rows))
+        return false;
+
+    if (ranks != (W32)rankcount || banks != (W32)bankcount ||
+            rows != (W32)rowcount)
+        return false;
+
+    int bankTotal = rankcount*bankcount;
+    state.rowBuffers = new int[bankTotal];
+    state.hitCounts = new int[bankTotal];
+    state.mappings = new int[bankTotal*rowcount];
+
+    for (int i=0; i<bankTotal; ++i) {
+        W32 rowBuffer, hitCount;
+
+        if (!reader.get(rowBuffer) || !reader.get(hitCount) ||
+                !reader.get_array((W32*)&state.mappings[i*rowcount],
+                    rowcount))
+            return false;
+
+        state.rowBuffers[i] = rowBuffer;
+        state.hitCounts[i] = hitCount;
+
+        /* Open row and remapped rows must be rows of this bank */
+        if (state.rowBuffers[i] < -1 || state.rowBuffers[i] >= rowcount)
+            return false;
+        for (int row=0; row<rowcount; ++row) {
+            int mapped = state.mappings[i*rowcount + row];
+            if (mapped < 0 || mapped >= rowcount)
+                return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief Replace bank state with state read by read_state()
+ */
+void MemoryController::apply_state(const SavedBankState &state)
+{
+    Coordinates coordinates = {0};
+    for (coordinates.rank=0; coordinates.rank<rankcount; ++coordinates.rank) {
+        RankData &rank = channel->getRankData(coordinates);
+        rank.activeCount = 0;
+        rank.is_sleeping = false;
+
+        for (coordinates.bank=0; coordinates.bank<bankcount; ++coordinates.bank) {
+            int i = coordinates.rank*bankcount + coordinates.bank;
+            BankData &bank = channel->getBankData(coordinates);
+            bank.rowBuffer = state.rowBuffers[i];
+            bank.hitCount = state.hitCounts[i];
+            bank.supplyCount = 0;
+            bank.conflicted = false;
+            memcpy(bank.mapping, &state.mappings[i*rowcount],
+                    sizeof(int)*rowcount);
+
+            if (bank.rowBuffer != -1)
+                rank.activeCount += 1;
+        }
+    }
+}
+
 extern ConfigurationParser<PTLsimConfig> config;
 
+/* Bits of the physical address that select a byte within a cache line */
+#define LINE_OFFSET_BITS 6
+
+static int field_width(long count)
+{
+    int width;
+    for (width=0; (1L<<width)<count; width+=1);
+    return width;
+}
+
+BitField &AddressMapping::field(int type)
+{
+    switch (type) {
+        case FIELD_channel: return channel;
+        case FIELD_rank:    return rank;
+        case FIELD_bank:    return bank;
+        case FIELD_row:     return row;
+        default:            return column;
+    }
+}
+
+/**
+ * @brief Setup address bit layout from a mapping scheme
+ *
+ * @param name Scheme name or layout string
+ * @param widths Number of bits of each MappingField
+ * @param offset First address bit above the cache line offset
+ *
+ * Layout strings list address fields from the least significant bit up,
+ * using 'C' for channel, 'R' for rank, 'b' for bank, 'r' for row and 'c'
+ * for column. When each letter appears once it stands for the whole
+ * field ("CcbRr" is the default layout). Otherwise the string is a bit
+ * list with one letter per address bit, so each letter must appear as
+ * many times as its field has bits. Predefined schemes are:
+ *
+ *   row_interleaved  - "cCbRr", consecutive lines fill a whole row
+ *   line_interleaved - "CbRcr", consecutive lines spread over channels,
+ *                      banks and ranks
+ *   permutation      - row_interleaved with bank XOR hashing
+ *
+ * @return false if the layout is invalid
+ */
+bool AddressMapping::setup(const char *name, const int *widths, int offset)
+{
+    static const char letters[NUM_MAPPING_FIELDS+1] = "CRbrc";
+    const char *layout = name;
+
+    if (!strcmp(name, "row_interleaved")) {
+        layout = "cCbRr";
+    } else if (!strcmp(name, "line_interleaved")) {
+        layout = "CbRcr";
+    } else if (!strcmp(name, "permutation")) {
+        layout = "cCbRr";
+        bank_xor = true;
+    }
+
+    int counts[NUM_MAPPING_FIELDS] = {0};
+    int length = strlen(layout);
+    int *types = new int[length];
+    bool whole_fields = true;
+
+    for (int i=0; i<length; ++i) {
+        const char *letter = strchr(letters, layout[i]);
+        if (!letter || !layout[i]) {
+            delete [] types;
+            return false;
+        }
+        types[i] = letter - letters;
+        counts[types[i]] += 1;
+    }
+
+    foreach (type, NUM_MAPPING_FIELDS) {
+        if (counts[type] != 1) whole_fields = false;
+    }
+
+    if (!whole_fields) {
+        /* Bit list must cover every bit of every field exactly */
+        foreach (type, NUM_MAPPING_FIELDS) {
+            if (counts[type] != widths[type] || widths[type] > MAX_FIELD_BITS) {
+                delete [] types;
+                return false;
+            }
+        }
+    }
+
+    for (int i=0; i<length; ++i) {
+        BitField &bitfield = field(types[i]);
+        int bitcount = whole_fields ? widths[types[i]] : 1;
+        for (int b=0; b<bitcount; ++b) {
+            bitfield.add_bit(offset++);
+        }
+    }
+
+    delete [] types;
+
+    scheme << name;
+    return true;
+}
+
 MemoryControllerHub::MemoryControllerHub(W8 coreid, const char *name,
         MemoryHierarchy *memoryHierarchy, int type) :
     Controller(coreid, name, memoryHierarchy)
@@ -289,6 +525,7 @@ MemoryControllerHub::MemoryControllerHub(W8 coreid, const char *name,
     memoryHierarchy_->add_mem_controller(this);
     
     int asym_mat_group, asym_mat_ratio;
+    stringbuf mapping_scheme;
     
     {
         BaseMachine &machine = memoryHierarchy_->get_machine();
@@ -298,7 +535,17 @@ MemoryControllerHub::MemoryControllerHub(W8 coreid, const char *name,
         option(policy.max_row_idle, "max_row_idle", 0);
         option(asym_mat_group, "asym_mat_group", 1);
         option(asym_mat_ratio, "asym_mat_ratio", 0);
+        option(mapping.bank_xor, "bank_xor", false);
+        option(policy.write_high_watermark, "write_high_watermark", MEM_TRANS_NUM*3/4);
+        option(policy.write_low_watermark, "write_low_watermark", MEM_TRANS_NUM/4);
+        option(policy.batch_cap, "batch_cap", 5);
+        option(policy.quantum, "quantum", 100000);
+        option(policy.starvation_limit, "starvation_limit", 10000);
 #undef option
+        if (!machine.get_option(name, "mapping", mapping_scheme))
+            mapping_scheme << "CcbRr";
+        if (!machine.get_option(name, "scheduler", policy.scheduler))
+            policy.scheduler << "fcfs";
     }
     
     {
@@ -315,27 +562,45 @@ MemoryControllerHub::MemoryControllerHub(W8 coreid, const char *name,
         clock_rem = 0;
         clock_mem = 0;
     
-        int channel, rank, row;
-        for (channel=0; (1<<channel)<dramconfig.channelcount; channel+=1);
-        for (rank=0; (1<<rank)<dramconfig.rankcount; rank+=1);
-        for (row=0; (1L<<(row+13+3))<dramconfig.ranksize; row+=1);
-
-        int offset = 6;
-        mapping.channel.offset = offset; offset +=
-        mapping.channel.width  = channel;
-        mapping.column.offset  = offset; offset +=
-        mapping.column.width   = 7;
-        mapping.bank.offset    = offset; offset +=
-        mapping.bank.width     = 3;
-        mapping.rank.offset    = offset; offset +=
-        mapping.rank.width     = rank;
-        mapping.row.offset     = offset; offset +=
-        mapping.row.width      = row;
+        int widths[NUM_MAPPING_FIELDS];
+        widths[FIELD_channel] = field_width(dramconfig.channelcount);
+        widths[FIELD_rank]    = field_width(dramconfig.rankcount);
+        widths[FIELD_bank]    = field_width(dramconfig.bankcount);
+        widths[FIELD_row]     = field_width(dramconfig.rowcount);
+        widths[FIELD_column]  = field_width(dramconfig.columncount >> LINE_OFFSET_BITS);
+
+        if (!mapping.setup(mapping_scheme.buf, widths, LINE_OFFSET_BITS)) {
+            ptl_logfile << "[ERROR] ", name, ": invalid DRAM address mapping '",
+                        mapping_scheme, "'", endl;
+            cerr << "[ERROR] " << name << ": invalid DRAM address mapping '"
+                 << mapping_scheme << "'" << endl;
+            assert_fail(__STRING(0), __FILE__, __LINE__, __PRETTY_FUNCTION__);
+        }
+    }
+    
+    stats = new Statable(name, &memoryHierarchy_->get_machine());
+    totalStats = new BankStats("total", stats);
+    
+    foreach (i, NUM_SIM_CORES) {
+        stringbuf coreName;
+        coreName << "core", i;
+        coreStats[i] = new CoreServiceStats(coreName, stats);
     }
     
     controller = new MemoryController*[channelcount];
     for (int channel=0; channel<channelcount; ++channel) {
-        controller[channel] = new MemoryController(dramconfig, mapping, policy);
+        stringbuf channelName;
+        channelName << "channel", channel;
+        controller[channel] = new MemoryController(dramconfig, mapping, policy,
+                channelName, stats, *totalStats);
+        
+        if (!controller[channel]->scheduler) {
+            ptl_logfile << "[ERROR] ", name, ": unknown DRAM scheduler '",
+                        policy.scheduler, "'", endl;
+            cerr << "[ERROR] " << name << ": unknown DRAM scheduler '"
+                 << policy.scheduler << "'" << endl;
+            assert_fail(__STRING(0), __FILE__, __LINE__, __PRETTY_FUNCTION__);
+        }
     }
     
     SET_SIGNAL_CB(name, "_Access_Completed", accessCompleted_,
@@ -351,6 +616,11 @@ MemoryControllerHub::~MemoryControllerHub()
         delete controller[channel];
     }
     delete [] controller;
+    foreach (i, NUM_SIM_CORES) {
+        delete coreStats[i];
+    }
+    delete totalStats;
+    delete stats;
 }
 
 void MemoryControllerHub::register_interconnect(Interconnect *interconnect,
@@ -369,7 +639,7 @@ bool MemoryControllerHub::handle_interconnect_cb(void *arg)
 {
     Message *message = (Message*)arg;
     
-    int channel = mapping.channel.value(message->request->get_physical_address());
+    int channel = mapping.get_channel(message->request->get_physical_address());
 
     //memdebug("Received message in Memory controller: ", *message, endl);
 
@@ -432,8 +702,10 @@ bool MemoryControllerHub::handle_interconnect_cb(void *arg)
 
     queueEntry->request = message->request;
     queueEntry->source = (Controller*)message->origin;
+    queueEntry->arrival = sim_cycle;
 
     queueEntry->request->incRefCounter();
+    queueEntry->request->set_miss(MAIN_MEMORY);
     ADD_HISTORY_ADD(queueEntry->request);
 
     /* yclin */
@@ -458,13 +730,15 @@ bool MemoryControllerHub::access_completed_cb(void *arg)
 {
     RequestEntry *queueEntry = (RequestEntry*)arg;
     
-    int channel = mapping.channel.value(queueEntry->request->get_physical_address());
+    int channel = mapping.get_channel(queueEntry->request->get_physical_address());
 
     if(!queueEntry->annuled) {
 
         /* Send response back to cache */
         //memdebug("Memory access done for Request: ", *queueEntry->request, endl);
 
+        update_service_stats(queueEntry);
+
         wait_interconnect_cb(queueEntry);
     } else {
         queueEntry->request->decRefCounter();
@@ -475,11 +749,38 @@ bool MemoryControllerHub::access_completed_cb(void *arg)
     return true;
 }
 
+/**
+ * @brief Account served request to its core
+ */
+void MemoryControllerHub::update_service_stats(RequestEntry *queueEntry)
+{
+    MemoryRequest *request = queueEntry->request;
+    int coreid = request->get_coreid();
+    if (coreid >= NUM_SIM_CORES) return;
+
+    CoreServiceStats &stats = *coreStats[coreid];
+    bool kernel = request->is_kernel();
+
+    if (request->get_type() == MEMORY_OP_UPDATE) {
+        N_STAT_UPDATE(stats.writes, ++, kernel);
+        return;
+    }
+
+    W64 latency = sim_cycle - queueEntry->arrival;
+    int bucket = 0;
+    while (bucket < DRAM_LATENCY_BUCKETS-1 && (latency >> (bucket+1)))
+        bucket += 1;
+
+    N_STAT_UPDATE(stats.reads, ++, kernel);
+    N_STAT_UPDATE(stats.read_latency, += latency, kernel);
+    N_STAT_UPDATE(stats.read_latency_histogram, [bucket]++, kernel);
+}
+
 bool MemoryControllerHub::wait_interconnect_cb(void *arg)
 {
     RequestEntry *queueEntry = (RequestEntry*)arg;
     
-    int channel = mapping.channel.value(queueEntry->request->get_physical_address());
+    int channel = mapping.get_channel(queueEntry->request->get_physical_address());
 
     bool success = false;
 
@@ -497,6 +798,10 @@ bool MemoryControllerHub::wait_interconnect_cb(void *arg)
     message.dest = queueEntry->source;
     message.request = queueEntry->request;
     message.hasData = true;
+    /* Memory is guest RAM, writebacks need not update it */
+    message.data = memoryHierarchy_->read_memory_data(
+        queueEntry->request->get_physical_address(),
+        queueEntry->request->is_kernel());
 
     //memdebug("Memory sending message: ", message);
     success = cacheInterconnect_->get_controller_request_signal()->
@@ -534,7 +839,7 @@ void MemoryControllerHub::clock()
 
 void MemoryControllerHub::annul_request(MemoryRequest *request)
 {
-    int channel = mapping.channel.value(request->get_physical_address());
+    int channel = mapping.get_channel(request->get_physical_address());
     
     RequestEntry *queueEntry;
     foreach_list_mutable(controller[channel]->pendingRequests_.list(), queueEntry,
@@ -575,11 +880,63 @@ void MemoryControllerHub::dump_configuration(YAML::Emitter &out) const
 
     YAML_KEY_VAL(out, "type", "dram_module");
     YAML_KEY_VAL(out, "RAM_size", ram_size); /* ram_size is from QEMU */
+    YAML_KEY_VAL(out, "channels", channelcount);
+    YAML_KEY_VAL(out, "ranks", dramconfig.rankcount);
+    YAML_KEY_VAL(out, "banks", dramconfig.bankcount);
+    YAML_KEY_VAL(out, "mapping", mapping.scheme.buf);
+    YAML_KEY_VAL(out, "bank_xor", mapping.bank_xor);
+    YAML_KEY_VAL(out, "scheduler", policy.scheduler.buf);
     //YAML_KEY_VAL(out, "pending_queue_size", pendingRequests_.size());
 
     out << YAML::EndMap;
 }
 
+/**
+ * @brief Save DRAM bank state into micro-architectural checkpoint
+ *
+ * @param writer Checkpoint writer positioned in this module's section
+ */
+void MemoryControllerHub::save_state(UarchStateWriter &writer) const
+{
+    writer.put((W32)channelcount);
+    for (int channel=0; channel<channelcount; ++channel) {
+        controller[channel]->save_state(writer);
+    }
+}
+
+/**
+ * @brief Restore DRAM bank state from micro-architectural checkpoint
+ *
+ * @param reader Checkpoint reader positioned in this module's section
+ *
+ * @return false if saved DRAM organization does not match
+ */
+bool MemoryControllerHub::restore_state(UarchStateReader &reader)
+{
+    W32 channels;
+
+    if (!reader.get(channels) || channels != (W32)channelcount)
+        return false;
+
+    /* Apply only once every channel was read */
+    SavedBankState *state = new SavedBankState[channelcount];
+    bool rc = true;
+
+    for (int channel=0; rc && channel<channelcount; ++channel) {
+        rc = controller[channel]->read_state(reader, state[channel]);
+    }
+
+    if (rc) {
+        for (int channel=0; channel<channelcount; ++channel) {
+            controller[channel]->apply_state(state[channel]);
+        }
+    }
+
+    delete [] state;
+
+    return rc;
+}
+
 /* Memory Controller Builder */
 struct MemoryControllerHubBuilder : public ControllerBuilder
 {
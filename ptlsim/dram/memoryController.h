@@ -4,37 +4,130 @@
 #include <controller.h>
 #include <interconnect.h>
 #include <superstl.h>
+#include <memoryStats.h>
 
 #include <memoryModule.h>
+#include <memoryScheduler.h>
 
 using namespace Memory;
 
 namespace DRAM {
     
+#define MAX_FIELD_BITS 32
+
+/*
+ * A field of the physical address. Most mapping schemes use contiguous
+ * bits which are extracted with a shift and mask, user specified bit
+ * lists may scatter a field over the address and use the bits[] table.
+ */
 struct BitField {
     unsigned width;
     unsigned offset;
+    bool contiguous;
+    W8 bits[MAX_FIELD_BITS];
+    
+    BitField() : width(0), offset(0), contiguous(true) {}
     
-    long value(long address) {
-        return (address >> offset) & ((1 << width) - 1);
+    long value(W64 address) const {
+        if (contiguous)
+            return (address >> offset) & (((W64)1 << width) - 1);
+        
+        long result = 0;
+        for (unsigned i=0; i<width; ++i) {
+            result |= ((address >> bits[i]) & 1) << i;
+        }
+        return result;
     }
     
-    long filter(long address) {
-        return address & (((1 << width) - 1) << offset);
+    void add_bit(unsigned bit) {
+        assert(width < MAX_FIELD_BITS);
+        if (width == 0) offset = bit;
+        if (bit != offset + width) contiguous = false;
+        bits[width++] = bit;
     }
 };
 
+enum MappingField {
+    FIELD_channel,
+    FIELD_rank,
+    FIELD_bank,
+    FIELD_row,
+    FIELD_column,
+    NUM_MAPPING_FIELDS,
+};
+
 struct AddressMapping {
     BitField channel;
     BitField rank;
     BitField bank;
     BitField row;
     BitField column;
+    
+    /* Permutation-based interleaving: bank index is XORed with row bits */
+    bool bank_xor;
+    
+    stringbuf scheme;
+    
+    AddressMapping() : bank_xor(false) {}
+    
+    BitField &field(int type);
+    bool setup(const char *name, const int *widths, int offset);
+    
+    int get_channel(W64 address) const {
+        return channel.value(address);
+    }
+    
+    void decode(W64 address, Coordinates &coordinates) const {
+        coordinates.channel = channel.value(address);
+        coordinates.rank    = rank.value(address);
+        coordinates.bank    = bank.value(address);
+        coordinates.row     = row.value(address);
+        coordinates.column  = column.value(address);
+        
+        if (bank_xor) {
+            coordinates.bank ^= coordinates.row & ((1 << bank.width) - 1);
+        }
+    }
 };
 
 struct Policy {
     int max_row_idle;
     int max_row_hits;
+    
+    stringbuf scheduler;
+    int write_high_watermark;
+    int write_low_watermark;
+    int batch_cap;
+    int quantum;
+    int starvation_limit;
+};
+
+/*
+ * Row buffer outcome of column accesses:
+ *   row_hit      - row was already open
+ *   row_miss     - bank was precharged, row had to be activated
+ *   row_conflict - an other row was open and had to be closed first, also
+ *                  when the precharge was issued for an other transaction
+ */
+struct BankStats : public Statable
+{
+    StatObj<W64> row_hit;
+    StatObj<W64> row_miss;
+    StatObj<W64> row_conflict;
+
+    BankStats(const char *name, Statable *parent)
+        : Statable(name, parent)
+          , row_hit("row_hit", this)
+          , row_miss("row_miss", this)
+          , row_conflict("row_conflict", this)
+    {}
+
+    BankStats(stringbuf &name, Statable *parent)
+        : Statable(name, parent)
+          , row_hit("row_hit", this)
+          , row_miss("row_miss", this)
+          , row_conflict("row_conflict", this)
+    {}
 };
 
 
@@ -45,9 +138,11 @@ struct RequestEntry : public FixStateListObject
     Controller *source;
     bool annuled;
     bool issued;
+    W64 arrival;
 
     void init() {
         request = NULL;
+        arrival = 0;
         annuled = false;
         issued = false;
     }
@@ -68,9 +163,17 @@ struct TransactionEntry : public FixStateListObject
 {
     RequestEntry *request;    
     Coordinates coordinates;
+    bool activated;
+    bool precharged;
+    bool marked;
+    long arrival;
 
     void init() {
         request = NULL;
+        activated = false;
+        precharged = false;
+        marked = false;
+        arrival = 0;
     }
 };
 
@@ -90,7 +193,48 @@ struct CommandEntry : public FixStateListObject
 
 
 
-class MemoryController
+#define DRAM_LATENCY_BUCKETS 16
+
+/*
+ * Per core service of a memory module, read latency is measured in core
+ * cycles from arrival at the memory controller to data return and its
+ * histogram uses power of two buckets: [0,2), [2,4), [4,8) ...
+ */
+struct CoreServiceStats : public Statable
+{
+    StatObj<W64> reads;
+    StatObj<W64> writes;
+    StatObj<W64> read_latency;
+    StatArray<W64, DRAM_LATENCY_BUCKETS> read_latency_histogram;
+
+    CoreServiceStats(stringbuf &name, Statable *parent)
+        : Statable(name, parent)
+          , reads("reads", this)
+          , writes("writes", this)
+          , read_latency("read_latency", this)
+          , read_latency_histogram("read_latency_histogram", this)
+    {}
+};
+
+/*
+ * Bank state of one channel read from a uarch checkpoint, it is applied
+ * only once all channels were read.
+ */
+struct SavedBankState
+{
+    int *rowBuffers;
+    int *hitCounts;
+    int *mappings;
+
+    SavedBankState() : rowBuffers(NULL), hitCounts(NULL), mappings(NULL) {}
+    ~SavedBankState() {
+        delete [] rowBuffers;
+        delete [] hitCounts;
+        delete [] mappings;
+    }
+};
+
+class MemoryController : public Statable
 {
     private:
         AddressMapping &mapping;
@@ -98,13 +242,23 @@ class MemoryController
     
         int rankcount;
         int bankcount;
+        int rowcount;
         int refresh_interval;
 
+        BankStats **bankStats;
+        BankStats &totalStats;
+
+        dynarray<TransactionEntry*> scheduleQueue;
+
+        void update_stats(TransactionEntry *transaction);
+
     public:
-        MemoryController(Config &config, AddressMapping &mapping, Policy &policy);
+        MemoryController(Config &config, AddressMapping &mapping, Policy &policy,
+                stringbuf &name, Statable *parent, BankStats &totalStats);
         virtual ~MemoryController();
         
         Channel *channel;
+        Scheduler *scheduler;
         
         FixStateList<RequestEntry, MEM_REQ_NUM> pendingRequests_;
         FixStateList<TransactionEntry, MEM_TRANS_NUM> pendingTransactions_;
@@ -113,6 +267,10 @@ class MemoryController
         bool addTransaction(long clock, RequestEntry *request);
         bool addCommand(long clock, CommandType type, Coordinates *coordinates, RequestEntry *request);
         void doScheduling(long clock, Signal &accessCompleted_);
+
+        void save_state(UarchStateWriter &writer);
+        bool read_state(UarchStateReader &reader, SavedBankState &state);
+        void apply_state(const SavedBankState &state);
 };
 
 class MemoryControllerHub : public Controller
@@ -127,6 +285,11 @@ class MemoryControllerHub : public Controller
         Policy policy;
     
         Config dramconfig;
+        Statable *stats;
+        BankStats *totalStats;
+        CoreServiceStats *coreStats[NUM_SIM_CORES];
+
+        void update_service_stats(RequestEntry *queueEntry);
         int channelcount;
         
         MemoryController **controller;
@@ -147,6 +310,8 @@ class MemoryControllerHub : public Controller
 
         void annul_request(MemoryRequest *request);
         void dump_configuration(YAML::Emitter &out) const;
+        void save_state(UarchStateWriter &writer) const;
+        bool restore_state(UarchStateReader &reader);
 
         int get_no_pending_request(W8 coreid);
         bool is_full(bool fromInterconnect = false) const {
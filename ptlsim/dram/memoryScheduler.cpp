@@ -0,0 +1,298 @@
+#ifdef MEM_TEST
+#include <test.h>
+#else
+#include <ptlsim.h>
+#endif
+
+#include <memoryScheduler.h>
+#include <memoryController.h>
+
+using namespace DRAM;
+
+Scheduler::Scheduler(Config &config, Channel *channel, Policy &policy) :
+    channel(channel), policy(policy), rankcount(config.rankcount),
+    bankcount(config.bankcount)
+{
+}
+
+bool Scheduler::is_row_hit(TransactionEntry *transaction)
+{
+    BankData &bank = channel->getBankData(transaction->coordinates);
+    return bank.rowBuffer == transaction->coordinates.row;
+}
+
+bool Scheduler::is_write(TransactionEntry *transaction)
+{
+    return transaction->request->request->get_type() == MEMORY_OP_UPDATE;
+}
+
+int Scheduler::get_coreid(TransactionEntry *transaction)
+{
+    int coreid = transaction->request->request->get_coreid();
+    return (coreid < NUM_SIM_CORES) ? coreid : 0;
+}
+
+/**
+ * @brief Build the list of transactions to consider in this cycle
+ *
+ * @param clock Memory clock
+ * @param transactions Pending transactions in arrival order
+ * @param queue Filled with eligible transactions, highest priority first
+ */
+void Scheduler::order(long clock, StateList &transactions,
+        dynarray<TransactionEntry*> &queue)
+{
+    queue.clear();
+    prepare(clock, transactions);
+
+    TransactionEntry *transaction;
+    foreach_list_mutable(transactions, transaction, entry, nextentry) {
+        if (!is_eligible(transaction)) continue;
+
+        /* Insertion sort, stable so ties keep arrival order */
+        queue.push(transaction);
+        int i = queue.size() - 1;
+        while (i > 0 && has_priority(transaction, queue[i-1])) {
+            queue[i] = queue[i-1];
+            i -= 1;
+        }
+        queue[i] = transaction;
+    }
+}
+
+/* First-Ready First-Come-First-Served */
+class FRFCFSScheduler : public Scheduler
+{
+    protected:
+        bool has_priority(TransactionEntry *a, TransactionEntry *b)
+        {
+            return is_row_hit(a) && !is_row_hit(b);
+        }
+
+    public:
+        FRFCFSScheduler(Config &config, Channel *channel,
+                Policy &policy) :
+            Scheduler(config, channel, policy)
+        {}
+};
+
+/*
+ * Write drain: reads are served while writes are buffered, once the number
+ * of pending writes reaches the high watermark only writes are served until
+ * it falls to the low watermark. Writes are also served when no read is
+ * pending.
+ */
+class WriteDrainScheduler : public FRFCFSScheduler
+{
+    private:
+        bool draining;
+        bool serveWrites;
+
+    protected:
+        void prepare(long clock, StateList &transactions)
+        {
+            int reads = 0, writes = 0;
+
+            TransactionEntry *transaction;
+            foreach_list_mutable(transactions, transaction, entry, nextentry) {
+                if (is_write(transaction))
+                    writes += 1;
+                else
+                    reads += 1;
+            }
+
+            if (writes >= policy.write_high_watermark)
+                draining = true;
+            else if (writes <= policy.write_low_watermark)
+                draining = false;
+
+            serveWrites = draining || reads == 0;
+        }
+
+        bool is_eligible(TransactionEntry *transaction)
+        {
+            return is_write(transaction) == serveWrites;
+        }
+
+    public:
+        WriteDrainScheduler(Config &config, Channel *channel,
+                Policy &policy) :
+            FRFCFSScheduler(config, channel, policy), draining(false),
+            serveWrites(false)
+        {}
+};
+
+/*
+ * Parallelism-Aware Batch Scheduling
+ *
+ * When the current batch is served, up to batch_cap oldest transactions
+ * of each core to each bank are marked as the new batch. Marked
+ * transactions go first, then row hits, then transactions of cores with
+ * the lowest maximum per-bank load in the batch (shortest job first).
+ */
+class PARBSScheduler : public Scheduler
+{
+    private:
+        int maxLoad[NUM_SIM_CORES];
+        int totalLoad[NUM_SIM_CORES];
+
+        /* Marked transactions per core and bank while forming a batch */
+        int *batchLoad;
+        int markedCount;
+
+        int &batch_load(TransactionEntry *transaction)
+        {
+            Coordinates &coordinates = transaction->coordinates;
+            int bank = coordinates.rank*bankcount + coordinates.bank;
+            return batchLoad[get_coreid(transaction)*rankcount*bankcount + bank];
+        }
+
+    protected:
+        void prepare(long clock, StateList &transactions)
+        {
+            if (markedCount > 0) return;
+
+            /* Form a new batch and rank cores */
+            foreach (i, NUM_SIM_CORES) {
+                maxLoad[i] = 0;
+                totalLoad[i] = 0;
+            }
+            memset(batchLoad, 0, sizeof(int)*NUM_SIM_CORES*rankcount*bankcount);
+
+            TransactionEntry *transaction;
+            foreach_list_mutable(transactions, transaction, entry, nextentry) {
+                int &load = batch_load(transaction);
+                if (load >= policy.batch_cap) continue;
+
+                int coreid = get_coreid(transaction);
+                transaction->marked = true;
+                markedCount += 1;
+                load += 1;
+                maxLoad[coreid] = max(maxLoad[coreid], load);
+                totalLoad[coreid] += 1;
+            }
+        }
+
+        bool has_priority(TransactionEntry *a, TransactionEntry *b)
+        {
+            if (a->marked != b->marked) return a->marked;
+
+            bool hitA = is_row_hit(a), hitB = is_row_hit(b);
+            if (hitA != hitB) return hitA;
+
+            int coreA = get_coreid(a), coreB = get_coreid(b);
+            if (maxLoad[coreA] != maxLoad[coreB])
+                return maxLoad[coreA] < maxLoad[coreB];
+            return totalLoad[coreA] < totalLoad[coreB];
+        }
+
+    public:
+        PARBSScheduler(Config &config, Channel *channel,
+                Policy &policy) :
+            Scheduler(config, channel, policy), markedCount(0)
+        {
+            foreach (i, NUM_SIM_CORES) {
+                maxLoad[i] = 0;
+                totalLoad[i] = 0;
+            }
+            batchLoad = new int[NUM_SIM_CORES*rankcount*bankcount];
+        }
+
+        ~PARBSScheduler()
+        {
+            delete [] batchLoad;
+        }
+
+        void issued(long clock, TransactionEntry *transaction)
+        {
+            if (transaction->marked)
+                markedCount -= 1;
+        }
+};
+
+/*
+ * Adaptive per-Thread Least-Attained-Service
+ *
+ * Service attained by each core is accumulated over a quantum and
+ * averaged with previous quanta. Transactions waiting for longer than
+ * starvation_limit go first, then cores with the least attained service,
+ * then row hits.
+ */
+class ATLASScheduler : public Scheduler
+{
+    private:
+        double attained[NUM_SIM_CORES];
+        double current[NUM_SIM_CORES];
+        long quantumEnd;
+        long now;
+
+        bool is_starving(TransactionEntry *transaction)
+        {
+            return now - transaction->arrival > policy.starvation_limit;
+        }
+
+    protected:
+        void prepare(long clock, StateList &transactions)
+        {
+            now = clock;
+            if (clock < quantumEnd) return;
+
+            foreach (i, NUM_SIM_CORES) {
+                attained[i] = 0.875*attained[i] + 0.125*current[i];
+                current[i] = 0;
+            }
+            quantumEnd = clock + policy.quantum;
+        }
+
+        bool has_priority(TransactionEntry *a, TransactionEntry *b)
+        {
+            bool starvingA = is_starving(a), starvingB = is_starving(b);
+            if (starvingA != starvingB) return starvingA;
+
+            int coreA = get_coreid(a), coreB = get_coreid(b);
+            if (attained[coreA] != attained[coreB])
+                return attained[coreA] < attained[coreB];
+
+            return is_row_hit(a) && !is_row_hit(b);
+        }
+
+    public:
+        ATLASScheduler(Config &config, Channel *channel,
+                Policy &policy) :
+            Scheduler(config, channel, policy), quantumEnd(0), now(0)
+        {
+            foreach (i, NUM_SIM_CORES) {
+                attained[i] = 0;
+                current[i] = 0;
+            }
+        }
+
+        void issued(long clock, TransactionEntry *transaction)
+        {
+            current[get_coreid(transaction)] += 1;
+        }
+};
+
+/**
+ * @brief Create a transaction scheduler
+ *
+ * @param name Scheduler name as given in machine configuration
+ *
+ * @return NULL if there is no scheduler of that name
+ */
+Scheduler *Scheduler::create(const char *name, Config &config,
+        Channel *channel, Policy &policy)
+{
+    if (!strcmp(name, "fcfs"))
+        return new Scheduler(config, channel, policy);
+    if (!strcmp(name, "frfcfs"))
+        return new FRFCFSScheduler(config, channel, policy);
+    if (!strcmp(name, "write_drain"))
+        return new WriteDrainScheduler(config, channel, policy);
+    if (!strcmp(name, "parbs"))
+        return new PARBSScheduler(config, channel, policy);
+    if (!strcmp(name, "atlas"))
+        return new ATLASScheduler(config, channel, policy);
+
+    return NULL;
+}
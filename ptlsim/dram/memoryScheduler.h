@@ -0,0 +1,63 @@
+#ifndef MEMORY_SCHEDULER_H
+#define MEMORY_SCHEDULER_H
+
+#include <superstl.h>
+#include <statelist.h>
+
+#include <memoryModule.h>
+
+namespace DRAM {
+
+struct Policy;
+struct TransactionEntry;
+
+/*
+ * Transaction scheduler
+ *
+ * Every memory cycle the controller asks its scheduler for the order in
+ * which pending transactions are considered. A scheduler can hide some
+ * transactions for this cycle (is_eligible) and sorts the remaining ones
+ * with has_priority, ties keep arrival order. Schedulers are selected by
+ * name with the 'scheduler' option of a dram_module:
+ *
+ *   fcfs        - arrival order (default)
+ *   frfcfs      - row hits first, then arrival order
+ *   write_drain - frfcfs serving reads, writes are drained in bursts
+ *                 between high and low watermarks to limit bus turnarounds
+ *   parbs       - parallelism-aware batching, oldest requests of each core
+ *                 are batched and cores with lighter load are served first
+ *   atlas       - cores with least attained service are served first
+ */
+class Scheduler
+{
+    protected:
+        Channel *channel;
+        Policy &policy;
+        int rankcount;
+        int bankcount;
+
+        bool is_row_hit(TransactionEntry *transaction);
+        bool is_write(TransactionEntry *transaction);
+        int get_coreid(TransactionEntry *transaction);
+
+        virtual void prepare(long clock, StateList &transactions) {}
+        virtual bool is_eligible(TransactionEntry *transaction) { return true; }
+        virtual bool has_priority(TransactionEntry *a, TransactionEntry *b) { return false; }
+
+    public:
+        Scheduler(Config &config, Channel *channel, Policy &policy);
+        virtual ~Scheduler() {}
+
+        void order(long clock, StateList &transactions,
+                dynarray<TransactionEntry*> &queue);
+
+        /* Called when a read or write of the transaction is issued */
+        virtual void issued(long clock, TransactionEntry *transaction) {}
+
+        static Scheduler *create(const char *name, Config &config,
+                Channel *channel, Policy &policy);
+};
+
+};
+
+#endif // MEMORY_SCHEDULER_H
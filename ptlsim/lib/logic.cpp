@@ -0,0 +1,357 @@
+//
+// Vectorized associative tag search kernels
+//
+// Modification for MARSSx86
+//
+// This program is free software; it is licensed under the
+// GNU General Public License, Version 2.
+//
+
+#include <globals.h>
+#include <superstl.h>
+#include <logic.h>
+
+//
+// Every kernel writes one mask bit per tag into <mask>, packed in
+// tag order. A tag matches when (tag & a) == b; the result is then
+// XORed with <invert>. Exact matching uses a = all ones, b = target
+// and invert = 0, "any bit set" matching uses a = target, b = 0 and
+// invert = all ones. The 8-bit kernels write 16 bits per 16-byte
+// chunk, the 16-bit kernels 8 bits per chunk.
+//
+// The wider kernels handle as many chunks as fit in whole vectors
+// and finish the remaining chunks with SSE2.
+//
+
+static inline void assoc_match8_sse2_chunks(void* mask, const vec16b* tags, byte a, byte b, W64 invert, int first, int chunks) {
+  vec16b va = x86_sse_dupb(a);
+  vec16b vb = x86_sse_dupb(b);
+  W16* out = (W16*)mask;
+
+  for (int i = first; i < chunks; i++) {
+    out[i] = x86_sse_pmovmskb(x86_sse_pcmpeqb(x86_sse_pandb(tags[i], va), vb)) ^ (W16)invert;
+  }
+}
+
+static inline void assoc_match16_sse2_chunks(void* mask, const vec8w* tags, W16 a, W16 b, W64 invert, int first, int chunks) {
+  vec8w va = x86_sse_dupw(a);
+  vec8w vb = x86_sse_dupw(b);
+  byte* out = (byte*)mask;
+
+  for (int i = first; i < chunks; i++) {
+    out[i] = x86_sse_pmovmskw(x86_sse_pcmpeqw(x86_sse_pandw(tags[i], va), vb)) ^ (byte)invert;
+  }
+}
+
+static inline W64 assoc_onehot_sse2_chunks(const vec16b* tags, const byte* targets, int slices, int stride, int first, int chunks) {
+  W64 sum = 0;
+
+  for (int i = first; i < chunks; i++) {
+    vec16b eq = *((vec16b*)&index_bytes_plus1_vec16b[i]);
+    foreach (j, slices) {
+      eq = x86_sse_pandb(x86_sse_pcmpeqb(tags[j*stride + i], x86_sse_dupb(targets[j])), eq);
+    }
+    vec16b s = x86_sse_psadbw(eq, x86_sse_zerob());
+    sum += x86_sse_pextrw<0>(s) + x86_sse_pextrw<4>(s);
+  }
+
+  return sum;
+}
+
+//
+// SSE2
+//
+
+static void assoc_match8_sse2(void* mask, const vec16b* tags, byte a, byte b, W64 invert, int chunks) {
+  assoc_match8_sse2_chunks(mask, tags, a, b, invert, 0, chunks);
+}
+
+static void assoc_match16_sse2(void* mask, const vec8w* tags, W16 a, W16 b, W64 invert, int chunks) {
+  assoc_match16_sse2_chunks(mask, tags, a, b, invert, 0, chunks);
+}
+
+static W64 assoc_onehot_sse2(const vec16b* tags, const byte* targets, int slices, int stride, int chunks) {
+  return assoc_onehot_sse2_chunks(tags, targets, slices, stride, 0, chunks);
+}
+
+//
+// AVX2: 32-byte compares, two chunks per iteration
+//
+
+static void assoc_match8_avx2(void* mask, const vec16b* tags, byte a, byte b, W64 invert, int chunks) {
+  int n = chunks / 2;
+
+  if (n) {
+    const vec16b* p = tags;
+    W32* out = (W32*)mask;
+
+    asm volatile("vpbroadcastb %[a],%%ymm0\n"
+                 "vpbroadcastb %[b],%%ymm1\n"
+                 "1:\n"
+                 "vpand (%[p]),%%ymm0,%%ymm2\n"
+                 "vpcmpeqb %%ymm1,%%ymm2,%%ymm2\n"
+                 "vpmovmskb %%ymm2,%%eax\n"
+                 "xorl %k[inv],%%eax\n"
+                 "movl %%eax,(%[out])\n"
+                 "addq $32,%[p]\n"
+                 "addq $4,%[out]\n"
+                 "decl %[n]\n"
+                 "jnz 1b\n"
+                 "vzeroupper\n"
+                 : [p] "+r" (p), [out] "+r" (out), [n] "+r" (n)
+                 : [a] "m" (a), [b] "m" (b), [inv] "r" (invert)
+                 : "rax", "xmm0", "xmm1", "xmm2", "memory", "cc");
+  }
+
+  assoc_match8_sse2_chunks(mask, tags, a, b, invert, chunks & ~1, chunks);
+}
+
+static void assoc_match16_avx2(void* mask, const vec8w* tags, W16 a, W16 b, W64 invert, int chunks) {
+  int n = chunks / 4;
+
+  if (n) {
+    const vec8w* p = tags;
+    W32* out = (W32*)mask;
+
+    // vpacksswb packs within 128-bit lanes, vpermq restores tag order
+    asm volatile("vpbroadcastw %[a],%%ymm0\n"
+                 "vpbroadcastw %[b],%%ymm1\n"
+                 "1:\n"
+                 "vpand (%[p]),%%ymm0,%%ymm2\n"
+                 "vpand 32(%[p]),%%ymm0,%%ymm3\n"
+                 "vpcmpeqw %%ymm1,%%ymm2,%%ymm2\n"
+                 "vpcmpeqw %%ymm1,%%ymm3,%%ymm3\n"
+                 "vpacksswb %%ymm3,%%ymm2,%%ymm2\n"
+                 "vpermq $0xd8,%%ymm2,%%ymm2\n"
+                 "vpmovmskb %%ymm2,%%eax\n"
+                 "xorl %k[inv],%%eax\n"
+                 "movl %%eax,(%[out])\n"
+                 "addq $64,%[p]\n"
+                 "addq $4,%[out]\n"
+                 "decl %[n]\n"
+                 "jnz 1b\n"
+                 "vzeroupper\n"
+                 : [p] "+r" (p), [out] "+r" (out), [n] "+r" (n)
+                 : [a] "m" (a), [b] "m" (b), [inv] "r" (invert)
+                 : "rax", "xmm0", "xmm1", "xmm2", "xmm3", "memory", "cc");
+  }
+
+  assoc_match16_sse2_chunks(mask, tags, a, b, invert, chunks & ~3, chunks);
+}
+
+static W64 assoc_onehot_avx2(const vec16b* tags, const byte* targets, int slices, int stride, int chunks) {
+  int n = chunks / 2;
+  W64 sum = 0;
+
+  if (n) {
+    const vec16b* p = tags;
+    const byte* idx = &index_bytes_plus1_vec16b[0][0];
+    W64 stridebytes = stride * sizeof(vec16b);
+
+    asm volatile("vpxor %%xmm3,%%xmm3,%%xmm3\n"
+                 "vpxor %%xmm4,%%xmm4,%%xmm4\n"
+                 "1:\n"
+                 "vmovdqu (%[idx]),%%ymm2\n"
+                 "movq %[p],%%r10\n"
+                 "movq %[t],%%r11\n"
+                 "movl %[slices],%%ecx\n"
+                 "2:\n"
+                 "vpbroadcastb (%%r11),%%ymm0\n"
+                 "vpcmpeqb (%%r10),%%ymm0,%%ymm1\n"
+                 "vpand %%ymm1,%%ymm2,%%ymm2\n"
+                 "addq %[stride],%%r10\n"
+                 "incq %%r11\n"
+                 "decl %%ecx\n"
+                 "jnz 2b\n"
+                 "vpsadbw %%ymm4,%%ymm2,%%ymm2\n"
+                 "vpaddq %%ymm2,%%ymm3,%%ymm3\n"
+                 "addq $32,%[p]\n"
+                 "addq $32,%[idx]\n"
+                 "decl %[n]\n"
+                 "jnz 1b\n"
+                 "vextracti128 $1,%%ymm3,%%xmm0\n"
+                 "vpaddq %%xmm0,%%xmm3,%%xmm3\n"
+                 "vpshufd $0x4e,%%xmm3,%%xmm0\n"
+                 "vpaddq %%xmm0,%%xmm3,%%xmm3\n"
+                 "vmovq %%xmm3,%[sum]\n"
+                 "vzeroupper\n"
+                 : [p] "+r" (p), [idx] "+r" (idx), [n] "+r" (n), [sum] "=r" (sum)
+                 : [t] "r" (targets), [slices] "r" (slices), [stride] "r" (stridebytes)
+                 : "rcx", "r10", "r11", "xmm0", "xmm1", "xmm2", "xmm3", "xmm4", "memory", "cc");
+  }
+
+  return sum + assoc_onehot_sse2_chunks(tags, targets, slices, stride, chunks & ~1, chunks);
+}
+
+//
+// AVX-512BW: 64-byte compares into mask registers, four chunks per iteration
+//
+// k1 is not listed as clobbered: this file is built without AVX-512
+// code generation, so the compiler never allocates mask registers.
+//
+
+static void assoc_match8_avx512(void* mask, const vec16b* tags, byte a, byte b, W64 invert, int chunks) {
+  int n = chunks / 4;
+
+  if (n) {
+    const vec16b* p = tags;
+    W64* out = (W64*)mask;
+
+    asm volatile("vpbroadcastb %[a],%%zmm0\n"
+                 "vpbroadcastb %[b],%%zmm1\n"
+                 "1:\n"
+                 "vpandq (%[p]),%%zmm0,%%zmm2\n"
+                 "vpcmpeqb %%zmm1,%%zmm2,%%k1\n"
+                 "kmovq %%k1,%%rax\n"
+                 "xorq %[inv],%%rax\n"
+                 "movq %%rax,(%[out])\n"
+                 "addq $64,%[p]\n"
+                 "addq $8,%[out]\n"
+                 "decl %[n]\n"
+                 "jnz 1b\n"
+                 "vzeroupper\n"
+                 : [p] "+r" (p), [out] "+r" (out), [n] "+r" (n)
+                 : [a] "m" (a), [b] "m" (b), [inv] "r" (invert)
+                 : "rax", "xmm0", "xmm1", "xmm2", "memory", "cc");
+  }
+
+  assoc_match8_sse2_chunks(mask, tags, a, b, invert, chunks & ~3, chunks);
+}
+
+static void assoc_match16_avx512(void* mask, const vec8w* tags, W16 a, W16 b, W64 invert, int chunks) {
+  int n = chunks / 4;
+
+  if (n) {
+    const vec8w* p = tags;
+    W32* out = (W32*)mask;
+
+    asm volatile("vpbroadcastw %[a],%%zmm0\n"
+                 "vpbroadcastw %[b],%%zmm1\n"
+                 "1:\n"
+                 "vpandq (%[p]),%%zmm0,%%zmm2\n"
+                 "vpcmpeqw %%zmm1,%%zmm2,%%k1\n"
+                 "kmovd %%k1,%%eax\n"
+                 "xorl %k[inv],%%eax\n"
+                 "movl %%eax,(%[out])\n"
+                 "addq $64,%[p]\n"
+                 "addq $4,%[out]\n"
+                 "decl %[n]\n"
+                 "jnz 1b\n"
+                 "vzeroupper\n"
+                 : [p] "+r" (p), [out] "+r" (out), [n] "+r" (n)
+                 : [a] "m" (a), [b] "m" (b), [inv] "r" (invert)
+                 : "rax", "xmm0", "xmm1", "xmm2", "memory", "cc");
+  }
+
+  assoc_match16_sse2_chunks(mask, tags, a, b, invert, chunks & ~3, chunks);
+}
+
+static W64 assoc_onehot_avx512(const vec16b* tags, const byte* targets, int slices, int stride, int chunks) {
+  int n = chunks / 4;
+  W64 sum = 0;
+
+  if (n) {
+    const vec16b* p = tags;
+    const byte* idx = &index_bytes_plus1_vec16b[0][0];
+    W64 stridebytes = stride * sizeof(vec16b);
+
+    // Matching slices are ANDed in k1, then select the index bytes
+    asm volatile("vpxorq %%zmm3,%%zmm3,%%zmm3\n"
+                 "vpxorq %%zmm4,%%zmm4,%%zmm4\n"
+                 "1:\n"
+                 "kxnorq %%k1,%%k1,%%k1\n"
+                 "movq %[p],%%r10\n"
+                 "movq %[t],%%r11\n"
+                 "movl %[slices],%%ecx\n"
+                 "2:\n"
+                 "vpbroadcastb (%%r11),%%zmm0\n"
+                 "vpcmpeqb (%%r10),%%zmm0,%%k1%{%%k1%}\n"
+                 "addq %[stride],%%r10\n"
+                 "incq %%r11\n"
+                 "decl %%ecx\n"
+                 "jnz 2b\n"
+                 "vmovdqu8 (%[idx]),%%zmm2%{%%k1%}%{z%}\n"
+                 "vpsadbw %%zmm4,%%zmm2,%%zmm2\n"
+                 "vpaddq %%zmm2,%%zmm3,%%zmm3\n"
+                 "addq $64,%[p]\n"
+                 "addq $64,%[idx]\n"
+                 "decl %[n]\n"
+                 "jnz 1b\n"
+                 "vextracti64x4 $1,%%zmm3,%%ymm0\n"
+                 "vpaddq %%ymm0,%%ymm3,%%ymm3\n"
+                 "vextracti128 $1,%%ymm3,%%xmm0\n"
+                 "vpaddq %%xmm0,%%xmm3,%%xmm3\n"
+                 "vpshufd $0x4e,%%xmm3,%%xmm0\n"
+                 "vpaddq %%xmm0,%%xmm3,%%xmm3\n"
+                 "vmovq %%xmm3,%[sum]\n"
+                 "vzeroupper\n"
+                 : [p] "+r" (p), [idx] "+r" (idx), [n] "+r" (n), [sum] "=r" (sum)
+                 : [t] "r" (targets), [slices] "r" (slices), [stride] "r" (stridebytes)
+                 : "rcx", "r10", "r11", "xmm0", "xmm2", "xmm3", "xmm4", "memory", "cc");
+  }
+
+  return sum + assoc_onehot_sse2_chunks(tags, targets, slices, stride, chunks & ~3, chunks);
+}
+
+static const AssocTagKernels assoc_tag_kernel_table[ASSOC_KERNEL_COUNT] = {
+  {"sse2", assoc_match8_sse2, assoc_match16_sse2, assoc_onehot_sse2},
+  {"avx2", assoc_match8_avx2, assoc_match16_avx2, assoc_onehot_avx2},
+  {"avx512bw", assoc_match8_avx512, assoc_match16_avx512, assoc_onehot_avx512},
+};
+
+// Statically initialized so tag arrays used by other constructors work
+AssocTagKernels assoc_tag_kernels = {"sse2", assoc_match8_sse2, assoc_match16_sse2, assoc_onehot_sse2};
+
+static inline void cpuid_count(W32 op, W32 count, W32& eax, W32& ebx, W32& ecx, W32& edx) {
+  asm("cpuid" : "=a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx) : "0" (op), "2" (count));
+}
+
+static inline W64 xgetbv(W32 index) {
+  W32 lo, hi;
+  asm volatile("xgetbv" : "=a" (lo), "=d" (hi) : "c" (index));
+  return ((W64)lo) | (((W64)hi) << 32);
+}
+
+//
+// Widest kernel set supported by both the host CPU and the
+// OS (which must save the YMM/ZMM state, checked via XCR0)
+//
+int assoc_tag_kernels_best() {
+  W32 eax, ebx, ecx, edx;
+
+  cpuid_count(0, 0, eax, ebx, ecx, edx);
+  if (eax < 7) return ASSOC_KERNEL_SSE2;
+  W32 maxleaf = eax;
+
+  cpuid_count(1, 0, eax, ebx, ecx, edx);
+  bool osxsave = bit(ecx, 27);
+  bool avx = bit(ecx, 28);
+  if ((!osxsave) | (!avx) | (maxleaf < 7)) return ASSOC_KERNEL_SSE2;
+
+  W64 xcr0 = xgetbv(0);
+  if ((xcr0 & 0x6) != 0x6) return ASSOC_KERNEL_SSE2;
+
+  cpuid_count(7, 0, eax, ebx, ecx, edx);
+  bool avx2 = bit(ebx, 5);
+  bool avx512f = bit(ebx, 16);
+  bool avx512bw = bit(ebx, 30);
+
+  if (avx512f & avx512bw & ((xcr0 & 0xe6) == 0xe6)) return ASSOC_KERNEL_AVX512;
+  if (avx2) return ASSOC_KERNEL_AVX2;
+  return ASSOC_KERNEL_SSE2;
+}
+
+bool assoc_tag_kernels_select(int isa) {
+  if ((isa < 0) | (isa >= ASSOC_KERNEL_COUNT)) return false;
+  if (isa > assoc_tag_kernels_best()) return false;
+  assoc_tag_kernels = assoc_tag_kernel_table[isa];
+  return true;
+}
+
+struct AssocTagKernelsInit {
+  AssocTagKernelsInit() {
+    assoc_tag_kernels_select(assoc_tag_kernels_best());
+  }
+};
+
+static AssocTagKernelsInit assoc_tag_kernels_init;
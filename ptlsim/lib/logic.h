@@ -21,6 +21,41 @@ inline vec8w x86_sse_ldvwu(const vec8w* m) {
 //inline vec8w x86_sse_ldvwu(const vec8w* m) { vec8w rd; asm("movdqu %[rd], %[m]" : [rd] "=x" (rd) : [m] "xm" (*m)); return rd; }
 inline void x86_sse_stvwu(vec8w* m, const vec8w ra) { asm("movdqu %[ra],%[m]" : [m] "=m" (*m) : [ra] "x" (ra) : "memory"); }
 
+//
+// Out of line tag search kernels for the vectorized associative
+// arrays below. The widest set supported by the host is selected
+// at startup using cpuid; SSE2 is always available as fallback.
+// Arrays smaller than ASSOC_KERNEL_MIN_CHUNKS 16-byte chunks keep
+// the inline SSE2 code, where the call would cost more than the
+// wider compares save (see tests/logic-bench.cpp).
+//
+enum { ASSOC_KERNEL_SSE2, ASSOC_KERNEL_AVX2, ASSOC_KERNEL_AVX512, ASSOC_KERNEL_COUNT };
+
+static const int ASSOC_KERNEL_MIN_CHUNKS = 4;
+
+struct AssocTagKernels {
+  const char* name;
+  // One mask bit per tag: ((tag & a) == b) ^ invert
+  void (*match8)(void* mask, const vec16b* tags, byte a, byte b, W64 invert, int chunks);
+  void (*match16)(void* mask, const vec8w* tags, W16 a, W16 b, W64 invert, int chunks);
+  // Sum of (index + 1) over tags matching every byte slice
+  W64 (*onehot)(const vec16b* tags, const byte* targets, int slices, int stride, int chunks);
+};
+
+extern AssocTagKernels assoc_tag_kernels;
+
+int assoc_tag_kernels_best();
+bool assoc_tag_kernels_select(int isa);
+
+template <int size>
+inline bitvec<size> assoc_mask_to_bitvec(const W64* words, int count) {
+  bitvec<size> m = words[0];
+  for (int i = 1; i < count; i++) {
+    m |= bitvec<size>(words[i]) << (i*64);
+  }
+  return m;
+}
+
 extern ofstream ptl_logfile;
 extern ofstream yaml_stats_file;
 
@@ -543,6 +578,12 @@ struct FullyAssociativeTagsNbitOneHot {
   }
 
   int match(const vec16b* targetslices) const {
+    if (chunkcount >= ASSOC_KERNEL_MIN_CHUNKS) {
+      byte targets[slices];
+      foreach (j, slices) targets[j] = *(const byte*)&targetslices[j];
+      return int(assoc_tag_kernels.onehot(&tags[0][0], targets, slices, chunkcount + padchunkcount, chunkcount)) - 1;
+    }
+
     vec16b sum = x86_sse_zerob();
 
     foreach (i, chunkcount) {
@@ -1600,7 +1641,19 @@ struct FullyAssociativeTags8bit {
     return insertslot(idx, tag);
   }
 
+  static const int maskwords = (chunkcount + 3) / 4;
+
+  bitvec<size> kernelmatch(byte a, byte b, W64 invert) const {
+    W64 words[maskwords];
+    words[maskwords - 1] = 0;
+    assoc_tag_kernels.match8(words, tags, a, b, invert, chunkcount);
+    return assoc_mask_to_bitvec<size>(words, maskwords);
+  }
+
   bitvec<size> match(const vec_t target) const {
+    if (chunkcount >= ASSOC_KERNEL_MIN_CHUNKS)
+      return kernelmatch(0xff, *(const byte*)&target, 0) & valid;
+
     bitvec<size> m = 0;
 
     foreach (i, chunkcount) {
@@ -1615,6 +1668,9 @@ struct FullyAssociativeTags8bit {
   }
 
   bitvec<size> matchany(const vec_t target) const {
+    if (chunkcount >= ASSOC_KERNEL_MIN_CHUNKS)
+      return kernelmatch(*(const byte*)&target, 0, (W64)-1) & valid;
+
     bitvec<size> m = 0;
 
     vec_t zero = prep(0);
@@ -1762,7 +1818,19 @@ struct FullyAssociativeTags16bit {
     return insertslot(idx, tag);
   }
 
+  static const int maskwords = (chunkcount + 7) / 8;
+
+  bitvec<size> kernelmatch(W16 a, W16 b, W64 invert) const {
+    W64 words[maskwords];
+    words[maskwords - 1] = 0;
+    assoc_tag_kernels.match16(words, tags, a, b, invert, chunkcount);
+    return assoc_mask_to_bitvec<size>(words, maskwords);
+  }
+
   bitvec<size> match(const vec_t target) const {
+    if (chunkcount >= ASSOC_KERNEL_MIN_CHUNKS)
+      return kernelmatch(0xffff, *(const W16*)&target, 0) & valid;
+
     bitvec<size> m = 0;
 
     foreach (i, chunkcount) {
@@ -1777,6 +1845,9 @@ struct FullyAssociativeTags16bit {
   }
 
   bitvec<size> matchany(const vec_t target) const {
+    if (chunkcount >= ASSOC_KERNEL_MIN_CHUNKS)
+      return kernelmatch(*(const W16*)&target, 0, (W64)-1) & valid;
+
     bitvec<size> m = 0;
 
     vec_t zero = prep(0);
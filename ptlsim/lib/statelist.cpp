@@ -9,15 +9,33 @@ void StateList::init(const char* name, ListOfStateLists& lol, W32 flags) {
 
 
 StateList::StateList(const char* name, ListOfStateLists& lol, W32 flags) {
+  slotmap = NULL;
+  slotcount = 0;
   init(name, lol, flags);
 }
 
+void StateList::track_slots(int count) {
+  if (slotmap) delete[] slotmap;
+  slotcount = count;
+  slotmap = new W64[(count + 63) / 64];
+  memset(slotmap, 0, ((count + 63) / 64) * sizeof(W64));
+}
+
+int StateList::slot_popcount() const {
+  int n = 0;
+  foreach (i, (slotcount + 63) / 64) {
+    n += popcount64(slotmap[i]);
+  }
+  return n;
+}
+
 
 void StateList::reset() {
   selfqueuelink::reset();
   count = 0;
   dispatch_source_counter = 0;
   issue_source_counter = 0;
+  if (slotmap) memset(slotmap, 0, ((slotcount + 63) / 64) * sizeof(W64));
 }
 
 int ListOfStateLists::add(StateList* list) {
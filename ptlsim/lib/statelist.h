@@ -34,6 +34,24 @@
 
 #define foreach_list_mutable_backwards(L, obj, entry, preventry) foreach_list_mutable_linktype_backwards(L, obj, entry, preventry, selfqueuelink)
 
+/*
+ * Iterate through the members of a StateList tracking slots (see
+ * StateList::track_slots). Like foreach_list_mutable, the entry in the
+ * current slot may leave the list inside the loop body.
+ */
+
+#define foreach_slot(L, slot) \
+  for (int slot = (L).next_slot(0, (L).slotcount); slot >= 0; slot = (L).next_slot(slot + 1, (L).slotcount))
+
+/*
+ * Same as foreach_slot, but in age order of a circular queue whose oldest
+ * entry is in slot 'oldest' (e.g. the ROB head).
+ */
+
+#define foreach_slot_by_age(L, oldest, slot) \
+  for (int slot##_oldest = (oldest), slot = (L).next_slot_by_age(-1, slot##_oldest); slot >= 0; \
+    slot = (L).next_slot_by_age(slot, slot##_oldest))
+
   struct StateList;
 
   struct ListOfStateLists: public array<StateList*, 64> {
@@ -53,16 +71,27 @@
     W64 issue_source_counter;
     W32 flags;
 
-    StateList() { name = NULL; listid = 0; reset(); }
+    /* Optional bitmap of member slots, see track_slots() */
+    W64* slotmap;
+    int slotcount;
 
-    ~StateList() { if(name) delete name; }
+    StateList() { name = NULL; listid = 0; slotmap = NULL; slotcount = 0; reset(); }
 
-    StateList(const char* name_, W32 flags_ = 0): flags(flags_){ name = strdup(name_); listid = 0; reset();}
+    ~StateList() { if(name) delete name; if(slotmap) delete[] slotmap; }
+
+    StateList(const char* name_, W32 flags_ = 0): flags(flags_){ name = strdup(name_); listid = 0; slotmap = NULL; slotcount = 0; reset();}
 
     void init(const char* name, ListOfStateLists& lol, W32 flags = 0);
 
     StateList(const char* name, ListOfStateLists& lol, W32 flags = 0);
 
+  private:
+    /* Copies would share slotmap */
+    StateList(const StateList&);
+    StateList& operator =(const StateList&);
+
+  public:
+
     // simulated asymmetric c++ array constructor:
     StateList& operator ()(const char* name, ListOfStateLists& lol, W32 flags = 0) {
       init(name, lol, flags);
@@ -71,7 +100,10 @@
 
     void reset();
 
+    bool empty() const { return (count == 0); }
+
     selfqueuelink* dequeue() {
+      assert(!slotmap);
       if (empty())
         return NULL;
       count--;
@@ -81,12 +113,14 @@
     }
 
     selfqueuelink* enqueue(selfqueuelink* entry) {
+      assert(!slotmap);
       entry->addtail(this);
       count++;
       return entry;
     }
 
     selfqueuelink* enqueue_after(selfqueuelink* entry, selfqueuelink* preventry) {
+      assert(!slotmap);
       if (preventry) entry->addhead(preventry);
 	  else entry->addhead(this);
       count++;
@@ -94,6 +128,7 @@
     }
 
     selfqueuelink* remove(selfqueuelink* entry) {
+      assert(!slotmap);
       assert(entry->linked());
       entry->unlink();
       count--;
@@ -102,6 +137,7 @@
     }
 
     selfqueuelink* peek() {
+      assert(!slotmap);
       return (empty()) ? NULL : head();
     }
 
@@ -114,11 +150,80 @@
       return newqueue;
     }
 
+    /*
+     * Track members in a bitmap indexed by their slot (ROB index,
+     * physical register index, ...) instead of linking them, so per-cycle
+     * loops bit-scan the members instead of chasing list pointers. Such
+     * a list only supports add_slot(), remove_slot(), the slot queries
+     * and foreach_slot; the queue operations above assert that the list
+     * is linked, as they would corrupt the count of a tracking list.
+     */
+    void track_slots(int count);
+
+    void add_slot(int slot) {
+      assert(!has_slot(slot));
+      slotmap[slot >> 6] |= (1ULL << (slot & 63));
+      count++;
+    }
+
+    void remove_slot(int slot) {
+      assert(has_slot(slot));
+      slotmap[slot >> 6] &= ~(1ULL << (slot & 63));
+      count--;
+    }
+
+    bool has_slot(int slot) const {
+      return (slotmap[slot >> 6] >> (slot & 63)) & 1;
+    }
+
+    int slot_popcount() const;
+
+    /* First member slot in [from, end), or -1 */
+    int next_slot(int from, int end) const {
+      if unlikely (from >= end) return -1;
+
+      int w = from >> 6;
+      int lastw = (end - 1) >> 6;
+      W64 bits = slotmap[w] & ((W64)(-1LL) << (from & 63));
+
+      for (;;) {
+        if (bits) {
+          int slot = (w << 6) + lsbindex64(bits);
+          return (slot < end) ? slot : -1;
+        }
+        if (++w > lastw) return -1;
+        bits = slotmap[w];
+      }
+    }
+
+    /*
+     * Next member slot after 'slot' in circular order starting at slot
+     * 'oldest', or -1 once the order wraps around. Pass -1 as 'slot' to
+     * get the oldest member.
+     */
+    int next_slot_by_age(int slot, int oldest) const {
+      int from = (slot < 0) ? oldest : slot + 1;
+
+      if ((slot < 0) | (slot >= oldest)) {
+        int found = next_slot(from, slotcount);
+        if (found >= 0) return found;
+        from = 0;
+      }
+
+      return next_slot(from, oldest);
+    }
+
     void checkvalid();
 
     ostream& print(ostream& os) const{
       os << " (", count, " entries):";
 
+      if (slotmap) {
+        foreach_slot(*this, slot) os << " ", slot;
+        os << endl;
+        return os;
+      }
+
       selfqueuelink* obj;
       foreach_list_mutable(*this, obj, entry, nextentry) {
         obj->print(os);
@@ -0,0 +1,287 @@
+/*
+ * MARSSx86 : A Full System Computer-Architecture Simulator
+ *
+ * This code is released under GPL.
+ *
+ * Copyright 2011 Avadh Patel <apatel@cs.binghamton.edu>
+ *
+ */
+
+#include <io-models.h>
+#include <ptlsim.h>
+
+static const char *storage_dir_names[2] = {"read", "write"};
+static const char *network_dir_names[2] = {"tx", "rx"};
+
+/* IOEventQueue */
+
+void IOEventQueue::sift_up(int idx)
+{
+    while (idx > 0) {
+        int parent = (idx - 1) / 2;
+        if (!(heap_[idx] < heap_[parent]))
+            break;
+
+        swap(heap_[idx], heap_[parent]);
+        idx = parent;
+    }
+}
+
+void IOEventQueue::sift_down(int idx)
+{
+    int n = heap_.size();
+
+    for (;;) {
+        int left = 2 * idx + 1;
+        int right = left + 1;
+        int smallest = idx;
+
+        if (left < n && heap_[left] < heap_[smallest])
+            smallest = left;
+        if (right < n && heap_[right] < heap_[smallest])
+            smallest = right;
+        if (smallest == idx)
+            break;
+
+        swap(heap_[idx], heap_[smallest]);
+        idx = smallest;
+    }
+}
+
+void IOEventQueue::add(W64 cycle, Callback fn, void *arg)
+{
+    Event &event = heap_.push();
+    event.cycle = cycle;
+    event.seq = seq_++;
+    event.fn = fn;
+    event.arg = arg;
+
+    sift_up(heap_.size() - 1);
+}
+
+/**
+ * @brief Run all events scheduled at or before given cycle
+ *
+ * @param cycle Current cycle, use all ones to drain the queue
+ *
+ * @return Number of events executed
+ */
+int IOEventQueue::run(W64 cycle)
+{
+    int count = 0;
+
+    /* Callbacks may add new events, so pop one at a time */
+    while (heap_.size() && heap_[0].cycle <= cycle) {
+        Event event = heap_[0];
+
+        heap_[0] = heap_[heap_.size() - 1];
+        heap_.pop();
+        if (heap_.size())
+            sift_down(0);
+
+        if (logable(4)) {
+            ptl_logfile << "Executing QEMU IO Event scheduled at ",
+                        event.cycle, " at ", sim_cycle, endl;
+        }
+
+        event.fn(event.arg);
+        count++;
+    }
+
+    return count;
+}
+
+/* StorageModel */
+
+StorageStats::StorageStats(Statable *parent)
+    : Statable("disk", parent)
+      , requests("requests", this, storage_dir_names)
+      , bytes("bytes", this, storage_dir_names)
+      , queue_full("queue_full", this)
+      , cycles("cycles", this)
+{}
+
+StorageModel::StorageModel(Statable *parent, W64 channels, W64 queueDepth,
+        W64 readLatency, W64 writeLatency, double bytesPerCycle)
+    : channels_(channels)
+      , queueDepth_(queueDepth)
+      , bytesPerCycle_(bytesPerCycle)
+      , stats(parent)
+{
+    latency_[0] = readLatency;
+    latency_[1] = writeLatency;
+
+    channelFree_ = new W64[channels_];
+    for (W64 i = 0; i < channels_; i++) {
+        channelFree_[i] = 0;
+    }
+}
+
+StorageModel::~StorageModel()
+{
+    delete [] channelFree_;
+}
+
+/**
+ * @brief Time a new request issued in current cycle
+ *
+ * @param write True for writes
+ * @param bytes Size of the request
+ *
+ * @return Cycles until the request completes
+ */
+W64 StorageModel::request(bool write, W64 bytes)
+{
+    W64 start = sim_cycle;
+
+    /* Retire completed requests, the queue holds completion cycles */
+    for (int i = outstanding_.size() - 1; i >= 0; i--) {
+        if (outstanding_[i] <= sim_cycle) {
+            outstanding_[i] = outstanding_[outstanding_.size() - 1];
+            outstanding_.pop();
+        }
+    }
+
+    /* Device queue is full, wait for the earliest completion */
+    if (W64(outstanding_.size()) >= queueDepth_) {
+        int first = 0;
+        foreach (i, outstanding_.size()) {
+            if (outstanding_[i] < outstanding_[first])
+                first = i;
+        }
+
+        start = outstanding_[first];
+        outstanding_[first] = outstanding_[outstanding_.size() - 1];
+        outstanding_.pop();
+        stats.queue_full++;
+    }
+
+    W64 channel = 0;
+    for (W64 i = 1; i < channels_; i++) {
+        if (channelFree_[i] < channelFree_[channel])
+            channel = i;
+    }
+
+    start = max(start, channelFree_[channel]);
+
+    W64 transfer = W64(ceil(double(bytes) / bytesPerCycle_));
+    W64 done = start + latency_[write] + transfer;
+
+    channelFree_[channel] = done;
+    outstanding_.push(done);
+
+    stats.requests[write]++;
+    stats.bytes[write] += bytes;
+    stats.cycles += done - sim_cycle;
+
+    return done - sim_cycle;
+}
+
+/**
+ * @brief Create storage model from simulator options
+ *
+ * @return NULL if -disk-model is none
+ */
+StorageModel *StorageModel::create(PTLsimConfig &config, Statable *parent)
+{
+    if (config.disk_model == "none")
+        return NULL;
+
+    if (config.disk_model != "ssd") {
+        ptl_logfile << "[ERROR] Unknown disk model '", config.disk_model,
+                    "'", endl;
+        cerr << "[ERROR] Unknown disk model '" << config.disk_model << "'"
+             << endl;
+        assert_fail(__STRING(0), __FILE__, __LINE__, __PRETTY_FUNCTION__);
+    }
+
+    if (config.disk_channels == 0 || config.disk_queue_depth == 0 ||
+            config.disk_bandwidth <= 0) {
+        ptl_logfile << "[ERROR] disk-channels, disk-queue-depth and ",
+                    "disk-bandwidth must be positive", endl;
+        cerr << "[ERROR] disk-channels, disk-queue-depth and "
+             << "disk-bandwidth must be positive" << endl;
+        assert_fail(__STRING(0), __FILE__, __LINE__, __PRETTY_FUNCTION__);
+    }
+
+    double bytesPerCycle = (config.disk_bandwidth * 1e6) /
+        double(config.core_freq_hz);
+
+    return new StorageModel(parent, config.disk_channels,
+            config.disk_queue_depth,
+            ns_to_simcycles(config.disk_read_latency),
+            ns_to_simcycles(config.disk_write_latency), bytesPerCycle);
+}
+
+/* NetworkModel */
+
+NetworkStats::NetworkStats(Statable *parent)
+    : Statable("nic", parent)
+      , packets("packets", this, network_dir_names)
+      , bytes("bytes", this, network_dir_names)
+      , cycles("cycles", this)
+{}
+
+NetworkModel::NetworkModel(Statable *parent, W64 latency,
+        double bytesPerCycle)
+    : latency_(latency)
+      , bytesPerCycle_(bytesPerCycle)
+      , stats(parent)
+{
+    linkFree_[0] = linkFree_[1] = 0;
+}
+
+/**
+ * @brief Time a packet sent in current cycle
+ *
+ * @param rx True for packets received by the guest
+ * @param bytes Size of the packet
+ *
+ * @return Cycles until the packet is delivered
+ */
+W64 NetworkModel::packet(bool rx, W64 bytes)
+{
+    W64 start = max(sim_cycle, linkFree_[rx]);
+    W64 transfer = W64(ceil(double(bytes) / bytesPerCycle_));
+
+    linkFree_[rx] = start + transfer;
+
+    W64 delay = start + transfer + latency_ - sim_cycle;
+
+    stats.packets[rx]++;
+    stats.bytes[rx] += bytes;
+    stats.cycles += delay;
+
+    return delay;
+}
+
+/**
+ * @brief Create NIC model from simulator options
+ *
+ * @return NULL if -nic-model is none
+ */
+NetworkModel *NetworkModel::create(PTLsimConfig &config, Statable *parent)
+{
+    if (config.nic_model == "none")
+        return NULL;
+
+    if (config.nic_model != "link") {
+        ptl_logfile << "[ERROR] Unknown NIC model '", config.nic_model,
+                    "'", endl;
+        cerr << "[ERROR] Unknown NIC model '" << config.nic_model << "'"
+             << endl;
+        assert_fail(__STRING(0), __FILE__, __LINE__, __PRETTY_FUNCTION__);
+    }
+
+    if (config.nic_bandwidth <= 0) {
+        ptl_logfile << "[ERROR] nic-bandwidth must be positive", endl;
+        cerr << "[ERROR] nic-bandwidth must be positive" << endl;
+        assert_fail(__STRING(0), __FILE__, __LINE__, __PRETTY_FUNCTION__);
+    }
+
+    double bytesPerCycle = (config.nic_bandwidth * 1e6 / 8) /
+        double(config.core_freq_hz);
+
+    return new NetworkModel(parent, ns_to_simcycles(config.nic_latency),
+            bytesPerCycle);
+}
@@ -0,0 +1,168 @@
+/*
+ * MARSSx86 : A Full System Computer-Architecture Simulator
+ *
+ * This code is released under GPL.
+ *
+ * Copyright 2011 Avadh Patel <apatel@cs.binghamton.edu>
+ *
+ */
+
+#ifndef IO_MODELS_H
+#define IO_MODELS_H
+
+#include <globals.h>
+#include <superstl.h>
+#include <statsBuilder.h>
+
+struct PTLsimConfig;
+
+/*
+ * Queue of QEMU device callbacks ordered by simulation cycle
+ *
+ * Events are kept in a binary min-heap on (cycle, sequence number), so the
+ * simulation loop only compares sim_cycle with the head and events added
+ * for the same cycle run in the order they were added.
+ */
+class IOEventQueue
+{
+    public:
+        typedef void (*Callback)(void*);
+
+    private:
+        struct Event {
+            W64 cycle;
+            W64 seq;
+            Callback fn;
+            void *arg;
+
+            bool operator <(const Event &other) const {
+                if (cycle != other.cycle)
+                    return cycle < other.cycle;
+                return seq < other.seq;
+            }
+        };
+
+        dynarray<Event> heap_;
+        W64 seq_;
+
+        void sift_up(int idx);
+        void sift_down(int idx);
+
+    public:
+        IOEventQueue()
+            : seq_(0)
+        {}
+
+        void add(W64 cycle, Callback fn, void *arg);
+
+        /* Cycle of the earliest event, all ones if queue is empty */
+        W64 next_cycle() const {
+            return heap_.size() ? heap_[0].cycle : (W64)-1;
+        }
+
+        int run(W64 cycle);
+        int size() const { return heap_.size(); }
+};
+
+/*
+ * Storage timing model
+ *
+ *  requests   : requests per direction (read, write)
+ *  bytes      : bytes transferred per direction
+ *  queue_full : requests that waited for a slot in the device queue
+ *  cycles     : sum of request latencies, from issue to completion
+ */
+struct StorageStats : public Statable
+{
+    StatArray<W64, 2> requests;
+    StatArray<W64, 2> bytes;
+    StatObj<W64> queue_full;
+    StatObj<W64> cycles;
+
+    StorageStats(Statable *parent);
+};
+
+/*
+ * SSD-like storage device
+ *
+ * A request first waits for a slot in the device queue, which holds at most
+ * 'queue_depth' outstanding requests, then for the earliest free channel.
+ * The channel is busy for the access latency plus the transfer time at the
+ * per-channel bandwidth, and the request completes when the channel is done.
+ * Options:
+ *
+ *   -disk-model         : none or ssd
+ *   -disk-channels      : independent channels
+ *   -disk-queue-depth   : outstanding requests in the device
+ *   -disk-read-latency  : read access latency in ns
+ *   -disk-write-latency : write access latency in ns
+ *   -disk-bandwidth     : per-channel bandwidth in MB/s
+ */
+class StorageModel
+{
+    private:
+        W64 channels_;
+        W64 queueDepth_;
+        W64 latency_[2];
+        double bytesPerCycle_;
+
+        W64 *channelFree_;
+        dynarray<W64> outstanding_;
+
+    public:
+        StorageStats stats;
+
+        StorageModel(Statable *parent, W64 channels, W64 queueDepth,
+                W64 readLatency, W64 writeLatency, double bytesPerCycle);
+        ~StorageModel();
+
+        W64 request(bool write, W64 bytes);
+
+        static StorageModel *create(PTLsimConfig &config, Statable *parent);
+};
+
+/*
+ * Network timing model
+ *
+ *  packets   : packets per direction (tx, rx)
+ *  bytes     : bytes per direction
+ *  cycles    : sum of packet delays, including waiting for the link
+ */
+struct NetworkStats : public Statable
+{
+    StatArray<W64, 2> packets;
+    StatArray<W64, 2> bytes;
+    StatObj<W64> cycles;
+
+    NetworkStats(Statable *parent);
+};
+
+/*
+ * NIC link
+ *
+ * Each direction is a link with a fixed per-packet latency and a bandwidth.
+ * Packets are serialized on the link and delivered 'latency' after their
+ * last byte is sent. Options:
+ *
+ *   -nic-model     : none or link
+ *   -nic-latency   : per-packet latency in ns
+ *   -nic-bandwidth : link bandwidth in Mbit/s
+ */
+class NetworkModel
+{
+    private:
+        W64 latency_;
+        double bytesPerCycle_;
+        W64 linkFree_[2];
+
+    public:
+        NetworkStats stats;
+
+        NetworkModel(Statable *parent, W64 latency, double bytesPerCycle);
+
+        W64 packet(bool rx, W64 bytes);
+
+        static NetworkModel *create(PTLsimConfig &config, Statable *parent);
+};
+
+#endif // IO_MODELS_H
@@ -15,6 +15,8 @@
 #include <basecore.h>
 #include <statsBuilder.h>
 #include <memoryHierarchy.h>
+#include <uarch-checkpoint.h>
+#include <partition.h>
 
 #include <cstdarg>
 
@@ -161,41 +163,170 @@ bool BaseMachine::init(PTLsimConfig& config)
  */
 void BaseMachine::dump_configuration(ostream& os) const
 {
-	YAML::Emitter *config_yaml;
+	YAML::Emitter config_yaml;
 
 	os << "#\n# Simulated Machine Configuration\n#\n";
 
-	config_yaml = new YAML::Emitter();
+	emit_configuration(config_yaml);
 
-	*config_yaml << YAML::BeginMap;
-	*config_yaml << YAML::Key << "machine";
-	*config_yaml << YAML::Value << YAML::BeginMap;
+	os << config_yaml.c_str() << "\n";
+	os << "\n# End Machine Configuration\n";
+
+	ptl_logfile << "Dumped all machine configuration\n";
+}
+
+/**
+ * @brief Emit configuration of the machine and all its modules
+ *
+ * @param config_yaml YAML emitter, the machine is written as one map
+ */
+void BaseMachine::emit_configuration(YAML::Emitter& config_yaml) const
+{
+	config_yaml << YAML::BeginMap;
+	config_yaml << YAML::Key << "machine";
+	config_yaml << YAML::Value << YAML::BeginMap;
 
 	/* Some machine specific parameters */
-	*config_yaml << YAML::Key << "name" << YAML::Value << config.machine_config;
-	*config_yaml << YAML::Key << "cpu_contexts" << YAML::Value << NUM_SIM_CORES;
-	*config_yaml << YAML::Key << "freq" << YAML::Value << config.core_freq_hz;
+	config_yaml << YAML::Key << "name" << YAML::Value << config.machine_config;
+	config_yaml << YAML::Key << "cpu_contexts" << YAML::Value << NUM_SIM_CORES;
+	config_yaml << YAML::Key << "freq" << YAML::Value << config.core_freq_hz;
 
 	/* Now go through all cores */
 	foreach (i, cores.count())
-		cores[i]->dump_configuration(*config_yaml);
+		cores[i]->dump_configuration(config_yaml);
 
 	/* Next is all controllers/caches */
 	foreach (i, controllers.count())
-		controllers[i]->dump_configuration(*config_yaml);
+		controllers[i]->dump_configuration(config_yaml);
 
 	/* Now dump all interconnections */
 	foreach (i, interconnects.count())
-		interconnects[i]->dump_configuration(*config_yaml);
+		interconnects[i]->dump_configuration(config_yaml);
 
 	/* Finalize YAML */
-	*config_yaml << YAML::EndMap;
-	*config_yaml << YAML::EndMap;
+	config_yaml << YAML::EndMap;
+	config_yaml << YAML::EndMap;
+}
 
-	os << config_yaml->c_str() << "\n";
-	os << "\n# End Machine Configuration\n";
+/**
+ * @brief Signature of this machine stored in micro-architectural checkpoints
+ *
+ * The signature holds the machine name, the number of cores and a CRC of
+ * the full configuration dump, so any change of a module parameter
+ * (geometry, policy, latency, core widths...) invalidates checkpoints.
+ * Each module still validates its own geometry on restore.
+ */
+void BaseMachine::get_uarch_signature(stringbuf& sig) const
+{
+	YAML::Emitter config_yaml;
+	CRC32 crc;
 
-	ptl_logfile << "Dumped all machine configuration\n";
+	emit_configuration(config_yaml);
+	crc.update((byte*)config_yaml.c_str(), config_yaml.size());
+
+	sig << config.machine_config, ":", NUM_SIM_CORES, ":",
+		hexstring((W32)crc, 32);
+}
+
+/**
+ * @brief Save warmable state of all cores and controllers
+ *
+ * @param filename File to write checkpoint into
+ *
+ * @return false if file can't be written
+ */
+bool BaseMachine::save_uarch_state(const char* filename)
+{
+    UarchStateWriter writer;
+    stringbuf sig;
+    stringbuf section;
+
+    get_uarch_signature(sig);
+
+    if (!writer.open(filename, sig.buf))
+        return false;
+
+    foreach (i, cores.count()) {
+        section.reset();
+        section << "core:", cores[i]->get_name();
+        writer.begin_section(section.buf);
+        cores[i]->save_state(writer);
+        writer.end_section();
+    }
+
+    foreach (i, controllers.count()) {
+        section.reset();
+        section << "controller:", controllers[i]->get_name();
+        writer.begin_section(section.buf);
+        controllers[i]->save_state(writer);
+        writer.end_section();
+    }
+
+    Memory::WayPartition::save_all(writer);
+
+    writer.close();
+
+    ptl_logfile << "Saved micro-architectural state to ", filename, endl;
+
+    return true;
+}
+
+/**
+ * @brief Restore warmable state of all cores and controllers
+ *
+ * @param filename Checkpoint file saved by save_uarch_state()
+ *
+ * @return false if checkpoint can't be used with this machine
+ *
+ * Modules whose section is missing or doesn't match their current
+ * configuration are skipped and start cold.
+ */
+bool BaseMachine::restore_uarch_state(const char* filename)
+{
+    UarchStateReader reader;
+    stringbuf sig;
+    stringbuf section;
+    int restored = 0;
+    int skipped = 0;
+
+    get_uarch_signature(sig);
+
+    if (!reader.open(filename, sig.buf))
+        return false;
+
+    foreach (i, cores.count()) {
+        section.reset();
+        section << "core:", cores[i]->get_name();
+        if (reader.find_section(section.buf) &&
+                cores[i]->restore_state(reader)) {
+            restored++;
+        } else {
+            ptl_logfile << "uarch checkpoint: skipping ", section, endl;
+            skipped++;
+        }
+    }
+
+    foreach (i, controllers.count()) {
+        section.reset();
+        section << "controller:", controllers[i]->get_name();
+        if (reader.find_section(section.buf) &&
+                controllers[i]->restore_state(reader)) {
+            restored++;
+        } else {
+            ptl_logfile << "uarch checkpoint: skipping ", section, endl;
+            skipped++;
+        }
+    }
+
+    Memory::WayPartition::restore_all(reader, restored, skipped);
+
+    reader.close();
+
+    ptl_logfile << "Restored micro-architectural state from ", filename,
+                ": ", restored, " modules restored, ", skipped,
+                " skipped", endl;
+
+    return true;
 }
 
 int BaseMachine::run(PTLsimConfig& config)
@@ -246,6 +377,9 @@ int BaseMachine::run(PTLsimConfig& config)
 
         if unlikely (time_stats_file && sim_cycle > 0 &&
                 sim_cycle % config.time_stats_period == 0) {
+            /* Sleeping cores account their skipped cycles here */
+            foreach (i, cores.count())
+                cores[i]->update_stats();
             StatsBuilder::get().dump_periodic(*time_stats_file, sim_cycle);
         }
 
@@ -322,13 +456,18 @@ void BaseMachine::flush_all_pipelines()
 
 void BaseMachine::update_stats()
 {
+    /* Cores may still have stats to flush into user/kernel stats */
+    foreach(i, cores.count()) {
+        cores[i]->update_stats();
+    }
+
     global_stats->reset();
     *global_stats += *user_stats;
     *global_stats += *kernel_stats;
 
-    foreach(i, cores.count()) {
-        cores[i]->update_stats();
-    }
+    /* Cache profiles write their tables into each stats on their own */
+    if (memoryHierarchyPtr)
+        memoryHierarchyPtr->update_stats();
 }
 
 Context& BaseMachine::get_next_context()
@@ -68,7 +68,11 @@ struct BaseMachine: public PTLsimMachine {
     void flush_all_pipelines();
     virtual void reset();
 	virtual void dump_configuration(ostream& os) const;
+	void emit_configuration(YAML::Emitter& config_yaml) const;
+	void get_uarch_signature(stringbuf& sig) const;
 	virtual void shutdown();
+    virtual bool save_uarch_state(const char* filename);
+    virtual bool restore_uarch_state(const char* filename);
     virtual ~BaseMachine();
 
     bitvec<NUM_SIM_CORES> context_used;
@@ -0,0 +1,196 @@
+/*
+ * MARSSx86 : A Full System Computer-Architecture Simulator
+ *
+ * This code is released under GPL.
+ *
+ */
+
+#include <globals.h>
+#include <ptlsim.h>
+#include <statsBuilder.h>
+#include <pmu.h>
+
+#define __INSIDE_MARSS_QEMU__
+#include <ptlcalls.h>
+
+/* Maximum nesting of regions of interest */
+#define ROI_MAX_DEPTH 16
+
+struct PMUCounter {
+    stringbuf pattern;
+    dynarray<StatRef> refs;
+    bool resolved;
+
+    PMUCounter() : resolved(false) {}
+};
+
+static PMUCounter pmu_counters[PTLSIM_PMU_COUNTERS];
+
+static const char* pmu_default_events[PTLSIM_PMU_COUNTERS] = {
+    "sim_cycle",
+    "base_machine.*.*.commit.insns",
+    "base_machine.*.*.commit.uops",
+    "base_machine.*.*.branchpred.summary.mispred",
+    "base_machine.L1_I_*.cpurequest.count.miss.*",
+    "base_machine.L1_D_*.cpurequest.count.miss.*",
+    "base_machine.L2_*.cpurequest.count.miss.*",
+    "base_machine.L3_*.cpurequest.count.miss.*",
+};
+
+static PMUCounter& get_counter(int counter)
+{
+    PMUCounter &c = pmu_counters[counter];
+
+    if (!c.pattern.size())
+        c.pattern << pmu_default_events[counter];
+
+    return c;
+}
+
+bool pmu_program(int counter, const char *pattern)
+{
+    if (counter < 0 || counter >= PTLSIM_PMU_COUNTERS)
+        return false;
+
+    PMUCounter &c = pmu_counters[counter];
+    c.pattern.reset();
+    c.pattern << pattern;
+    c.refs.clear();
+    c.resolved = false;
+
+    ptl_logfile << "PMU counter ", counter, " counts '", pattern, "'", endl;
+    return true;
+}
+
+W64 pmu_read(int counter)
+{
+    if (counter < 0 || counter >= PTLSIM_PMU_COUNTERS || !user_stats)
+        return 0;
+
+    PMUCounter &c = get_counter(counter);
+
+    if (c.pattern == "sim_cycle")
+        return sim_cycle;
+
+    if (!c.resolved) {
+        int count = (StatsBuilder::get()).find_stats(c.pattern, c.refs);
+        if (!count) {
+            ptl_logfile << "[WARNING] PMU counter ", counter, " pattern '",
+                        c.pattern, "' matches no stats", endl;
+        }
+        c.resolved = true;
+    }
+
+    W64 value = 0;
+    foreach (i, c.refs.size()) {
+        StatRef &ref = c.refs[i];
+        value += ref.obj->get_value(user_stats, ref.index);
+        value += ref.obj->get_value(kernel_stats, ref.index);
+    }
+
+    return value;
+}
+
+bool pmu_rdpmc(W32 index, W64 &value)
+{
+    if (index < PTLSIM_RDPMC_BASE ||
+            index >= PTLSIM_RDPMC_BASE + PTLSIM_PMU_COUNTERS)
+        return false;
+
+    value = pmu_read(index - PTLSIM_RDPMC_BASE);
+    return true;
+}
+
+bool pmu_rdmsr(W32 index, W64 &value)
+{
+    if (index < PTLSIM_PMU_MSR_BASE ||
+            index >= PTLSIM_PMU_MSR_BASE + PTLSIM_PMU_COUNTERS)
+        return false;
+
+    value = pmu_read(index - PTLSIM_PMU_MSR_BASE);
+    return true;
+}
+
+/*
+ * Stack of open regions, each with the stats at its begin
+ */
+struct ROIEntry {
+    stringbuf name;
+    W64 start_cycle;
+    Stats *start;
+
+    ROIEntry() : start_cycle(0), start(NULL) {}
+};
+
+static ROIEntry roi_stack[ROI_MAX_DEPTH];
+static int roi_depth = 0;
+static Stats *roi_delta = NULL;
+
+static void roi_capture(Stats &stats)
+{
+    stats.reset();
+    stats += *user_stats;
+    stats += *kernel_stats;
+}
+
+bool roi_begin(const char *name)
+{
+    if (!user_stats)
+        return false;
+
+    if (roi_depth == ROI_MAX_DEPTH) {
+        ptl_logfile << "[ERROR] Region of interest '", name, "' nested ",
+                    "deeper than ", ROI_MAX_DEPTH, " regions", endl;
+        return false;
+    }
+
+    ROIEntry &entry = roi_stack[roi_depth++];
+
+    if (!entry.start)
+        entry.start = (StatsBuilder::get()).get_new_stats();
+
+    entry.name.reset();
+    entry.name << name;
+    entry.start_cycle = sim_cycle;
+    roi_capture(*entry.start);
+
+    return true;
+}
+
+bool roi_end(const char *name)
+{
+    int idx;
+
+    for (idx = roi_depth - 1; idx >= 0; idx--) {
+        if (roi_stack[idx].name == name)
+            break;
+    }
+
+    if (idx < 0) {
+        ptl_logfile << "[ERROR] End of region of interest '", name,
+                    "' that was not started", endl;
+        return false;
+    }
+
+    /* Inner regions that are still open are dropped */
+    if (idx != roi_depth - 1) {
+        ptl_logfile << "[WARNING] End of region of interest '", name,
+                    "' drops ", roi_depth - 1 - idx, " open inner regions",
+                    endl;
+    }
+
+    StatsBuilder &builder = StatsBuilder::get();
+    ROIEntry &entry = roi_stack[idx];
+
+    if (!roi_delta)
+        roi_delta = builder.get_new_stats();
+
+    roi_capture(*roi_delta);
+    builder.sub_stats(*roi_delta, *entry.start);
+
+    builder.get_region(name)->add(*roi_delta,
+            sim_cycle - entry.start_cycle);
+
+    roi_depth = idx;
+    return true;
+}
@@ -0,0 +1,38 @@
+/*
+ * MARSSx86 : A Full System Computer-Architecture Simulator
+ *
+ * This code is released under GPL.
+ *
+ */
+
+#ifndef PMU_H
+#define PMU_H
+
+#include <globals.h>
+#include <superstl.h>
+
+/*
+ * Guest visible performance counters and regions of interest
+ *
+ * These implement PTLCALL_PMU and PTLCALL_ROI, see ptlcalls.h for the
+ * guest side. A counter is the live sum of all stats counters matching
+ * its pattern, in user and kernel stats. Patterns are resolved to
+ * counters on first read after they are programmed.
+ *
+ * A region of interest saves the stats at begin and adds the difference
+ * at the matching end to the 'roi.<name>' stats. Saving and adding walk
+ * the whole stats tree, so regions should not be entered millions of
+ * times.
+ */
+
+bool pmu_program(int counter, const char *pattern);
+W64 pmu_read(int counter);
+
+/* RDPMC and RDMSR of simulated counters, false if 'index' is not one */
+bool pmu_rdpmc(W32 index, W64 &value);
+bool pmu_rdmsr(W32 index, W64 &value);
+
+bool roi_begin(const char *name);
+bool roi_end(const char *name);
+
+#endif // PMU_H
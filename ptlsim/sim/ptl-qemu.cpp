@@ -44,6 +44,7 @@ extern "C" {
 #include <ptlsim.h>
 
 #include <cacheConstants.h>
+#include <pmu.h>
 
 #define __INSIDE_MARSS_QEMU__
 #include <ptlcalls.h>
@@ -65,6 +66,10 @@ uint8_t ptl_stable_state = 1;
 uint64_t ptl_start_sim_rip = 0;
 uint8_t qemu_initialized = 0;
 
+/* Checkpoint loaded with -loadvm, its micro-architectural state is restored
+ * on first simulation run */
+static stringbuf loaded_checkpoint;
+
 static char *pending_command_str = NULL;
 static int pending_call_type = -1;
 static int pending_call_arg3 = -1;
@@ -105,6 +110,22 @@ static void save_core_dump(char* dump, W64 dump_size,
                 filename, " with signal ", signum, endl;
 }
 
+/*
+ * Copy a string of 'size' bytes from guest memory, returns false if it is
+ * longer than PTLCALL_MAX_STRING
+ */
+static bool read_guest_string(stringbuf& str, W64 addr, W64 size)
+{
+    str.reset();
+    if (size > PTLCALL_MAX_STRING)
+        return false;
+
+    foreach (i, (W64s)size) {
+        str << (char)ldub_kernel((target_ulong)(addr + i));
+    }
+    return true;
+}
+
 static void ptlcall_mmio_write(CPUX86State* cpu, W64 offset, W64 value,
         int length) {
     int calltype = (int)(cpu->regs[REG_rax]);
@@ -250,6 +271,48 @@ static void ptlcall_mmio_write(CPUX86State* cpu, W64 offset, W64 value,
                 ptl_logfile << "[VM @" << sim_cycle << "] " << vm_log;
                 break;
             }
+        case PTLCALL_PMU:
+            {
+                /*
+                 * arg1: PTLCALL_PMU_READ or PTLCALL_PMU_PROGRAM
+                 * arg2: Counter
+                 * arg3: Pattern of stats to count (program)
+                 * arg4: Length of pattern (program)
+                 */
+                if (arg1 == PTLCALL_PMU_READ) {
+                    cpu->regs[REG_rax] = pmu_read(arg2);
+                } else if (arg1 == PTLCALL_PMU_PROGRAM) {
+                    stringbuf pattern;
+                    if (read_guest_string(pattern, arg3, arg4) &&
+                            pmu_program(arg2, pattern))
+                        cpu->regs[REG_rax] = 0;
+                    else
+                        cpu->regs[REG_rax] = -EINVAL;
+                } else {
+                    cpu->regs[REG_rax] = -EINVAL;
+                }
+                break;
+            }
+        case PTLCALL_ROI:
+            {
+                /*
+                 * arg1: PTLCALL_ROI_BEGIN or PTLCALL_ROI_END
+                 * arg2: Name of region
+                 * arg3: Length of name
+                 */
+                stringbuf name;
+                bool ok = false;
+
+                if (!read_guest_string(name, arg2, arg3))
+                    ok = false;
+                else if (arg1 == PTLCALL_ROI_BEGIN)
+                    ok = roi_begin(name);
+                else if (arg1 == PTLCALL_ROI_END)
+                    ok = roi_end(name);
+
+                cpu->regs[REG_rax] = ok ? 0 : -EINVAL;
+                break;
+            }
         default :
             cout << "PTLCALL type unknown : ", calltype, endl;
             cpu->regs[REG_rax] = -EINVAL;
@@ -405,6 +468,24 @@ int ptl_cpuid(uint32_t index, uint32_t count, uint32_t *eax, uint32_t *ebx,
     return 0;
 }
 
+void ptl_cpuid_features(uint32_t index, uint32_t count, uint32_t *eax,
+        uint32_t *ebx, uint32_t *ecx, uint32_t *edx)
+{
+    if (!config.avx)
+        return;
+
+    /*
+     * XSAVE/OSXSAVE are not reported as QEMU does not implement them, so
+     * software checking XCR0 still avoids AVX; code built for AVX runs.
+     * See the -avx notes in ptlsim.h for the limits.
+     */
+    if (index == 1) {
+        *ecx |= (1 << 28); /* AVX */
+    } else if (index == 7 && count == 0) {
+        *ebx |= (1 << 5); /* AVX2 */
+    }
+}
+
 void create_checkpoint(const char* chk_name)
 {
     if (!config.quiet)
@@ -416,11 +497,69 @@ void create_checkpoint(const char* chk_name)
                 qstring_from_str(chk_name)));
     do_savevm(cur_mon, checkpoint_dict);
 
+    /* Caches, TLB and predictors are only warm if simulation has run */
+    PTLsimMachine* machine = PTLsimMachine::getcurrent();
+    if (!config.no_uarch_chk && machine && machine->initialized) {
+        stringbuf filename;
+        get_uarch_chk_filename(chk_name, filename);
+
+        if (!machine->save_uarch_state(filename.buf)) {
+            cerr << "MARSSx86::Unable to save micro-architectural state to ",
+                 filename, endl;
+        }
+    }
+
     if (!config.quiet)
         cout << "MARSSx86::Checkpoint ", chk_name,
              " created\n";
 }
 
+/**
+ * @brief Get name of the file holding micro-architectural state of checkpoint
+ *
+ * @param chk_name Name of the QEMU checkpoint
+ * @param filename Output file name
+ */
+void get_uarch_chk_filename(const char* chk_name, stringbuf& filename)
+{
+    filename.reset();
+    filename << config.uarch_chk_dir, "/", chk_name, ".uarch";
+}
+
+void ptl_checkpoint_loaded(const char *chk_name)
+{
+    loaded_checkpoint.reset();
+    loaded_checkpoint << chk_name;
+}
+
+/**
+ * @brief Restore micro-architectural state saved with loaded checkpoint
+ *
+ * @param machine Newly initialized simulation machine
+ *
+ * If no state was saved with the checkpoint, or it was saved by an
+ * incompatible machine, simulation simply starts with cold structures.
+ */
+void restore_uarch_checkpoint(PTLsimMachine* machine)
+{
+    if (config.no_uarch_chk || !loaded_checkpoint.set())
+        return;
+
+    stringbuf filename;
+    get_uarch_chk_filename(loaded_checkpoint.buf, filename);
+
+    if (!machine->restore_uarch_state(filename.buf)) {
+        ptl_logfile << "No usable micro-architectural state in ", filename,
+                    ", starting with cold caches", endl;
+    } else if (!config.quiet) {
+        cout << "MARSSx86::Restored micro-architectural state from ",
+             filename, endl;
+    }
+
+    /* Only restore once, later runs continue from current state */
+    loaded_checkpoint.reset();
+}
+
 void ptl_check_ptlcall_queue() {
 
     if(pending_call_type != -1) {
@@ -1284,9 +1423,32 @@ bool Context::try_handle_fault(Waddr virtaddr, int store) {
     return true;
 }
 
+/* Guest physical page to host page of guest RAM, shared by all contexts */
+static map<Waddr, Waddr> gphys_hvirt_map;
+
 extern "C" void ptl_add_phys_memory_mapping(int8_t cpu_index, uint64_t host_vaddr, uint64_t guest_paddr)
 {
   contextof(cpu_index).hvirt_gphys_map[(Waddr)host_vaddr] = (Waddr)guest_paddr;
+  gphys_hvirt_map[(Waddr)guest_paddr] = (Waddr)host_vaddr;
+}
+
+extern "C" uint8_t* ptl_guest_ram_ptr(uint64_t guest_paddr)
+{
+  static Waddr last_gphys = (Waddr)-1;
+  static Waddr last_hvirt = 0;
+
+  Waddr page = (Waddr)guest_paddr & TARGET_PAGE_MASK;
+
+  if (page != last_gphys) {
+    map<Waddr, Waddr>::iterator it = gphys_hvirt_map.find(page);
+    if (it == gphys_hvirt_map.end())
+      return NULL;
+
+    last_gphys = page;
+    last_hvirt = it->second;
+  }
+
+  return (uint8_t*)(last_hvirt + ((Waddr)guest_paddr & ~TARGET_PAGE_MASK));
 }
 
 void ptl_quit()
@@ -1300,6 +1462,12 @@ uint64_t get_sim_cpu_freq() {
     return config.core_freq_hz;
 }
 
+uint8_t get_sim_virtual_time() {
+    return config.virtual_time;
+}
+
+W64 sim_timer_deadline = (W64)-1;
+
 /* Simpoint Support */
 
 struct Simpoint
@@ -170,6 +170,17 @@ void update_progress(void);
 int ptl_cpuid(uint32_t index, uint32_t count, uint32_t *eax, uint32_t *ebx,
 		uint32_t *ecx, uint32_t *edx);
 
+/*
+ * ptl_cpuid_features
+ * index		: cpuid index value after QEMU clamped it to the maximum
+ * count		: requested count value in cpuid
+ * eax..edx		: values computed by QEMU, updated in place
+ * working		: Add the ISA extensions only PTLsim decodes (AVX/AVX2 with
+ *				  -avx) to the feature leaves
+ */
+void ptl_cpuid_features(uint32_t index, uint32_t count, uint32_t *eax,
+		uint32_t *ebx, uint32_t *ecx, uint32_t *edx);
+
 /*
  * ptl_flush_bbcache
  * context_id	: ID of the context of which the BasicBlockCache will be
@@ -189,6 +200,17 @@ extern uint8_t ptl_stable_state;
 
 void ptl_add_phys_memory_mapping(int8_t cpu_index, uint64_t host_vaddr, uint64_t guest_paddr);
 
+/*
+ * ptl_guest_ram_ptr
+ * guest_paddr	: Guest physical address
+ * returns		: Host pointer to the guest RAM byte at guest_paddr, or NULL
+ *				  if its page was never mapped in a QEMU TLB
+ * working		: Reverse lookup of the TLB addends seen by
+ *				  ptl_add_phys_memory_mapping, used to read guest memory
+ *				  without copying it through QEMU
+ */
+uint8_t* ptl_guest_ram_ptr(uint64_t guest_paddr);
+
 /*
  * qemu_take_screenshot
  * filename     : Name of the file to store screenshot of VGA screen
@@ -204,7 +226,30 @@ void ptl_quit(void);
 
 typedef void (*QemuIOCB)(void*);
 
-void add_qemu_io_event(QemuIOCB fn, void* arg, int delay);
+/**
+ * @brief Call a device function after given number of simulated cycles
+ */
+void add_qemu_io_event(QemuIOCB fn, void* arg, W64 delay);
+
+/**
+ * @brief Time a disk request issued in current cycle
+ *
+ * @param write Non-zero for writes
+ * @param bytes Size of the request
+ *
+ * @return Cycles until the request completes, 0 if no disk model is set
+ */
+W64 ptl_disk_io_delay(int write, W64 bytes);
+
+/**
+ * @brief Time a network packet sent in current cycle
+ *
+ * @param rx Non-zero for packets going to the guest NIC
+ * @param bytes Size of the packet
+ *
+ * @return Cycles until the packet is delivered, 0 if no NIC model is set
+ */
+W64 ptl_net_io_delay(int rx, W64 bytes);
 
 /*
  * ptl_start_sim_rip
@@ -216,6 +261,20 @@ extern uint64_t qemu_ram_size;
 
 uint64_t get_sim_cpu_freq(void);
 
+/**
+ * @brief Check if QEMU clocks and timers only follow simulated time
+ */
+uint8_t get_sim_virtual_time(void);
+
+/**
+ * @brief Simulation cycle of the next QEMU timer deadline
+ *
+ * Set by QEMU in virtual time mode, the simulation loop raises QEMU's alarm
+ * with qemu_sim_alarm() when sim_cycle reaches it. All ones when no timer
+ * is pending.
+ */
+extern W64 sim_timer_deadline;
+
 /**
  * @brief Update simulation clock offset if set
  */
@@ -262,6 +321,16 @@ void set_cpu_fast_fwd(void);
  */
 void ptl_qemu_initialized(void);
 
+/**
+ * @brief Record name of checkpoint loaded by QEMU
+ *
+ * @param chk_name Name passed to -loadvm
+ *
+ * Micro-architectural state saved with this checkpoint is restored
+ * when the simulation machine is initialized.
+ */
+void ptl_checkpoint_loaded(const char *chk_name);
+
 #ifdef __cplusplus
 }
 #endif
@@ -23,7 +23,9 @@
 #include <bson/bson.h>
 #include <bson/mongo.h>
 #include <machine.h>
-#include <statelist.h>
+#include <io-models.h>
+#include <partition.h>
+#include <sampler.h>
 #include <decode.h>
 
 #include <fstream>
@@ -34,7 +36,6 @@
 /*
  * DEPRECATED CONFIG OPTIONS:
  perfect_cache
- verify_cache (this one implements 'data' in caches, it might be helpful to find bugs)
  */
 
 #ifndef CONFIG_ONLY
@@ -173,11 +174,13 @@ void ConfigurationParser<PTLsimConfig>::reset() {
   dump_state_now = 0;
 
   verify_cache = 0;
+  verify_cache_limit = 64;
   stats_filename.reset();
   yaml_stats_filename="";
   stats_format = "yaml";
   snapshot_cycles = infinity;
   snapshot_now.reset();
+  snapshot_limit = 64;
   time_stats_logfile = "";
   time_stats_period = 10000;
 
@@ -203,15 +206,33 @@ void ConfigurationParser<PTLsimConfig>::reset() {
   event_trace_replay_filename.reset();
 
   core_freq_hz = 0;
+  virtual_time = 0;
+
+  disk_model = "none";
+  disk_channels = 8;
+  disk_queue_depth = 32;
+  disk_read_latency = 50000;
+  disk_write_latency = 20000;
+  disk_bandwidth = 200;
+  nic_model = "none";
+  nic_latency = 5000;
+  nic_bandwidth = 1000;
   // default timer frequency is 100 hz in time-xen.c:
 
   perfect_cache = 0;
+  core_sleep = 0;
+  ooo_rob_size.reset();
+  ooo_iq_size.reset();
+  ooo_ldq_size.reset();
+  ooo_stq_size.reset();
+  ooo_fetchq_size.reset();
 
   dumpcode_filename = "test.dat";
   dump_at_end = 0;
   bbcache_dump_filename.reset();
 
   machine_config = "";
+  avx = 0;
 
   ///
   /// memory hierarchy implementation
@@ -240,6 +261,18 @@ void ConfigurationParser<PTLsimConfig>::reset() {
   simpoint_file = "";
   simpoint_interval = 10e6;
   simpoint_chk_name = "simpoint";
+
+  // Micro-architectural checkpoint options
+  uarch_chk_dir = ".";
+  no_uarch_chk = 0;
+
+  cache_partition = "";
+  cache_geometry = "";
+
+  sample_file.reset();
+  sample_events = "uops";
+  sample_period = 100000;
+  sample_buffer = 65536;
 }
 
 template <>
@@ -271,9 +304,10 @@ void ConfigurationParser<PTLsimConfig>::setup() {
   section("Statistics Database");
   add(stats_filename,               "stats",                "Statistics data store hierarchy root");
   add(yaml_stats_filename,          "yamlstats",                "Statistics data stores in YAML format");
-  add(stats_format,					"stats-format",          "Statistics output format, default is YAML");
+  add(stats_format,					"stats-format",          "Statistics output format: yaml (default), json, bson or text");
   add(snapshot_cycles,              "snapshot-cycles",      "Take statistical snapshot and reset every <snapshot> cycles");
   add(snapshot_now,                 "snapshot-now",         "Take statistical snapshot immediately, using specified name");
+  add(snapshot_limit,               "snapshot-limit",       "Keep only the last <n> statistical snapshots (0 for all)");
   add(time_stats_logfile,           "time-stats-logfile",   "File to write time-series statistics (new)");
   add(time_stats_period,            "time-stats-period",    "Frequency of capturing time-stats (in cycles)");
   section("Trace Start/Stop Point");
@@ -298,6 +332,18 @@ void ConfigurationParser<PTLsimConfig>::setup() {
 
   section("Timers and Interrupts");
   add(core_freq_hz,                 "corefreq",             "Core clock frequency in Hz (default uses host system frequency)");
+  add(virtual_time,                 "virtual-time",         "Drive all QEMU clocks and timers from simulated cycles, no host timers fire while simulating");
+
+  section("I/O Timing");
+  add(disk_model,                   "disk-model",           "Disk timing model: none or ssd, I/O timing options are fixed once the machine is built");
+  add(disk_channels,                "disk-channels",        "Independent channels of the disk");
+  add(disk_queue_depth,             "disk-queue-depth",     "Outstanding requests in the disk queue");
+  add(disk_read_latency,            "disk-read-latency",    "Disk read access latency in ns");
+  add(disk_write_latency,           "disk-write-latency",   "Disk write access latency in ns");
+  add(disk_bandwidth,               "disk-bandwidth",       "Disk bandwidth per channel in MB/s");
+  add(nic_model,                    "nic-model",            "NIC timing model: none or link");
+  add(nic_latency,                  "nic-latency",          "NIC per-packet latency in ns");
+  add(nic_bandwidth,                "nic-bandwidth",        "NIC link bandwidth in Mbit/s");
 
   section("Validation");
   add(checker_enabled, 		"enable-checker", 		"Enable emulation based checker");
@@ -305,16 +351,24 @@ void ConfigurationParser<PTLsimConfig>::setup() {
 
   section("Out of Order Core (ooocore)");
   add(perfect_cache,                "perfect-cache",        "Perfect cache performance: all loads and stores hit in L1");
+  add(core_sleep,                   "core-sleep",           "Stop fetching on hlt and skip the cycles of cores whose threads are all halted (cores stalled on misses still run)");
+  add(ooo_rob_size,                 "ooo-rob-size",         "ROB entries per thread, up to the configured size: <size>[,<size>...] by core id, the last one for the rest");
+  add(ooo_iq_size,                  "ooo-iq-size",          "Issue queue entries per cluster, up to the configured size, by core id like -ooo-rob-size");
+  add(ooo_ldq_size,                 "ooo-ldq-size",         "Load queue entries per thread, up to the configured size, by core id like -ooo-rob-size");
+  add(ooo_stq_size,                 "ooo-stq-size",         "Store queue entries per thread, up to the configured size, by core id like -ooo-rob-size");
+  add(ooo_fetchq_size,              "ooo-fetchq-size",      "Fetch queue entries per thread, up to the configured size, by core id like -ooo-rob-size");
 
   section("Miscellaneous");
   add(dumpcode_filename,            "dumpcode",             "Save page of user code at final rip to file <dumpcode>");
   add(dump_at_end,                  "dump-at-end",          "Set breakpoint and dump core before first instruction executed on return to native mode");
   add(bbcache_dump_filename,        "bbdump",               "Basic block cache dump filename");
 
- add(verify_cache,               "verify-cache",                   "run simulation with storing actual data in cache");
+  add(verify_cache,                 "verify-cache",         "Carry line data in caches and check loads against guest memory at commit");
+  add(verify_cache_limit,           "verify-cache-limit",   "Maximum memory for cache line data in MB with verify-cache");
 
   section("Core Configuration");
   add(machine_config, "machine", "Name of machine configuration to simulate");
+  add(avx,            "avx",     "Experimental: decode AVX/AVX2 (VEX) instructions and report them in CPUID, without XSAVE; AVX code must only run while simulating");
 
  ///
  /// following are for the new memory hierarchy implementation:
@@ -346,6 +400,22 @@ void ConfigurationParser<PTLsimConfig>::setup() {
   add(simpoint_file, "simpoint", "Create simpoint based checkpoints from given 'simpoint' file");
   add(simpoint_interval, "simpoint-interval", "Number of instructions in each interval");
   add(simpoint_chk_name, "simpoint-chk-name", "Checkpoint name prefix");
+
+  section("Micro-architectural Checkpoint Options");
+  add(uarch_chk_dir, "uarch-chk-dir", "Directory where cache/TLB/predictor state is saved along with checkpoints");
+  add(no_uarch_chk, "no-uarch-chk", "Do not save or restore micro-architectural state with checkpoints");
+
+  section("Cache Geometry");
+  add(cache_geometry, "cache-geometry", "Change size, ways and latency of caches with run time geometry: <cache>=<size>:<ways>[:<latency>],...");
+
+  section("Cache Partitioning");
+  add(cache_partition, "cache-partition", "Change way masks of partitioned caches: <cache>:cos<n>=<mask>,<cache>:core<n>=<cos>");
+
+  section("Event Sampling");
+  add(sample_file, "sample-file", "Write precise samples of committed uops to this profile file");
+  add(sample_events, "sample-events", "Comma separated events to sample: uops, l2-miss, branch-miss, tlb-miss");
+  add(sample_period, "sample-period", "Events between two samples");
+  add(sample_buffer, "sample-buffer", "Samples buffered in memory before writing to the profile file");
 };
 
 #ifndef CONFIG_ONLY
@@ -446,31 +516,152 @@ void capture_stats_snapshot(const char* name) {
     ptl_logfile << " at cycle " << sim_cycle << endl;
   }
 
-  /* TODO: Support stats snapshot in new Stats module */
+  if (!global_stats)
+    return;
+
+  PTLsimMachine* machine = PTLsimMachine::getmachine(config.core_name.buf);
+  assert(machine);
+  machine->update_stats();
+
+  StatsBuilder& builder = StatsBuilder::get();
+  builder.set_snapshot_limit(config.snapshot_limit);
+
+  stringbuf snapshot_name;
+  if (name)
+    snapshot_name << name;
+  else
+    snapshot_name << "snapshot", builder.get_snapshots_taken();
+
+  StatsSnapshot *snapshot = builder.capture_snapshot(global_stats,
+      snapshot_name, sim_cycle);
+
+  ptl_logfile << "Snapshot ", snapshot->get_name(), " copied ",
+              snapshot->new_page_count(), " of ", snapshot->page_count(),
+              " stats pages", endl;
+}
+
+/**
+ * @brief Call func for a Stats copy of each snapshot
+ *
+ * Snapshots are restored one by one into a scratch Stats tagged with the
+ * total tags and the snapshot name. Dumping makes the scratch Stats the
+ * default of all counters, their previous defaults are restored after.
+ */
+static void foreach_stats_snapshot(void (*func)(Stats *stats,
+      StatsSnapshot *snapshot, void *arg), void *arg)
+{
+  static Stats *stats = NULL;
+  StatsBuilder& builder = StatsBuilder::get();
+
+  if (!builder.snapshot_count())
+    return;
+
+  if (!stats)
+    stats = builder.get_new_stats();
+
+  dynarray<Stats*> defaults;
+  builder.save_default_stats(defaults);
+
+  foreach (i, builder.snapshot_count()) {
+    StatsSnapshot *snapshot = builder.get_snapshot(i);
+    snapshot->restore(*stats);
+
+    stringbuf tags;
+    tags << simstats.tags(global_stats), ",snapshot.", snapshot->get_name();
+    simstats.tags.set(stats, tags);
+
+    func(stats, snapshot, arg);
+  }
+
+  builder.restore_default_stats(defaults);
+}
+
+static void dump_writer_snapshot(Stats *stats, StatsSnapshot *snapshot,
+    void *arg)
+{
+  StatsWriter *writer = (StatsWriter*)arg;
+
+  (StatsBuilder::get()).dump(stats, *writer);
+}
+
+static void dump_text_snapshot(Stats *stats, StatsSnapshot *snapshot,
+    void *arg)
+{
+  stringbuf pfx;
+  pfx << "snapshot.", snapshot->get_name(), ".";
+
+  (StatsBuilder::get()).dump(stats, yaml_stats_file, pfx.buf);
+}
+
+/**
+ * @brief Call func for the Stats of each region of interest
+ *
+ * Region Stats are tagged with the total tags and the region name.
+ */
+static void foreach_stats_region(void (*func)(StatsRegion *region,
+      void *arg), void *arg)
+{
+  StatsBuilder& builder = StatsBuilder::get();
+
+  foreach (i, builder.region_count()) {
+    StatsRegion *region = builder.get_region(i);
+
+    stringbuf tags;
+    tags << simstats.tags(global_stats), ",roi.", region->get_name();
+    simstats.tags.set(region->get_stats(), tags);
+
+    func(region, arg);
+  }
+}
+
+static void dump_writer_region(StatsRegion *region, void *arg)
+{
+  StatsWriter *writer = (StatsWriter*)arg;
+
+  (StatsBuilder::get()).dump(region->get_stats(), *writer);
+}
+
+static void dump_text_region(StatsRegion *region, void *arg)
+{
+  stringbuf pfx;
+  pfx << "roi.", region->get_name(), ".";
+
+  yaml_stats_file << pfx, "entries:", region->get_entries(), "\n";
+  yaml_stats_file << pfx, "cycles:", region->get_cycles(), "\n";
+
+  (StatsBuilder::get()).dump(region->get_stats(), yaml_stats_file, pfx.buf);
 }
 
 void print_sysinfo(ostream& os) {
 	// TODO: In QEMU based system
 }
 
-void dump_yaml_stats()
+/**
+ * @brief Stream kernel, user and total stats as documents
+ *
+ * @param format Name of a StatsWriter format: yaml, json or bson
+ *
+ * Stats tree is written to the stats file while it is walked, so memory
+ * use doesn't grow with the number of counters.
+ */
+void dump_stats_documents(const char *format)
 {
     if(!config.yaml_stats_filename) {
         return;
     }
 
-    YAML::Emitter k_out, u_out, g_out;
+    StatsWriter *writer = StatsWriter::create(format, yaml_stats_file);
+    assert(writer);
 
-    (StatsBuilder::get()).dump(kernel_stats, k_out);
-    yaml_stats_file << k_out.c_str() << "\n";
+    (StatsBuilder::get()).dump(kernel_stats, *writer);
+    (StatsBuilder::get()).dump(user_stats, *writer);
+    (StatsBuilder::get()).dump(global_stats, *writer);
 
-    (StatsBuilder::get()).dump(user_stats, u_out);
-    yaml_stats_file << u_out.c_str() << "\n";
+    foreach_stats_snapshot(dump_writer_snapshot, writer);
+    foreach_stats_region(dump_writer_region, writer);
 
-    (StatsBuilder::get()).dump(global_stats, g_out);
-    yaml_stats_file << g_out.c_str() << "\n";
-
-    yaml_stats_file.flush();
+    /* Writer flushes its buffer into the file */
+    delete writer;
 }
 
 /**
@@ -485,6 +676,9 @@ void dump_text_stats()
 	(StatsBuilder::get()).dump(kernel_stats, yaml_stats_file, "kernel.");
 	(StatsBuilder::get()).dump(global_stats, yaml_stats_file, "total.");
 
+	foreach_stats_snapshot(dump_text_snapshot, NULL);
+	foreach_stats_region(dump_text_region, NULL);
+
 	yaml_stats_file.flush();
 }
 
@@ -503,11 +697,14 @@ static void flush_stats()
 
 	if (config.stats_format == "text") {
 		dump_text_stats();
+	} else if (config.stats_format == "yaml" ||
+			config.stats_format == "json" ||
+			config.stats_format == "bson") {
+		dump_stats_documents(config.stats_format);
 	} else {
-		if (config.stats_format != "yaml")
-			ptl_logfile << "Unknown Stats format: " << config.stats_format <<
-				" dumping in default YAML format." << endl;
-		dump_yaml_stats();
+		ptl_logfile << "Unknown Stats format: " << config.stats_format <<
+			" dumping in default YAML format." << endl;
+		dump_stats_documents("yaml");
 	}
 
     if(config.enable_mongo)
@@ -517,6 +714,8 @@ static void flush_stats()
         time_stats_file->close();
     }
 
+    sampler_flush();
+
     ptl_logfile << "Stats Summary:\n";
     (StatsBuilder::get()).dump_summary(ptl_logfile);
 }
@@ -553,6 +752,8 @@ static void kill_simulation()
     ptl_quit();
 }
 
+static void keep_qemu_io_config(PTLsimConfig& config);
+
 bool handle_config_change(PTLsimConfig& config) {
   static bool first_time = true;
 
@@ -579,6 +780,16 @@ bool handle_config_change(PTLsimConfig& config) {
     current_yaml_stats_filename = config.yaml_stats_filename;
   }
 
+  /* Keep running with the sampling options in use, see ptlsim.log */
+  if (!sampler_configure(config)) {
+      cerr << "[ERROR] invalid sampling options, configuration rejected" <<
+          endl << flush;
+      config.run = 0;
+      return false;
+  }
+
+  keep_qemu_io_config(config);
+
   /* There is a pending request to dump current stats to a file. */
   if ((config.stats_filename.set() || config.yaml_stats_filename.set()) && config.dump_state_now) {
 	config.dump_state_now = 0;
@@ -670,6 +881,21 @@ if ((config.loglevel > 0) & (config.start_log_at_rip == INVALIDRIP) & (config.st
       config.core_freq_hz = get_native_core_freq_hz();
   }
 
+  if (config.cache_partition.size() > 0) {
+      if (!Memory::WayPartition::command(config.cache_partition.buf))
+          cerr << "[ERROR] invalid cache partition command '" <<
+              config.cache_partition << "'" << endl << flush;
+      config.cache_partition = "";
+  }
+
+  static bool avx_reported = false;
+  if (config.avx && !avx_reported) {
+    ptl_logfile << "[WARNING] -avx reports AVX without XSAVE and QEMU can't execute VEX instructions, guest AVX code must only run while simulating", endl, flush;
+    if (!config.quiet)
+      cerr << "[WARNING] -avx reports AVX without XSAVE and QEMU can't execute VEX instructions, guest AVX code must only run while simulating" << endl << flush;
+    avx_reported = true;
+  }
+
   return true;
 }
 
@@ -822,7 +1048,11 @@ void ptl_reconfigure(const char* config_str) {
     argv[strlen(config_str)] = '\0';
 
 	config.parse(config, argv);
-	handle_config_change(config);
+	if (!handle_config_change(config)) {
+		ptl_logfile << "Configuration rejected: " << config_str << endl;
+		qemu_free(argv);
+		return;
+	}
 
 	BaseMachine* machine = (BaseMachine*)(PTLsimMachine::getmachine(
 				config.core_name));
@@ -1293,6 +1523,9 @@ extern "C" uint8_t ptl_simulate() {
 		/* Dump Machine configuration */
 		dump_machine_configuration(machine);
 
+		/* Warm up caches, TLB and predictors from loaded checkpoint */
+		restore_uarch_checkpoint(machine);
+
 		/* Update stats every half second: */
 		ticks_per_update = seconds_to_native_ticks(0.2);
 		last_printed_status_at_ticks = 0;
@@ -1418,6 +1651,8 @@ extern "C" uint8_t ptl_simulate() {
         kill_simulation();
 	}
 
+    flush_qemu_io_events();
+
     machine->first_run = 1;
     sim_update_clock_offset = 1;
 
@@ -1500,54 +1735,124 @@ void dump_all_info() {
 
 /* IO Signal Support */
 
-struct QemuIOSignal : public FixStateListObject
+static IOEventQueue *qemuIOEvents = NULL;
+static StorageModel *diskModel = NULL;
+static NetworkModel *nicModel = NULL;
+
+/* Options the IO models were built with */
+static PTLsimConfig ioConfig;
+
+/**
+ * @brief Set up the IO event queue and the disk and NIC models
+ *
+ * The models are built once with the machine, later changes of their
+ * options are reverted by keep_qemu_io_config().
+ */
+void init_qemu_io_events()
 {
-    QemuIOCB fn;
-    void *arg;
-    W64 cycle;
+    qemuIOEvents = new IOEventQueue();
 
-    void init()
-    {
-        fn = 0;
-        arg = 0;
-        cycle = 0;
+    if (config.disk_model != "none" || config.nic_model != "none") {
+        Statable *io_stats = new Statable("io");
+        diskModel = StorageModel::create(config, io_stats);
+        nicModel = NetworkModel::create(config, io_stats);
     }
 
-    void setup(QemuIOCB fn, void *arg, int delay)
-    {
-        this->fn = fn;
-        this->arg = arg;
-        this->cycle = sim_cycle + delay;
+    ioConfig = config;
+}
+
+/**
+ * @brief Revert IO model options changed after the models were built
+ *
+ * @param config Simulator options to check
+ */
+static void keep_qemu_io_config(PTLsimConfig& config)
+{
+    bool changed = false;
+
+    if (!qemuIOEvents)
+        return;
+
+#define keep(opt) \
+    if (!(config.opt == ioConfig.opt)) { \
+        config.opt = ioConfig.opt; \
+        changed = true; \
+    }
+    keep(disk_channels);
+    keep(disk_queue_depth);
+    keep(disk_read_latency);
+    keep(disk_write_latency);
+    keep(disk_bandwidth);
+    keep(nic_latency);
+    keep(nic_bandwidth);
+#undef keep
+
+    if (strcmp(config.disk_model.buf, ioConfig.disk_model.buf) ||
+            strcmp(config.nic_model.buf, ioConfig.nic_model.buf)) {
+        config.disk_model = ioConfig.disk_model;
+        config.nic_model = ioConfig.nic_model;
+        changed = true;
     }
-};
 
-static FixStateList<QemuIOSignal, 32> *qemuIOEvents = NULL;
+    if (changed) {
+        ptl_logfile << "[WARNING] disk and NIC model options can only be ",
+                    "set when the simulator starts, keeping ",
+                    config.disk_model, " disk and ", config.nic_model,
+                    " NIC", endl;
+        cerr << "[WARNING] disk and NIC model options can only be set "
+             << "when the simulator starts, keeping " << config.disk_model
+             << " disk and " << config.nic_model << " NIC" << endl << flush;
+    }
+}
 
-void init_qemu_io_events()
+void clock_qemu_io_events()
 {
-    qemuIOEvents = new FixStateList<QemuIOSignal, 32>();
+    if unlikely (sim_cycle >= sim_timer_deadline) {
+        /* Return to QEMU so its main loop runs the expired timers */
+        qemu_sim_alarm();
+        if (cpu_single_env)
+            cpu_exit(cpu_single_env);
+    }
+
+    if unlikely (sim_cycle >= qemuIOEvents->next_cycle()) {
+        qemuIOEvents->run(sim_cycle);
+    }
 }
 
-void clock_qemu_io_events()
+/**
+ * @brief Run all pending QEMU IO events, used when leaving simulation so
+ * devices don't wait for cycles that will never come
+ */
+void flush_qemu_io_events()
 {
-    QemuIOSignal *signal;
-    foreach_list_mutable(qemuIOEvents->list(), signal, entry, prev) {
-        if (signal->cycle <= sim_cycle) {
-            ptl_logfile << "Executing QEMU IO Event at " << sim_cycle << endl;
-            signal->fn(signal->arg);
-            qemuIOEvents->free(signal);
-        }
+    if (qemuIOEvents)
+        qemuIOEvents->run((W64)-1);
+}
+
+extern "C" void add_qemu_io_event(QemuIOCB fn, void *arg, W64 delay)
+{
+    qemuIOEvents->add(sim_cycle + delay, fn, arg);
+
+    if (logable(4)) {
+        ptl_logfile << "Added QEMU IO event for " << (sim_cycle + delay)
+                    << endl;
     }
 }
 
-extern "C" void add_qemu_io_event(QemuIOCB fn, void *arg, int delay)
+extern "C" W64 ptl_disk_io_delay(int write, W64 bytes)
 {
-    QemuIOSignal* signal = qemuIOEvents->alloc();
-    assert(signal);
+    if (!diskModel)
+        return 0;
 
-    signal->setup(fn, arg, delay);
+    return diskModel->request(write, bytes);
+}
+
+extern "C" W64 ptl_net_io_delay(int rx, W64 bytes)
+{
+    if (!nicModel)
+        return 0;
 
-    ptl_logfile << "Added QEMU IO event for " << (sim_cycle + delay) << endl;
+    return nicModel->packet(rx, bytes);
 }
 
 W64 ns_to_simcycles(W64 ns)
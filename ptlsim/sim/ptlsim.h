@@ -64,6 +64,8 @@ struct PTLsimMachine : public Statable {
   virtual void dump_configuration(ostream& os) const;
   virtual void reset(){};
   virtual void shutdown(){};
+  virtual bool save_uarch_state(const char* filename) { return false; }
+  virtual bool restore_uarch_state(const char* filename) { return false; }
   static void addmachine(const char* name, PTLsimMachine* machine);
   static void removemachine(const char* name, PTLsimMachine* machine);
   static PTLsimMachine* getmachine(const char* name);
@@ -134,6 +136,8 @@ struct TransOpBuffer {
 void split_unaligned(const TransOp& transop, TransOpBuffer& buf);
 
 void capture_stats_snapshot(const char* name = NULL);
+void get_uarch_chk_filename(const char* chk_name, stringbuf& filename);
+void restore_uarch_checkpoint(PTLsimMachine* machine);
 bool handle_config_change(PTLsimConfig& config);
 void collect_sysinfo(PTLsimStats& stats, int argc, char** argv);
 void print_sysinfo(ostream& os);
@@ -214,12 +218,14 @@ struct PTLsimConfig {
   bool abort_at_end;
 
   bool verify_cache;
+  W64 verify_cache_limit;
 
   // Statistics Database
   stringbuf stats_filename;
   stringbuf yaml_stats_filename;
   W64 snapshot_cycles;
   stringbuf snapshot_now;
+  W64 snapshot_limit;
   stringbuf time_stats_logfile;
   W64 time_stats_period;
   stringbuf stats_format;
@@ -246,9 +252,27 @@ struct PTLsimConfig {
 
   // Core features
   W64 core_freq_hz;
+  bool virtual_time;
+
+  // I/O timing models
+  stringbuf disk_model;
+  W64 disk_channels;
+  W64 disk_queue_depth;
+  W64 disk_read_latency;
+  W64 disk_write_latency;
+  double disk_bandwidth;
+  stringbuf nic_model;
+  W64 nic_latency;
+  double nic_bandwidth;
 
   // Out of order core features
   bool perfect_cache;
+  bool core_sleep;
+  stringbuf ooo_rob_size;
+  stringbuf ooo_iq_size;
+  stringbuf ooo_ldq_size;
+  stringbuf ooo_stq_size;
+  stringbuf ooo_fetchq_size;
 
   // Other info
   stringbuf dumpcode_filename;
@@ -258,6 +282,21 @@ struct PTLsimConfig {
   // Machine configurations
   stringbuf machine_config;
 
+  /*
+   * -avx : experimental AVX/AVX2 support, off by default.
+   *
+   * Enables the VEX decoder and reports AVX and AVX2 in CPUID. XSAVE and
+   * OSXSAVE are not reported and XCR0 does not exist, so:
+   *   - guests that check OSXSAVE/XCR0 (Linux, glibc ifuncs) never use AVX,
+   *     only binaries built with -mavx that skip the check do;
+   *   - the guest kernel doesn't save the upper YMM halves on context
+   *     switches, run one AVX process per core;
+   *   - QEMU's TCG raises #UD on VEX, so AVX code must only run while
+   *     simulating, not before -run or during fast-forward.
+   * Guests read CPUID at boot, give it with -simconfig when starting QEMU.
+   */
+  bool avx;
+
   ///
   /// for memory hierarchy implementaion
   ///
@@ -287,6 +326,20 @@ struct PTLsimConfig {
   W64 simpoint_interval;
   stringbuf simpoint_chk_name;
 
+  // Micro-architectural checkpoint options
+  stringbuf uarch_chk_dir;
+  bool no_uarch_chk;
+
+  // Cache partitioning
+  stringbuf cache_partition;
+  stringbuf cache_geometry;
+
+  // Event sampling
+  stringbuf sample_file;
+  stringbuf sample_events;
+  W64 sample_period;
+  W64 sample_buffer;
+
   void reset();
 
 };
@@ -313,6 +366,7 @@ void force_logging_enabled();
 
 void init_qemu_io_events();
 void clock_qemu_io_events();
+void flush_qemu_io_events();
 
 /**
  * @brief Convert nano-seconds to Simulation Cycles
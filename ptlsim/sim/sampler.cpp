@@ -0,0 +1,194 @@
+/*
+ * MARSSx86 : A Full System Computer-Architecture Simulator
+ *
+ * This code is released under GPL.
+ *
+ */
+
+#include <globals.h>
+#include <ptlsim.h>
+#include <sampler.h>
+
+const char* sample_event_names[SAMPLE_EVENT_COUNT] = {
+    "uops", "l2-miss", "branch-miss", "tlb-miss",
+};
+
+static stringbuf sample_filename;
+static ofstream sample_file;
+static W64 sample_period = 0;
+static W32 sample_events = 0;
+
+/* Options in use, given back to a config that is rejected */
+static stringbuf sample_events_option;
+
+static SampleRecord *sample_buffer = NULL;
+static W64 sample_buffer_size = 0;
+static W64 sample_count = 0;
+
+/* All countdowns, reset when sampling options change */
+static dynarray<SampleCountdown*> *countdowns = NULL;
+
+SampleCountdown::SampleCountdown()
+{
+    if (!countdowns)
+        countdowns = new dynarray<SampleCountdown*>();
+    countdowns->push(this);
+
+    reset();
+}
+
+SampleCountdown::~SampleCountdown()
+{
+    countdowns->remove(this);
+}
+
+void SampleCountdown::reset(int event)
+{
+    left[event] = bit(sample_events, event) ? sample_period : 0;
+}
+
+void SampleCountdown::reset()
+{
+    enabled = false;
+
+    foreach (i, SAMPLE_EVENT_COUNT) {
+        reset(i);
+        enabled |= (left[i] != 0);
+    }
+}
+
+int sampler_parse_events(const char *str)
+{
+    dynarray<stringbuf*> names;
+    int events = 0;
+
+    stringbuf buf;
+    buf << str;
+    buf.split(names, ",");
+
+    foreach (i, names.count()) {
+        int event;
+        for (event = 0; event < SAMPLE_EVENT_COUNT; event++) {
+            if (*names[i] == sample_event_names[event]) break;
+        }
+
+        if (event == SAMPLE_EVENT_COUNT) events = -1;
+        else if (events >= 0) events |= (1 << event);
+
+        delete names[i];
+    }
+
+    return events;
+}
+
+static void write_samples()
+{
+    if (!sample_count) return;
+
+    sample_file.write((const char*)sample_buffer,
+            sample_count * sizeof(SampleRecord));
+    sample_count = 0;
+}
+
+static void open_sample_file()
+{
+    SampleFileHeader header;
+
+    sample_file.open(sample_filename.buf,
+            std::ios_base::binary | std::ios_base::out);
+    if (!sample_file.is_open()) {
+        ptl_logfile << "[ERROR] Unable to open sample file ",
+                    sample_filename, endl;
+        return;
+    }
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SAMPLE_FILE_MAGIC, sizeof(header.magic));
+    header.version = SAMPLE_FILE_VERSION;
+    header.record_size = sizeof(SampleRecord);
+    header.period = sample_period;
+    header.events = sample_events;
+
+    sample_file.write((const char*)&header, sizeof(header));
+}
+
+bool sampler_configure(PTLsimConfig &config)
+{
+    W64 period = 0;
+    int events = 0;
+
+    if (config.sample_file.set()) {
+        events = sampler_parse_events(config.sample_events.buf);
+        period = config.sample_period;
+
+        if (events < 0 || !period || !config.sample_buffer) {
+            ptl_logfile << "[ERROR] invalid sampling options: events '",
+                        config.sample_events, "' period ", period,
+                        " buffer ", config.sample_buffer, endl;
+
+            config.sample_file = sample_filename;
+            if (sample_period) {
+                config.sample_events = sample_events_option;
+                config.sample_period = sample_period;
+                config.sample_buffer = sample_buffer_size;
+            }
+            return false;
+        }
+    }
+
+    if (period == sample_period && (W32)events == sample_events &&
+            !strcmp(sample_filename.buf, config.sample_file.buf) &&
+            (!period || sample_buffer_size == config.sample_buffer))
+        return true;
+
+    /* Samples taken so far belong to the old file */
+    if (sample_file.is_open()) {
+        write_samples();
+        sample_file.close();
+    }
+
+    sample_period = period;
+    sample_events = events;
+    sample_events_option = config.sample_events;
+    sample_filename.reset();
+    sample_filename << config.sample_file;
+
+    if (period && sample_buffer_size != config.sample_buffer) {
+        delete [] sample_buffer;
+        sample_buffer_size = config.sample_buffer;
+        sample_buffer = new SampleRecord[sample_buffer_size];
+    }
+
+    if (sample_period)
+        open_sample_file();
+
+    if (countdowns) {
+        foreach (i, countdowns->count()) {
+            (*countdowns)[i]->reset();
+        }
+    }
+
+    ptl_logfile << "Sampling events ", hexstring(sample_events,
+            SAMPLE_EVENT_COUNT), " every ", sample_period, " into ",
+                sample_filename, endl;
+
+    return true;
+}
+
+void sampler_record(const SampleRecord &record)
+{
+    if unlikely (!sample_file.is_open()) return;
+
+    sample_buffer[sample_count++] = record;
+
+    if unlikely (sample_count == sample_buffer_size)
+        write_samples();
+}
+
+void sampler_flush()
+{
+    if (!sample_file.is_open()) return;
+
+    write_samples();
+    sample_file.flush();
+}
@@ -0,0 +1,117 @@
+/*
+ * MARSSx86 : A Full System Computer-Architecture Simulator
+ *
+ * This code is released under GPL.
+ *
+ */
+
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include <globals.h>
+#include <superstl.h>
+
+/*
+ * Precise event sampling
+ *
+ * Every 'sample-period' events of each kind in 'sample-events' a core
+ * records the committing uop into a buffer of 'sample-buffer' records,
+ * which is appended to 'sample-file' when it fills and at the end of
+ * the run. Events are counted down per thread, so only sampled uops
+ * pay for building a record. util/marss-profile.py symbolizes the file
+ * against guest binaries.
+ *
+ * File format: a SampleFileHeader followed by SampleRecords, all in
+ * host byte order.
+ */
+
+enum SampleEvent {
+    SAMPLE_UOPS,
+    SAMPLE_L2_MISS,
+    SAMPLE_BRANCH_MISS,
+    SAMPLE_TLB_MISS,
+    SAMPLE_EVENT_COUNT
+};
+
+extern const char* sample_event_names[SAMPLE_EVENT_COUNT];
+
+enum {
+    SAMPLE_FLAG_KERNEL   = (1 << 0),
+    SAMPLE_FLAG_L1_MISS  = (1 << 1),
+    SAMPLE_FLAG_L2_MISS  = (1 << 2),
+    SAMPLE_FLAG_L3_MISS  = (1 << 3),
+    SAMPLE_FLAG_TLB_MISS = (1 << 4),
+    SAMPLE_FLAG_MISPRED  = (1 << 5),
+    SAMPLE_FLAG_DRAM     = (1 << 6),
+};
+
+#define SAMPLE_FILE_MAGIC   "MARSSPRF"
+#define SAMPLE_FILE_VERSION 1
+
+struct SampleFileHeader {
+    char magic[8];
+    W32 version;
+    W32 record_size;
+    W64 period;
+    W32 events;         // bitmask of sampled SampleEvents
+    W32 pad;
+};
+
+struct SampleRecord {
+    W64 cycle;
+    W64 rip;
+    W64 addr;           // data virtual address, 0 if not a load or store
+    W64 cr3;            // page table base, identifies the guest process
+    W32 latency;        // cycles from rename to commit
+    W32 mem_latency;    // cycles for load data to return, 0 if none
+    W8  event;
+    W8  flags;          // SAMPLE_FLAG_*
+    W8  coreid;
+    W8  threadid;
+    W32 pad;
+};
+
+/**
+ * @brief Per thread countdown to the next sample of each event
+ *
+ * A countdown of 0 means the event is not sampled.
+ */
+struct SampleCountdown {
+    W64 left[SAMPLE_EVENT_COUNT];
+    bool enabled;
+
+    SampleCountdown();
+    ~SampleCountdown();
+
+    void reset();
+
+    /* Count one event, true if it has to be sampled */
+    bool tick(int event) {
+        if likely (!left[event]) return false;
+        if likely (--left[event]) return false;
+        reset(event);
+        return true;
+    }
+
+    void reset(int event);
+};
+
+/*
+ * Apply sampling options of 'config', returns false if they are invalid.
+ * In that case the options in use are kept and copied back to 'config'.
+ */
+struct PTLsimConfig;
+bool sampler_configure(PTLsimConfig &config);
+
+/*
+ * Parse a comma separated list of event names, returns the event bitmask
+ * or -1 if any name is unknown.
+ */
+int sampler_parse_events(const char *str);
+
+void sampler_record(const SampleRecord &record);
+
+/* Write buffered samples to the sample file */
+void sampler_flush();
+
+#endif // SAMPLER_H
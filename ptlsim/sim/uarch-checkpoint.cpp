@@ -0,0 +1,268 @@
+/*
+ * MARSSx86 : A Full System Computer-Architecture Simulator
+ *
+ * This code is released under GPL.
+ *
+ * Copyright 2011 Avadh Patel <apatel@cs.binghamton.edu>
+ *
+ */
+
+#include <ptlsim.h>
+#include <uarch-checkpoint.h>
+
+/* Upper bound on section and signature names, guards against corrupt files */
+#define UARCH_CHK_MAX_NAME 256
+
+UarchStateWriter::UarchStateWriter()
+    : inSection_(false)
+    , section_(NULL)
+    , sectionSize_(0)
+    , sectionCapacity_(0)
+{
+}
+
+UarchStateWriter::~UarchStateWriter()
+{
+    close();
+    delete [] section_;
+}
+
+bool UarchStateWriter::open(const char *filename, const char *signature)
+{
+    os_.open(filename, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!os_.is_open())
+        return false;
+
+    W64 magic = UARCH_CHK_MAGIC;
+    W32 version = UARCH_CHK_VERSION;
+
+    write(&magic, sizeof(magic));
+    write(&version, sizeof(version));
+    put_string(signature);
+
+    return os_.good();
+}
+
+void UarchStateWriter::close()
+{
+    if (!os_.is_open())
+        return;
+
+    if (inSection_)
+        end_section();
+
+    os_.close();
+}
+
+void UarchStateWriter::write(const void *data, W64 size)
+{
+    os_.write((const char*)data, size);
+}
+
+void UarchStateWriter::put_string(const char *str)
+{
+    W32 len = strlen(str);
+    write(&len, sizeof(len));
+    write(str, len);
+}
+
+/*
+ * Section payload is kept in memory until end_section(), so its size is
+ * known before anything is written.
+ */
+void UarchStateWriter::begin_section(const char *name)
+{
+    assert(!inSection_);
+
+    put_string(name);
+    sectionSize_ = 0;
+    inSection_ = true;
+}
+
+void UarchStateWriter::end_section()
+{
+    assert(inSection_);
+
+    write(&sectionSize_, sizeof(sectionSize_));
+    write(section_, sectionSize_);
+
+    sectionSize_ = 0;
+    inSection_ = false;
+}
+
+void UarchStateWriter::put_block(const void *data, W64 size)
+{
+    assert(inSection_);
+
+    if (sectionSize_ + size > sectionCapacity_) {
+        W64 capacity = max(sectionCapacity_ * 2, (W64)4096);
+        while (capacity < sectionSize_ + size)
+            capacity *= 2;
+
+        byte *buf = new byte[capacity];
+        memcpy(buf, section_, sectionSize_);
+        delete [] section_;
+        section_ = buf;
+        sectionCapacity_ = capacity;
+    }
+
+    memcpy(section_ + sectionSize_, data, size);
+    sectionSize_ += size;
+}
+
+UarchStateReader::UarchStateReader()
+    : section_(NULL)
+    , sectionSize_(0)
+    , sectionPos_(0)
+{
+}
+
+UarchStateReader::~UarchStateReader()
+{
+    close();
+}
+
+/**
+ * @brief Open a checkpoint file and index its sections
+ *
+ * @param filename File to read
+ * @param signature Signature of the running machine
+ *
+ * @return false if file is missing, corrupt, from an other version or
+ * was created by a different machine configuration.
+ */
+bool UarchStateReader::open(const char *filename, const char *signature)
+{
+    is_.open(filename, std::ios::in | std::ios::binary);
+    if (!is_.is_open())
+        return false;
+
+    W64 magic = 0;
+    W32 version = 0;
+    stringbuf sig;
+
+    if (!read(&magic, sizeof(magic)) || magic != UARCH_CHK_MAGIC) {
+        ptl_logfile << "uarch checkpoint ", filename, ": bad magic", endl;
+        return false;
+    }
+
+    if (!read(&version, sizeof(version)) || version != UARCH_CHK_VERSION) {
+        ptl_logfile << "uarch checkpoint ", filename, ": version ",
+                    version, " is not supported (expected ",
+                    UARCH_CHK_VERSION, ")", endl;
+        return false;
+    }
+
+    if (!get_string(sig) || strcmp(sig.buf, signature)) {
+        ptl_logfile << "uarch checkpoint ", filename, ": created for '",
+                    sig, "' while running '", signature, "'", endl;
+        return false;
+    }
+
+    /* Build the section index */
+    while (true) {
+        stringbuf name;
+        W64 size;
+
+        if (!get_string(name) || !read(&size, sizeof(size)))
+            break;
+
+        Section *section = new Section();
+        section->name << name;
+        section->offset = is_.tellg();
+        section->size = size;
+        sections_.push(section);
+
+        is_.seekg(size, std::ios::cur);
+    }
+
+    is_.clear();
+
+    return true;
+}
+
+void UarchStateReader::close()
+{
+    if (is_.is_open())
+        is_.close();
+
+    foreach (i, sections_.size()) {
+        delete sections_[i];
+    }
+    sections_.clear();
+
+    delete [] section_;
+    section_ = NULL;
+    sectionSize_ = 0;
+    sectionPos_ = 0;
+}
+
+bool UarchStateReader::read(void *data, W64 size)
+{
+    if (!is_.good())
+        return false;
+
+    is_.read((char*)data, size);
+    return ((W64)is_.gcount() == size);
+}
+
+bool UarchStateReader::get_string(stringbuf& str)
+{
+    W32 len;
+    if (!read(&len, sizeof(len)) || len >= UARCH_CHK_MAX_NAME)
+        return false;
+
+    char buf[UARCH_CHK_MAX_NAME];
+    if (!read(buf, len))
+        return false;
+
+    buf[len] = '\0';
+    str << buf;
+    return true;
+}
+
+/**
+ * @brief Load named section, following get() calls read its payload
+ *
+ * @return false if section is missing or truncated
+ */
+bool UarchStateReader::find_section(const char *name)
+{
+    delete [] section_;
+    section_ = NULL;
+    sectionSize_ = 0;
+    sectionPos_ = 0;
+
+    foreach (i, sections_.size()) {
+        Section *section = sections_[i];
+        if (strcmp(section->name.buf, name))
+            continue;
+
+        /* Don't trust sizes of corrupt files for the allocation */
+        is_.clear();
+        is_.seekg(0, std::ios::end);
+        W64 fileSize = is_.tellg();
+        if (section->offset + section->size > fileSize)
+            return false;
+
+        section_ = new byte[section->size + 1];
+        is_.seekg(section->offset);
+        if (!read(section_, section->size))
+            return false;
+
+        sectionSize_ = section->size;
+        return true;
+    }
+
+    return false;
+}
+
+bool UarchStateReader::get_block(void *data, W64 size)
+{
+    if (size > sectionSize_ - sectionPos_)
+        return false;
+
+    memcpy(data, section_ + sectionPos_, size);
+    sectionPos_ += size;
+    return true;
+}
@@ -0,0 +1,218 @@
+/*
+ * MARSSx86 : A Full System Computer-Architecture Simulator
+ *
+ * This code is released under GPL.
+ *
+ * Copyright 2011 Avadh Patel <apatel@cs.binghamton.edu>
+ *
+ */
+
+#ifndef UARCH_CHECKPOINT_H
+#define UARCH_CHECKPOINT_H
+
+#include <globals.h>
+#include <superstl.h>
+#include <logic.h>
+
+/*
+ * Micro-architectural checkpoints
+ *
+ * QEMU's savevm only captures architectural state, so a simulation started
+ * from a checkpoint sees cold caches, TLBs and predictors. These classes
+ * read and write a small binary file, saved next to each checkpoint, that
+ * holds the warmable state of the simulated machine.
+ *
+ * File layout:
+ *   header  : magic (W64), version (W32), signature string
+ *   section : name string, payload size (W64), payload
+ *   ...
+ *
+ * Each section is owned by one simulator object (a controller, a core...)
+ * and is looked up by name at restore time. Sections carry their own size
+ * so that a reader can skip the ones that do not match the running machine.
+ *
+ * Payloads are written field by field with fixed width integers, never as
+ * host images of structures, so the format does not depend on structure
+ * layout, padding or pointers. Arrays and bit vectors carry their length.
+ * A reader loads a whole section in memory before it is parsed, modules
+ * parse it into temporary state and only update themselves once the
+ * section was read completely.
+ */
+
+#define UARCH_CHK_MAGIC   0x4b4843415241554dULL /* "MUARACHK" */
+#define UARCH_CHK_VERSION 3
+
+class UarchStateWriter
+{
+    private:
+        ofstream os_;
+        bool inSection_;
+
+        /* Payload of the current section, written by end_section() */
+        byte *section_;
+        W64 sectionSize_;
+        W64 sectionCapacity_;
+
+        void write(const void *data, W64 size);
+        void put_string(const char *str);
+
+    public:
+        UarchStateWriter();
+        ~UarchStateWriter();
+
+        bool open(const char *filename, const char *signature);
+        void close();
+
+        void begin_section(const char *name);
+        void end_section();
+
+        void put_block(const void *data, W64 size);
+
+        /* Fixed width integer or bool */
+        template <typename T>
+        void put(const T& value)
+        {
+            put_block(&value, sizeof(T));
+        }
+
+        /* Array of fixed width integers, prefixed by its length */
+        template <typename T>
+        void put_array(const T *values, W64 count)
+        {
+            put(count);
+            put_block(values, count * sizeof(T));
+        }
+
+        /* Bit vector, one byte per 8 bits, prefixed by its width */
+        template <size_t N>
+        void put_bits(const bitvec<N>& bits)
+        {
+            put((W32)N);
+            for (int i = 0; i < (int)N; i += 8) {
+                byte b = 0;
+                for (int j = i; j < (int)N && j < i + 8; j++)
+                    b |= bits[j] << (j - i);
+                put(b);
+            }
+        }
+
+        /**
+         * @brief Write tags, NRU bits and entries of an associative array
+         *
+         * Entries write their own fields with save_state().
+         */
+        template <typename T, typename V, int SETS, int WAYS, int LINE,
+                 typename ST>
+        void put_associative(const AssociativeArray<T, V, SETS, WAYS, LINE,
+                ST>& array)
+        {
+            put((W32)SETS);
+            put((W32)WAYS);
+            foreach (i, SETS) {
+                put_bits(array.sets[i].tags.evictmap);
+                foreach (j, WAYS) {
+                    put((W64)array.sets[i].tags.tags[j]);
+                    array.sets[i].data[j].save_state(*this);
+                }
+            }
+        }
+};
+
+class UarchStateReader
+{
+    private:
+        struct Section {
+            stringbuf name;
+            W64 offset;
+            W64 size;
+        };
+
+        ifstream is_;
+        dynarray<Section*> sections_;
+
+        /* Payload of the current section */
+        byte *section_;
+        W64 sectionSize_;
+        W64 sectionPos_;
+
+        bool read(void *data, W64 size);
+        bool get_string(stringbuf& str);
+
+    public:
+        UarchStateReader();
+        ~UarchStateReader();
+
+        bool open(const char *filename, const char *signature);
+        void close();
+
+        bool find_section(const char *name);
+
+        bool get_block(void *data, W64 size);
+
+        template <typename T>
+        bool get(T& value)
+        {
+            return get_block(&value, sizeof(T));
+        }
+
+        /* Array written by put_array(), its length must be 'count' */
+        template <typename T>
+        bool get_array(T *values, W64 count)
+        {
+            W64 saved;
+            if (!get(saved) || saved != count)
+                return false;
+            return get_block(values, count * sizeof(T));
+        }
+
+        template <size_t N>
+        bool get_bits(bitvec<N>& bits)
+        {
+            W32 width;
+            if (!get(width) || width != (W32)N)
+                return false;
+
+            bits = 0;
+            for (int i = 0; i < (int)N; i += 8) {
+                byte b;
+                if (!get(b))
+                    return false;
+                for (int j = i; j < (int)N && j < i + 8; j++)
+                    bits[j] = (b >> (j - i)) & 1;
+            }
+            return true;
+        }
+
+        /**
+         * @brief Read an array written by put_associative()
+         *
+         * @array is overwritten even on failure, callers read into a
+         * temporary array.
+         */
+        template <typename T, typename V, int SETS, int WAYS, int LINE,
+                 typename ST>
+        bool get_associative(AssociativeArray<T, V, SETS, WAYS, LINE,
+                ST>& array)
+        {
+            W32 sets, ways;
+            if (!get(sets) || !get(ways) || sets != (W32)SETS ||
+                    ways != (W32)WAYS)
+                return false;
+
+            foreach (i, SETS) {
+                if (!get_bits(array.sets[i].tags.evictmap))
+                    return false;
+                foreach (j, WAYS) {
+                    W64 tag;
+                    if (!get(tag))
+                        return false;
+                    array.sets[i].tags.tags[j] = tag;
+                    if (!array.sets[i].data[j].restore_state(*this))
+                        return false;
+                }
+            }
+            return true;
+        }
+};
+
+#endif // UARCH_CHECKPOINT_H
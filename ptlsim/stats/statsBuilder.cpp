@@ -12,6 +12,8 @@
 
 #include <ptlsim.h>
 
+#include <fnmatch.h>
+
 static Stats *periodic_stats = NULL;
 static Stats *temp_stats  = NULL;
 static Stats *temp2_stats  = NULL;
@@ -236,6 +238,25 @@ bson_buffer* Statable::dump(bson_buffer *bb, Stats *stats)
     return bb;
 }
 
+void Statable::dump(StatsWriter &out, Stats *stats)
+{
+    if(dump_disabled) return;
+
+    out.begin_map(name.size() ? (char *)name : NULL);
+
+    // First print all the leafs
+    foreach(i, leafs.count()) {
+        leafs[i]->dump(out, stats);
+    }
+
+    // Now print all the child nodes
+    foreach(i, childNodes.count()) {
+        childNodes[i]->dump(out, stats);
+    }
+
+    out.end_map();
+}
+
 void Statable::add_stats(Stats& dest_stats, Stats& src_stats)
 {
     // First add all the leafs
@@ -249,6 +270,33 @@ void Statable::add_stats(Stats& dest_stats, Stats& src_stats)
     }
 }
 
+void Statable::save_default_stats(dynarray<Stats*> &defaults) const
+{
+    defaults.push(default_stats);
+
+    foreach(i, leafs.count()) {
+        defaults.push(leafs[i]->get_default_stats());
+    }
+
+    foreach(i, childNodes.count()) {
+        childNodes[i]->save_default_stats(defaults);
+    }
+}
+
+void Statable::restore_default_stats(const dynarray<Stats*> &defaults,
+        int &idx)
+{
+    default_stats = defaults[idx++];
+
+    foreach(i, leafs.count()) {
+        leafs[i]->set_default_stats(defaults[idx++]);
+    }
+
+    foreach(i, childNodes.count()) {
+        childNodes[i]->restore_default_stats(defaults, idx);
+    }
+}
+
 void Statable::sub_stats(Stats& dest_stats, Stats& src_stats)
 {
     // First add all the leafs
@@ -339,6 +387,62 @@ StatObjBase* Statable::get_stat_obj(dynarray<stringbuf*> &names, int idx)
 	return NULL;
 }
 
+StatsDelta::StatsDelta(Statable *node)
+    : node_(node)
+      , delta_(NULL)
+      , scratch_(NULL)
+{}
+
+StatsDelta::~StatsDelta()
+{
+    if (delta_)
+        StatsBuilder::get().destroy_stats(delta_);
+    if (scratch_)
+        StatsBuilder::get().destroy_stats(scratch_);
+}
+
+/**
+ * @brief Start recording the stats a cycle adds to 'stats'
+ */
+void StatsDelta::begin(Stats &stats)
+{
+    if (!delta_)
+        delta_ = StatsBuilder::get().get_new_stats();
+
+    delta_->reset();
+    node_->sub_stats(*delta_, stats);
+}
+
+/**
+ * @brief End of the recorded cycle, keep what it added to 'stats'
+ */
+void StatsDelta::end(Stats &stats)
+{
+    node_->add_stats(*delta_, stats);
+}
+
+/**
+ * @brief Add the recorded delta 'count' times to 'stats'
+ *
+ * Uses binary doubling, so the cost is logarithmic in 'count'.
+ */
+void StatsDelta::add(Stats &stats, W64 count)
+{
+    if (!count)
+        return;
+
+    if (!scratch_)
+        scratch_ = StatsBuilder::get().get_new_stats();
+
+    *scratch_ = *delta_;
+    for (W64 n = count; n; n >>= 1) {
+        if (n & 1)
+            node_->add_stats(stats, *scratch_);
+        if (n > 1)
+            node_->add_stats(*scratch_, *scratch_);
+    }
+}
+
 StatsBuilder *StatsBuilder::_builder = NULL;
 
 Stats* StatsBuilder::get_new_stats()
@@ -350,10 +454,132 @@ Stats* StatsBuilder::get_new_stats()
 
 void StatsBuilder::destroy_stats(Stats *stats)
 {
-    delete stats->mem;
     delete stats;
 }
 
+StatsSnapshot* StatsBuilder::capture_snapshot(Stats *stats,
+        const char *name, W64 cycle)
+{
+    StatsSnapshot *prev = NULL;
+    if (snapshots.size())
+        prev = snapshots[snapshots.size() - 1];
+
+    StatsSnapshot *snapshot = new StatsSnapshot(name, cycle, *stats, prev);
+    Stats::clear_dirty();
+
+    /* Pages of dropped snapshots shared with later ones stay */
+    while (snapshot_limit > 0 && snapshots.size() >= snapshot_limit) {
+        StatsSnapshot *oldest = snapshots[0];
+        snapshots.remove(oldest);
+        delete oldest;
+    }
+
+    snapshots.push(snapshot);
+    snapshots_taken++;
+
+    return snapshot;
+}
+
+void StatsBuilder::save_default_stats(dynarray<Stats*> &defaults) const
+{
+    defaults.clear();
+    rootNode->save_default_stats(defaults);
+}
+
+void StatsBuilder::restore_default_stats(const dynarray<Stats*> &defaults)
+    const
+{
+    int idx = 0;
+    rootNode->restore_default_stats(defaults, idx);
+    assert(idx == defaults.size());
+}
+
+W64 Stats::dirty_pages[(STATS_PAGES + 63) / 64];
+
+Stats::Stats()
+{
+    /* Anonymous memory is zero filled and only backed once touched */
+    void *addr = mmap(NULL, STATS_SIZE, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    assert(addr != MAP_FAILED);
+
+    mem = (W8*)addr;
+}
+
+Stats::~Stats()
+{
+    munmap(mem, STATS_SIZE);
+}
+
+StatsSnapshot::StatsSnapshot(const char *name, W64 cycle, Stats &stats,
+        const StatsSnapshot *prev)
+    : cycle(cycle)
+      , new_pages(0)
+{
+    this->name = name;
+
+    W8 *mem = (W8*)stats.base();
+    int count = (StatsBuilder::get()).get_used_size() / STATS_PAGE_SIZE;
+
+    foreach (i, count) {
+        W8 *data = mem + i * STATS_PAGE_SIZE;
+        Page *page = NULL;
+
+        if (prev && i < prev->pages.size()) {
+            page = prev->pages[i];
+            if (Stats::is_dirty(i) &&
+                    memcmp(page->data, data, STATS_PAGE_SIZE) != 0)
+                page = NULL;
+        }
+
+        if (page) {
+            page->refs++;
+        } else {
+            page = new Page();
+            page->refs = 1;
+            memcpy(page->data, data, STATS_PAGE_SIZE);
+            new_pages++;
+        }
+
+        pages.push(page);
+    }
+}
+
+StatsSnapshot::~StatsSnapshot()
+{
+    foreach (i, pages.size()) {
+        if (--pages[i]->refs == 0)
+            delete pages[i];
+    }
+}
+
+void StatsSnapshot::restore(Stats &stats) const
+{
+    W8 *mem = (W8*)stats.base();
+
+    foreach (i, pages.size()) {
+        memcpy(mem + i * STATS_PAGE_SIZE, pages[i]->data, STATS_PAGE_SIZE);
+    }
+
+    /* Counters added after this snapshot was taken */
+    W64 size = pages.size() * STATS_PAGE_SIZE;
+    W64 used = (StatsBuilder::get()).get_used_size();
+    if (used > size)
+        memset(mem + size, 0, used - size);
+}
+
+int StatsSnapshot::changed_pages(const StatsSnapshot &other) const
+{
+    int changed = 0;
+
+    foreach (i, pages.size()) {
+        if (i >= other.pages.size() || pages[i] != other.pages[i])
+            changed++;
+    }
+
+    return changed;
+}
+
 ostream& StatsBuilder::dump_header(ostream &os) const
 {
     if (rootNode->is_dump_periodic())
@@ -446,6 +672,16 @@ bson_buffer* StatsBuilder::dump(Stats *stats, bson_buffer *bb) const
     return rootNode->dump(bb, stats);
 }
 
+void StatsBuilder::dump(Stats *stats, StatsWriter &out) const
+{
+    // First set the stats as default stats in each node
+    rootNode->set_default_stats(stats, true, true);
+
+    out.begin_document();
+    rootNode->dump(out, stats);
+    out.end_document();
+}
+
 /**
  * @brief Get Statistic Object from name
  *
@@ -479,6 +715,89 @@ StatObjBase* StatsBuilder::get_stat_obj(const char *name)
 	return get_stat_obj(name_);
 }
 
+/**
+ * @brief Add counters under this node that match patterns[idx..]
+ */
+void Statable::find_stats(dynarray<stringbuf*> &patterns, int idx,
+        dynarray<StatRef> &refs)
+{
+    const char *pattern = patterns[idx]->buf;
+    bool last = (idx == patterns.size() - 1);
+
+    if (!last) {
+        foreach (i, childNodes.size()) {
+            if (fnmatch(pattern, childNodes[i]->get_name(), 0) == 0)
+                childNodes[i]->find_stats(patterns, idx + 1, refs);
+        }
+    }
+
+    foreach (i, leafs.size()) {
+        StatObjBase *leaf = leafs[i];
+
+        if (fnmatch(pattern, leaf->get_name(), 0) != 0)
+            continue;
+
+        if (last) {
+            refs.push(StatRef(leaf, -1));
+        } else if (idx == patterns.size() - 2) {
+            int index = leaf->get_label_index(patterns[idx + 1]->buf);
+            if (index >= 0)
+                refs.push(StatRef(leaf, index));
+        }
+    }
+}
+
+int StatsBuilder::find_stats(const char *pattern, dynarray<StatRef> &refs)
+{
+    dynarray<stringbuf*> patterns;
+    stringbuf name;
+    int count = refs.size();
+
+    name << pattern;
+    name.split(patterns, ".");
+
+    if (patterns.size() > 0)
+        rootNode->find_stats(patterns, 0, refs);
+
+    foreach (i, patterns.size()) {
+        delete patterns[i];
+    }
+
+    return refs.size() - count;
+}
+
+StatsRegion* StatsBuilder::get_region(const char *name)
+{
+    foreach (i, regions.size()) {
+        if (strequal(regions[i]->get_name(), name))
+            return regions[i];
+    }
+
+    StatsRegion *region = new StatsRegion(name);
+    regions.push(region);
+    return region;
+}
+
+StatsRegion::StatsRegion(const char *name)
+    : entries(0)
+      , cycles(0)
+{
+    this->name = name;
+    stats = (StatsBuilder::get()).get_new_stats();
+}
+
+StatsRegion::~StatsRegion()
+{
+    (StatsBuilder::get()).destroy_stats(stats);
+}
+
+void StatsRegion::add(Stats &delta, W64 cycles)
+{
+    *stats += delta;
+    entries++;
+    this->cycles += cycles;
+}
+
 void StatObjBase::set_default_stats(Stats *stats)
 {
     default_stats = stats;
@@ -17,14 +17,33 @@
 #include <yaml/yaml.h>
 #include <bson/bson.h>
 
+#include <statsWriter.h>
+
 #ifdef ENABLE_TESTS
 #  define STATS_SIZE 1024*1024*10
 #else
 #  define STATS_SIZE 1024*1024
 #endif
 
+/* Stats memory is cleared, copied and snapshotted in pages */
+#define STATS_PAGE_SIZE 4096
+#define STATS_PAGES ((STATS_SIZE) / STATS_PAGE_SIZE)
+
 class StatObjBase;
 class Stats;
+class StatsSnapshot;
+class StatsRegion;
+
+/**
+ * @brief Reference to a counter, or one element of a counter array
+ */
+struct StatRef {
+    StatObjBase *obj;
+    int index;
+
+    StatRef() : obj(NULL), index(-1) {}
+    StatRef(StatObjBase *obj, int index) : obj(obj), index(index) {}
+};
 
 inline static YAML::Emitter& operator << (YAML::Emitter& out, const W64 value)
 {
@@ -234,9 +253,21 @@ class Statable {
          */
         bson_buffer* dump(bson_buffer *bb, Stats *stats);
 
+        /**
+         * @brief Stream Statable and its childs to a StatsWriter
+         *
+         * @param out Writer to stream into
+         * @param stats Stats database to read data from
+         */
+        void dump(StatsWriter &out, Stats *stats);
+
         void add_stats(Stats& dest_stats, Stats& src_stats);
         void sub_stats(Stats& dest_stats, Stats& src_stats);
 
+        void save_default_stats(dynarray<Stats*> &defaults) const;
+        void restore_default_stats(const dynarray<Stats*> &defaults,
+                int &idx);
+
         void add_periodic_stats(Stats& dest_stats, Stats& src_stats);
         void sub_periodic_stats(Stats& dest_stats, Stats& src_stats);
 
@@ -247,6 +278,31 @@ class Statable {
         stringbuf *get_full_stat_string() const;
 
 		StatObjBase* get_stat_obj(dynarray<stringbuf*> &names, int idx);
+
+        void find_stats(dynarray<stringbuf*> &patterns, int idx,
+                dynarray<StatRef> &refs);
+};
+
+/**
+ * @brief Stats added by one cycle of a Statable subtree, repeated in bulk
+ *
+ * A model that skips cycles which would all add the same stats records one
+ * such cycle between begin() and end(), then add() adds that delta once
+ * per skipped cycle.
+ */
+class StatsDelta {
+    private:
+        Statable *node_;
+        Stats *delta_;
+        Stats *scratch_;
+
+    public:
+        StatsDelta(Statable *node);
+        ~StatsDelta();
+
+        void begin(Stats &stats);
+        void end(Stats &stats);
+        void add(Stats &stats, W64 count);
 };
 
 /**
@@ -262,11 +318,20 @@ class StatsBuilder {
         static StatsBuilder *_builder;
         Statable *rootNode;
         W64 stat_offset;
+        W64 stat_limit;
+
+        dynarray<StatsSnapshot*> snapshots;
+        int snapshot_limit;
+        W64 snapshots_taken;
+        dynarray<StatsRegion*> regions;
 
         StatsBuilder()
         {
             rootNode = new Statable("", true);
             stat_offset = 0;
+            stat_limit = 0;
+            snapshot_limit = 0;
+            snapshots_taken = 0;
         }
 
         ~StatsBuilder()
@@ -312,9 +377,23 @@ class StatsBuilder {
             W64 ret_val = stat_offset;
             stat_offset += size;
             assert(stat_offset < STATS_SIZE);
+            stat_limit = max(stat_limit, stat_offset);
             return ret_val;
         }
 
+        /**
+         * @brief Get number of bytes of Stats memory in use
+         *
+         * @return Highest offset ever allocated, rounded up to a page
+         *
+         * Stats objects never write past this limit so reset, copy and
+         * snapshot only need to touch this part of their memory.
+         */
+        W64 get_used_size() const
+        {
+            return ceil(stat_limit, STATS_PAGE_SIZE);
+        }
+
         /**
          * @brief Get a new Stats object
          *
@@ -329,6 +408,58 @@ class StatsBuilder {
          */
         void destroy_stats(Stats *stats);
 
+        /**
+         * @brief Take a named snapshot of a Stats database
+         *
+         * @param stats Stats to copy
+         * @param name Name of the snapshot
+         * @param cycle Simulation cycle of the snapshot
+         *
+         * @return new snapshot, owned by StatsBuilder
+         *
+         * Only pages written since the previous snapshot are compared with
+         * it, see Stats::mark_dirty(). When the snapshot limit is reached
+         * the oldest snapshot is dropped.
+         */
+        StatsSnapshot* capture_snapshot(Stats *stats, const char *name,
+                W64 cycle);
+
+        int snapshot_count() const { return snapshots.size(); }
+        StatsSnapshot* get_snapshot(int idx) { return snapshots[idx]; }
+
+        /* Number of snapshots taken, including dropped ones */
+        W64 get_snapshots_taken() const { return snapshots_taken; }
+
+        /**
+         * @brief Limit number of snapshots kept in memory
+         *
+         * @param limit Maximum number of snapshots, 0 for no limit
+         */
+        void set_snapshot_limit(int limit) { snapshot_limit = limit; }
+
+        /**
+         * @brief Save default Stats of every counter
+         *
+         * @param defaults Filled with default Stats in tree order
+         *
+         * Dumping changes the default Stats of all counters, use this with
+         * restore_default_stats() to dump without touching them.
+         */
+        void save_default_stats(dynarray<Stats*> &defaults) const;
+        void restore_default_stats(const dynarray<Stats*> &defaults) const;
+
+        /**
+         * @brief Get a named region, created on first use
+         *
+         * @param name Name of the region
+         *
+         * @return region, owned by StatsBuilder
+         */
+        StatsRegion* get_region(const char *name);
+
+        int region_count() const { return regions.size(); }
+        StatsRegion* get_region(int idx) { return regions[idx]; }
+
         /**
          * @brief Dump whole Stats tree to ostream
          *
@@ -360,6 +491,14 @@ class StatsBuilder {
          */
         bson_buffer* dump(Stats *stats, bson_buffer *bb) const;
 
+        /**
+         * @brief Stream Stats tree as one document of a StatsWriter
+         *
+         * @param stats Use given Stats* for values
+         * @param out Writer to stream into
+         */
+        void dump(Stats *stats, StatsWriter &out) const;
+
         void init_timer_stats();
 
         void add_stats(Stats& dest_stats, Stats& src_stats) const
@@ -399,6 +538,19 @@ class StatsBuilder {
 
 		StatObjBase* get_stat_obj(stringbuf &name);
 		StatObjBase* get_stat_obj(const char *name);
+
+        /**
+         * @brief Find counters matching a name pattern
+         *
+         * @param pattern Dot separated name like in text stats, each part
+         * can use shell wildcards, e.g. 'base_machine.L1_D_*.cpurequest.
+         * count.miss.*'. A label of a counter array selects one element,
+         * e.g. '*.*.*.branchpred.summary.mispred'.
+         * @param refs Matching counters are added here
+         *
+         * @return number of matching counters
+         */
+        int find_stats(const char *pattern, dynarray<StatRef> &refs);
 };
 
 /**
@@ -408,16 +560,21 @@ class StatsBuilder {
  * classes to store their variables. Users are not allowed to directly create
  * an object of Stats, they must used StatsBuilder::get_new_stats() function
  * to get one.
+ *
+ * Counters cache pointers into this memory so its address can't change
+ * when new counters are added. STATS_SIZE bytes of address space are
+ * reserved up front, but host pages are only allocated when touched and
+ * all bulk operations are limited to StatsBuilder::get_used_size().
  */
 class Stats {
     private:
         W8 *mem;
 
-        Stats()
-        {
-            mem = new W8[STATS_SIZE];
-            reset();
-        }
+        /* Pages written by counters since the last snapshot */
+        static W64 dirty_pages[(STATS_PAGES + 63) / 64];
+
+        Stats();
+        ~Stats();
 
     public:
         friend class StatsBuilder;
@@ -427,9 +584,42 @@ class Stats {
             return (W64)mem;
         }
 
+        /**
+         * @brief Record a counter write for the next snapshot
+         *
+         * @param offset Offset of the written bytes in the layout
+         * @param size Number of bytes written
+         *
+         * Counters call this on every write. Pages are tracked for the
+         * layout, not per Stats, so whole database operations (reset, = and
+         * +=) which only derive a Stats from others are not tracked. A
+         * derived Stats must be rebuilt before it is captured.
+         */
+        static inline void mark_dirty(W64 offset, W64 size)
+        {
+            W64 last = (offset + size - 1) / STATS_PAGE_SIZE;
+            for (W64 page = offset / STATS_PAGE_SIZE; page <= last; page++)
+                dirty_pages[page / 64] |= (W64)1 << (page % 64);
+        }
+
+        static inline bool is_dirty(int page)
+        {
+            return (dirty_pages[page / 64] >> (page % 64)) & 1;
+        }
+
+        static void mark_all_dirty()
+        {
+            memset(dirty_pages, 0xff, sizeof(dirty_pages));
+        }
+
+        static void clear_dirty()
+        {
+            memset(dirty_pages, 0, sizeof(dirty_pages));
+        }
+
         void reset()
         {
-            memset(mem, 0, sizeof(W8) * STATS_SIZE);
+            memset(mem, 0, (StatsBuilder::get()).get_used_size());
         }
 
         Stats& operator+=(Stats& rhs_stats)
@@ -440,11 +630,92 @@ class Stats {
 
         Stats& operator=(Stats& rhs_stats)
         {
-            memcpy(mem, rhs_stats.mem, sizeof(W8) * STATS_SIZE);
+            memcpy(mem, rhs_stats.mem, (StatsBuilder::get()).get_used_size());
             return *this;
         }
 };
 
+/**
+ * @brief Read-only copy of a Stats database at a given cycle
+ *
+ * Snapshot memory is kept in STATS_PAGE_SIZE pages. A page no counter
+ * wrote since the previous snapshot is shared with it, a written page is
+ * compared with the previous one and copied only if it changed. So a
+ * series of snapshots only grows by the pages that changed between them,
+ * and comparing two snapshots skips every shared page.
+ */
+class StatsSnapshot {
+    private:
+        struct Page {
+            int refs;
+            W8 data[STATS_PAGE_SIZE];
+        };
+
+        stringbuf name;
+        W64 cycle;
+        dynarray<Page*> pages;
+        int new_pages;
+
+    public:
+        StatsSnapshot(const char *name, W64 cycle, Stats &stats,
+                const StatsSnapshot *prev);
+        ~StatsSnapshot();
+
+        /**
+         * @brief Copy snapshot back into a Stats database
+         *
+         * @param stats Stats to overwrite
+         */
+        void restore(Stats &stats) const;
+
+        /**
+         * @brief Count pages that differ from an other snapshot
+         *
+         * @param other Snapshot to compare with
+         *
+         * @return number of pages that are not shared with @other
+         */
+        int changed_pages(const StatsSnapshot &other) const;
+
+        const char* get_name() const { return name.buf; }
+        W64 get_cycle() const { return cycle; }
+        int page_count() const { return pages.size(); }
+
+        /* Pages this snapshot had to copy, others are shared */
+        int new_page_count() const { return new_pages; }
+};
+
+/**
+ * @brief Stats accumulated over all executions of a named code region
+ *
+ * Region stats are the sum of the differences between Stats at the end
+ * and at the start of each execution of the region.
+ */
+class StatsRegion {
+    private:
+        stringbuf name;
+        Stats *stats;
+        W64 entries;
+        W64 cycles;
+
+    public:
+        StatsRegion(const char *name);
+        ~StatsRegion();
+
+        /**
+         * @brief Add one execution of the region
+         *
+         * @param delta Stats difference of this execution
+         * @param cycles Cycles spent in this execution
+         */
+        void add(Stats &delta, W64 cycles);
+
+        const char* get_name() const { return name.buf; }
+        Stats* get_stats() { return stats; }
+        W64 get_entries() const { return entries; }
+        W64 get_cycles() const { return cycles; }
+};
+
 /**
  * @brief Base class for all Statistics container classes
  */
@@ -470,6 +741,7 @@ class StatObjBase {
         }
 
         virtual void set_default_stats(Stats *stats);
+        Stats* get_default_stats() const { return default_stats; }
 
 
         virtual ostream& dump(ostream& os, Stats *stats,
@@ -478,6 +750,7 @@ class StatObjBase {
                 Stats *stats) const = 0;
         virtual bson_buffer* dump(bson_buffer* out,
                 Stats *stats) const = 0;
+        virtual void dump(StatsWriter &out, Stats *stats) const = 0;
 
         virtual ostream& dump_periodic(ostream &os, Stats *stats) const = 0;
 
@@ -548,6 +821,31 @@ class StatObjBase {
         virtual void add_periodic_stats(Stats& dest_stats, Stats& src_stats) = 0;
         virtual void sub_periodic_stats(Stats& dest_stats, Stats& src_stats) = 0;
 
+        /**
+         * @brief Get value of a counter as integer
+         *
+         * @param stats Stats database to read from
+         * @param index Element of an array, -1 for sum of all elements
+         *
+         * @return value, 0 for objects that are not counters
+         */
+        virtual W64 get_value(Stats *stats, int index=-1) const
+        {
+            return 0;
+        }
+
+        /**
+         * @brief Get array index of an element label
+         *
+         * @param label Label of the element
+         *
+         * @return index, -1 if there is no element with this label
+         */
+        virtual int get_label_index(const char *label) const
+        {
+            return -1;
+        }
+
         void disable_dump() { dump_disabled = true; }
         void enable_dump() { dump_disabled = false; }
         bool is_dump_disabled() const { return dump_disabled; }
@@ -576,6 +874,17 @@ class StatObj : public StatObjBase {
             }
         }
 
+        /* Value in given Stats, reading it doesn't dirty the page */
+        inline T& at(Stats *stats) const
+        {
+            return *(T*)(stats->base() + offset);
+        }
+
+        inline void mark_dirty() const
+        {
+            Stats::mark_dirty(offset, sizeof(T));
+        }
+
     public:
         /**
          * @brief Default constructor for StatObj
@@ -617,6 +926,7 @@ class StatObj : public StatObjBase {
         inline T operator++(int dummy)
         {
             assert(default_var);
+            mark_dirty();
             T ret = (*default_var)++;
             return ret;
         }
@@ -629,6 +939,7 @@ class StatObj : public StatObjBase {
         inline T operator++()
         {
             assert(default_var);
+            mark_dirty();
             (*default_var)++;
             return (*default_var);
         }
@@ -642,6 +953,7 @@ class StatObj : public StatObjBase {
          */
         inline T operator--(int dummy) {
             assert(default_var);
+            mark_dirty();
             T ret = (*default_var)--;
             return ret;
         }
@@ -653,6 +965,7 @@ class StatObj : public StatObjBase {
          */
         inline T operator--() {
             assert(default_var);
+            mark_dirty();
             (*default_var)--;
             return (*default_var);
         }
@@ -665,12 +978,14 @@ class StatObj : public StatObjBase {
          * @return T& with updated value
          */
         inline T& operator -= (T& val) {
+            mark_dirty();
             (*default_var) -= val;
             return (*default_var);
         }
 
         inline T& operator=(T& val) {
             assert(default_var);
+            mark_dirty();
             (*default_var) = val;
             return (*default_var);
         }
@@ -711,6 +1026,7 @@ class StatObj : public StatObjBase {
          */
         inline T operator +=(const T &b) const {
             assert(default_var);
+            mark_dirty();
             *default_var += b;
             return *default_var;;
         }
@@ -725,6 +1041,7 @@ class StatObj : public StatObjBase {
         inline T operator +=(const StatObj<T> &statObj) const {
             assert(default_var);
             assert(statObj.default_var);
+            mark_dirty();
             *default_var += (*statObj.default_var);
             return  *default_var;
         }
@@ -828,7 +1145,13 @@ class StatObj : public StatObjBase {
          */
         inline T& operator()(Stats *stats) const
         {
-            return *(T*)(stats->base() + offset);
+            mark_dirty();
+            return at(stats);
+        }
+
+        W64 get_value(Stats *stats, int index=-1) const
+        {
+            return (W64)at(stats);
         }
 
         /**
@@ -844,7 +1167,7 @@ class StatObj : public StatObjBase {
         {
             if(is_dump_disabled()) return os;
 
-            T var = (*this)(stats);
+            T var = at(stats);
 			stringbuf *full_string = get_full_stat_string();
 
             os << pfx << *full_string << ":" << var << "\n";
@@ -865,7 +1188,7 @@ class StatObj : public StatObjBase {
         {
             if(is_dump_disabled()) return out;
 
-            T var = (*this)(stats);
+            T var = at(stats);
 
             out << YAML::Key << (char *)name;
             out << YAML::Value << var;
@@ -885,22 +1208,36 @@ class StatObj : public StatObjBase {
         {
             if(is_dump_disabled()) return bb;
 
-            T var = (*this)(stats);
+            T var = at(stats);
 
             // FIXME : Currently we dump all values as 'long'
             return bson_append_long(bb, (char *)name, var);
         }
 
+        /**
+         * @brief Stream StatObj to a StatsWriter
+         *
+         * @param out Writer to stream into
+         * @param stats Stats database to read value from
+         */
+        void dump(StatsWriter &out, Stats *stats) const
+        {
+            if(is_dump_disabled()) return;
+
+            T var = at(stats);
+            out.value((char *)name, var);
+        }
+
         void add_stats(Stats& dest_stats, Stats& src_stats)
         {
-            T& dest_var = (*this)(&dest_stats);
-            dest_var += (*this)(&src_stats);
+            T& dest_var = at(&dest_stats);
+            dest_var += at(&src_stats);
         }
 
         void sub_stats(Stats& dest_stats, Stats& src_stats)
         {
-            T& dest_var = (*this)(&dest_stats);
-            dest_var -= (*this)(&src_stats);
+            T& dest_var = at(&dest_stats);
+            dest_var -= at(&src_stats);
         }
 
         void add_periodic_stats(Stats& dest_stats, Stats& src_stats)
@@ -921,7 +1258,7 @@ class StatObj : public StatObjBase {
         {
             if (is_dump_periodic())
             {
-                T& val = (*this)(stats);
+                T& val = at(stats);
                 os << "," << val;
             }
             return os;
@@ -930,7 +1267,7 @@ class StatObj : public StatObjBase {
         ostream &dump_summary(ostream &os, Stats *stats, const char* pfx) const
         {
             if (is_summarize_enabled()) {
-                T& val = (*this)(stats);
+                T& val = at(stats);
                 stringbuf *name = get_full_stat_string();
                 os << pfx << "." << (*name) << " = " << val << endl;
             }
@@ -967,6 +1304,15 @@ class StatArray : public StatObjBase {
 
         typedef T BaseArr[size];
 
+    private:
+        /* Array in given Stats, reading it doesn't dirty the pages */
+        inline BaseArr& at(Stats *stats) const
+        {
+            return *(BaseArr*)(stats->base() + offset);
+        }
+
+    public:
+
         /**
          * @brief Default constructor
          *
@@ -1011,6 +1357,7 @@ class StatArray : public StatObjBase {
             assert(index < size);
             assert(default_var);
 
+            Stats::mark_dirty(offset + sizeof(T) * index, sizeof(T));
             BaseArr& arr = *(BaseArr*)(default_var);
             return arr[index];
         }
@@ -1025,7 +1372,33 @@ class StatArray : public StatObjBase {
          */
         BaseArr& operator()(Stats *stats) const
         {
-            return *(BaseArr*)(stats->base() + offset);
+            Stats::mark_dirty(offset, sizeof(T) * size);
+            return at(stats);
+        }
+
+        W64 get_value(Stats *stats, int index=-1) const
+        {
+            BaseArr& arr = at(stats);
+
+            if (index >= 0)
+                return (W64)arr[index];
+
+            W64 sum = 0;
+            foreach(i, size) {
+                sum += (W64)arr[i];
+            }
+            return sum;
+        }
+
+        int get_label_index(const char *label) const
+        {
+            if (!labels) return -1;
+
+            foreach(i, size) {
+                if (strequal(labels[i], label))
+                    return i;
+            }
+            return -1;
         }
 
         /**
@@ -1044,14 +1417,14 @@ class StatArray : public StatObjBase {
 			stringbuf *full_string = get_full_stat_string();
 
 			if (labels) {
-				BaseArr& arr = (*this)(stats);
+				BaseArr& arr = at(stats);
 				foreach(i, size) {
 					os << pfx << *full_string << "." << labels[i] <<
 						":" << arr[i] << "\n";
 				}
 			} else {
 				os << pfx << *full_string << ":";
-				BaseArr& arr = (*this)(stats);
+				BaseArr& arr = at(stats);
 				foreach(i, size) {
 					os << arr[i] << " ";
 				}
@@ -1081,7 +1454,7 @@ class StatArray : public StatObjBase {
             if(labels) {
                 out << YAML::BeginMap;
 
-                BaseArr& arr = (*this)(stats);
+                BaseArr& arr = at(stats);
                 foreach(i, size) {
                     out << YAML::Key << labels[i];
                     out << YAML::Value << arr[i];
@@ -1092,7 +1465,7 @@ class StatArray : public StatObjBase {
                 out << YAML::Flow;
                 out << YAML::BeginSeq;
 
-                BaseArr& arr = (*this)(stats);
+                BaseArr& arr = at(stats);
                 foreach(i, size) {
                     out << arr[i];
                 }
@@ -1119,7 +1492,7 @@ class StatArray : public StatObjBase {
             char numstr[16];
             bson_buffer *arr;
 
-            BaseArr& val = (*this)(stats);
+            BaseArr& val = at(stats);
             if(labels) {
                 arr = bson_append_start_object(bb, (char *)name);
 
@@ -1138,10 +1511,37 @@ class StatArray : public StatObjBase {
             return bson_append_finish_object(arr);
         }
 
+        /**
+         * @brief Stream StatArray to a StatsWriter
+         *
+         * @param out Writer to stream into
+         * @param stats Stats database to read array from
+         */
+        void dump(StatsWriter &out, Stats *stats) const
+        {
+            if(is_dump_disabled()) return;
+
+            BaseArr& arr = at(stats);
+
+            if(labels) {
+                out.begin_map((char *)name);
+                foreach(i, size) {
+                    out.value(labels[i], arr[i]);
+                }
+                out.end_map();
+            } else {
+                out.begin_seq((char *)name);
+                foreach(i, size) {
+                    out.value(NULL, arr[i]);
+                }
+                out.end_seq();
+            }
+        }
+
         void add_stats(Stats& dest_stats, Stats& src_stats)
         {
-            BaseArr& dest_arr = (*this)(&dest_stats);
-            BaseArr& src_arr = (*this)(&src_stats);
+            BaseArr& dest_arr = at(&dest_stats);
+            BaseArr& src_arr = at(&src_stats);
             foreach(i, size) {
                 dest_arr[i] += src_arr[i];
             }
@@ -1149,8 +1549,8 @@ class StatArray : public StatObjBase {
 
         void sub_stats(Stats& dest_stats, Stats& src_stats)
         {
-            BaseArr& dest_arr = (*this)(&dest_stats);
-            BaseArr& src_arr = (*this)(&src_stats);
+            BaseArr& dest_arr = at(&dest_stats);
+            BaseArr& src_arr = at(&src_stats);
             foreach(i, size) {
                 dest_arr[i] -= src_arr[i];
             }
@@ -1212,7 +1612,7 @@ class StatArray : public StatObjBase {
         {
             if (!is_dump_periodic()) return os;
 
-            BaseArr& arr = (*this)(stats);
+            BaseArr& arr = at(stats);
 
             foreach(i, size) {
                 if(periodic_flag[i]) {
@@ -1238,7 +1638,7 @@ class StatArray : public StatObjBase {
         {
             if (!is_summarize_enabled()) return os;
 
-            BaseArr& arr = (*this)(stats);
+            BaseArr& arr = at(stats);
             stringbuf* name = get_full_stat_string();
 
             foreach (i, size) {
@@ -1295,6 +1695,11 @@ class StatString : public StatObjBase {
             }
         }
 
+        inline char* at(Stats *stats) const
+        {
+            return (char*)(stats->base() + offset);
+        }
+
     public:
 
         static const uint16_t MAX_STAT_STR_SIZE = 256;
@@ -1355,6 +1760,7 @@ class StatString : public StatObjBase {
 
             assert(default_var);
 
+            Stats::mark_dirty(offset, MAX_STAT_STR_SIZE);
             strcpy(default_var, str);
 
             return default_var;
@@ -1386,9 +1792,10 @@ class StatString : public StatObjBase {
                 assert(0);
             }
 
-            char* var = (*this)(stats);
+            char* var = at(stats);
             assert(var);
 
+            Stats::mark_dirty(offset, MAX_STAT_STR_SIZE);
             strcpy(var, str);
         }
 
@@ -1410,7 +1817,8 @@ class StatString : public StatObjBase {
          */
         inline char* operator()(Stats *stats) const
         {
-            return (char*)(stats->base() + offset);
+            Stats::mark_dirty(offset, MAX_STAT_STR_SIZE);
+            return at(stats);
         }
 
         /**
@@ -1424,7 +1832,7 @@ class StatString : public StatObjBase {
         {
             if(is_dump_disabled()) return os;
 
-            char* var = (*this)(stats);
+            char* var = at(stats);
 			stringbuf *full_string = get_full_stat_string();
 
             if(split[0] != '\0') {
@@ -1456,7 +1864,7 @@ class StatString : public StatObjBase {
         {
             if(is_dump_disabled()) return out;
 
-            char* var = (*this)(stats);
+            char* var = at(stats);
 
             if(split[0] != '\0') {
                 dynarray<stringbuf*> tags;
@@ -1495,7 +1903,7 @@ class StatString : public StatObjBase {
         {
             if(is_dump_disabled()) return bb;
 
-            char* var = (*this)(stats);
+            char* var = at(stats);
 
             if(split[0] != '\0') {
                 dynarray<stringbuf*> tags;
@@ -1516,6 +1924,34 @@ class StatString : public StatObjBase {
             return bson_append_string(bb, (char *)name, var);
         }
 
+        /**
+         * @brief Stream StatString to a StatsWriter
+         *
+         * @param out Writer to stream into
+         * @param stats Stats database to read string from
+         */
+        void dump(StatsWriter &out, Stats *stats) const
+        {
+            if(is_dump_disabled()) return;
+
+            char* var = at(stats);
+
+            if(split[0] != '\0') {
+                dynarray<stringbuf*> tags;
+                stringbuf st_tags; st_tags << var;
+                st_tags.split(tags, split);
+
+                out.begin_seq((char *)name);
+                foreach(i, tags.size()) {
+                    out.value(NULL, tags[i]->buf);
+                    delete tags[i];
+                }
+                out.end_seq();
+            } else {
+                out.value((char *)name, var);
+            }
+        }
+
         void add_stats(Stats& dest_stats, Stats& src_stats)
         {
             /* NOTE: We don't do auto addition os stats string */
@@ -1689,6 +2125,18 @@ class StatEquation : public StatObj<K> {
             return base_t::dump(out, stats);
         }
 
+        /**
+         * @brief Stream value of this Stats Object
+         *
+         * @param out Writer to stream into
+         * @param stats Stats Database that holds the value
+         */
+        void dump(StatsWriter &out, Stats *stats) const
+        {
+            compute(stats);
+            base_t::dump(out, stats);
+        }
+
         /**
          * @brief Dump Periodic value of this Stats Object
          *
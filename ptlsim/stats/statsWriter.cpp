@@ -0,0 +1,545 @@
+/*
+ * MARSSx86 : A Full System Computer-Architecture Simulator
+ *
+ * This code is released under GPL.
+ *
+ * Copyright 2011 Avadh Patel <apatel@cs.binghamton.edu>
+ *
+ */
+
+#include "statsWriter.h"
+
+#include <bson/bson.h>
+#include <math.h>
+
+StatsWriter::StatsWriter(ostream &os)
+    : os_(os)
+      , used_(0)
+{
+}
+
+StatsWriter::~StatsWriter()
+{
+    flush();
+}
+
+void StatsWriter::write(const void *data, int size)
+{
+    const char *ptr = (const char*)data;
+
+    while (size > 0) {
+        if (used_ == STATS_WRITER_BUF_SIZE)
+            flush();
+
+        int len = min(size, STATS_WRITER_BUF_SIZE - used_);
+        memcpy(buf_ + used_, ptr, len);
+
+        used_ += len;
+        ptr   += len;
+        size  -= len;
+    }
+}
+
+void StatsWriter::flush()
+{
+    if (used_) {
+        os_.write(buf_, used_);
+        used_ = 0;
+    }
+
+    os_.flush();
+}
+
+/* Enough digits to read back the same double */
+static void format_double(char *buf, int size, double val)
+{
+    snprintf(buf, size, "%.17g", val);
+}
+
+/*
+ * YAML writer
+ *
+ * Maps are printed in block style with two spaces of indentation and
+ * sequences in flow style, like the yaml-cpp emitter did. A map key is
+ * only printed once the map gets its first element so empty maps can
+ * be printed as '{}'.
+ */
+class YAMLStatsWriter : public StatsWriter
+{
+    private:
+        struct Frame {
+            const char *key;
+            bool seq;
+            bool opened;
+            int  count;
+        };
+
+        Frame stack_[STATS_WRITER_MAX_DEPTH];
+        int depth_;
+
+        void indent(int level)
+        {
+            foreach (i, level) {
+                write("  ");
+            }
+        }
+
+        static bool is_plain(const char *str)
+        {
+            if (!str[0]) return false;
+
+            for (const char *c = str; *c; c++) {
+                if (!isalnum(*c) && !strchr("_-./", *c))
+                    return false;
+            }
+
+            return true;
+        }
+
+        void scalar(const char *str)
+        {
+            if (is_plain(str)) {
+                write(str);
+                return;
+            }
+
+            write('"');
+            for (const char *c = str; *c; c++) {
+                if (*c == '"' || *c == '\\') {
+                    write('\\');
+                    write(*c);
+                } else if ((unsigned char)*c < 0x20) {
+                    char esc[8];
+                    snprintf(esc, sizeof(esc), "\\x%02x", (unsigned char)*c);
+                    write(esc);
+                } else {
+                    write(*c);
+                }
+            }
+            write('"');
+        }
+
+        /* Print keys of all enclosing maps that are not printed yet */
+        void open(int level)
+        {
+            Frame &frame = stack_[level];
+            if (frame.opened) return;
+
+            if (level > 0)
+                open(level - 1);
+
+            if (frame.key) {
+                indent(level - 1);
+                scalar(frame.key);
+                write(":\n");
+            }
+
+            frame.opened = true;
+        }
+
+        /* Start an element of the innermost container */
+        void element(const char *key)
+        {
+            Frame &frame = stack_[depth_ - 1];
+
+            if (frame.seq) {
+                if (frame.count) write(", ");
+            } else {
+                open(depth_ - 1);
+                indent(depth_ - 1);
+                scalar(key);
+                write(": ");
+            }
+
+            frame.count++;
+        }
+
+        void end_element()
+        {
+            if (!stack_[depth_ - 1].seq)
+                write('\n');
+        }
+
+        void push(const char *key, bool seq)
+        {
+            assert(depth_ < STATS_WRITER_MAX_DEPTH);
+
+            Frame &frame = stack_[depth_++];
+            frame.key    = key;
+            frame.seq    = seq;
+            frame.opened = false;
+            frame.count  = 0;
+        }
+
+    public:
+        YAMLStatsWriter(ostream &os)
+            : StatsWriter(os)
+              , depth_(0)
+        {}
+
+        void begin_document()
+        {
+            write("---\n");
+        }
+
+        void end_document()
+        {
+            assert(depth_ == 0);
+        }
+
+        void begin_map(const char *key)
+        {
+            push(key, false);
+        }
+
+        void end_map()
+        {
+            Frame &frame = stack_[--depth_];
+
+            /* Map is opened by its first element, even a nested one */
+            if (frame.opened) return;
+
+            /* Empty map */
+            if (depth_ > 0) {
+                open(depth_ - 1);
+                indent(depth_ - 1);
+            }
+            if (frame.key) {
+                scalar(frame.key);
+                write(": ");
+            }
+            write("{}\n");
+        }
+
+        void begin_seq(const char *key)
+        {
+            element(key);
+            write('[');
+            push(key, true);
+        }
+
+        void end_seq()
+        {
+            depth_--;
+            write(']');
+            end_element();
+        }
+
+        void value(const char *key, W64 val)
+        {
+            char str[32];
+            snprintf(str, sizeof(str), "%llu", (unsigned long long)val);
+
+            element(key);
+            write(str);
+            end_element();
+        }
+
+        void value(const char *key, double val)
+        {
+            char str[32];
+            format_double(str, sizeof(str), val);
+
+            element(key);
+            write(str);
+            end_element();
+        }
+
+        void value(const char *key, const char *val)
+        {
+            element(key);
+            scalar(val);
+            end_element();
+        }
+};
+
+/*
+ * JSON Lines writer
+ *
+ * Each document is one compact JSON object on its own line.
+ */
+class JSONStatsWriter : public StatsWriter
+{
+    private:
+        int count_[STATS_WRITER_MAX_DEPTH];
+        int depth_;
+
+        void quoted(const char *str)
+        {
+            write('"');
+            for (const char *c = str; *c; c++) {
+                if (*c == '"' || *c == '\\') {
+                    write('\\');
+                    write(*c);
+                } else if ((unsigned char)*c < 0x20) {
+                    char esc[8];
+                    snprintf(esc, sizeof(esc), "\\u%04x", (unsigned char)*c);
+                    write(esc);
+                } else {
+                    write(*c);
+                }
+            }
+            write('"');
+        }
+
+        void element(const char *key)
+        {
+            if (depth_ > 0) {
+                if (count_[depth_ - 1]++)
+                    write(',');
+            }
+
+            if (key) {
+                quoted(key);
+                write(':');
+            }
+        }
+
+        void push()
+        {
+            assert(depth_ < STATS_WRITER_MAX_DEPTH);
+            count_[depth_++] = 0;
+        }
+
+    public:
+        JSONStatsWriter(ostream &os)
+            : StatsWriter(os)
+              , depth_(0)
+        {}
+
+        void begin_document() {}
+
+        void end_document()
+        {
+            assert(depth_ == 0);
+            write('\n');
+        }
+
+        void begin_map(const char *key)
+        {
+            element(key);
+            write('{');
+            push();
+        }
+
+        void end_map()
+        {
+            depth_--;
+            write('}');
+        }
+
+        void begin_seq(const char *key)
+        {
+            element(key);
+            write('[');
+            push();
+        }
+
+        void end_seq()
+        {
+            depth_--;
+            write(']');
+        }
+
+        void value(const char *key, W64 val)
+        {
+            char str[32];
+            snprintf(str, sizeof(str), "%llu", (unsigned long long)val);
+
+            element(key);
+            write(str);
+        }
+
+        void value(const char *key, double val)
+        {
+            char str[32];
+
+            /* JSON has no NaN or infinity */
+            if (isnan(val) || isinf(val))
+                strcpy(str, "null");
+            else
+                format_double(str, sizeof(str), val);
+
+            element(key);
+            write(str);
+        }
+
+        void value(const char *key, const char *val)
+        {
+            element(key);
+            quoted(val);
+        }
+};
+
+/*
+ * BSON writer
+ *
+ * Each document is built in memory, where the length of each nested
+ * object and array is filled in when it ends. The document is written to
+ * the stream once its root map ends, so the stream never has to seek.
+ */
+class BSONStatsWriter : public StatsWriter
+{
+    private:
+        struct Frame {
+            int start;
+            bool seq;
+            int count;
+        };
+
+        Frame stack_[STATS_WRITER_MAX_DEPTH];
+        int depth_;
+
+        /* Document being built, kept between documents */
+        char *doc_;
+        int docSize_;
+        int docCapacity_;
+
+        void put(const void *data, int size)
+        {
+            if (docSize_ + size > docCapacity_) {
+                int capacity = max(docCapacity_ * 2, docSize_ + size);
+                char *doc = new char[capacity];
+                memcpy(doc, doc_, docSize_);
+                delete [] doc_;
+                doc_ = doc;
+                docCapacity_ = capacity;
+            }
+
+            memcpy(doc_ + docSize_, data, size);
+            docSize_ += size;
+        }
+
+        void put(char c) { put(&c, 1); }
+
+        void element(char type, const char *key)
+        {
+            put(type);
+
+            if (depth_ > 0 && stack_[depth_ - 1].seq) {
+                char numstr[16];
+                bson_numstr(numstr, stack_[depth_ - 1].count);
+                put(numstr, strlen(numstr) + 1);
+            } else {
+                put(key, strlen(key) + 1);
+            }
+
+            if (depth_ > 0)
+                stack_[depth_ - 1].count++;
+        }
+
+        void push(bool seq)
+        {
+            assert(depth_ < STATS_WRITER_MAX_DEPTH);
+
+            Frame &frame = stack_[depth_++];
+            frame.start  = docSize_;
+            frame.seq    = seq;
+            frame.count  = 0;
+
+            /* Length is known when the frame ends */
+            W32 size = 0;
+            put(&size, sizeof(size));
+        }
+
+        void pop()
+        {
+            Frame &frame = stack_[--depth_];
+
+            put((char)bson_eoo);
+
+            W32 size = docSize_ - frame.start;
+            memcpy(doc_ + frame.start, &size, sizeof(size));
+
+            if (depth_ == 0) {
+                write(doc_, docSize_);
+                docSize_ = 0;
+            }
+        }
+
+    public:
+        BSONStatsWriter(ostream &os)
+            : StatsWriter(os)
+              , depth_(0)
+              , doc_(NULL)
+              , docSize_(0)
+              , docCapacity_(0)
+        {}
+
+        ~BSONStatsWriter()
+        {
+            delete [] doc_;
+        }
+
+        void begin_document() {}
+
+        void end_document()
+        {
+            assert(depth_ == 0);
+        }
+
+        void begin_map(const char *key)
+        {
+            /* Root map is the document itself */
+            if (depth_ > 0)
+                element(bson_object, key);
+            push(false);
+        }
+
+        void end_map()
+        {
+            pop();
+        }
+
+        void begin_seq(const char *key)
+        {
+            element(bson_array, key);
+            push(true);
+        }
+
+        void end_seq()
+        {
+            pop();
+        }
+
+        void value(const char *key, W64 val)
+        {
+            element(bson_long, key);
+            put(&val, sizeof(val));
+        }
+
+        void value(const char *key, double val)
+        {
+            element(bson_double, key);
+            put(&val, sizeof(val));
+        }
+
+        void value(const char *key, const char *val)
+        {
+            W32 size = strlen(val) + 1;
+
+            element(bson_string, key);
+            put(&size, sizeof(size));
+            put(val, size);
+        }
+};
+
+/**
+ * @brief Create a Stats writer for given format
+ *
+ * @param format Name of output format
+ * @param os Stream to write into
+ *
+ * @return NULL if format is not supported
+ */
+StatsWriter* StatsWriter::create(const char *format, ostream &os)
+{
+    if (!strcmp(format, "yaml"))
+        return new YAMLStatsWriter(os);
+    if (!strcmp(format, "json"))
+        return new JSONStatsWriter(os);
+    if (!strcmp(format, "bson"))
+        return new BSONStatsWriter(os);
+
+    return NULL;
+}
@@ -0,0 +1,70 @@
+/*
+ * MARSSx86 : A Full System Computer-Architecture Simulator
+ *
+ * This code is released under GPL.
+ *
+ * Copyright 2011 Avadh Patel <apatel@cs.binghamton.edu>
+ *
+ */
+
+#ifndef STATS_WRITER_H
+#define STATS_WRITER_H
+
+#include <globals.h>
+#include <superstl.h>
+
+#define STATS_WRITER_BUF_SIZE (64 * 1024)
+
+/* Deepest nesting of maps and sequences a writer can track */
+#define STATS_WRITER_MAX_DEPTH 64
+
+/**
+ * @brief Streaming writer for Stats documents
+ *
+ * Stats tree is dumped by walking it and calling this interface. Output is
+ * formatted on the fly into a fixed buffer which is written to the stream
+ * whenever it fills up, so no document tree is kept in memory. Keys are
+ * NULL for elements of a sequence and for the root map of a document.
+ *
+ * Writers are created by name with StatsWriter::create():
+ *
+ *   yaml - one YAML document per Stats, same layout as yaml-cpp output
+ *   json - JSON Lines, one compact JSON object per Stats
+ *   bson - BSON documents, one per Stats, as stored in MongoDB
+ */
+class StatsWriter
+{
+    private:
+        ostream &os_;
+        char buf_[STATS_WRITER_BUF_SIZE];
+        int used_;
+
+    protected:
+        void write(const void *data, int size);
+        void write(const char *str) { write(str, strlen(str)); }
+        void write(char c) { write(&c, 1); }
+
+    public:
+        StatsWriter(ostream &os);
+        virtual ~StatsWriter();
+
+        virtual void begin_document() = 0;
+        virtual void end_document() = 0;
+
+        virtual void begin_map(const char *key) = 0;
+        virtual void end_map() = 0;
+
+        /* Sequences only hold values */
+        virtual void begin_seq(const char *key) = 0;
+        virtual void end_seq() = 0;
+
+        virtual void value(const char *key, W64 val) = 0;
+        virtual void value(const char *key, double val) = 0;
+        virtual void value(const char *key, const char *val) = 0;
+
+        void flush();
+
+        static StatsWriter* create(const char *format, ostream &os);
+};
+
+#endif // STATS_WRITER_H
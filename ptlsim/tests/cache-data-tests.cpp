@@ -0,0 +1,334 @@
+#include <gtest/gtest.h>
+
+#define DISABLE_ASSERT
+#include <ptlsim.h>
+#include <ptl-qemu.h>
+#include <memoryHierarchy.h>
+#include <dynamicCacheLines.h>
+#include <lineData.h>
+#include <uarch-checkpoint.h>
+
+using namespace Memory;
+
+namespace {
+
+    const int LINE = 64;
+    const char *CHECKPOINT_FILE = "/tmp/marss-cache-data-test.chk";
+
+    /* Guest page backed by a host buffer for line data tests */
+    const W64 RAM_BASE = 0xfff00000000ULL;
+    W8 guest_ram[PAGE_SIZE];
+
+    TEST(CacheData, ArenaLimit)
+    {
+        Statable parent("cache_data_test");
+        LineDataPool pool(&parent, LINE, 2 * LineDataPool::CHUNK_SIZE);
+
+        /* First line of each chunk holds the chunk link */
+        int perChunk = LineDataPool::CHUNK_SIZE / LINE - 1;
+        W8 *last = NULL;
+
+        foreach (i, 2 * perChunk) {
+            last = pool.alloc();
+            ASSERT_TRUE(last != NULL);
+        }
+
+        ASSERT_TRUE(pool.alloc() == NULL);
+        ASSERT_EQ(pool.get_alloc_bytes(), pool.get_limit());
+        ASSERT_EQ(pool.get_in_use(), (W64)(2 * perChunk));
+
+        /* Freed buffers are reused without growing the arena */
+        pool.free(last);
+        ASSERT_TRUE(pool.alloc() == last);
+        ASSERT_EQ(pool.get_alloc_bytes(), pool.get_limit());
+    }
+
+    TEST(CacheData, MessageFill)
+    {
+        Statable parent("cache_data_test");
+        LineDataPool pool(&parent, LINE, LineDataPool::CHUNK_SIZE);
+        LineDataBuffer held;
+        CacheLine line;
+        W8 data[LINE];
+
+        foreach (i, LINE) {
+            data[i] = i;
+        }
+
+        /* Queue entry keeps a copy of the message data */
+        pool.hold(held, data, false);
+        ASSERT_TRUE(held.get() != NULL);
+        ASSERT_TRUE(held.get() != data);
+        data[0] = 0xff;
+
+        line.init(0x1000);
+        ASSERT_TRUE(line.get_data() == NULL);
+        pool.fill(&line, held.get(), false);
+        ASSERT_TRUE(line.get_data() != NULL);
+        ASSERT_EQ(line.data[0], 0);
+        ASSERT_EQ(memcmp(line.data + 1, data + 1, LINE - 1), 0);
+
+        /* Response without data, like an upgrade, keeps line data */
+        pool.fill(&line, NULL, false);
+        ASSERT_TRUE(line.get_data() != NULL);
+
+        /* Writeback without data leaves the line without data */
+        pool.update(&line, NULL, false);
+        ASSERT_TRUE(line.get_data() == NULL);
+
+        /* Reused entry holds no data until the next message, same buffer */
+        const W8 *buf = held.get();
+        held.reset();
+        ASSERT_TRUE(held.get() == NULL);
+        pool.hold(held, NULL, false);
+        ASSERT_TRUE(held.get() == NULL);
+        pool.hold(held, data, false);
+        ASSERT_TRUE(held.get() == buf);
+        ASSERT_EQ(pool.get_in_use(), 2);
+    }
+
+    TEST(CacheData, NoStaleData)
+    {
+        Statable parent("cache_data_test");
+        LineDataPool pool(&parent, LINE, LineDataPool::CHUNK_SIZE);
+        CacheLine line;
+        W8 data[LINE] = {0};
+
+        line.init(0x1000);
+        pool.fill(&line, data, false);
+        W8 *buf = line.data;
+
+        /* Line of a new tag has no data, buffer is kept for its fill */
+        line.init(0x2000);
+        ASSERT_TRUE(line.get_data() == NULL);
+        ASSERT_TRUE(line.data == buf);
+
+        pool.fill(&line, data, false);
+        line.reset();
+        ASSERT_TRUE(line.get_data() == NULL);
+
+        pool.fill(&line, data, false);
+        line.invalidate();
+        ASSERT_TRUE(line.get_data() == NULL);
+        ASSERT_EQ(pool.get_in_use(), 1);
+    }
+
+    TEST(CacheData, BuffersReturned)
+    {
+        Statable parent("cache_data_test");
+        LineDataPool pool(&parent, LINE, LineDataPool::CHUNK_SIZE);
+        DynamicCacheLines lines(64, 4, LINE, 2, REPL_LRU, 2, 2);
+        MemoryRequest request;
+        W8 data[LINE] = {0};
+
+        lines.set_line_data(&pool);
+        lines.init();
+
+        foreach (i, 16) {
+            W64 tag = -1;
+            request.init(0, 0, i * LINE, 0, 0, false, 0, 0,
+                    MEMORY_OP_READ);
+            CacheLine *line = lines.insert(&request, tag);
+            line->init(lines.tagOf(i * LINE));
+            pool.fill(line, data, false);
+        }
+        ASSERT_EQ(pool.get_in_use(), 16);
+
+        /* Checkpoint restore drops line data but keeps the buffers */
+        UarchStateWriter writer;
+        ASSERT_TRUE(writer.open(CHECKPOINT_FILE, "test:1:0"));
+        writer.begin_section("cache");
+        lines.save_state(writer);
+        writer.end_section();
+        writer.close();
+
+        UarchStateReader reader;
+        ASSERT_TRUE(reader.open(CHECKPOINT_FILE, "test:1:0"));
+        ASSERT_TRUE(reader.find_section("cache"));
+        ASSERT_TRUE(lines.restore_state(reader));
+        unlink(CHECKPOINT_FILE);
+        ASSERT_TRUE(lines.peek(0) != NULL);
+        ASSERT_TRUE(lines.peek(0)->get_data() == NULL);
+        ASSERT_EQ(pool.get_in_use(), 16);
+
+        lines.init();
+        ASSERT_EQ(pool.get_in_use(), 16);
+
+        /* New geometry frees the lines and their buffers */
+        ASSERT_TRUE(lines.set_geometry(32, 4, 2));
+        ASSERT_EQ(pool.get_in_use(), 0);
+    }
+
+    TEST(CacheData, PeekHasNoSideEffect)
+    {
+        DynamicCacheLines lines(64, 4, LINE, 2, REPL_LRU, 2, 2);
+        MemoryRequest request;
+
+        lines.init();
+
+        /* Fill one set, the first line is the LRU victim */
+        foreach (i, 4) {
+            W64 tag = -1;
+            request.init(0, 0, i * 64 * LINE, 0, 0, false, 0, 0,
+                    MEMORY_OP_READ);
+            lines.insert(&request, tag);
+        }
+
+        ASSERT_TRUE(lines.peek(0) != NULL);
+        ASSERT_TRUE(lines.peek(0)->get_data() == NULL);
+        ASSERT_TRUE(lines.peek(4 * 64 * LINE) == NULL);
+
+        W64 tag = -1;
+        request.init(0, 0, 4 * 64 * LINE, 0, 0, false, 0, 0,
+                MEMORY_OP_READ);
+        lines.insert(&request, tag);
+        ASSERT_EQ(tag, 0);
+    }
+
+    /*
+     * Private L1 and L2 of one core with memory in 'guest_ram'. Data
+     * moves only through messages, as the cache controllers move it.
+     */
+    struct DataHarness {
+        Statable parent;
+        LineDataPool pool;
+        DynamicCacheLines l1;
+        DynamicCacheLines l2;
+        MemoryRequest request;
+
+        DataHarness()
+            : parent("cache_data_test")
+              , pool(&parent, LINE, LineDataPool::CHUNK_SIZE)
+              , l1(8, 2, LINE, 2, REPL_LRU, 2, 2)
+              , l2(64, 4, LINE, 5, REPL_LRU, 2, 2)
+        {
+            l1.set_line_data(&pool);
+            l2.set_line_data(&pool);
+            l1.init();
+            l2.init();
+
+            foreach (i, PAGE_SIZE) {
+                guest_ram[i] = i * 7;
+            }
+            ptl_add_phys_memory_mapping(0, (W64)guest_ram, RAM_BASE);
+        }
+
+        CacheLine *insert(DynamicCacheLines& lines, W64 address)
+        {
+            W64 tag = -1;
+            request.init(0, 0, address, 0, 0, false, 0, 0,
+                    MEMORY_OP_READ);
+            CacheLine *line = lines.insert(&request, tag);
+            line->init(lines.tagOf(address));
+            line->state = 1;
+            return line;
+        }
+
+        /* Deliver a message with the line data of the sender */
+        void deliver(CacheLine *line, const W8 *src, bool writeback)
+        {
+            Message message;
+            message.init();
+            message.hasData = true;
+            message.data = src;
+
+            if (writeback)
+                pool.update(line, message.data, false);
+            else
+                pool.fill(line, message.data, false);
+        }
+
+        /* L1 read miss, L2 misses too if it does not have the line */
+        CacheLine *read(W64 address)
+        {
+            CacheLine *l2line = l2.peek(address);
+            if (!l2line) {
+                l2line = insert(l2, address);
+                deliver(l2line, pool.read_memory(address, false), false);
+            }
+
+            CacheLine *l1line = insert(l1, address);
+            deliver(l1line, l2line->get_data(), false);
+            return l1line;
+        }
+
+        /* Committed store writes guest RAM, then the L1 line */
+        void store(CacheLine *line, W64 address, W64 value)
+        {
+            *(W64*)&guest_ram[address - RAM_BASE] = value;
+
+            request.init(0, 0, address, 0, 0, false, 0, 0,
+                    MEMORY_OP_WRITE);
+            request.set_store_data(value, 0xff);
+            pool.write(line, &request);
+        }
+
+        /* Evict the L1 line, writing back its data unless 'drop' */
+        void evict(W64 address, bool drop)
+        {
+            CacheLine *l1line = l1.peek(address);
+
+            if (!drop)
+                deliver(l2.peek(address), l1line->get_data(), true);
+
+            request.init(0, 0, address, 0, 0, false, 0, 0,
+                    MEMORY_OP_EVICT);
+            l1.invalidate(&request);
+        }
+
+        bool check(CacheLine *line, W64 address)
+        {
+            return pool.check(line, address, 8, false);
+        }
+
+        W64 mismatches()
+        {
+            return pool.stats.mismatches(user_stats);
+        }
+    };
+
+    TEST(CacheData, DataFollowsProtocol)
+    {
+        DataHarness h;
+        W64 address = RAM_BASE + 3 * LINE + 8;
+        W64 before = h.mismatches();
+
+        CacheLine *line = h.read(address);
+        ASSERT_TRUE(line->get_data() != NULL);
+        ASSERT_TRUE(h.check(line, address));
+
+        /* Store reaches L1 only, its writeback reaches L2 */
+        h.store(line, address, 0x0123456789abcdefULL);
+        ASSERT_TRUE(h.check(line, address));
+
+        h.evict(address, false);
+        ASSERT_TRUE(h.l1.peek(address) == NULL);
+
+        line = h.read(address);
+        ASSERT_TRUE(h.check(line, address));
+        ASSERT_TRUE(h.check(line, address + 8));
+        ASSERT_EQ(h.mismatches(), before);
+    }
+
+    TEST(CacheData, ProtocolBugCaught)
+    {
+        DataHarness h;
+        W64 address = RAM_BASE + 5 * LINE;
+        W64 before = h.mismatches();
+
+        CacheLine *line = h.read(address);
+        h.store(line, address, 0xfeedfacecafebeefULL);
+
+        /* Injected bug: dirty L1 line is dropped without a writeback,
+         * the refill brings the stale L2 data back */
+        h.evict(address, true);
+        line = h.read(address);
+
+        ASSERT_TRUE(line->get_data() != NULL);
+        ASSERT_FALSE(h.check(line, address));
+        ASSERT_EQ(h.mismatches(), before + 1);
+
+        /* Bytes the store did not touch still match */
+        ASSERT_TRUE(h.check(line, address + 8));
+    }
+};
@@ -0,0 +1,99 @@
+#include <gtest/gtest.h>
+
+#define DISABLE_ASSERT
+#include <ptlsim.h>
+#include <memoryHierarchy.h>
+#include <dynamicCacheLines.h>
+
+using namespace Memory;
+
+namespace {
+
+    const int SETS = 64;
+    const int WAYS = 4;
+    const int LINE = 64;
+
+    /*
+     * Run the same access stream on both caches, a miss inserts the
+     * line. Both must hit, miss and evict the same lines.
+     */
+    template <int POLICY>
+    void compare_with_static()
+    {
+        CacheLines<SETS, WAYS, LINE, 2, POLICY> fixed(2, 2);
+        DynamicCacheLines dynamic(SETS, WAYS, LINE, 2, POLICY, 2, 2);
+        MemoryRequest request;
+
+        fixed.init();
+        dynamic.init();
+
+        W64 seed = 1;
+        foreach (i, 20000) {
+            seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+
+            /* Mostly reuse a small working set, sometimes stream */
+            W64 line = (seed >> 33) % ((i % 8) ? SETS * WAYS * 2 : 1 << 20);
+            request.init(0, 0, line * LINE, 0, 0, false, 0, 0,
+                    MEMORY_OP_READ);
+
+            bool hit = fixed.probe(&request) != NULL;
+            ASSERT_EQ(hit, dynamic.probe(&request) != NULL);
+
+            if (!hit) {
+                W64 fixedTag = -1, dynamicTag = -1;
+                fixed.insert(&request, fixedTag);
+                dynamic.insert(&request, dynamicTag);
+                ASSERT_EQ(fixedTag, dynamicTag);
+            }
+        }
+    }
+
+    TEST(CacheGeometry, SameAsStaticNRU)
+    {
+        compare_with_static<REPL_NRU>();
+    }
+
+    TEST(CacheGeometry, SameAsStaticLRU)
+    {
+        compare_with_static<REPL_LRU>();
+    }
+
+    TEST(CacheGeometry, SameAsStaticSRRIP)
+    {
+        compare_with_static<REPL_SRRIP>();
+    }
+
+    TEST(CacheGeometry, Resize)
+    {
+        DynamicCacheLines lines(SETS, WAYS, LINE, 2, REPL_LRU, 2, 2);
+
+        ASSERT_FALSE(lines.set_geometry(48, 4, 2));
+        ASSERT_FALSE(lines.set_geometry(64, 65, 2));
+        ASSERT_EQ(lines.get_set_count(), SETS);
+
+        ASSERT_TRUE(lines.set_geometry(256, 16, 12));
+        ASSERT_EQ(lines.get_size(), 256 * 16 * LINE);
+        ASSERT_EQ(lines.get_access_latency(), 12);
+        ASSERT_EQ(lines.get_line_bits(), 6);
+
+        /* 16 lines mapping to one set all fit */
+        MemoryRequest request;
+        W64 oldTag;
+        foreach (i, 16) {
+            request.init(0, 0, i * 256 * LINE, 0, 0, false, 0, 0,
+                    MEMORY_OP_READ);
+            lines.insert(&request, oldTag);
+        }
+        foreach (i, 16) {
+            request.init(0, 0, i * 256 * LINE, 0, 0, false, 0, 0,
+                    MEMORY_OP_READ);
+            ASSERT_TRUE(lines.probe(&request) != NULL);
+        }
+    }
+
+    TEST(CacheGeometry, StaticCantResize)
+    {
+        CacheLines<SETS, WAYS, LINE, 2> lines(2, 2);
+        ASSERT_FALSE(lines.set_geometry(128, 4, 2));
+    }
+};
@@ -0,0 +1,117 @@
+#include <gtest/gtest.h>
+
+#define DISABLE_ASSERT
+#include <ptlsim.h>
+#include <cacheProfiler.h>
+
+using namespace Memory;
+
+namespace {
+
+    W64 next_random(W64 &seed)
+    {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        return seed >> 33;
+    }
+
+    TEST(CacheProfiler, ExactDistance)
+    {
+        ReuseSampler sampler(1024, 0);
+        W64 distance;
+
+        /* Loop over 100 lines, each reuse sees the 99 others */
+        foreach (i, 1000) {
+            ASSERT_TRUE(sampler.access(i % 100, distance));
+            if (i < 100)
+                ASSERT_TRUE(distance == ReuseSampler::COLD);
+            else
+                ASSERT_EQ(distance, 99);
+        }
+
+        ASSERT_TRUE(sampler.access(99, distance));
+        ASSERT_EQ(distance, 0);
+        ASSERT_EQ(sampler.get_count(), 100);
+    }
+
+    TEST(CacheProfiler, BoundedLines)
+    {
+        ReuseSampler sampler(256, 0);
+        W64 distance;
+
+        foreach (i, 100000) {
+            sampler.access(i, distance);
+            ASSERT_LE(sampler.get_count(), 256);
+        }
+
+        /* About 100000 / 2^rate lines were sampled */
+        ASSERT_GE(sampler.get_rate(), 8);
+    }
+
+    /*
+     * Miss ratio of a fully associative LRU cache of 2^size lines for
+     * random accesses to 'lines' lines, as seen by the sampler.
+     */
+    double miss_ratio(ReuseSampler &sampler, int lines, int size)
+    {
+        W64 seed = 7, distance;
+        W64 accesses = 0, misses = 0;
+
+        foreach (i, 400000) {
+            if (!sampler.access(next_random(seed) % lines, distance))
+                continue;
+
+            /* Skip warmup, like a simulation after fast forward */
+            if (i < 100000)
+                continue;
+
+            W64 weight = 1ULL << sampler.get_rate();
+            accesses += weight;
+            if (distance >= (1ULL << size))
+                misses += weight;
+        }
+
+        return (double)misses / accesses;
+    }
+
+    TEST(CacheProfiler, SampledMissRatio)
+    {
+        const int LINES = 8192;
+
+        foreach (size, 3) {
+            ReuseSampler exact(LINES, 0);
+            ReuseSampler sampled(256, 0);
+
+            double expect = miss_ratio(exact, LINES, 10 + size);
+            double got = miss_ratio(sampled, LINES, 10 + size);
+
+            ASSERT_NEAR(expect, got, 0.05);
+        }
+    }
+
+    TEST(CacheProfiler, TopMisses)
+    {
+        MissSketch sketch(8);
+        MissSketch::Top top[MissSketch::TOP];
+        W64 seed = 11;
+
+        /* Four hot keys among many cold ones */
+        foreach (i, 50000) {
+            if (i % 4 == 0)
+                sketch.add(0x1000 + (i / 4) % 4);
+            else
+                sketch.add(next_random(seed));
+        }
+
+        int count = sketch.get_top(top);
+        ASSERT_EQ(count, (int)MissSketch::TOP);
+
+        foreach (i, 4) {
+            ASSERT_GE(top[i].key, 0x1000);
+            ASSERT_LT(top[i].key, 0x1004);
+            ASSERT_GE(top[i].count, 50000 / 16);
+            ASSERT_GE(sketch.estimate(top[i].key), top[i].count);
+        }
+
+        ASSERT_GE(top[0].count, top[MissSketch::TOP - 1].count);
+    }
+};
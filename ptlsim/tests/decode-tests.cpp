@@ -0,0 +1,91 @@
+#include <gtest/gtest.h>
+
+#define DISABLE_ASSERT
+#include <ptlsim.h>
+#include <decode.h>
+
+namespace {
+
+    Statable decode_test_stats("decode_test");
+
+    /* Translate one instruction in 64-bit mode into a new basic block */
+    void translate_insn(TraceDecoder& trans, byte* insn, int size)
+    {
+        if (!decoder_stats[0])
+            set_decoder_stats(&decode_test_stats, 0);
+
+        trans.use64 = 1;
+        trans.pe = 1;
+        trans.insnbytes = insn;
+        trans.insnbytes_bufsize = size + 15;
+        trans.valid_byte_count = size;
+
+        while (trans.translate());
+    }
+
+    RIPVirtPhys test_rip()
+    {
+        RIPVirtPhys rvp;
+        setzero(rvp);
+        rvp.rip = 0x400000;
+        rvp.use64 = 1;
+        return rvp;
+    }
+
+    /* vaddps ymm0, ymm1, ymm2: one uop per 64-bit lane */
+    TEST(DecodeAVX, Packed256)
+    {
+        byte insn[] = {0xc5, 0xf4, 0x58, 0xc2};
+        config.avx = 1;
+
+        TraceDecoder trans(test_rip());
+        translate_insn(trans, insn, sizeof(insn));
+
+        ASSERT_GE(trans.bb.count, 4);
+        foreach (i, 4) {
+            TransOp& uop = trans.bb.transops[i];
+            ASSERT_EQ(uop.opcode, OP_fadd);
+            ASSERT_EQ(uop.rd, ymm_lane_reg(REG_xmml0, i));
+            ASSERT_EQ(uop.ra, ymm_lane_reg(REG_xmml1, i));
+            ASSERT_EQ(uop.rb, ymm_lane_reg(REG_xmml2, i));
+        }
+        ASSERT_EQ(trans.bb.transops[3].rd, REG_ymmhh0);
+
+        config.avx = 0;
+    }
+
+    /* vpaddd xmm0, xmm1, xmm2: VEX.128 clears bits 128-255 */
+    TEST(DecodeAVX, Integer128ZeroesUpper)
+    {
+        byte insn[] = {0xc5, 0xf1, 0xfe, 0xc2};
+        config.avx = 1;
+
+        TraceDecoder trans(test_rip());
+        translate_insn(trans, insn, sizeof(insn));
+
+        ASSERT_GE(trans.bb.count, 4);
+        ASSERT_EQ(trans.bb.transops[0].opcode, OP_vadd);
+        ASSERT_EQ(trans.bb.transops[0].size, 2);
+        ASSERT_EQ(trans.bb.transops[1].rd, REG_xmmh0);
+        ASSERT_EQ(trans.bb.transops[1].ra, REG_xmmh1);
+        ASSERT_EQ(trans.bb.transops[2].opcode, OP_mov);
+        ASSERT_EQ(trans.bb.transops[2].rd, REG_ymmhl0);
+        ASSERT_EQ(trans.bb.transops[2].rb, REG_zero);
+        ASSERT_EQ(trans.bb.transops[3].rd, REG_ymmhh0);
+
+        config.avx = 0;
+    }
+
+    /* Without -avx VEX prefixes stay invalid opcodes */
+    TEST(DecodeAVX, DisabledIsInvalid)
+    {
+        byte insn[] = {0xc5, 0xf4, 0x58, 0xc2};
+        config.avx = 0;
+
+        TraceDecoder trans(test_rip());
+        translate_insn(trans, insn, sizeof(insn));
+
+        ASSERT_EQ(trans.bb.brtype, BRTYPE_BARRIER);
+        ASSERT_EQ(trans.bb.rip_taken, ASSIST_INVALID_OPCODE);
+    }
+};
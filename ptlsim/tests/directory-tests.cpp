@@ -0,0 +1,94 @@
+#include <gtest/gtest.h>
+
+#define DISABLE_ASSERT
+#include <globalDirectory.h>
+
+namespace {
+
+    /* Limited pointers keep exact sharers */
+    TEST(Directory, SharerPointers)
+    {
+        SharerSet::setup(DIR_MAX_POINTERS);
+        SharerSet s;
+
+        ASSERT_TRUE(s.iszero());
+        ASSERT_EQ(s.lsb(), -1);
+
+        int n = min(NUM_SIM_CORES, DIR_MAX_POINTERS);
+        foreach (i, n) {
+            s.set(n - 1 - i);
+            s.set(n - 1 - i);
+            ASSERT_EQ(s.popcount(), i + 1);
+        }
+
+        ASSERT_FALSE(s.vector);
+        ASSERT_EQ(s.lsb(), 0);
+
+        foreach (i, n) {
+            ASSERT_TRUE(s.test(i));
+            s.reset(i);
+            ASSERT_FALSE(s.test(i));
+        }
+
+        ASSERT_TRUE(s.iszero());
+    }
+
+    /* Running out of pointers falls back to a vector that keeps all
+     * sharers */
+    TEST(Directory, SharerOverflow)
+    {
+        SharerSet::setup(1);
+        SharerSet s;
+
+        s.set(0);
+        ASSERT_FALSE(s.vector);
+
+        if (NUM_SIM_CORES < 2)
+            return;
+
+        s.set(NUM_SIM_CORES - 1);
+        ASSERT_TRUE(s.vector);
+        ASSERT_TRUE(s.test(0));
+        ASSERT_TRUE(s.test(NUM_SIM_CORES - 1));
+        ASSERT_GE(s.popcount(), 2);
+
+        /* Coarse bits can't drop a single core */
+        s.reset(0);
+        if (s.is_coarse()) {
+            ASSERT_TRUE(s.test(0));
+        } else {
+            ASSERT_FALSE(s.test(0));
+            s.reset(NUM_SIM_CORES - 1);
+            ASSERT_TRUE(s.iszero());
+            ASSERT_FALSE(s.vector);
+        }
+
+        s.reset();
+        ASSERT_TRUE(s.iszero());
+        ASSERT_FALSE(s.vector);
+    }
+
+    /* Bit vector is exact up to 64 cores */
+    TEST(Directory, SharerVector)
+    {
+        SharerSet::setup(0);
+        SharerSet s;
+
+        ASSERT_TRUE(s.vector);
+
+        foreach (i, NUM_SIM_CORES) {
+            s.set(i);
+        }
+        ASSERT_EQ(s.popcount(), NUM_SIM_CORES);
+        ASSERT_EQ(s.lsb(), 0);
+
+        s.reset();
+        s.set(NUM_SIM_CORES - 1);
+        ASSERT_TRUE(s.test(NUM_SIM_CORES - 1));
+
+        if (NUM_SIM_CORES <= 64) {
+            ASSERT_EQ(s.lsb(), NUM_SIM_CORES - 1);
+            ASSERT_EQ(s.popcount(), 1);
+        }
+    }
+};
@@ -0,0 +1,285 @@
+
+#include <gtest/gtest.h>
+
+#define DISABLE_ASSERT
+#include <decode.h>
+
+#define INTERVAL_CORE_NAME "Interval_Test"
+#define INTERVAL_CORE_MODEL Interval_Test
+#include <intervalcore.cpp>
+
+#include <machine.h>
+
+const int TEST_BRANCH_RESOLVE_CYCLES = 9;
+
+void gen_interval_test_machine(BaseMachine& machine)
+{
+    while(!machine.context_used.allset()) {
+        machine.add_option("interval_", machine.coreid_counter,
+                "branch_resolve_cycles", TEST_BRANCH_RESOLVE_CYCLES);
+        CoreBuilder::add_new_core(machine, "interval_", "Interval_Test");
+    }
+
+    foreach(i, machine.get_num_cores()) {
+        ControllerBuilder::add_new_cont(machine, i, "core_", "cpu", 0);
+    }
+
+    foreach(i, machine.get_num_cores()) {
+        machine.add_option("L1_I_", i, "private", true);
+        ControllerBuilder::add_new_cont(machine, i, "L1_I_", "mesi_cache", 0);
+    }
+
+    foreach(i, machine.get_num_cores()) {
+        machine.add_option("L1_D_", i, "private", true);
+        ControllerBuilder::add_new_cont(machine, i, "L1_D_", "mesi_cache", 0);
+    }
+
+
+    foreach(i, machine.get_num_cores()) {
+        machine.add_option("L2_", i, "last_private", true);
+        machine.add_option("L2_", i, "private", true);
+        ControllerBuilder::add_new_cont(machine, i, "L2_", "mesi_cache", 0);
+    }
+
+    foreach(i, 1) {
+        ControllerBuilder::add_new_cont(machine, i, "MEM_", "simple_dram_cont", 0);
+    }
+
+    foreach(i, machine.get_num_cores()) {
+        ConnectionDef* connDef = machine.get_new_connection_def("p2p",
+                "p2p_core_L1_I_", i);
+
+        stringbuf core_;
+        core_ << "core_" << i;
+        machine.add_new_connection(connDef, core_.buf, INTERCONN_TYPE_I);
+
+        stringbuf L1_I_;
+        L1_I_ << "L1_I_" << i;
+        machine.add_new_connection(connDef, L1_I_.buf, INTERCONN_TYPE_UPPER);
+    }
+
+    foreach(i, machine.get_num_cores()) {
+        ConnectionDef* connDef = machine.get_new_connection_def("p2p",
+                "p2p_core_L1_D_", i);
+        stringbuf core_;
+        core_ << "core_" << i;
+        machine.add_new_connection(connDef, core_.buf, INTERCONN_TYPE_D);
+
+        stringbuf L1_D_;
+        L1_D_ << "L1_D_" << i;
+        machine.add_new_connection(connDef, L1_D_.buf, INTERCONN_TYPE_UPPER);
+    }
+
+    foreach(i, machine.get_num_cores()) {
+        ConnectionDef* connDef = machine.get_new_connection_def("p2p",
+                "p2p_L1_I_L2_", i);
+        stringbuf L1_I_;
+        L1_I_ << "L1_I_" << i;
+        machine.add_new_connection(connDef, L1_I_.buf, INTERCONN_TYPE_LOWER);
+
+        stringbuf L2_;
+        L2_ << "L2_" << i;
+        machine.add_new_connection(connDef, L2_.buf, INTERCONN_TYPE_UPPER);
+    }
+
+    foreach(i, machine.get_num_cores()) {
+        ConnectionDef* connDef = machine.get_new_connection_def("p2p",
+                "p2p_L1_D_L2_", i);
+        stringbuf L1_D_;
+        L1_D_ << "L1_D_" << i;
+        machine.add_new_connection(connDef, L1_D_.buf, INTERCONN_TYPE_LOWER);
+
+        stringbuf L2_;
+        L2_ << "L2_" << i;
+        machine.add_new_connection(connDef, L2_.buf, INTERCONN_TYPE_UPPER2);
+    }
+
+    foreach(i, 1) {
+        ConnectionDef* connDef = machine.get_new_connection_def("split_bus",
+                "split_bus_0", i);
+        foreach(j, machine.get_num_cores()) {
+            stringbuf L2_;
+            L2_ << "L2_" << j;
+            machine.add_new_connection(connDef, L2_.buf, INTERCONN_TYPE_LOWER);
+        }
+
+        stringbuf MEM_0;
+        MEM_0 << "MEM_0";
+        machine.add_new_connection(connDef, MEM_0.buf, INTERCONN_TYPE_UPPER);
+    }
+
+    machine.setup_interconnects();
+    machine.memoryHierarchyPtr->setup_full_flags();
+}
+
+MachineBuilder interval_test_machine("interval-test",
+        &gen_interval_test_machine);
+
+namespace {
+
+    using namespace Core;
+    using namespace INTERVAL_CORE_MODEL;
+
+    class IntervalCoreTest : public ::testing::Test {
+        public:
+            BaseMachine *base_machine;
+
+            IntervalCoreTest()
+            {
+                base_machine = (BaseMachine*)PTLsimMachine::getmachine(
+                        "base");
+
+                // If machine is not configured to use IntervalCore, change
+                // configuration
+                if(strcmp(config.machine_config, "interval-test")) {
+                    config.machine_config = "interval-test";
+
+                    base_machine->reset();
+                }
+
+                base_machine->init(config);
+
+                foreach(i, base_machine->cores.count()) {
+                    IntervalCore* core = (IntervalCore*)base_machine->cores[i];
+                    core->threads[0]->set_default_stats(user_stats);
+                }
+            }
+
+            void TearDown()
+            {
+                base_machine->reset();
+                sim_cycle = 0;
+
+                // clean up bbcache
+                foreach(i, NUM_SIM_CORES) {
+                    bbcache[i].flush(i);
+                }
+            }
+    };
+
+    TEST_F(IntervalCoreTest, InitializedBaseMachine)
+    {
+        ASSERT_STREQ(config.machine_config.buf, "interval-test");
+        ASSERT_EQ(base_machine->coreid_counter, NUM_SIM_CORES);
+
+        foreach(i, base_machine->cores.count()) {
+            IntervalCore* core = (IntervalCore*)base_machine->cores[i];
+
+            ASSERT_EQ(core->get_coreid(), i);
+            ASSERT_EQ(core->threadcount, 1);
+            ASSERT_EQ(core->dispatch_credit, DISPATCH_WIDTH);
+
+            // Branch penalty comes from the core option
+            ASSERT_EQ(core->branch_resolve_cycles, TEST_BRANCH_RESOLVE_CYCLES);
+
+            IntervalThread* thread = core->threads[0];
+            ASSERT_EQ(&thread->core, core);
+            ASSERT_EQ(thread->ctx.cpu_index, i);
+            ASSERT_EQ(thread->miss_count, 0);
+            ASSERT_EQ(thread->frontend_stall, 0);
+            ASSERT_FALSE(thread->wait_for_miss_resolve);
+            ASSERT_FALSE(thread->current_bb);
+        }
+    }
+
+    TEST_F(IntervalCoreTest, WindowBehindOldestMiss)
+    {
+        IntervalCore& core = *(IntervalCore*)base_machine->cores[0];
+        IntervalThread& thread = *core.threads[0];
+
+        // Without outstanding misses the window never fills
+        thread.dispatch_seq = 1000;
+        ASSERT_FALSE(thread.window_full(ROB_SIZE * 2));
+
+        // Window is counted from the oldest miss only
+        thread.misses[0].seq = 100;
+        thread.misses[1].seq = 150;
+        thread.miss_count = 2;
+        thread.dispatch_seq = 100 + ROB_SIZE - 4;
+
+        ASSERT_FALSE(thread.window_full(4));
+        ASSERT_TRUE(thread.window_full(5));
+
+        // Resolving the oldest miss slides the window
+        thread.remove_miss(0);
+        ASSERT_EQ(thread.miss_count, 1);
+        ASSERT_EQ(thread.misses[0].seq, 150);
+        ASSERT_FALSE(thread.window_full(50));
+    }
+
+    TEST_F(IntervalCoreTest, FlushChargesFrontendRefill)
+    {
+        IntervalCore& core = *(IntervalCore*)base_machine->cores[0];
+        IntervalThread& thread = *core.threads[0];
+        StatArray<W64, NUM_STALL_REASONS>::BaseArr& stall =
+            thread.st_dispatch.stall(user_stats);
+        W64 flush_stalls = stall[STALL_FLUSH];
+
+        thread.flush_pipeline();
+        ASSERT_EQ(thread.frontend_stall, FRONTEND_STAGES);
+
+        // Each stalled cycle is charged and dispatches nothing
+        foreach(i, FRONTEND_STAGES) {
+            int width = DISPATCH_WIDTH;
+            ASSERT_EQ(thread.dispatch(width), DISPATCH_OK);
+            ASSERT_EQ(width, DISPATCH_WIDTH);
+        }
+
+        ASSERT_EQ(thread.frontend_stall, 0);
+        ASSERT_EQ(stall[STALL_FLUSH], flush_stalls + FRONTEND_STAGES);
+    }
+
+    TEST_F(IntervalCoreTest, DependentMispredictWaitsForMiss)
+    {
+        IntervalCore& core = *(IntervalCore*)base_machine->cores[0];
+        IntervalThread& thread = *core.threads[0];
+        StatArray<W64, NUM_STALL_REASONS>::BaseArr& stall =
+            thread.st_dispatch.stall(user_stats);
+        W64 resolve_stalls = stall[STALL_MISS_RESOLVE];
+
+        // State left by a mispredict that depends on an outstanding miss
+        thread.frontend_stall = core.branch_resolve_cycles + FRONTEND_STAGES;
+        thread.frontend_stall_reason = STALL_MISPREDICT;
+        thread.wait_for_miss_resolve = true;
+        thread.misses[0].seq = 0;
+        thread.miss_count = 1;
+
+        // Penalty doesn't start until the miss is resolved
+        int width = DISPATCH_WIDTH;
+        thread.dispatch(width);
+        ASSERT_EQ(thread.stall_reason, STALL_MISS_RESOLVE);
+        ASSERT_EQ(thread.frontend_stall,
+                core.branch_resolve_cycles + FRONTEND_STAGES);
+        ASSERT_EQ(stall[STALL_MISS_RESOLVE], resolve_stalls + 1);
+
+        thread.remove_miss(0);
+        thread.dispatch(width);
+        ASSERT_EQ(thread.stall_reason, STALL_MISPREDICT);
+        ASSERT_EQ(thread.frontend_stall,
+                core.branch_resolve_cycles + FRONTEND_STAGES - 1);
+    }
+
+    TEST(IntervalCoreModelTest, SharedRegisterTables)
+    {
+        // Flags are one architectural register in an in-order core
+        ASSERT_EQ(archreg_remap_table[REG_zf], REG_flags);
+        ASSERT_EQ(archreg_remap_table[REG_cf], REG_flags);
+        ASSERT_EQ(archreg_remap_table[REG_of], REG_flags);
+        ASSERT_EQ(archreg_remap_table[REG_rax], REG_rax);
+        ASSERT_EQ(archreg_remap_table[REG_ymmhh15], REG_ymmhh15);
+
+        ASSERT_TRUE(archdest_is_visible[REG_rax]);
+        ASSERT_TRUE(archdest_is_visible[REG_ymmhl0]);
+        ASSERT_FALSE(archdest_is_visible[REG_temp0]);
+        ASSERT_FALSE(archdest_is_visible[REG_temp10]);
+
+        W64 data = 0x00000000000080f0ULL;
+        ASSERT_EQ(extract_bytes((byte*)&data, 0, false), 0xf0ULL);
+        ASSERT_EQ(extract_bytes((byte*)&data, 0, true),
+                0xfffffffffffffff0ULL);
+        ASSERT_EQ(extract_bytes((byte*)&data, 1, true),
+                0xffffffffffff80f0ULL);
+        ASSERT_EQ(extract_bytes((byte*)&data, 3, true), data);
+    }
+
+}; // namespace
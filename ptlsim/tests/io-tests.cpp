@@ -0,0 +1,93 @@
+#include <gtest/gtest.h>
+
+#define DISABLE_ASSERT
+#include <ptlsim.h>
+#include <io-models.h>
+
+namespace {
+
+    dynarray<int> fired;
+
+    void record_event(void *arg)
+    {
+        fired.push((int)(long)arg);
+    }
+
+    /* Events run in cycle order, same cycle in insertion order */
+    TEST(IOModels, EventQueueOrder)
+    {
+        IOEventQueue queue;
+        fired.clear();
+
+        queue.add(30, record_event, (void*)3);
+        queue.add(10, record_event, (void*)1);
+        queue.add(20, record_event, (void*)2);
+        queue.add(10, record_event, (void*)4);
+
+        ASSERT_EQ(queue.next_cycle(), 10);
+        ASSERT_EQ(queue.run(9), 0);
+        ASSERT_EQ(queue.run(20), 3);
+        ASSERT_EQ(queue.next_cycle(), 30);
+        ASSERT_EQ(queue.run((W64)-1), 1);
+        ASSERT_EQ(queue.next_cycle(), (W64)-1);
+
+        ASSERT_EQ(fired.size(), 4);
+        ASSERT_EQ(fired[0], 1);
+        ASSERT_EQ(fired[1], 4);
+        ASSERT_EQ(fired[2], 2);
+        ASSERT_EQ(fired[3], 3);
+    }
+
+    /* Channels serve requests in parallel, then requests queue up */
+    TEST(IOModels, StorageChannels)
+    {
+        Statable parent("io_test");
+        StorageModel disk(&parent, 2, 8, 100, 50, 1.0);
+        parent.set_default_stats(user_stats);
+        W64 saved_cycle = sim_cycle;
+        sim_cycle = 1000;
+
+        ASSERT_EQ(disk.request(false, 100), 200);
+        ASSERT_EQ(disk.request(false, 100), 200);
+        ASSERT_EQ(disk.request(true, 10), 260);
+
+        ASSERT_EQ(disk.stats.requests[0], 2);
+        ASSERT_EQ(disk.stats.requests[1], 1);
+        ASSERT_EQ(disk.stats.bytes[0], 200);
+
+        sim_cycle = saved_cycle;
+    }
+
+    /* A full device queue delays new requests until one completes */
+    TEST(IOModels, StorageQueueDepth)
+    {
+        Statable parent("io_test");
+        StorageModel disk(&parent, 4, 1, 100, 100, 1.0);
+        parent.set_default_stats(user_stats);
+        W64 saved_cycle = sim_cycle;
+        sim_cycle = 0;
+
+        ASSERT_EQ(disk.request(false, 0), 100);
+        ASSERT_EQ(disk.request(false, 0), 200);
+        ASSERT_EQ(disk.stats.queue_full(user_stats), 1);
+
+        sim_cycle = saved_cycle;
+    }
+
+    /* Packets are serialized on each direction of the link */
+    TEST(IOModels, NetworkLink)
+    {
+        Statable parent("io_test");
+        NetworkModel nic(&parent, 10, 2.0);
+        parent.set_default_stats(user_stats);
+        W64 saved_cycle = sim_cycle;
+        sim_cycle = 0;
+
+        ASSERT_EQ(nic.packet(true, 100), 60);
+        ASSERT_EQ(nic.packet(true, 100), 110);
+        ASSERT_EQ(nic.packet(false, 100), 60);
+        ASSERT_EQ(nic.stats.packets[1], 2);
+
+        sim_cycle = saved_cycle;
+    }
+};
@@ -0,0 +1,90 @@
+#include <gtest/gtest.h>
+
+#define DISABLE_ASSERT
+#include <ptlsim.h>
+#include <logic.h>
+
+/*
+ * Microbenchmarks for the associative tag search kernels
+ *
+ * These are disabled by default, run them with:
+ *   ptlsim --gtest_also_run_disabled_tests --gtest_filter='AssocTagsBench.*'
+ *
+ * Each benchmark times the same searches with every kernel set the
+ * host supports and prints the average cycles per search.
+ */
+
+namespace {
+
+    const int iterations = 1 << 16;
+
+    template <typename F>
+    void run_bench(const char *title, F& search)
+    {
+        int best = assoc_tag_kernels_best();
+
+        for(int isa = ASSOC_KERNEL_SSE2; isa <= best; isa++) {
+            assoc_tag_kernels_select(isa);
+
+            W64 found = 0;
+            W64 start = rdtsc();
+            foreach(i, iterations) {
+                found += search(i);
+            }
+            W64 cycles = rdtsc() - start;
+
+            cout << title << " " << assoc_tag_kernels.name << ": " <<
+                (double(cycles) / iterations) << " cycles/search (" <<
+                found << " hits)" << endl;
+        }
+
+        assoc_tag_kernels_select(best);
+    }
+
+    template <int size>
+    struct Search8 {
+        FullyAssociativeTags8bit<size, size> tags;
+
+        Search8() { foreach(i, size) tags.insert(i); }
+
+        int operator()(int i) { return tags.search((byte)i) >= 0; }
+    };
+
+    template <int size>
+    struct Search16 {
+        FullyAssociativeTags16bit<size, size> tags;
+
+        Search16() { foreach(i, size) tags.insert(i * 3); }
+
+        int operator()(int i) { return tags.search(W16(i)) >= 0; }
+    };
+
+    template <int size>
+    struct SearchNbit {
+        FullyAssociativeTagsNbitOneHot<size, 40> tags;
+
+        SearchNbit() { foreach(i, size) tags.update(i, W64(i) << 12); }
+
+        int operator()(int i) {
+            return tags.search(W64(i % (size * 2)) << 12) >= 0;
+        }
+    };
+
+#define TAG_BENCH(name, type, size) \
+    TEST(AssocTagsBench, DISABLED_##name##_##size) \
+    { \
+        type<size> search; \
+        run_bench(#name "<" #size ">", search); \
+    }
+
+    TAG_BENCH(Tags8bit, Search8, 64)
+    TAG_BENCH(Tags8bit, Search8, 128)
+    TAG_BENCH(Tags8bit, Search8, 256)
+    TAG_BENCH(Tags16bit, Search16, 64)
+    TAG_BENCH(Tags16bit, Search16, 128)
+    TAG_BENCH(Tags16bit, Search16, 256)
+    TAG_BENCH(TagsNbitOneHot, SearchNbit, 64)
+    TAG_BENCH(TagsNbitOneHot, SearchNbit, 128)
+
+#undef TAG_BENCH
+};
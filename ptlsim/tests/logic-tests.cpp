@@ -4,6 +4,7 @@
 #define DISABLE_ASSERT
 #include <ptlsim.h>
 #include <logic.h>
+#include <statelist.h>
 
 namespace {
 
@@ -42,6 +43,99 @@ namespace {
         }
     }
 
+    /* Every tag search kernel the host supports gives the SSE2 result */
+    TEST(Logic, AssocTagKernels)
+    {
+        const int size = 128;
+        FullyAssociativeTags8bit<size, size> tags8;
+        FullyAssociativeTags16bit<size, size> tags16;
+        FullyAssociativeTagsNbitOneHot<size, 40> tagsnbit;
+
+        foreach(i, size - 8) {
+            tags8.insert((i * 37) & 0xff);
+            tags16.insert((i * 997) & 0xffff);
+            tagsnbit.update(i, (W64(i) * 0x1234567) & 0xffffffffffULL);
+        }
+        tags8.invalidateslot(5);
+
+        int best = assoc_tag_kernels_best();
+        ASSERT_TRUE(assoc_tag_kernels_select(ASSOC_KERNEL_SSE2));
+
+        bitvec<size> match8[256], any8[256], match16[64];
+        int nbit[64];
+
+        foreach(t, 256) {
+            match8[t] = tags8.match((byte)t);
+            any8[t] = tags8.matchany((byte)t);
+        }
+        foreach(t, 64) {
+            match16[t] = tags16.match(W16(t * 997));
+            nbit[t] = tagsnbit.match((W64(t * 3) * 0x1234567) & 0xffffffffffULL);
+        }
+
+        for(int isa = ASSOC_KERNEL_AVX2; isa <= best; isa++) {
+            ASSERT_TRUE(assoc_tag_kernels_select(isa));
+
+            foreach(t, 256) {
+                ASSERT_EQ(match8[t], tags8.match((byte)t)) <<
+                    assoc_tag_kernels.name << " tag " << t;
+                ASSERT_EQ(any8[t], tags8.matchany((byte)t)) <<
+                    assoc_tag_kernels.name << " tag " << t;
+            }
+            foreach(t, 64) {
+                ASSERT_EQ(match16[t], tags16.match(W16(t * 997))) <<
+                    assoc_tag_kernels.name << " tag " << t;
+                ASSERT_EQ(nbit[t], tagsnbit.match(
+                            (W64(t * 3) * 0x1234567) & 0xffffffffffULL)) <<
+                    assoc_tag_kernels.name << " tag " << t;
+            }
+        }
+
+        ASSERT_EQ(match8[(7 * 37) & 0xff].lsb(), 7);
+        ASSERT_FALSE(match8[(5 * 37) & 0xff]);
+        ASSERT_EQ(nbit[2], 6);
+
+        assoc_tag_kernels_select(best);
+        ASSERT_FALSE(assoc_tag_kernels_select(ASSOC_KERNEL_COUNT));
+    }
+
+    /* StateList slot bitmap iterates members in circular age order */
+    TEST(Logic, StateListSlots)
+    {
+        const int size = 192;
+        StateList list("slots");
+        list.track_slots(size);
+
+        int members[] = {3, 64, 100, 127, 128, 150, 191};
+        foreach(i, lengthof(members)) {
+            list.add_slot(members[i]);
+        }
+        list.remove_slot(100);
+        ASSERT_EQ(list.slot_popcount(), 6);
+        ASSERT_EQ(list.count, 6);
+        ASSERT_FALSE(list.empty());
+
+        dynarray<int> order;
+        foreach_slot_by_age(list, 128, slot) {
+            order.push(slot);
+            /* removing the current slot does not stop the scan */
+            list.remove_slot(slot);
+        }
+
+        int expected[] = {128, 150, 191, 3, 64, 127};
+        ASSERT_EQ(order.size(), lengthof(expected));
+        foreach(i, lengthof(expected)) {
+            ASSERT_EQ(order[i], expected[i]);
+        }
+        ASSERT_EQ(list.slot_popcount(), 0);
+        ASSERT_TRUE(list.empty());
+
+        list.add_slot(5);
+        list.reset();
+        ASSERT_EQ(list.count, 0);
+        ASSERT_EQ(list.next_slot(0, size), -1);
+    }
+
     /* Test simulation freq related functions */
     TEST(Sim, SimFreq)
     {
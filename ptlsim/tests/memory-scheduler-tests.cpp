@@ -0,0 +1,240 @@
+#include <gtest/gtest.h>
+
+#define DISABLE_ASSERT
+#include <ptlsim.h>
+#include <memoryHierarchy.h>
+#include <memoryController.h>
+#include <memoryScheduler.h>
+
+using namespace DRAM;
+
+namespace {
+
+    const int BANKS = 8;
+
+    /* One rank channel with transactions in arrival order */
+    struct SchedulerHarness {
+        Config config;
+        Policy policy;
+        Channel *channel;
+        Scheduler *scheduler;
+
+        FixStateList<TransactionEntry, MEM_TRANS_NUM> transactions;
+        RequestEntry requests[MEM_TRANS_NUM];
+        MemoryRequest memoryRequests[MEM_TRANS_NUM];
+        dynarray<TransactionEntry*> queue;
+        int count;
+
+        SchedulerHarness(const char *name) : count(0)
+        {
+            config.rankcount = 1;
+            config.bankcount = BANKS;
+
+            policy.write_high_watermark = 4;
+            policy.write_low_watermark = 1;
+            policy.batch_cap = 2;
+            policy.quantum = 1000;
+            policy.starvation_limit = 100;
+
+            channel = new Channel(&config);
+            scheduler = Scheduler::create(name, config, channel, policy);
+
+            Coordinates coordinates = {0};
+            foreach (i, BANKS) {
+                coordinates.bank = i;
+                channel->getBankData(coordinates).rowBuffer = -1;
+            }
+        }
+
+        ~SchedulerHarness()
+        {
+            delete scheduler;
+            delete channel;
+        }
+
+        void open_row(int bank, int row)
+        {
+            Coordinates coordinates = {0};
+            coordinates.bank = bank;
+            channel->getBankData(coordinates).rowBuffer = row;
+        }
+
+        TransactionEntry *add(int coreid, int bank, int row,
+                bool write = false, long arrival = 0)
+        {
+            MemoryRequest &memoryRequest = memoryRequests[count];
+            RequestEntry &request = requests[count];
+            count += 1;
+
+            memoryRequest.init(coreid, 0, 0, 0, 0, false, 0, 0,
+                    write ? MEMORY_OP_UPDATE : MEMORY_OP_READ);
+            request.init();
+            request.request = &memoryRequest;
+
+            TransactionEntry *transaction = transactions.alloc();
+            transaction->init();
+            transaction->request = &request;
+            transaction->coordinates.rank = 0;
+            transaction->coordinates.bank = bank;
+            transaction->coordinates.row = row;
+            transaction->arrival = arrival;
+            return transaction;
+        }
+
+        void order(long clock = 0)
+        {
+            scheduler->order(clock, transactions.list(), queue);
+        }
+
+        void issue(TransactionEntry *transaction, long clock = 0)
+        {
+            scheduler->issued(clock, transaction);
+            transactions.free(transaction);
+        }
+    };
+
+    TEST(MemoryScheduler, UnknownName)
+    {
+        Config config;
+        Policy policy;
+        config.rankcount = 1;
+        config.bankcount = BANKS;
+        ASSERT_TRUE(Scheduler::create("fifo", config, NULL, policy) == NULL);
+    }
+
+    TEST(MemoryScheduler, FCFSKeepsArrivalOrder)
+    {
+        SchedulerHarness h("fcfs");
+        h.open_row(1, 7);
+        TransactionEntry *a = h.add(0, 0, 3);
+        TransactionEntry *b = h.add(0, 1, 7);
+
+        h.order();
+        ASSERT_EQ(h.queue.size(), 2);
+        ASSERT_TRUE(h.queue[0] == a);
+        ASSERT_TRUE(h.queue[1] == b);
+    }
+
+    TEST(MemoryScheduler, FRFCFSRowHitsFirst)
+    {
+        SchedulerHarness h("frfcfs");
+        h.open_row(1, 7);
+        TransactionEntry *a = h.add(0, 0, 3);
+        TransactionEntry *b = h.add(0, 1, 7);
+        TransactionEntry *c = h.add(0, 1, 8);
+        TransactionEntry *d = h.add(0, 1, 7);
+
+        h.order();
+        ASSERT_EQ(h.queue.size(), 4);
+        ASSERT_TRUE(h.queue[0] == b);
+        ASSERT_TRUE(h.queue[1] == d);
+        ASSERT_TRUE(h.queue[2] == a);
+        ASSERT_TRUE(h.queue[3] == c);
+    }
+
+    TEST(MemoryScheduler, WriteDrainWatermarks)
+    {
+        SchedulerHarness h("write_drain");
+        TransactionEntry *read = h.add(0, 0, 1);
+        TransactionEntry *writes[4];
+        foreach (i, 3) {
+            writes[i] = h.add(0, i, 2, true);
+        }
+
+        /* Below the high watermark reads are served */
+        h.order();
+        ASSERT_EQ(h.queue.size(), 1);
+        ASSERT_TRUE(h.queue[0] == read);
+
+        /* At the high watermark only writes until the low watermark */
+        writes[3] = h.add(0, 3, 2, true);
+        h.order();
+        ASSERT_EQ(h.queue.size(), 4);
+
+        foreach (i, 2) {
+            h.issue(writes[i]);
+            h.order();
+            ASSERT_EQ(h.queue.size(), 3 - i);
+            ASSERT_TRUE(h.queue[0] != read);
+        }
+
+        /* Low watermark reached, back to reads */
+        h.issue(writes[2]);
+        h.order();
+        ASSERT_EQ(h.queue.size(), 1);
+        ASSERT_TRUE(h.queue[0] == read);
+
+        /* No read pending, writes are served */
+        h.issue(read);
+        h.order();
+        ASSERT_EQ(h.queue.size(), 1);
+        ASSERT_TRUE(h.queue[0] == writes[3]);
+    }
+
+    TEST(MemoryScheduler, PARBSBatchCap)
+    {
+        SchedulerHarness h("parbs");
+        TransactionEntry *core0[3];
+        foreach (i, 3) {
+            core0[i] = h.add(0, 0, i);
+        }
+        TransactionEntry *other = h.add(0, 1, 0);
+        TransactionEntry *core1 = h.add(1, 0, 9);
+
+        /* Two oldest of core 0 to bank 0, all others fit the cap */
+        h.order();
+        ASSERT_TRUE(core0[0]->marked);
+        ASSERT_TRUE(core0[1]->marked);
+        ASSERT_FALSE(core0[2]->marked);
+        ASSERT_TRUE(other->marked);
+        ASSERT_TRUE(core1->marked);
+
+        /* Core 1 has the lighter load, unmarked ones go last */
+        ASSERT_EQ(h.queue.size(), 5);
+        ASSERT_TRUE(h.queue[0] == core1);
+        ASSERT_TRUE(h.queue[4] == core0[2]);
+    }
+
+    TEST(MemoryScheduler, PARBSNewBatchWhenServed)
+    {
+        SchedulerHarness h("parbs");
+        TransactionEntry *batch[2];
+        foreach (i, 2) {
+            batch[i] = h.add(0, 0, i);
+        }
+        h.order();
+
+        /* Arrivals during the batch are not marked */
+        TransactionEntry *late = h.add(0, 0, 5);
+        h.issue(batch[0]);
+        h.order();
+        ASSERT_FALSE(late->marked);
+        ASSERT_TRUE(h.queue[0] == batch[1]);
+
+        /* Last marked transaction issued, next batch is formed */
+        h.issue(batch[1]);
+        h.order();
+        ASSERT_TRUE(late->marked);
+    }
+
+    TEST(MemoryScheduler, ATLASLeastAttainedServiceFirst)
+    {
+        SchedulerHarness h("atlas");
+        long quantum = h.policy.quantum;
+        long limit = h.policy.starvation_limit;
+        foreach (i, 8) {
+            h.issue(h.add(0, 1, 1));
+        }
+
+        /* Service is accounted at the end of the quantum */
+        h.order(quantum);
+        TransactionEntry *busy = h.add(0, 0, 1, false, quantum);
+        TransactionEntry *idle = h.add(1, 2, 1, false, quantum + limit);
+        h.order(quantum + limit);
+        ASSERT_TRUE(h.queue[0] == idle);
+
+        /* Starving transactions go first */
+        h.order(quantum + limit + 1);
+        ASSERT_TRUE(h.queue[0] == busy);
+    }
+};
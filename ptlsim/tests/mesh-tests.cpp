@@ -0,0 +1,230 @@
+#include <gtest/gtest.h>
+
+#define DISABLE_ASSERT
+#include <ptlsim.h>
+#include <memoryHierarchy.h>
+#include <machine.h>
+#include <mesh.h>
+
+using namespace Memory;
+using namespace Memory::MeshInterconnect;
+
+namespace {
+
+    const int MESH_TEST_NODES = 9;
+
+    /* Controller that counts the packets ejected to it */
+    class MeshTestCont : public Controller
+    {
+        public:
+            bool accept;
+            int received;
+
+            MeshTestCont(const char *name, MemoryHierarchy *mem)
+                : Controller(0, name, mem)
+                  , accept(true)
+                  , received(0)
+            {}
+
+            bool handle_interconnect_cb(void *arg)
+            {
+                if (!accept)
+                    return false;
+                received++;
+                return true;
+            }
+
+            void register_interconnect(Interconnect *interconnect,
+                    int conn_type) {}
+            void print_map(ostream& os) {}
+            void print(ostream& os) const {}
+            bool is_full(bool fromInterconnect = false) const { return false; }
+            void annul_request(MemoryRequest *request) {}
+            void dump_configuration(YAML::Emitter &out) const {}
+    };
+
+    /* Mesh with one test controller per node, options set by name */
+    struct MeshHarness {
+        BaseMachine *machine;
+        MemoryHierarchy *mem;
+        Mesh *mesh;
+        MeshTestCont *conts[MESH_TEST_NODES];
+        MemoryRequest requests[MESH_TEST_NODES];
+        int nodes;
+        int sent;
+
+        MeshHarness(const char *name, int rows, int cols, bool torus,
+                int nodes_, const char *tiles = NULL)
+            : nodes(nodes_)
+              , sent(0)
+        {
+            machine = (BaseMachine*)PTLsimMachine::getmachine("base");
+            machine->set_default_stats(user_stats);
+            mem = new MemoryHierarchy(*machine);
+
+            machine->add_option(name, "rows", rows);
+            machine->add_option(name, "cols", cols);
+            machine->add_option(name, "torus", torus);
+            if (tiles)
+                machine->add_option(name, "tiles", tiles);
+
+            mesh = new Mesh(name, mem);
+
+            foreach (i, nodes) {
+                stringbuf cont_name;
+                cont_name << name << "_cont_" << i;
+                conts[i] = new MeshTestCont(cont_name.buf, mem);
+                mesh->register_controller(conts[i]);
+            }
+
+            sim_cycle = 0;
+        }
+
+        ~MeshHarness()
+        {
+            delete mesh;
+            foreach (i, nodes) {
+                delete conts[i];
+            }
+            sim_cycle = 0;
+        }
+
+        bool send(int from, int to, bool data = false)
+        {
+            MemoryRequest &request = requests[sent++ % MESH_TEST_NODES];
+            Message msg;
+
+            request.init(0, 0, 0x1000 * sent, 0, sim_cycle, false, 0, 0,
+                    MEMORY_OP_READ);
+
+            msg.init();
+            msg.sender = conts[from];
+            msg.dest = conts[to];
+            msg.request = &request;
+            msg.hasData = data;
+
+            return mesh->controller_request_cb(&msg);
+        }
+
+        void run(int cycles)
+        {
+            foreach (i, cycles) {
+                sim_cycle++;
+                mesh->tick_cb(NULL);
+            }
+        }
+
+        W64 link_packets(int node, int port)
+        {
+            Router *router = mesh->get_router(conts[node]);
+            return router->stats->link_packets(user_stats)[port];
+        }
+    };
+
+    TEST(Mesh, XYRouting)
+    {
+        MeshHarness h("mesh_test_xy", 3, 3, false, 9);
+
+        /* (0,0) to (2,2): both X hops before any Y hop */
+        ASSERT_TRUE(h.send(0, 8));
+        h.run(40);
+
+        ASSERT_EQ(h.conts[8]->received, 1);
+        ASSERT_EQ(h.link_packets(0, PORT_EAST), 1);
+        ASSERT_EQ(h.link_packets(1, PORT_EAST), 1);
+        ASSERT_EQ(h.link_packets(2, PORT_SOUTH), 1);
+        ASSERT_EQ(h.link_packets(5, PORT_SOUTH), 1);
+        ASSERT_EQ(h.link_packets(8, PORT_LOCAL), 1);
+        ASSERT_EQ(h.link_packets(0, PORT_SOUTH), 0);
+        ASSERT_EQ(h.link_packets(3, PORT_EAST), 0);
+
+        /* Routers are found by controller in any order */
+        foreach (i, 9) {
+            Router *router = h.mesh->get_router(h.conts[i]);
+            ASSERT_TRUE(router->controller == h.conts[i]);
+            ASSERT_EQ(router->x, i % 3);
+            ASSERT_EQ(router->y, i / 3);
+        }
+    }
+
+    TEST(Mesh, TilePlacement)
+    {
+        /* 2x2 grid, tile 2 has no controller */
+        MeshHarness h("mesh_test_tiles", 0, 2, false, 3, "3,0,1");
+
+        Router *router = h.mesh->get_router(h.conts[0]);
+        ASSERT_EQ(router->x, 1);
+        ASSERT_EQ(router->y, 1);
+
+        router = h.mesh->get_router(h.conts[2]);
+        ASSERT_EQ(router->x, 1);
+        ASSERT_EQ(router->y, 0);
+
+        /* (1,1) to (0,0) goes west through the empty tile first */
+        ASSERT_TRUE(h.send(0, 1));
+        h.run(20);
+        ASSERT_EQ(h.conts[1]->received, 1);
+        ASSERT_EQ(h.link_packets(0, PORT_WEST), 1);
+        ASSERT_EQ(h.link_packets(2, PORT_SOUTH), 0);
+    }
+
+    TEST(Mesh, CreditsBackpressure)
+    {
+        MeshHarness h("mesh_test_credits", 1, 2, false, 2);
+        Router *src = h.mesh->get_router(h.conts[0]);
+        Router *dst = h.mesh->get_router(h.conts[1]);
+        int depth = src->credits[PORT_EAST][0];
+
+        /* Data packets fill a whole VC, one per VC downstream */
+        h.conts[1]->accept = false;
+        foreach (i, 3) {
+            ASSERT_TRUE(h.send(0, 1, true));
+        }
+        h.run(20);
+
+        int flits = depth - src->credits[PORT_EAST][0];
+        ASSERT_GT(flits, 1);
+        ASSERT_EQ(src->credits[PORT_EAST][1], depth - flits);
+        ASSERT_EQ(dst->inputs[PORT_WEST][0].count, 1);
+        ASSERT_EQ(dst->inputs[PORT_WEST][1].count, 1);
+        ASSERT_EQ(src->inject.count, 1);
+        ASSERT_GT(src->stats->credit_stalls(user_stats)[PORT_EAST], 0);
+
+        /* Ejection returns the credits and the last packet moves on */
+        h.conts[1]->accept = true;
+        h.run(40);
+
+        ASSERT_EQ(h.conts[1]->received, 3);
+        ASSERT_EQ(src->inject.count, 0);
+        ASSERT_EQ(src->credits[PORT_EAST][0], depth);
+        ASSERT_EQ(src->credits[PORT_EAST][1], depth);
+    }
+
+    TEST(Mesh, TorusDateline)
+    {
+        MeshHarness h("mesh_test_torus", 1, 4, true, 4);
+        Router *first = h.mesh->get_router(h.conts[0]);
+        Router *second = h.mesh->get_router(h.conts[1]);
+
+        h.conts[0]->accept = false;
+        h.conts[1]->accept = false;
+
+        /* 3 -> 0 takes the wraparound link and moves to the upper class */
+        ASSERT_TRUE(h.send(3, 0));
+        /* 0 -> 1 stays in the lower class */
+        ASSERT_TRUE(h.send(0, 1));
+        h.run(20);
+
+        ASSERT_EQ(h.link_packets(3, PORT_EAST), 1);
+        ASSERT_EQ(first->inputs[PORT_WEST][0].count, 0);
+        ASSERT_EQ(first->inputs[PORT_WEST][1].count, 1);
+        ASSERT_EQ(second->inputs[PORT_WEST][0].count, 1);
+        ASSERT_EQ(second->inputs[PORT_WEST][1].count, 0);
+
+        h.conts[0]->accept = true;
+        h.conts[1]->accept = true;
+        h.run(20);
+        ASSERT_EQ(h.conts[0]->received, 1);
+        ASSERT_EQ(h.conts[1]->received, 1);
+    }
+};
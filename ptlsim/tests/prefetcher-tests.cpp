@@ -0,0 +1,148 @@
+#include <gtest/gtest.h>
+
+#define DISABLE_ASSERT
+#include <ptlsim.h>
+#include <memoryHierarchy.h>
+#include <cacheLines.h>
+#include <prefetcher.h>
+
+using namespace Memory;
+
+namespace {
+
+    const int LINE_BITS = 6;
+    const int LINE = 1 << LINE_BITS;
+
+    /* Degree 2, distance 4, 16 table entries */
+    Prefetcher *create(const char *type, Statable *parent)
+    {
+        return Prefetcher::create(type, parent, LINE_BITS, 2, 4, 16);
+    }
+
+    TEST(Prefetcher, StrideDetection)
+    {
+        Statable parent("prefetch_test");
+        Prefetcher *stride = create("stride", &parent);
+        dynarray<W64> prefetches;
+
+        /* Stride of 4 lines is confirmed on the fourth access */
+        foreach (i, 3) {
+            prefetches.clear();
+            stride->train(0x400, i * 4 * LINE, false, prefetches);
+            ASSERT_EQ(prefetches.size(), 0);
+        }
+
+        stride->train(0x400, 3 * 4 * LINE, false, prefetches);
+        ASSERT_EQ(prefetches.size(), 2);
+        ASSERT_EQ(prefetches[0], (3 + 4) * 4 * LINE);
+        ASSERT_EQ(prefetches[1], (3 + 5) * 4 * LINE);
+
+        /* Another PC takes over the entry and starts untrained */
+        prefetches.clear();
+        stride->train(0x400 + 16, 0x100000, false, prefetches);
+        ASSERT_EQ(prefetches.size(), 0);
+
+        delete stride;
+    }
+
+    TEST(Prefetcher, StreamDetection)
+    {
+        Statable parent("prefetch_test");
+        Prefetcher *stream = create("stream", &parent);
+        dynarray<W64> prefetches;
+
+        /* Hits don't allocate streams */
+        stream->train(0, 100 * LINE, true, prefetches);
+        stream->train(0, 101 * LINE, true, prefetches);
+        ASSERT_EQ(prefetches.size(), 0);
+
+        /* Miss allocates, the next access sets the direction */
+        stream->train(0, 200 * LINE, false, prefetches);
+        stream->train(0, 201 * LINE, true, prefetches);
+        ASSERT_EQ(prefetches.size(), 0);
+
+        stream->train(0, 202 * LINE, true, prefetches);
+        ASSERT_EQ(prefetches.size(), 2);
+        ASSERT_EQ(prefetches[0], (202 + 4) * LINE);
+        ASSERT_EQ(prefetches[1], (202 + 5) * LINE);
+
+        /* Descending stream */
+        prefetches.clear();
+        stream->train(0, 500 * LINE, false, prefetches);
+        stream->train(0, 499 * LINE, false, prefetches);
+        stream->train(0, 498 * LINE, false, prefetches);
+        ASSERT_EQ(prefetches.size(), 2);
+        ASSERT_EQ(prefetches[0], (498 - 4) * LINE);
+        ASSERT_EQ(prefetches[1], (498 - 5) * LINE);
+
+        delete stream;
+    }
+
+    TEST(Prefetcher, AccuracyCounters)
+    {
+        Statable parent("prefetch_test");
+        parent.set_default_stats(user_stats);
+        Prefetcher *stream = create("stream", &parent);
+        dynarray<W64> prefetches;
+        CacheLine used, unused, dropped;
+
+        used.init(0);
+        used.prefetched = true;
+        unused.init(LINE);
+        dropped.init(2 * LINE);
+        dropped.prefetched = true;
+
+        /* First use of a prefetched line is useful, later ones are hits */
+        stream->demand_access(0, 0, false, &used, prefetches);
+        ASSERT_FALSE(used.prefetched);
+        stream->demand_access(0, 0, false, &used, prefetches);
+        stream->demand_access(0, LINE, false, &unused, prefetches);
+        stream->demand_access(0, 8 * LINE, false, NULL, prefetches);
+
+        ASSERT_EQ(stream->stats.useful(user_stats), 1);
+        ASSERT_EQ(stream->stats.misses(user_stats), 2);
+
+        /* Evicted or invalidated before use is useless, only once */
+        stream->line_dropped(&dropped, false);
+        stream->line_dropped(&dropped, false);
+        stream->line_dropped(&used, false);
+
+        ASSERT_EQ(stream->stats.useless(user_stats), 1);
+        ASSERT_EQ(stream->stats.useful(user_stats), 1);
+
+        delete stream;
+    }
+
+    TEST(Prefetcher, PendingLines)
+    {
+        Statable parent("prefetch_test");
+        Prefetcher *stride = create("stride", &parent);
+
+        /* Any address in the line matches */
+        stride->add_pending(10 * LINE);
+        ASSERT_TRUE(stride->is_pending(10 * LINE + 8));
+        ASSERT_FALSE(stride->is_pending(11 * LINE));
+
+        /* Two prefetches of a line need two removals */
+        stride->add_pending(10 * LINE);
+        stride->remove_pending(10 * LINE);
+        ASSERT_TRUE(stride->is_pending(10 * LINE));
+        stride->remove_pending(10 * LINE);
+        ASSERT_FALSE(stride->is_pending(10 * LINE));
+        ASSERT_EQ(stride->get_pending_count(), 0);
+
+        /* Removal keeps the other entries reachable */
+        foreach (i, 300) {
+            stride->add_pending(i * 4096 * LINE);
+        }
+        for (int i = 0; i < 300; i += 2) {
+            stride->remove_pending(i * 4096 * LINE);
+        }
+        foreach (i, 300) {
+            ASSERT_EQ(stride->is_pending(i * 4096 * LINE), (i & 1) != 0);
+        }
+        ASSERT_EQ(stride->get_pending_count(), 150);
+
+        delete stride;
+    }
+};
@@ -0,0 +1,176 @@
+#include <gtest/gtest.h>
+
+#define DISABLE_ASSERT
+#include <ptlsim.h>
+#include <replacement.h>
+
+using namespace Memory;
+
+namespace {
+
+    const bitvec<4> ALL_WAYS(0xf);
+
+    /* Fill all ways of set 0 in order */
+    template <typename P>
+    void fill_set(P& policy, int ways, W64 pc = 0)
+    {
+        foreach (i, ways) {
+            int way = policy.victim(0, i, ALL_WAYS);
+            ASSERT_EQ(way, i);
+            policy.fill(0, way, pc);
+        }
+    }
+
+    TEST(Replacement, LRU)
+    {
+        LRUReplacement<1, 4> lru;
+        lru.reset();
+        fill_set(lru, 4);
+
+        /* Oldest is way 0, after touching it way 1 is */
+        ASSERT_EQ(lru.victim(0, -1, ALL_WAYS), 0);
+        lru.hit(0, 0);
+        ASSERT_EQ(lru.victim(0, -1, ALL_WAYS), 1);
+        lru.hit(0, 1);
+        lru.hit(0, 2);
+        ASSERT_EQ(lru.victim(0, -1, ALL_WAYS), 3);
+    }
+
+    TEST(Replacement, TreePLRU)
+    {
+        PLRUReplacement<1, 4> plru;
+        plru.reset();
+        fill_set(plru, 4);
+
+        /* Last touched way 3, victim must be in the left half */
+        ASSERT_EQ(plru.victim(0, -1, ALL_WAYS), 0);
+        plru.hit(0, 0);
+        ASSERT_EQ(plru.victim(0, -1, ALL_WAYS), 2);
+        plru.hit(0, 2);
+        ASSERT_EQ(plru.victim(0, -1, ALL_WAYS), 1);
+    }
+
+    TEST(Replacement, SRRIPScanResistance)
+    {
+        SRRIPReplacement<1, 4> rrip;
+        rrip.reset();
+        fill_set(rrip, 4);
+
+        /* Reused lines survive a scan twice the size of the rest */
+        rrip.hit(0, 0);
+        rrip.hit(0, 1);
+
+        foreach (i, 4) {
+            int way = rrip.victim(0, -1, ALL_WAYS);
+            ASSERT_NE(way, 0);
+            ASSERT_NE(way, 1);
+            rrip.fill(0, way, 0);
+        }
+    }
+
+    TEST(Replacement, DRRIPSetDueling)
+    {
+        typedef DRRIPReplacement<128, 4> Policy;
+        Policy drrip;
+        drrip.reset();
+
+        int start = drrip.psel;
+
+        /* Misses in SRRIP leader sets make followers use BRRIP */
+        foreach (i, 64) {
+            drrip.fill(0, 0, 0);
+        }
+        ASSERT_GT(drrip.psel, start);
+        ASSERT_EQ(Policy::set_type(2), (int)Policy::FOLLOWER);
+
+        int distant = 0;
+        foreach (i, 64) {
+            distant += drrip.fill(2, 0, 0);
+        }
+        ASSERT_GT(distant, 32);
+
+        /* And misses in BRRIP leader sets bring them back to SRRIP */
+        foreach (i, 256) {
+            drrip.fill(1, 0, 0);
+        }
+        ASSERT_LT(drrip.psel, start);
+        ASSERT_FALSE(drrip.fill(2, 0, 0));
+    }
+
+    TEST(Replacement, WayMask)
+    {
+        const bitvec<4> upper(0xc);
+
+        NRUReplacement<1, 4> nru;
+        nru.reset();
+        fill_set(nru, 4);
+        foreach (i, 8) {
+            int way = nru.victim(0, -1, upper);
+            ASSERT_GE(way, 2);
+            nru.fill(0, way, 0);
+        }
+
+        LRUReplacement<1, 4> lru;
+        lru.reset();
+        fill_set(lru, 4);
+        ASSERT_EQ(lru.victim(0, -1, upper), 2);
+
+        PLRUReplacement<1, 4> plru;
+        plru.reset();
+        fill_set(plru, 4);
+        ASSERT_EQ(plru.victim(0, -1, upper), 2);
+        plru.hit(0, 2);
+        ASSERT_EQ(plru.victim(0, -1, upper), 3);
+        ASSERT_EQ(plru.victim(0, -1, bitvec<4>(0x2)), 1);
+
+        SRRIPReplacement<1, 4> rrip;
+        rrip.reset();
+        fill_set(rrip, 4);
+        ASSERT_GE(rrip.victim(0, -1, upper), 2);
+    }
+
+    TEST(Replacement, SHiPLearnsDeadSignature)
+    {
+        SHiPReplacement<1, 4> ship;
+        ship.reset();
+
+        W64 dead_pc = 0x401000;
+        W64 live_pc = 0x402000;
+
+        /* Lines of 'dead_pc' are never reused */
+        foreach (i, 8) {
+            int way = ship.victim(0, -1, ALL_WAYS);
+            ship.evict(0, way);
+            ship.fill(0, way, dead_pc);
+        }
+        foreach (j, 4) ship.evict(0, j);
+
+        ASSERT_TRUE(ship.fill(0, 0, dead_pc));
+        ASSERT_FALSE(ship.fill(0, 1, live_pc));
+
+        ship.hit(0, 1);
+        ship.evict(0, 1);
+        ASSERT_FALSE(ship.fill(0, 1, live_pc));
+    }
+
+    TEST(Replacement, SHiPTouchDoesNotTrain)
+    {
+        SHiPReplacement<1, 4> ship;
+        ship.reset();
+
+        W64 pc = 0x403000;
+        W16 sig = SHiPReplacement<1, 4>::signature_of(pc);
+        W8 before = ship.shct[sig];
+
+        /* Insert of a present line renews it but is not a reuse */
+        ship.fill(0, 0, pc);
+        ship.rrpv[0][0] = SRRIPReplacement<1, 4>::RRPV_MAX;
+        ship.touch(0, 0);
+        ASSERT_EQ(ship.rrpv[0][0], 0);
+        ASSERT_EQ(ship.shct[sig], before);
+        ASSERT_FALSE(ship.outcome[0][0]);
+
+        ship.hit(0, 0);
+        ASSERT_EQ(ship.shct[sig], before + 1);
+    }
+};
@@ -0,0 +1,136 @@
+#include <gtest/gtest.h>
+
+#define DISABLE_ASSERT
+#include <ptlsim.h>
+#include <sampler.h>
+
+#include <fstream>
+
+namespace {
+
+    const char *SAMPLE_TEST_FILE = "/tmp/marss-sample-test.prf";
+
+    /* Sampling options, config fields other tests use are left alone */
+    struct SamplerHarness {
+        PTLsimConfig options;
+
+        SamplerHarness(const char *events, W64 period, W64 buffer)
+        {
+            options.sample_file = SAMPLE_TEST_FILE;
+            options.sample_events = events;
+            options.sample_period = period;
+            options.sample_buffer = buffer;
+        }
+
+        ~SamplerHarness()
+        {
+            /* Back to the options of the simulator */
+            sampler_configure(config);
+            unlink(SAMPLE_TEST_FILE);
+        }
+    };
+
+    TEST(Sampler, ParseEvents)
+    {
+        ASSERT_EQ(sampler_parse_events("uops"), (1 << SAMPLE_UOPS));
+        ASSERT_EQ(sampler_parse_events("l2-miss,tlb-miss"),
+                (1 << SAMPLE_L2_MISS) | (1 << SAMPLE_TLB_MISS));
+        ASSERT_EQ(sampler_parse_events("branch-miss,uops,branch-miss"),
+                (1 << SAMPLE_UOPS) | (1 << SAMPLE_BRANCH_MISS));
+
+        /* Empty names are skipped */
+        ASSERT_EQ(sampler_parse_events(""), 0);
+        ASSERT_EQ(sampler_parse_events("uops,"), (1 << SAMPLE_UOPS));
+
+        /* Any unknown name fails the whole list */
+        ASSERT_EQ(sampler_parse_events("uops,cycles"), -1);
+        ASSERT_EQ(sampler_parse_events("cycles,uops"), -1);
+    }
+
+    TEST(Sampler, CountdownTick)
+    {
+        SamplerHarness h("uops,branch-miss", 3, 4);
+        ASSERT_TRUE(sampler_configure(h.options));
+
+        SampleCountdown countdown;
+        ASSERT_TRUE(countdown.enabled);
+
+        /* Every third event is sampled */
+        foreach (i, 9) {
+            ASSERT_EQ(countdown.tick(SAMPLE_UOPS), (i % 3) == 2);
+        }
+
+        /* Events count down separately, others are never sampled */
+        ASSERT_FALSE(countdown.tick(SAMPLE_BRANCH_MISS));
+        ASSERT_FALSE(countdown.tick(SAMPLE_UOPS));
+        ASSERT_FALSE(countdown.tick(SAMPLE_BRANCH_MISS));
+        ASSERT_TRUE(countdown.tick(SAMPLE_BRANCH_MISS));
+        foreach (i, 10) {
+            ASSERT_FALSE(countdown.tick(SAMPLE_L2_MISS));
+        }
+
+        /* Rejected options leave the countdowns and config as they were */
+        PTLsimConfig bad = h.options;
+        bad.sample_events = "uops,cycles";
+        bad.sample_period = 7;
+        ASSERT_FALSE(sampler_configure(bad));
+        ASSERT_STREQ(bad.sample_events.buf, "uops,branch-miss");
+        ASSERT_EQ(bad.sample_period, 3);
+        ASSERT_FALSE(countdown.tick(SAMPLE_UOPS));
+        ASSERT_TRUE(countdown.tick(SAMPLE_UOPS));
+
+        /* New options restart every countdown */
+        h.options.sample_period = 2;
+        ASSERT_TRUE(sampler_configure(h.options));
+        ASSERT_FALSE(countdown.tick(SAMPLE_UOPS));
+        ASSERT_TRUE(countdown.tick(SAMPLE_UOPS));
+
+        /* No sample file turns sampling off */
+        h.options.sample_file.reset();
+        ASSERT_TRUE(sampler_configure(h.options));
+        ASSERT_FALSE(countdown.enabled);
+        foreach (i, 4) {
+            ASSERT_FALSE(countdown.tick(SAMPLE_UOPS));
+        }
+    }
+
+    TEST(Sampler, BufferFlush)
+    {
+        SamplerHarness h("l2-miss", 10, 4);
+        ASSERT_TRUE(sampler_configure(h.options));
+
+        /* Buffer fills once and starts over */
+        foreach (i, 6) {
+            SampleRecord record;
+            memset(&record, 0, sizeof(record));
+            record.cycle = 100 + i;
+            record.event = SAMPLE_L2_MISS;
+            sampler_record(record);
+        }
+        sampler_flush();
+
+        ifstream is(SAMPLE_TEST_FILE, std::ios::binary);
+        ASSERT_TRUE(is.good());
+
+        SampleFileHeader header;
+        is.read((char*)&header, sizeof(header));
+        ASSERT_EQ(memcmp(header.magic, SAMPLE_FILE_MAGIC, 8), 0);
+        ASSERT_EQ(header.version, SAMPLE_FILE_VERSION);
+        ASSERT_EQ(header.record_size, sizeof(SampleRecord));
+        ASSERT_EQ(header.period, 10);
+        ASSERT_EQ(header.events, (1 << SAMPLE_L2_MISS));
+
+        foreach (i, 6) {
+            SampleRecord record;
+            is.read((char*)&record, sizeof(record));
+            ASSERT_TRUE(is.good());
+            ASSERT_EQ(record.cycle, 100 + i);
+        }
+
+        /* Flush leaves nothing behind to write twice */
+        sampler_flush();
+        SampleRecord extra;
+        is.read((char*)&extra, sizeof(extra));
+        ASSERT_FALSE(is.good());
+    }
+};
@@ -0,0 +1,244 @@
+#include <gtest/gtest.h>
+
+#define DISABLE_ASSERT
+#include <ptlsim.h>
+#include <memoryHierarchy.h>
+#include <machine.h>
+#include <sliceMap.h>
+#include <mesh.h>
+
+using namespace Memory;
+using namespace Memory::MeshInterconnect;
+
+namespace {
+
+    const int LINE_BITS = 6;
+    const int SLICES = 4;
+
+    /* Controller that counts the requests ejected to it */
+    class SliceTestCont : public Controller
+    {
+        public:
+            int received;
+            W64 last_address;
+
+            SliceTestCont(W8 idx, const char *name, MemoryHierarchy *mem)
+                : Controller(idx, name, mem)
+                  , received(0)
+                  , last_address(-1)
+            {}
+
+            bool handle_interconnect_cb(void *arg)
+            {
+                Message *msg = (Message*)arg;
+                received++;
+                last_address = msg->request->get_physical_address();
+                return true;
+            }
+
+            void register_interconnect(Interconnect *interconnect,
+                    int conn_type) {}
+            void print_map(ostream& os) {}
+            void print(ostream& os) const {}
+            bool is_full(bool fromInterconnect = false) const { return false; }
+            void annul_request(MemoryRequest *request) {}
+            void dump_configuration(YAML::Emitter &out) const {}
+    };
+
+    TEST(Slice, ModHash)
+    {
+        SliceMap map(SLICES, SLICE_HASH_MOD, 0, 0, LINE_BITS);
+
+        /* Consecutive lines go round robin, offset in line is ignored */
+        foreach (i, 16) {
+            ASSERT_EQ(map.slice_of((i << LINE_BITS) + 8), i % SLICES);
+        }
+
+        /* Lines 'SLICES' apart all land on one slice */
+        foreach (i, 16) {
+            ASSERT_EQ(map.slice_of((i * SLICES) << LINE_BITS), 0);
+        }
+    }
+
+    TEST(Slice, XorHash)
+    {
+        SliceMap map(SLICES, SLICE_HASH_XOR, 0, 0, LINE_BITS);
+        int count[SLICES] = {0};
+
+        /* Below the first folded bit it is the same as mod */
+        foreach (i, 128) {
+            ASSERT_EQ(map.slice_of(i << LINE_BITS), i % SLICES);
+        }
+
+        /* Aligned blocks of lines are spread evenly */
+        foreach (i, 4096) {
+            count[map.slice_of((W64)i << LINE_BITS)]++;
+        }
+        foreach (i, SLICES) {
+            ASSERT_EQ(count[i], 4096 / SLICES);
+        }
+
+        /* Lines that 'mod' puts on one slice use all of them */
+        foreach (i, SLICES) {
+            count[i] = 0;
+        }
+        foreach (i, 1024) {
+            count[map.slice_of(((W64)i * SLICES) << LINE_BITS)]++;
+        }
+        foreach (i, SLICES) {
+            ASSERT_EQ(count[i], 1024 / SLICES);
+        }
+    }
+
+    TEST(Slice, Hops)
+    {
+        /* 2x2 tiles, core n sits on tile n % 4 */
+        SliceMap map(SLICES, SLICE_HASH_XOR, 3, 0, LINE_BITS);
+
+        ASSERT_EQ(map.hops(0, 0), 0);
+        ASSERT_EQ(map.hops(0, 1), 1);
+        ASSERT_EQ(map.hops(0, 3), 2);
+        ASSERT_EQ(map.hops(1, 2), 2);
+        ASSERT_EQ(map.hops(5, 1), 0);
+        ASSERT_EQ(map.hop_latency(2, 1), 6);
+
+        /* One row of tiles */
+        SliceMap row(SLICES, SLICE_HASH_XOR, 1, 4, LINE_BITS);
+        ASSERT_EQ(row.hops(0, 3), 3);
+    }
+
+    /* Requester and slices on a 1x5 mesh, slices listed out of order */
+    struct SliceHarness {
+        BaseMachine *machine;
+        MemoryHierarchy *mem;
+        Mesh *mesh;
+        SliceTestCont *requester;
+        dynarray<Controller*> slices;
+        SliceMap *map;
+        MemoryRequest requests[16];
+
+        SliceHarness(const char *name)
+        {
+            machine = (BaseMachine*)PTLsimMachine::getmachine("base");
+            machine->set_default_stats(user_stats);
+            mem = new MemoryHierarchy(*machine);
+
+            stringbuf mesh_name;
+            mesh_name << name << "_mesh";
+            machine->add_option(mesh_name.buf, "rows", 1);
+            mesh = new Mesh(mesh_name.buf, mem);
+
+            stringbuf req_name;
+            req_name << name << "_L2";
+            requester = new SliceTestCont(0, req_name.buf, mem);
+            mesh->register_controller(requester);
+
+            W8 order[SLICES] = {2, 0, 3, 1};
+            foreach (i, SLICES) {
+                stringbuf slice_name;
+                slice_name << name << "_L3_" << order[i];
+                machine->add_option(slice_name.buf, "slices", SLICES);
+                SliceTestCont *slice = new SliceTestCont(order[i],
+                        slice_name.buf, mem);
+                mesh->register_controller(slice);
+                slices.push(slice);
+            }
+
+            map = SliceMap::create_lower(*machine, slices, LINE_BITS);
+            sim_cycle = 0;
+        }
+
+        ~SliceHarness()
+        {
+            delete mesh;
+            delete map;
+            delete requester;
+            foreach (i, slices.count()) {
+                delete slices[i];
+            }
+            sim_cycle = 0;
+        }
+
+        /* Send a read of 'address' to the slice that owns it */
+        bool send(int n, W64 address)
+        {
+            MemoryRequest &request = requests[n];
+            Message msg;
+
+            request.init(0, 0, address, 0, sim_cycle, false, 0, 0,
+                    MEMORY_OP_READ);
+
+            msg.init();
+            msg.sender = requester;
+            msg.dest = slices[map->slice_of(address)];
+            msg.request = &request;
+
+            return mesh->controller_request_cb(&msg);
+        }
+
+        void run(int cycles)
+        {
+            foreach (i, cycles) {
+                sim_cycle++;
+                mesh->tick_cb(NULL);
+            }
+        }
+
+        SliceTestCont *slice(int n) {
+            return (SliceTestCont*)slices[n];
+        }
+    };
+
+    TEST(Slice, LowerSlicesBySliceId)
+    {
+        SliceHarness h("slice_test_order");
+
+        ASSERT_TRUE(h.map != NULL);
+        ASSERT_EQ(h.map->count(), SLICES);
+        foreach (i, SLICES) {
+            ASSERT_EQ(h.slices[i]->idx, i);
+        }
+
+        /* A single controller below is not sliced */
+        dynarray<Controller*> single;
+        single.push(h.requester);
+        ASSERT_TRUE(SliceMap::create_lower(*h.machine, single,
+                    LINE_BITS) == NULL);
+    }
+
+    TEST(Slice, RequestsReachOnlyTheOwner)
+    {
+        SliceHarness h("slice_test_route");
+        W64 addresses[8];
+
+        /* Lines 128 apart, the xor hash puts two on each slice */
+        foreach (i, 8) {
+            addresses[i] = (W64)(i * 128 + 0x10000) << LINE_BITS;
+        }
+
+        foreach (i, 8) {
+            int owner = h.map->slice_of(addresses[i]);
+            int before = h.slice(owner)->received;
+            int others = 0;
+            foreach (j, SLICES) {
+                if (j != owner)
+                    others += h.slice(j)->received;
+            }
+
+            ASSERT_TRUE(h.send(i, addresses[i]));
+            h.run(40);
+
+            ASSERT_EQ(h.slice(owner)->received, before + 1);
+            ASSERT_EQ(h.slice(owner)->last_address, addresses[i]);
+            foreach (j, SLICES) {
+                if (j != owner)
+                    others -= h.slice(j)->received;
+            }
+            ASSERT_EQ(others, 0);
+        }
+
+        foreach (i, SLICES) {
+            ASSERT_EQ(h.slice(i)->received, 2);
+        }
+    }
+};
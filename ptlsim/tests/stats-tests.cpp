@@ -5,6 +5,7 @@
 #define DISABLE_ASSERT
 #include <ptlsim.h>
 #include <statsBuilder.h>
+#include <bson/bson.h>
 
 #include <sstream>
 #define reset_stream(os) { os.str(""); }
@@ -318,4 +319,347 @@ namespace {
 
 		ASSERT_EQ(ct1_val, 10);
 	}
+
+    TEST(Stats, Snapshot) {
+        StatsBuilder &builder = StatsBuilder::get();
+        builder.delete_nodes();
+        user_stats->reset();
+
+        TestStat st;
+        st.ct1.set_default_stats(user_stats);
+        st.ct1 += 5;
+
+        StatsSnapshot *snap1 = builder.capture_snapshot(user_stats, "s1", 100);
+        ASSERT_GT(snap1->page_count(), 0);
+        ASSERT_EQ(snap1->new_page_count(), snap1->page_count());
+
+        /* Nothing changed, all pages are shared */
+        StatsSnapshot *snap2 = builder.capture_snapshot(user_stats, "s2", 200);
+        ASSERT_EQ(snap2->new_page_count(), 0);
+        ASSERT_EQ(snap2->changed_pages(*snap1), 0);
+
+        st.ct1++;
+        StatsSnapshot *snap3 = builder.capture_snapshot(user_stats, "s3", 300);
+        ASSERT_EQ(snap3->new_page_count(), 1);
+        ASSERT_EQ(snap3->changed_pages(*snap1), 1);
+
+        Stats *stats = builder.get_new_stats();
+        snap2->restore(*stats);
+        ASSERT_EQ(st.ct1(stats), 5);
+        snap3->restore(*stats);
+        ASSERT_EQ(st.ct1(stats), 6);
+        ASSERT_STREQ(snap3->get_name(), "s3");
+        ASSERT_EQ(snap3->get_cycle(), 300);
+        builder.destroy_stats(stats);
+    }
+
+    TEST(Stats, SnapshotDirtyPages) {
+        StatsBuilder &builder = StatsBuilder::get();
+        builder.delete_nodes();
+        user_stats->reset();
+
+        TestStat st;
+        StatArray<W64, 1024> big("big", &st);
+        st.set_default_stats(user_stats);
+        st.ct1 += 5;
+        W64 *raw = &st.ct1(user_stats);
+        builder.capture_snapshot(user_stats, "d1", 100);
+
+        /* Written back to the same value, compared and shared */
+        st.ct1++;
+        st.ct1--;
+        StatsSnapshot *snap2 = builder.capture_snapshot(user_stats, "d2", 200);
+        ASSERT_EQ(snap2->new_page_count(), 0);
+
+        /* Pages no counter wrote are not compared */
+        *raw += 1;
+        StatsSnapshot *snap3 = builder.capture_snapshot(user_stats, "d3", 300);
+        ASSERT_EQ(snap3->new_page_count(), 0);
+        *raw -= 1;
+
+        /* Stats arrays and strings mark their pages too */
+        big[1000]++;
+        StatsSnapshot *snap4 = builder.capture_snapshot(user_stats, "d4", 400);
+        ASSERT_EQ(snap4->new_page_count(), 1);
+
+        st.st1.set(user_stats, "tag");
+        StatsSnapshot *snap5 = builder.capture_snapshot(user_stats, "d5", 500);
+        ASSERT_EQ(snap5->new_page_count(), 1);
+    }
+
+    TEST(Stats, SnapshotLimit) {
+        StatsBuilder &builder = StatsBuilder::get();
+        builder.delete_nodes();
+        user_stats->reset();
+
+        TestStat st;
+        st.ct1.set_default_stats(user_stats);
+        builder.set_snapshot_limit(2);
+
+        W64 taken = builder.get_snapshots_taken();
+        foreach (i, 3) {
+            W64 value = i;
+            st.ct1 = value;
+            builder.capture_snapshot(user_stats, i == 0 ? "l0" :
+                    (i == 1 ? "l1" : "l2"), i);
+        }
+
+        /* Oldest are dropped, pages they shared stay with the others */
+        ASSERT_EQ(builder.snapshot_count(), 2);
+        ASSERT_EQ(builder.get_snapshots_taken(), taken + 3);
+        ASSERT_STREQ(builder.get_snapshot(0)->get_name(), "l1");
+
+        Stats *stats = builder.get_new_stats();
+        builder.get_snapshot(0)->restore(*stats);
+        ASSERT_EQ(st.ct1(stats), 1);
+        builder.get_snapshot(1)->restore(*stats);
+        ASSERT_EQ(st.ct1(stats), 2);
+        builder.destroy_stats(stats);
+
+        builder.set_snapshot_limit(0);
+    }
+
+    TEST(Stats, RestoreDefaultStats) {
+        StatsBuilder &builder = StatsBuilder::get();
+        builder.delete_nodes();
+
+        TestStat st;
+        st.set_default_stats(user_stats);
+        st.ct2.set_default_stats(kernel_stats);
+
+        dynarray<Stats*> defaults;
+        builder.save_default_stats(defaults);
+
+        /* Dumping makes the dumped Stats the default of every counter */
+        ostringstream os;
+        builder.dump(global_stats, os);
+        ASSERT_TRUE(st.ct1.get_default_stats() == global_stats);
+
+        builder.restore_default_stats(defaults);
+        ASSERT_TRUE(st.get_default_stats() == user_stats);
+        ASSERT_TRUE(st.ct1.get_default_stats() == user_stats);
+        ASSERT_TRUE(st.ct2.get_default_stats() == kernel_stats);
+
+        /* Counters write through the restored default again */
+        st.ct2(kernel_stats) = 0;
+        st.ct2++;
+        ASSERT_EQ(st.ct2(kernel_stats), 1);
+    }
+
+    /* One cycle of an idle core */
+    void idle_cycle(TestStat &st)
+    {
+        st.ct1 += 3;
+        st.ct3++;
+        st.arr1[2] += 2;
+    }
+
+    TEST(Stats, DeltaMatchesEveryCycle) {
+        StatsBuilder &builder = StatsBuilder::get();
+        builder.delete_nodes();
+
+        TestStat st;
+        Statable other("other");
+        StatObj<W64> busy("busy", &other);
+        Stats *run = builder.get_new_stats();
+        Stats *slept = builder.get_new_stats();
+        W64 start = 7;
+
+        foreach (i, 2) {
+            Stats *stats = (i == 0) ? run : slept;
+            st.set_default_stats(stats);
+            busy.set_default_stats(stats);
+            st.ct1 = start;
+        }
+
+        /* Run 1 + 1000 + 37 cycles one by one */
+        st.set_default_stats(run);
+        foreach (i, 1 + 1000 + 37) {
+            idle_cycle(st);
+        }
+
+        /* Record the first one, add the others in two flushes */
+        StatsDelta delta(&st);
+        st.set_default_stats(slept);
+        delta.begin(*slept);
+        idle_cycle(st);
+        busy++;
+        delta.end(*slept);
+        delta.add(*slept, 1000);
+        delta.add(*slept, 37);
+        delta.add(*slept, 0);
+
+        ASSERT_EQ(st.ct1(slept), st.ct1(run));
+        ASSERT_EQ(st.ct3(slept), st.ct3(run));
+        ASSERT_EQ(st.arr1(slept)[2], st.arr1(run)[2]);
+        ASSERT_EQ(st.ct1(slept), start + 3 * 1038);
+
+        /* Only the recorded subtree is repeated */
+        ASSERT_EQ(busy(slept), 1);
+
+        builder.destroy_stats(run);
+        builder.destroy_stats(slept);
+    }
+
+    TEST(Stats, StreamWriter) {
+        StatsBuilder &builder = StatsBuilder::get();
+        builder.delete_nodes();
+        user_stats->reset();
+
+        TestStat st;
+        st.ct1.set_default_stats(user_stats);
+        st.ct1 += 3;
+        st.st1.set(user_stats, "a b");
+
+        ostringstream os;
+        StatsWriter *writer = StatsWriter::create("json", os);
+        ASSERT_TRUE(writer != NULL);
+        builder.dump(user_stats, *writer);
+        delete writer;
+
+        ASSERT_STREQ(os.str().c_str(), "{\"test\":{\"arr1\":[0,0,0,0,0,0,0,0,0,0],"
+                "\"ct1\":3,\"ct2\":0,\"ct3\":0,\"st1\":\"a b\",\"st2\":\"\","
+                "\"sum\":3,\"div\":0,\"time_arr\":[0,0,0]}}\n");
+
+        reset_stream(os);
+        writer = StatsWriter::create("yaml", os);
+        builder.dump(user_stats, *writer);
+        delete writer;
+
+        ASSERT_STREQ(os.str().c_str(), "---\ntest:\n  arr1: [0, 0, 0, 0, 0, 0, 0, 0, 0, 0]\n"
+                "  ct1: 3\n  ct2: 0\n  ct3: 0\n  st1: \"a b\"\n  st2: \"\"\n"
+                "  sum: 3\n  div: 0\n  time_arr: [0, 0, 0]\n");
+
+        ASSERT_TRUE(StatsWriter::create("xml", os) == NULL);
+    }
+
+    TEST(Stats, BSONWriter) {
+        StatsBuilder &builder = StatsBuilder::get();
+        builder.delete_nodes();
+        user_stats->reset();
+
+        TestStat st;
+        st.ct1.set_default_stats(user_stats);
+        st.ct1 += 7;
+        st.div.set_default_stats(user_stats);
+
+        /* Two documents back to back, each with its own length */
+        ostringstream os;
+        StatsWriter *writer = StatsWriter::create("bson", os);
+        builder.dump(user_stats, *writer);
+        st.ct1 += 1;
+        builder.dump(user_stats, *writer);
+        delete writer;
+
+        std::string out = os.str();
+        bson doc, test;
+        bson_iterator it;
+
+        bson_init(&doc, (char*)out.data(), 0);
+        int size = bson_size(&doc);
+        ASSERT_LT(size, (int)out.size());
+        ASSERT_EQ(out[size - 1], 0);
+
+        ASSERT_EQ(bson_find(&it, &doc, "test"), bson_object);
+        bson_iterator_subobject(&it, &test);
+        ASSERT_EQ(bson_find(&it, &test, "ct1"), bson_long);
+        ASSERT_EQ(bson_iterator_long(&it), 7);
+
+        bson_init(&doc, (char*)out.data() + size, 0);
+        ASSERT_EQ(size + bson_size(&doc), (int)out.size());
+        ASSERT_EQ(bson_find(&it, &doc, "test"), bson_object);
+        bson_iterator_subobject(&it, &test);
+        ASSERT_EQ(bson_find(&it, &test, "ct1"), bson_long);
+        ASSERT_EQ(bson_iterator_long(&it), 8);
+        ASSERT_EQ(bson_find(&it, &test, "arr1"), bson_array);
+    }
+
+    TEST(Stats, WriterDoublePrecision) {
+        ostringstream os;
+        StatsWriter *writer = StatsWriter::create("yaml", os);
+        writer->begin_document();
+        writer->begin_map(NULL);
+        writer->value("third", 1.0 / 3);
+        writer->value("big", (W64)18446744073709551615ULL);
+        writer->end_map();
+        writer->end_document();
+        delete writer;
+
+        ASSERT_STREQ(os.str().c_str(), "---\nthird: 0.33333333333333331\n"
+                "big: 18446744073709551615\n");
+    }
+
+    const char* outcome_names[] = {"taken", "not_taken"};
+
+    TEST(Stats, FindStats) {
+        StatsBuilder &builder = StatsBuilder::get();
+        builder.delete_nodes();
+        user_stats->reset();
+
+        TestStat st;
+        StatArray<W64, 2> outcome("outcome", &st, outcome_names);
+        st.ct1.set_default_stats(user_stats);
+        st.ct2.set_default_stats(user_stats);
+        outcome.set_default_stats(user_stats);
+        st.ct1 += 2;
+        st.ct2 += 3;
+        outcome[1] += 4;
+
+        dynarray<StatRef> refs;
+        ASSERT_EQ(builder.find_stats("test.ct*", refs), 3);
+        W64 sum = 0;
+        foreach (i, refs.size()) {
+            sum += refs[i].obj->get_value(user_stats, refs[i].index);
+        }
+        ASSERT_EQ(sum, 5);
+
+        refs.clear();
+        ASSERT_EQ(builder.find_stats("test.outcome.not_taken", refs), 1);
+        ASSERT_EQ(refs[0].obj->get_value(user_stats, refs[0].index), 4);
+
+        refs.clear();
+        ASSERT_EQ(builder.find_stats("*.outcome", refs), 1);
+        ASSERT_EQ(refs[0].obj->get_value(user_stats, refs[0].index), 4);
+
+        refs.clear();
+        ASSERT_EQ(builder.find_stats("test.outcome.maybe", refs), 0);
+        ASSERT_EQ(builder.find_stats("other.ct1", refs), 0);
+    }
+
+    TEST(Stats, Region) {
+        StatsBuilder &builder = StatsBuilder::get();
+        builder.delete_nodes();
+        user_stats->reset();
+
+        TestStat st;
+        st.ct1.set_default_stats(user_stats);
+
+        Stats *start = builder.get_new_stats();
+        Stats *delta = builder.get_new_stats();
+
+        StatsRegion *region = builder.get_region("loop");
+        ASSERT_EQ(builder.get_region("loop"), region);
+
+        /* Two executions of the region with work outside of it */
+        foreach (i, 2) {
+            st.ct1 += 10;
+
+            start->reset();
+            *start += *user_stats;
+            st.ct1 += 3;
+
+            delta->reset();
+            *delta += *user_stats;
+            builder.sub_stats(*delta, *start);
+            region->add(*delta, 100);
+        }
+
+        ASSERT_EQ(st.ct1(region->get_stats()), 6);
+        ASSERT_EQ(region->get_entries(), 2);
+        ASSERT_EQ(region->get_cycles(), 200);
+        ASSERT_STREQ(region->get_name(), "loop");
+
+        builder.destroy_stats(start);
+        builder.destroy_stats(delta);
+    }
 };
@@ -0,0 +1,284 @@
+#include <gtest/gtest.h>
+
+#define DISABLE_ASSERT
+#include <ptlsim.h>
+#include <memoryHierarchy.h>
+#include <cacheLines.h>
+#include <dynamicCacheLines.h>
+#include <uarch-checkpoint.h>
+#include <partition.h>
+#include <machine.h>
+
+using namespace Memory;
+
+namespace {
+
+    const int LINE = 64;
+    const char *SIGNATURE = "test:1:0";
+
+    typedef CacheLines<16, 4, LINE, 2, REPL_LRU> LRULines;
+
+    void fill(CacheLinesBase &lines, W64 address, W8 state)
+    {
+        MemoryRequest request;
+        W64 oldTag = -1;
+
+        request.init(0, 0, address, 0, 0, false, 0, 0, MEMORY_OP_READ);
+        CacheLine *line = lines.insert(&request, oldTag);
+        line->init(lines.tagOf(address));
+        line->state = state;
+    }
+
+    /* Tag replaced by a fill of 'address' */
+    W64 victim_of(CacheLinesBase &lines, W64 address)
+    {
+        MemoryRequest request;
+        W64 oldTag = -1;
+
+        request.init(0, 0, address, 0, 0, false, 0, 0, MEMORY_OP_READ);
+        lines.insert(&request, oldTag);
+        return oldTag;
+    }
+
+    /* Four lines in set 0 with ascending age, two in set 1 */
+    void warm(CacheLinesBase &lines)
+    {
+        foreach (i, 4) {
+            fill(lines, i * 16 * LINE, i + 1);
+        }
+        fill(lines, LINE, 1);
+        fill(lines, 17 * LINE, 2);
+    }
+
+    void save(CacheLinesBase &lines, const char *filename)
+    {
+        UarchStateWriter writer;
+
+        ASSERT_TRUE(writer.open(filename, SIGNATURE));
+        writer.begin_section("cache");
+        lines.save_state(writer);
+        writer.end_section();
+        writer.close();
+    }
+
+    bool restore(CacheLinesBase &lines, const char *filename)
+    {
+        UarchStateReader reader;
+
+        if (!reader.open(filename, SIGNATURE))
+            return false;
+        if (!reader.find_section("cache"))
+            return false;
+        return lines.restore_state(reader);
+    }
+
+    TEST(UarchCheckpoint, RoundTrip)
+    {
+        const char *filename = "/tmp/marss-uarch-test.chk";
+        LRULines saved(2, 2), restored(2, 2);
+
+        saved.init();
+        restored.init();
+        warm(saved);
+        save(saved, filename);
+
+        ASSERT_TRUE(restore(restored, filename));
+
+        foreach (i, 4) {
+            CacheLine *line = restored.peek(i * 16 * LINE);
+            ASSERT_TRUE(line != NULL);
+            ASSERT_EQ(line->state, i + 1);
+            ASSERT_TRUE(line->data == NULL);
+        }
+        ASSERT_EQ(restored.peek(17 * LINE)->state, 2);
+
+        /* Replacement state came along: same victims in both caches */
+        foreach (i, 4) {
+            W64 address = (i + 4) * 16 * LINE;
+            ASSERT_EQ(victim_of(restored, address),
+                    victim_of(saved, address));
+        }
+
+        unlink(filename);
+    }
+
+    TEST(UarchCheckpoint, DynamicLinesShareFormat)
+    {
+        const char *filename = "/tmp/marss-uarch-test-dyn.chk";
+        LRULines saved(2, 2);
+        DynamicCacheLines restored(16, 4, LINE, 2, REPL_LRU, 2, 2);
+
+        saved.init();
+        restored.init();
+        warm(saved);
+        save(saved, filename);
+
+        ASSERT_TRUE(restore(restored, filename));
+        foreach (i, 4) {
+            ASSERT_EQ(restored.peek(i * 16 * LINE)->state, i + 1);
+        }
+        ASSERT_EQ(victim_of(restored, 8 * 16 * LINE),
+                victim_of(saved, 8 * 16 * LINE));
+
+        unlink(filename);
+    }
+
+    TEST(UarchCheckpoint, MismatchLeavesCacheUntouched)
+    {
+        const char *filename = "/tmp/marss-uarch-test-bad.chk";
+        LRULines saved(2, 2);
+        CacheLines<32, 4, LINE, 2, REPL_LRU> other(2, 2);
+        LRULines truncated(2, 2);
+
+        saved.init();
+        other.init();
+        truncated.init();
+        warm(saved);
+        fill(other, 5 * LINE, 3);
+        fill(truncated, 5 * LINE, 3);
+
+        /* Different geometry */
+        save(saved, filename);
+        ASSERT_FALSE(restore(other, filename));
+        ASSERT_EQ(other.peek(5 * LINE)->state, 3);
+        ASSERT_TRUE(other.peek(0) == NULL);
+
+        /* Section ends in the middle of the lines */
+        {
+            UarchStateWriter writer;
+            ASSERT_TRUE(writer.open(filename, SIGNATURE));
+            writer.begin_section("cache");
+            writer.put((W32)16);
+            writer.put((W32)4);
+            writer.put((W32)LINE);
+            writer.put((W32)REPL_LRU);
+            writer.put((W64)0);
+            writer.put((W64)0);
+            writer.put((W8)1);
+            writer.end_section();
+        }
+        ASSERT_FALSE(restore(truncated, filename));
+        ASSERT_EQ(truncated.peek(5 * LINE)->state, 3);
+        ASSERT_TRUE(truncated.peek(0) == NULL);
+
+        /* Other machine */
+        save(saved, filename);
+        UarchStateReader reader;
+        ASSERT_FALSE(reader.open(filename, "test:2:0"));
+
+        unlink(filename);
+    }
+
+    TEST(UarchCheckpoint, Partition)
+    {
+        const char *filename = "/tmp/marss-uarch-test-part.chk";
+        const char *names[3] = {"chk_part_saved", "chk_part_restored",
+            "chk_part_other"};
+        BaseMachine &machine = *(BaseMachine*)PTLsimMachine::getmachine(
+                "base");
+        Statable parent0("chk_part_test0"), parent1("chk_part_test1"),
+                 parent2("chk_part_test2");
+
+        parent0.set_default_stats(user_stats);
+        parent1.set_default_stats(user_stats);
+        parent2.set_default_stats(user_stats);
+
+        foreach (i, 2) {
+            machine.add_option(names[i], "partition", "ucp");
+            machine.add_option(names[i], "cos_count", 2);
+            machine.add_option(names[i], "ucp_sample_sets", 4);
+            machine.add_option(names[i], "ucp_interval", 1000);
+        }
+        machine.add_option(names[0], "core_cos", "1");
+        machine.add_option(names[2], "partition", "static");
+
+        sim_cycle = 0;
+        WayPartition *saved = WayPartition::create(machine, names[0],
+                &parent0, 16, 4);
+        WayPartition *restored = WayPartition::create(machine, names[1],
+                &parent1, 16, 4);
+        WayPartition *other = WayPartition::create(machine, names[2],
+                &parent2, 16, 8);
+
+        /* Core 0 is in cos 1 and reuses 3 lines of a sampled set */
+        foreach (i, 4) {
+            foreach (j, 3) {
+                saved->access(0, 0, j, i > 0, false);
+            }
+        }
+        saved->fill(0, 0, 0, false);
+        saved->fill(0, 0, 1, false);
+        saved->fill(0, 5, 2, false);
+        ASSERT_TRUE(WayPartition::command(
+                    "chk_part_saved:cos0=0x1,chk_part_saved:cos1=0xe"));
+
+        {
+            UarchStateWriter writer;
+            ASSERT_TRUE(writer.open(filename, SIGNATURE));
+            writer.begin_section("partition");
+            saved->save_state(writer);
+            writer.end_section();
+        }
+
+        UarchStateReader reader;
+        ASSERT_TRUE(reader.open(filename, SIGNATURE));
+
+        /* Other geometry is rejected */
+        ASSERT_TRUE(reader.find_section("partition"));
+        ASSERT_FALSE(other->restore_state(reader));
+        ASSERT_EQ(other->occupancy(1), 0);
+
+        ASSERT_TRUE(reader.find_section("partition"));
+        ASSERT_TRUE(restored->restore_state(reader));
+        ASSERT_EQ(restored->cos_of(0), 1);
+        ASSERT_EQ(restored->alloc_mask(0), 0xe);
+        ASSERT_EQ(restored->occupancy(1), 3);
+        ASSERT_EQ(restored->occupancy(0), 0);
+
+        /* Monitors came along: next repartition gives the same masks,
+         * cos 1 wins 3 ways with its hits */
+        sim_cycle = 1000;
+        saved->access(0, 1, 99, false, false);
+        restored->access(0, 1, 99, false, false);
+        ASSERT_EQ(restored->alloc_mask(0), saved->alloc_mask(0));
+        ASSERT_EQ(restored->alloc_mask(0), 0xe);
+
+        sim_cycle = 0;
+        delete saved;
+        delete restored;
+        delete other;
+        unlink(filename);
+    }
+
+    TEST(UarchCheckpoint, Bits)
+    {
+        const char *filename = "/tmp/marss-uarch-test-bits.chk";
+        bitvec<12> saved, restored;
+        bitvec<8> narrow;
+
+        saved = 0;
+        saved[0] = 1;
+        saved[9] = 1;
+        saved[11] = 1;
+
+        {
+            UarchStateWriter writer;
+            ASSERT_TRUE(writer.open(filename, SIGNATURE));
+            writer.begin_section("bits");
+            writer.put_bits(saved);
+            writer.put_bits(saved);
+            writer.end_section();
+        }
+
+        UarchStateReader reader;
+        ASSERT_TRUE(reader.open(filename, SIGNATURE));
+        ASSERT_TRUE(reader.find_section("bits"));
+        ASSERT_TRUE(reader.get_bits(restored));
+        ASSERT_TRUE(restored == saved);
+
+        /* Width is checked */
+        ASSERT_FALSE(reader.get_bits(narrow));
+
+        unlink(filename);
+    }
+};
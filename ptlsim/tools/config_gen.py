@@ -148,15 +148,26 @@ machine_core_option_add = '''
 '''
 
 cache_typedef_cacheline = '''
-typedef CacheLines<%s, %s, %s, %s> %sCacheLines;
+typedef CacheLines<%s, %s, %s, %s, %s> %sCacheLines;
 
 '''
 
+repl_policies = ("nru", "lru", "plru", "srrip", "drrip", "ship")
+
+# Policies supported by caches with 'GEOMETRY: runtime'
+runtime_repl_policies = ("nru", "lru", "srrip")
+
 cache_case_stmt = '''
         case %s:
             return new %s(%s_READ_PORTS, %s_WRITE_PORTS);
 '''
 
+cache_case_stmt_runtime = '''
+        case %s:
+            return new DynamicCacheLines(%sSETS, %sASSOC, %sLINE_SIZE,
+                    %sLATENCY, %sREPLACEMENT, %sREAD_PORTS, %sWRITE_PORTS);
+'''
+
 cache_line_func = '''
 namespace Memory {
     struct CacheLinesBase;
@@ -688,9 +699,28 @@ def generate_cache_logic(config, options):
         of.write("#include <memoryHierarchy.h>\n")
         of.write("#include <memoryRequest.h>\n")
         of.write("#include <cacheLines.h>\n")
+        of.write("#include <dynamicCacheLines.h>\n")
         of.write("\nnamespace Memory {\n\n")
         typedefs = {}
+        runtime = {}
         for cache, cfg in config["cache"].items():
+            # Replacement policy names map to REPL_* ids in replacement.h
+            repl = cfg["params"].get("REPLACEMENT", "nru")
+            assert repl in repl_policies, \
+                    "Unknown replacement policy %s for cache %s" % (repl,
+                            cache)
+            cfg["params"]["REPLACEMENT"] = "REPL_" + repl.upper()
+
+            # 'static' geometry is compiled in CacheLines, 'runtime' can
+            # be changed with -cache-geometry without rebuilding
+            geometry = cfg["params"].pop("GEOMETRY", "static")
+            assert geometry in ("static", "runtime"), \
+                    "Unknown geometry %s for cache %s" % (geometry, cache)
+            runtime[cache] = (geometry == "runtime")
+            assert not runtime[cache] or repl in runtime_repl_policies, \
+                    "Replacement policy %s of cache %s needs static geometry" \
+                    % (repl, cache)
+
             # First write all params
             for param,val in cfg["params"].items():
                 of.write("#define %s_%s %s\n" % (cache.upper(), param,
@@ -698,6 +728,10 @@ def generate_cache_logic(config, options):
             # Find the number of sets
             size = get_cache_size(cfg["params"]["SIZE"])
             assoc = cfg["params"]["ASSOC"]
+            assert repl != "plru" or (assoc > 0 and
+                    (assoc & (assoc - 1)) == 0), \
+                    "Replacement policy plru of cache %s needs a power of " \
+                    "two ASSOC" % cache
             l_size = cfg["params"]["LINE_SIZE"]
             lat = cfg["params"]["LATENCY"]
             sets = (size / l_size) / assoc
@@ -706,12 +740,16 @@ def generate_cache_logic(config, options):
             of.write("#define %s_%s %d\n" % (cache.upper(), "SETS",
                 sets))
 
+            if runtime[cache]:
+                continue
+
             # Now write typedef CacheLine
             of.write(cache_typedef_cacheline % (
                 c_pfx + "SETS",
                 c_pfx + "ASSOC",
                 c_pfx + "LINE_SIZE",
                 c_pfx + "LATENCY",
+                c_pfx + "REPLACEMENT",
                 c_pfx))
 
             typedefs[cache] = c_pfx + "CacheLines"
@@ -721,6 +759,11 @@ def generate_cache_logic(config, options):
         of.write("{\n")
         of.write("\tswitch(cache_type) {\n")
         for cache in config["cache"].keys():
+            if runtime[cache]:
+                c_pfx = cache.upper() + "_"
+                of.write(cache_case_stmt_runtime % ((cache.upper(),) +
+                    (c_pfx,) * 7))
+                continue
             of.write(cache_case_stmt % (cache.upper(),
                 typedefs[cache], cache.upper(), cache.upper()))
         of.write("\t\tdefault: assert(0);\n\t}\n")
@@ -430,4 +430,83 @@ static inline void ptlcall_log(const char* log)
 
 #endif // PTLCALLS_USERSPACE
 
+//
+// Read simulated performance counters. Each counter sums the stats
+// counters matching a pattern (see StatsBuilder::find_stats), over all
+// cores and both user and kernel mode. Counters are programmed with
+// these events at startup and can be reprogrammed with any pattern;
+// pattern "sim_cycle" counts simulated cycles.
+//
+// In simulation mode the counters can also be read with RDPMC using
+// PTLSIM_RDPMC_BASE + counter in %ecx, from any privilege level, and
+// by the kernel with RDMSR of PTLSIM_PMU_MSR_BASE + counter. In native
+// mode these instructions behave as on QEMU, use PTLCALL_PMU instead.
+//
+// Patterns, and region names below, longer than PTLCALL_MAX_STRING bytes
+// are rejected with -EINVAL.
+//
+#define PTLCALL_PMU 6
+
+#define PTLCALL_MAX_STRING    256
+
+#define PTLCALL_PMU_READ      0
+#define PTLCALL_PMU_PROGRAM   1
+
+#define PTLSIM_PMU_CYCLES         0
+#define PTLSIM_PMU_INSNS          1
+#define PTLSIM_PMU_UOPS           2
+#define PTLSIM_PMU_BRANCH_MISSES  3
+#define PTLSIM_PMU_L1I_MISSES     4
+#define PTLSIM_PMU_L1D_MISSES     5
+#define PTLSIM_PMU_L2_MISSES      6
+#define PTLSIM_PMU_L3_MISSES      7
+#define PTLSIM_PMU_COUNTERS       8
+
+#define PTLSIM_RDPMC_BASE     0x20000000
+#define PTLSIM_PMU_MSR_BASE   0x4d540000
+
+#ifdef PTLCALLS_USERSPACE
+
+static inline W64 ptlcall_pmu_read(int counter) {
+  return ptlcall(PTLCALL_PMU, PTLCALL_PMU_READ, counter, 0, 0, 0, 0);
+}
+
+static inline W64 ptlcall_pmu_program(int counter, const char* pattern) {
+  return ptlcall(PTLCALL_PMU, PTLCALL_PMU_PROGRAM, counter, (W64)pattern,
+          strlen(pattern), 0, 0);
+}
+
+static inline W64 ptlcall_rdpmc(int counter) {
+  W32 lo, hi;
+  asm volatile("rdpmc" : "=a" (lo), "=d" (hi) : "c" (PTLSIM_RDPMC_BASE + counter));
+  return ((W64)lo) | (((W64)hi) << 32);
+}
+
+#endif // PTLCALLS_USERSPACE
+
+//
+// Named regions of interest. Stats of all executions of a region, from
+// begin to the matching end, are summed and dumped as 'roi.<name>'
+// next to the user, kernel and total stats. Regions can be nested, an
+// outer region includes the stats of its inner regions.
+//
+#define PTLCALL_ROI 7
+
+#define PTLCALL_ROI_BEGIN   0
+#define PTLCALL_ROI_END     1
+
+#ifdef PTLCALLS_USERSPACE
+
+static inline W64 ptlcall_roi_begin(const char* name) {
+  return ptlcall(PTLCALL_ROI, PTLCALL_ROI_BEGIN, (W64)name, strlen(name),
+          0, 0, 0);
+}
+
+static inline W64 ptlcall_roi_end(const char* name) {
+  return ptlcall(PTLCALL_ROI, PTLCALL_ROI_END, (W64)name, strlen(name),
+          0, 0, 0);
+}
+
+#endif // PTLCALLS_USERSPACE
+
 #endif // __PTLCALLS_H__
@@ -0,0 +1,538 @@
+/*
+ *
+ * PTLsim: Cycle Accurate x86-64 Simulator
+ * Decoder for AVX/AVX2 (VEX encoded) instructions
+ *
+ * Each YMM register is four 64-bit lanes: the two xmml/xmmh registers of
+ * its low half and the ymmhl/ymmhh registers of its high half. 256-bit
+ * instructions are split into one uop per lane, exactly like the SSE
+ * decoder splits 128-bit instructions in two, so no new uops are needed.
+ * VEX.128 instructions clear the upper lanes of their destination.
+ *
+ */
+
+#include <decode.h>
+
+/*
+ * Find the registers holding each 64-bit lane of a vector source, loading
+ * memory operands into consecutive temporaries starting at tempbase.
+ */
+void TraceDecoder::avx_source_lanes(DecodedOperand ra, int* lanes, int count, int datatype, int tempbase) {
+  if (ra.type == OPTYPE_MEM) {
+    foreach (i, count) {
+      operand_load(tempbase + i, ra, OP_ld, datatype);
+      ra.mem.offset += 8;
+      lanes[i] = tempbase + i;
+    }
+  } else {
+    int reg = arch_pseudo_reg_to_arch_reg[ra.reg.reg];
+    foreach (i, count) lanes[i] = ymm_lane_reg(reg, i);
+  }
+}
+
+void TraceDecoder::avx_zero_upper(int rdreg) {
+  this << TransOp(OP_mov, ymm_lane_reg(rdreg, 2), REG_zero, REG_zero, REG_zero, 3);
+  this << TransOp(OP_mov, ymm_lane_reg(rdreg, 3), REG_zero, REG_zero, REG_zero, 3);
+}
+
+bool assist_vzeroupper(Context& ctx) {
+  int count = (ctx.use64) ? 16 : 8;
+  foreach (i, count) {
+    ctx.ymmh_regs[i]._q[0] = 0;
+    ctx.ymmh_regs[i]._q[1] = 0;
+  }
+  ctx.eip = ctx.reg_nextrip;
+  return true;
+}
+
+bool assist_vzeroall(Context& ctx) {
+  int count = (ctx.use64) ? 16 : 8;
+  foreach (i, count) {
+    ctx.xmm_regs[i]._q[0] = 0;
+    ctx.xmm_regs[i]._q[1] = 0;
+  }
+  return assist_vzeroupper(ctx);
+}
+
+/*
+ * Opcodes are (map << 12) | op, where map is 1 for 0f, 2 for 0f38 and
+ * 3 for 0f3a and op uses the same 0x2xx-0x5xx classes as decode_sse().
+ * Anything not listed here raises #UD, as on a CPU without it.
+ */
+bool TraceDecoder::decode_avx() {
+  DecodedOperand rd;
+  DecodedOperand ra;
+
+  is_sse = 1;
+
+  int lanes = (vex_l) ? 4 : 2;
+  int vreg = REG_xmml0 + (vex_reg * 2);
+
+  switch ((vex_map << 12) | op) {
+
+    /*
+     * Floating point arithmetic: vXXXss, vXXXps, vXXXsd, vXXXpd
+     */
+
+  case 0x1251 ... 0x1253:
+  case 0x1258 ... 0x1259:
+  case 0x125c ... 0x125f:
+  case 0x12c2:
+  case 0x1351 ... 0x1359:
+  case 0x135c ... 0x135f:
+  case 0x13c2:
+  case 0x1451:
+  case 0x1458 ... 0x1459:
+  case 0x145c ... 0x145f:
+  case 0x14c2:
+  case 0x1551:
+  case 0x1554 ... 0x1559:
+  case 0x155c ... 0x155f:
+  case 0x15c2: {
+    DECODE(gform, rd, x_mode);
+    DECODE(eform, ra, x_mode);
+
+    bool cmp = (lowbits(op, 8) == 0xc2);
+    DecodedOperand imm;
+    imm.imm.imm = 0;
+    if (cmp) {
+      DECODE(iform, imm, b_mode);
+      /*
+       * Predicates 16-23 only differ from 0-7 in signaling on QNaNs,
+       * which is masked anyway; 8-15 and 24-31 have no SSE equivalent.
+       */
+      if (bit(imm.imm.imm, 3)) MakeInvalid();
+    }
+
+    EndOfDecode();
+
+    byte sizetype = (op >> 8) - 2;
+    bool packed = bit(sizetype, 0);
+    int uop = (cmp) ? OP_fcmp : sse_float_opcode_to_uop[lowbits(op, 4)];
+    int datatype = sse_float_datatype_to_ptl_datatype[sizetype];
+    int count = (packed) ? lanes : 1;
+
+    int rdreg = arch_pseudo_reg_to_arch_reg[rd.reg.reg];
+    int rb[4];
+
+    if ((op >> 8) == 0x2) ra.mem.size = 2;
+    avx_source_lanes(ra, rb, count, datatype);
+
+    /* Zero idiom: vxorps/vxorpd with both sources the same register */
+    if unlikely ((uop == OP_xor) && (ra.type == OPTYPE_REG) && (rb[0] == vreg)) {
+      foreach (i, 4) this << TransOp(OP_xor, ymm_lane_reg(rdreg, i), REG_zero, REG_zero, REG_zero, 3);
+      break;
+    }
+
+    foreach (i, count) {
+      TransOp transop(uop, ymm_lane_reg(rdreg, i), ymm_lane_reg(vreg, i), rb[i], REG_zero, isclass(uop, OPCLASS_LOGIC) ? 3 : sizetype);
+      transop.cond = lowbits(imm.imm.imm, 3);
+      transop.datatype = datatype;
+      this << transop;
+    }
+
+    /* Scalar forms take bits 64-127 from the first source */
+    if ((!packed) && (rdreg != vreg))
+      this << TransOp(OP_mov, rdreg+1, REG_zero, vreg+1, REG_zero, 3);
+
+    if (count < 4) avx_zero_upper(rdreg);
+    break;
+  }
+
+    /*
+     * Integer arithmetic (AVX2 for 256-bit), same table as decode_sse()
+     */
+
+  case 0x15d1 ... 0x15d5:
+  case 0x15d8 ... 0x15df:
+  case 0x15e0 ... 0x15e5:
+  case 0x15e8 ... 0x15ef:
+  case 0x15f1 ... 0x15f6:
+  case 0x15f8 ... 0x15fe: {
+    DECODE(gform, rd, x_mode);
+    DECODE(eform, ra, x_mode);
+    EndOfDecode();
+
+    int uop = sse_int_opcode_to_uop[bits(op, 4, 4) - 0xd][lowbits(op, 4)];
+    int sizeshift = sse_int_opcode_to_sizeshift[bits(op, 4, 4) - 0xd][lowbits(op, 4)];
+    bool isshift = (uop == OP_vshr) | (uop == OP_vsar) | (uop == OP_vshl);
+
+    assert(uop != OP_nop);
+
+    int rdreg = arch_pseudo_reg_to_arch_reg[rd.reg.reg];
+    int rb[4];
+
+    avx_source_lanes(ra, rb, (isshift) ? 1 : lanes, DATATYPE_VEC_128BIT);
+
+    if unlikely ((uop == OP_xor) && (ra.type == OPTYPE_REG) && (rb[0] == vreg)) {
+      foreach (i, 4) this << TransOp(OP_xor, ymm_lane_reg(rdreg, i), REG_zero, REG_zero, REG_zero, 3);
+      break;
+    }
+
+    /* Every lane shifts by the low 64 bits of the count, which rd may overwrite */
+    if (isshift && (ra.type == OPTYPE_REG)) {
+      this << TransOp(OP_mov, REG_temp0, REG_zero, rb[0], REG_zero, 3);
+      rb[0] = REG_temp0;
+    }
+
+    foreach (i, lanes) {
+      this << TransOp(uop, ymm_lane_reg(rdreg, i), ymm_lane_reg(vreg, i), (isshift) ? rb[0] : rb[i], REG_zero, sizeshift);
+    }
+
+    if (lanes < 4) avx_zero_upper(rdreg);
+    break;
+  }
+
+  case 0x1564 ... 0x1566: /* vpcmpgtX */
+  case 0x1574 ... 0x1576: { /* vpcmpeqX */
+    DECODE(gform, rd, x_mode);
+    DECODE(eform, ra, x_mode);
+    EndOfDecode();
+
+    int cond = (bits(op, 4, 4) == 0x6) ? COND_nle : COND_e;
+    int sizeshift = lowbits(op, 2);
+
+    int rdreg = arch_pseudo_reg_to_arch_reg[rd.reg.reg];
+    int rb[4];
+
+    avx_source_lanes(ra, rb, lanes, DATATYPE_VEC_128BIT);
+
+    foreach (i, lanes) {
+      TransOp transop(OP_vcmp, ymm_lane_reg(rdreg, i), ymm_lane_reg(vreg, i), rb[i], REG_zero, sizeshift);
+      transop.cond = cond;
+      this << transop;
+    }
+
+    if (lanes < 4) avx_zero_upper(rdreg);
+    break;
+  }
+
+  case 0x1570: /* vpshufd */
+  case 0x13c6: { /* vshufps */
+    DECODE(gform, rd, x_mode);
+    DECODE(eform, ra, x_mode);
+    DecodedOperand imm;
+    DECODE(iform, imm, b_mode);
+    bool mix = (op == 0x3c6); /* low two dwords of each 128 bits come from vvvv */
+    if ((!mix) && vex_reg) MakeInvalid();
+    EndOfDecode();
+
+    int rdreg = arch_pseudo_reg_to_arch_reg[rd.reg.reg];
+    int rb[4];
+    int rv[4];
+
+    avx_source_lanes(ra, rb, lanes, (mix) ? DATATYPE_VEC_FLOAT : DATATYPE_VEC_32BIT);
+    foreach (i, lanes) rv[i] = ymm_lane_reg(vreg, i);
+
+    /* Sources are read after the first lane is written, so copy them */
+    if (ra.type == OPTYPE_REG) {
+      foreach (i, lanes) this << TransOp(OP_mov, REG_temp0 + i, REG_zero, rb[i], REG_zero, 3);
+      foreach (i, lanes) rb[i] = REG_temp0 + i;
+    }
+    if (mix && (vreg == rdreg)) {
+      foreach (i, lanes) this << TransOp(OP_mov, REG_temp4 + i, REG_zero, rv[i], REG_zero, 3);
+      foreach (i, lanes) rv[i] = REG_temp4 + i;
+    }
+
+    int base0 = bits(imm.imm.imm, 0*2, 2) * 4;
+    int base1 = bits(imm.imm.imm, 1*2, 2) * 4;
+    int base2 = bits(imm.imm.imm, 2*2, 2) * 4;
+    int base3 = bits(imm.imm.imm, 3*2, 2) * 4;
+
+    for (int i = 0; i < lanes; i += 2) {
+      int* lo = (mix) ? rv : rb;
+      this << TransOp(OP_permb, ymm_lane_reg(rdreg, i+0), lo[i], lo[i+1], REG_imm, 3, 0, PermbControlInfo(base1+3, base1+2, base1+1, base1+0, base0+3, base0+2, base0+1, base0+0));
+      this << TransOp(OP_permb, ymm_lane_reg(rdreg, i+1), rb[i], rb[i+1], REG_imm, 3, 0, PermbControlInfo(base3+3, base3+2, base3+1, base3+0, base2+3, base2+2, base2+1, base2+0));
+    }
+
+    if (lanes < 4) avx_zero_upper(rdreg);
+    break;
+  }
+
+    /*
+     * Moves
+     */
+
+  case 0x1328: /* vmovaps load */
+  case 0x1528: /* vmovapd load */
+  case 0x1310: /* vmovups load */
+  case 0x1510: /* vmovupd load */
+  case 0x156f: /* vmovdqa load */
+  case 0x126f: { /* vmovdqu load */
+    DECODE(gform, rd, x_mode);
+    DECODE(eform, ra, x_mode);
+    if (vex_reg) MakeInvalid();
+    EndOfDecode();
+
+    int rdreg = arch_pseudo_reg_to_arch_reg[rd.reg.reg];
+    int datatype = sse_float_datatype_to_ptl_datatype[(op >> 8) - 2];
+
+    if (ra.type == OPTYPE_MEM) {
+      foreach (i, lanes) {
+        operand_load(ymm_lane_reg(rdreg, i), ra, OP_ld, datatype);
+        ra.mem.offset += 8;
+      }
+    } else {
+      int rareg = arch_pseudo_reg_to_arch_reg[ra.reg.reg];
+      foreach (i, lanes) {
+        TransOp transop(OP_mov, ymm_lane_reg(rdreg, i), REG_zero, ymm_lane_reg(rareg, i), REG_zero, 3);
+        transop.datatype = datatype;
+        this << transop;
+      }
+    }
+
+    if (lanes < 4) avx_zero_upper(rdreg);
+    break;
+  }
+
+  case 0x1329: /* vmovaps store */
+  case 0x1529: /* vmovapd store */
+  case 0x1311: /* vmovups store */
+  case 0x1511: /* vmovupd store */
+  case 0x157f: /* vmovdqa store */
+  case 0x127f: /* vmovdqu store */
+  case 0x15e7: /* vmovntdq store */
+  case 0x152b: /* vmovntpd store */
+  case 0x132b: { /* vmovntps store */
+    DECODE(eform, rd, x_mode);
+    DECODE(gform, ra, x_mode);
+    if (vex_reg) MakeInvalid();
+    EndOfDecode();
+
+    int rareg = arch_pseudo_reg_to_arch_reg[ra.reg.reg];
+    int datatype = sse_float_datatype_to_ptl_datatype[(op >> 8) - 2];
+
+    if (rd.type == OPTYPE_MEM) {
+      foreach (i, lanes) {
+        result_store(ymm_lane_reg(rareg, i), REG_temp0 + i, rd, datatype);
+        rd.mem.offset += 8;
+      }
+    } else {
+      int rdreg = arch_pseudo_reg_to_arch_reg[rd.reg.reg];
+      foreach (i, lanes) {
+        TransOp transop(OP_mov, ymm_lane_reg(rdreg, i), REG_zero, ymm_lane_reg(rareg, i), REG_zero, 3);
+        transop.datatype = datatype;
+        this << transop;
+      }
+      if (lanes < 4) avx_zero_upper(rdreg);
+    }
+    break;
+  }
+
+  case 0x1210: /* vmovss load or merge */
+  case 0x1410: /* vmovsd load or merge */
+  case 0x1211: /* vmovss store or merge */
+  case 0x1411: { /* vmovsd store or merge */
+    bool store = bit(op, 0);
+    if (store) {
+      DECODE(eform, rd, x_mode);
+      DECODE(gform, ra, x_mode);
+    } else {
+      DECODE(gform, rd, x_mode);
+      DECODE(eform, ra, x_mode);
+    }
+    DecodedOperand& mem = (store) ? rd : ra;
+    if ((mem.type == OPTYPE_MEM) && vex_reg) MakeInvalid();
+    EndOfDecode();
+
+    int datatype = sse_float_datatype_to_ptl_datatype[(op >> 8) - 2];
+    bool isdouble = ((op >> 8) == 0x4);
+
+    if (mem.type == OPTYPE_MEM) {
+      mem.mem.size = (isdouble) ? 3 : 2;
+      if (store) {
+        result_store(arch_pseudo_reg_to_arch_reg[ra.reg.reg], REG_temp0, rd, datatype);
+      } else {
+        int rdreg = arch_pseudo_reg_to_arch_reg[rd.reg.reg];
+        operand_load(rdreg+0, ra, OP_ld, datatype);
+        this << TransOp(OP_mov, rdreg+1, REG_zero, REG_zero, REG_zero, 3);
+        avx_zero_upper(rdreg);
+      }
+      break;
+    }
+
+    /* Register form: low element from the ModRM source, the rest from vvvv */
+    int rdreg = arch_pseudo_reg_to_arch_reg[rd.reg.reg];
+    int rareg = arch_pseudo_reg_to_arch_reg[ra.reg.reg];
+
+    if (isdouble) {
+      TransOp transop(OP_mov, rdreg, REG_zero, rareg, REG_zero, 3); transop.datatype = datatype; this << transop;
+    } else {
+      TransOp transop(OP_maskb, rdreg, vreg, rareg, REG_imm, 3, 0, MaskControlInfo(0, 32, 0)); transop.datatype = datatype; this << transop;
+    }
+    if (rdreg != vreg)
+      this << TransOp(OP_mov, rdreg+1, REG_zero, vreg+1, REG_zero, 3);
+    avx_zero_upper(rdreg);
+    break;
+  }
+
+  case 0x1377: { /* vzeroupper, vzeroall */
+    if (vex_reg) MakeInvalid();
+    EndOfDecode();
+    microcode_assist((vex_l) ? ASSIST_VZEROALL : ASSIST_VZEROUPPER, ripstart, rip);
+    end_of_block = 1;
+    break;
+  }
+
+    /*
+     * Broadcasts (0f38)
+     */
+
+  case 0x2518: /* vbroadcastss */
+  case 0x2558: /* vpbroadcastd */
+  case 0x2519: /* vbroadcastsd */
+  case 0x2559: { /* vpbroadcastq */
+    DECODE(gform, rd, x_mode);
+    DECODE(eform, ra, x_mode);
+    bool isquad = bit(op, 0);
+    if (vex_reg) MakeInvalid();
+    /* vbroadcastsd only exists as 256-bit */
+    if ((op == 0x519) && (!vex_l)) MakeInvalid();
+    EndOfDecode();
+
+    int rdreg = arch_pseudo_reg_to_arch_reg[rd.reg.reg];
+    int datatype = (isquad) ? DATATYPE_VEC_DOUBLE : DATATYPE_VEC_FLOAT;
+    int src;
+
+    if (ra.type == OPTYPE_MEM) {
+      ra.mem.size = (isquad) ? 3 : 2;
+      operand_load(REG_temp0, ra, OP_ld, datatype);
+      src = REG_temp0;
+    } else {
+      src = arch_pseudo_reg_to_arch_reg[ra.reg.reg];
+    }
+
+    if (isquad) {
+      this << TransOp(OP_mov, REG_temp1, REG_zero, src, REG_zero, 3);
+    } else {
+      this << TransOp(OP_permb, REG_temp1, src, src, REG_imm, 3, 0, PermbControlInfo(3, 2, 1, 0, 3, 2, 1, 0));
+    }
+
+    foreach (i, lanes) {
+      TransOp transop(OP_mov, ymm_lane_reg(rdreg, i), REG_zero, REG_temp1, REG_zero, 3);
+      transop.datatype = datatype;
+      this << transop;
+    }
+
+    if (lanes < 4) avx_zero_upper(rdreg);
+    break;
+  }
+
+  case 0x251a: /* vbroadcastf128 */
+  case 0x255a: { /* vbroadcasti128 */
+    DECODE(gform, rd, x_mode);
+    DECODE(eform, ra, x_mode);
+    if ((ra.type != OPTYPE_MEM) || vex_reg || (!vex_l)) MakeInvalid();
+    EndOfDecode();
+
+    int rdreg = arch_pseudo_reg_to_arch_reg[rd.reg.reg];
+    int rb[2];
+
+    avx_source_lanes(ra, rb, 2, DATATYPE_VEC_128BIT);
+
+    foreach (i, 4) this << TransOp(OP_mov, ymm_lane_reg(rdreg, i), REG_zero, rb[i & 1], REG_zero, 3);
+    break;
+  }
+
+    /*
+     * 128-bit lane insert, extract and permute (0f3a)
+     */
+
+  case 0x3518: /* vinsertf128 */
+  case 0x3538: { /* vinserti128 */
+    DECODE(gform, rd, x_mode);
+    DECODE(eform, ra, x_mode);
+    DecodedOperand imm;
+    DECODE(iform, imm, b_mode);
+    if (!vex_l) MakeInvalid();
+    EndOfDecode();
+
+    int rdreg = arch_pseudo_reg_to_arch_reg[rd.reg.reg];
+    int half = bit(imm.imm.imm, 0);
+    int rb[2];
+
+    avx_source_lanes(ra, rb, 2, DATATYPE_VEC_128BIT);
+
+    /* The inserted half is written last in case it aliases rd */
+    if ((ra.type == OPTYPE_REG) && (rb[0] == rdreg) && (half == 1)) {
+      foreach (i, 2) this << TransOp(OP_mov, REG_temp0 + i, REG_zero, rb[i], REG_zero, 3);
+      foreach (i, 2) rb[i] = REG_temp0 + i;
+    }
+
+    if (rdreg != vreg) {
+      foreach (i, 2) {
+        int lane = ((!half) * 2) + i;
+        this << TransOp(OP_mov, ymm_lane_reg(rdreg, lane), REG_zero, ymm_lane_reg(vreg, lane), REG_zero, 3);
+      }
+    }
+
+    foreach (i, 2) this << TransOp(OP_mov, ymm_lane_reg(rdreg, (half * 2) + i), REG_zero, rb[i], REG_zero, 3);
+    break;
+  }
+
+  case 0x3519: /* vextractf128 */
+  case 0x3539: { /* vextracti128 */
+    DECODE(eform, rd, x_mode);
+    DECODE(gform, ra, x_mode);
+    DecodedOperand imm;
+    DECODE(iform, imm, b_mode);
+    if (vex_reg || (!vex_l)) MakeInvalid();
+    EndOfDecode();
+
+    int rareg = arch_pseudo_reg_to_arch_reg[ra.reg.reg];
+    int half = bit(imm.imm.imm, 0);
+
+    if (rd.type == OPTYPE_MEM) {
+      foreach (i, 2) {
+        result_store(ymm_lane_reg(rareg, (half * 2) + i), REG_temp0 + i, rd, DATATYPE_VEC_128BIT);
+        rd.mem.offset += 8;
+      }
+    } else {
+      int rdreg = arch_pseudo_reg_to_arch_reg[rd.reg.reg];
+      foreach (i, 2) this << TransOp(OP_mov, rdreg + i, REG_zero, ymm_lane_reg(rareg, (half * 2) + i), REG_zero, 3);
+      avx_zero_upper(rdreg);
+    }
+    break;
+  }
+
+  case 0x3506: /* vperm2f128 */
+  case 0x3546: { /* vperm2i128 */
+    DECODE(gform, rd, x_mode);
+    DECODE(eform, ra, x_mode);
+    DecodedOperand imm;
+    DECODE(iform, imm, b_mode);
+    if (!vex_l) MakeInvalid();
+    EndOfDecode();
+
+    int rdreg = arch_pseudo_reg_to_arch_reg[rd.reg.reg];
+    int src[8];
+
+    /* Copy both sources first: either may be the destination */
+    avx_source_lanes(ra, src + 4, 4, DATATYPE_VEC_128BIT, REG_temp4);
+    if (ra.type == OPTYPE_REG) {
+      foreach (i, 4) this << TransOp(OP_mov, REG_temp4 + i, REG_zero, src[4 + i], REG_zero, 3);
+    }
+    foreach (i, 4) {
+      this << TransOp(OP_mov, REG_temp0 + i, REG_zero, ymm_lane_reg(vreg, i), REG_zero, 3);
+      src[i] = REG_temp0 + i;
+      src[4 + i] = REG_temp4 + i;
+    }
+
+    foreach (half, 2) {
+      int ctl = bits(imm.imm.imm, half * 4, 4);
+      foreach (i, 2) {
+        int srcreg = (bit(ctl, 3)) ? REG_zero : src[(lowbits(ctl, 2) * 2) + i];
+        this << TransOp(OP_mov, ymm_lane_reg(rdreg, (half * 2) + i), REG_zero, srcreg, REG_zero, 3);
+      }
+    }
+    break;
+  }
+
+  default: {
+    MakeInvalid();
+    break;
+  }
+  }
+
+  return true;
+}
@@ -7,6 +7,7 @@
 //
 
 #include <decode.h>
+#include <pmu.h>
 
 // QEMU Helper functions
 extern "C" {
@@ -683,12 +684,39 @@ bool assist_wrmsr(Context& ctx) {
 
 
 bool assist_rdmsr(Context& ctx) {
+    W64 value;
+
+    // Simulated counters, see PTLSIM_PMU_MSR_BASE in ptlcalls.h
+    if (ctx.kernel_mode && pmu_rdmsr(ctx.regs[R_ECX], value)) {
+        ctx.regs[R_EAX] = LO32(value);
+        ctx.regs[R_EDX] = HI32(value);
+        ctx.eip = ctx.reg_nextrip;
+        return true;
+    }
+
     ctx.eip = ctx.reg_selfrip;
     ASSIST_IN_QEMU(helper_rdmsr);
     ctx.eip = ctx.reg_nextrip;
     return true;
 }
 
+bool assist_rdpmc(Context& ctx) {
+    W64 value;
+
+    // Simulated counters, see PTLSIM_RDPMC_BASE in ptlcalls.h
+    if (pmu_rdpmc(ctx.regs[R_ECX], value)) {
+        ctx.regs[R_EAX] = LO32(value);
+        ctx.regs[R_EDX] = HI32(value);
+        ctx.eip = ctx.reg_nextrip;
+        return true;
+    }
+
+    ctx.eip = ctx.reg_selfrip;
+    ASSIST_IN_QEMU(helper_rdpmc);
+    ctx.eip = ctx.reg_nextrip;
+    return true;
+}
+
 bool assist_write_cr0(Context& ctx) {
   ctx.eip = ctx.reg_selfrip;
   ASSIST_IN_QEMU(helper_write_crN, 0, ctx.reg_ar1);
@@ -2657,6 +2685,13 @@ bool TraceDecoder::decode_complex() {
     break;
   };
 
+  case 0x133: { // rdpmc
+    EndOfDecode();
+    microcode_assist(ASSIST_RDPMC, ripstart, rip);
+    end_of_block = 1;
+    break;
+  };
+
   case 0x130: { // wrmsr
     EndOfDecode();
     microcode_assist(ASSIST_WRMSR, ripstart, rip);
@@ -96,6 +96,9 @@ const assist_func_t assistid_to_func[ASSIST_COUNT] = {
     assist_ldmxcsr,
     assist_fxsave,
     assist_fxrstor,
+    // AVX
+    assist_vzeroupper,
+    assist_vzeroall,
     // Interrupts, system calls, etc.
     assist_int,
     assist_syscall,
@@ -170,6 +173,8 @@ const assist_func_t assistid_to_func[ASSIST_COUNT] = {
     // Halt
     assist_halt,
     assist_pause,
+    // Performance counters
+    assist_rdpmc,
 };
 
 const char* assist_names[ASSIST_COUNT] = {
@@ -221,6 +226,9 @@ const char* assist_names[ASSIST_COUNT] = {
   "ldmxcsr",
   "fxsave",
   "fxrstor",
+  // AVX
+  "vzeroupper",
+  "vzeroall",
   // Interrupts", system calls", etc.
   "int",
   "syscall",
@@ -295,6 +303,8 @@ const char* assist_names[ASSIST_COUNT] = {
   // HLT
   "halt",
   "pause",
+  // Performance counters
+  "rdpmc",
 };
 
 int assist_index(assist_func_t assist) {
@@ -662,6 +672,7 @@ void TraceDecoder::reset() {
     faultaddr = 0;
     prefixes = 0;
     rex = 0;
+    vex = 0;
     modrm = 0;
     user_insn_count = 0;
     last_flags_update_was_atomic = 0;
@@ -1633,6 +1644,49 @@ void TraceDecoder::decode_prefixes() {
     }
 }
 
+//
+// VEX prefix (AVX): C5 is the two byte form, C4 the three byte form.
+// The inverted R/X/B/W bits are folded into the REX byte so the usual
+// ModRM decoding works, vvvv names the extra (non-destructive) source
+// and pp selects the same 0x2xx-0x5xx opcode classes as the legacy
+// SSE prefixes do.
+//
+void TraceDecoder::decode_vex_prefix() {
+    byte b1 = fetch1();
+    byte b2;
+    byte map;
+
+    if (op == 0xc5) {
+        map = 1;
+        b2 = b1;
+        rex = 0x40 | ((!bit(b1, 7)) << 2);
+    } else {
+        map = lowbits(b1, 5);
+        b2 = fetch1();
+        rex = 0x40 | (bit(b2, 7) << 3) | ((!bit(b1, 7)) << 2) |
+            ((!bit(b1, 6)) << 1) | (!bit(b1, 5));
+    }
+
+    /* Only the W bit is meaningful outside of 64-bit mode */
+    if (!use64) rex = 0x40 | (rex & 0x08);
+
+    vex = 1;
+    vex_map = map;
+    vex_l = bit(b2, 2);
+    vex_reg = lowbits(~b2 >> 3, 4);
+    if (!use64) vex_reg = lowbits(vex_reg, 3);
+
+    /* Legacy SSE prefixes and REX are not allowed with VEX */
+    if (prefixes & (PFX_DATA | PFX_REPZ | PFX_REPNZ | PFX_LOCK | PFX_REX))
+        invalid = 1;
+
+    if ((map < 1) | (map > 3))
+        invalid = 1;
+
+    static const W16 pp_to_opclass[4] = {0x300, 0x500, 0x200, 0x400};
+    op = pp_to_opclass[lowbits(b2, 2)] | fetch1();
+}
+
 void TraceDecoder::split(bool after) {
     Waddr target = (after) ? rip : ripstart;
     if (!after) assert(!first_insn_in_bb());
@@ -1713,6 +1767,7 @@ bool BasicBlockCache::invalidate(BasicBlock* bb, int reason) {
     DECODERSTAT->bbcache.count = ct;
     DECODERSTAT->bbcache.invalidates[reason]++;
 
+    generation++;
     bb->free();
     return true;
 }
@@ -2168,7 +2223,16 @@ bool TraceDecoder::translate() {
     bool uses_sse = 0;
     op = fetch1();
     bool need_modrm = onebyte_has_modrm[op];
-    if (op == 0x0f) {
+    vex = 0;
+
+    /* Outside of 64-bit mode C4/C5 are LES/LDS unless ModRM.mod is 11 */
+    if unlikely (((op == 0xc4) | (op == 0xc5)) && config.avx && pe && (!vm86) &&
+            (use64 || ((insnbytes[byteoffset] >> 6) == 3))) {
+        decode_vex_prefix();
+        uses_sse = 1;
+        use_mmx = false;
+        need_modrm = (vex_map == 1) ? twobyte_has_modrm[lowbits(op, 8)] : 1;
+    } else if (op == 0x0f) {
         op = fetch1();
         need_modrm = twobyte_has_modrm[op];
 
@@ -2228,7 +2292,10 @@ bool TraceDecoder::translate() {
     }
 
 	if (setjmp(decode_jmp_buf) == 0) {
-		switch (op >> 8) {
+		if unlikely (vex) {
+			DECODERSTAT->x86_decode_type[DECODE_TYPE_SSE]++;
+			rc = decode_avx();
+		} else switch (op >> 8) {
 			case 0:
 			case 1: {
 						rc = decode_fast();
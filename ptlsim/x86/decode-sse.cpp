@@ -9,7 +9,45 @@
 
 #include <decode.h>
 
-static const byte sse_float_datatype_to_ptl_datatype[4] = {DATATYPE_FLOAT, DATATYPE_VEC_FLOAT, DATATYPE_DOUBLE, DATATYPE_VEC_DOUBLE};
+const byte sse_float_datatype_to_ptl_datatype[4] = {DATATYPE_FLOAT, DATATYPE_VEC_FLOAT, DATATYPE_DOUBLE, DATATYPE_VEC_DOUBLE};
+
+const byte sse_float_opcode_to_uop[16] = {OP_nop, OP_fsqrt, OP_frsqrt, OP_frcp, OP_and, OP_andnot, OP_or, OP_xor, OP_fadd, OP_fmul, OP_nop, OP_nop, OP_fsub, OP_fmin, OP_fdiv, OP_fmax};
+
+/*
+ * Integer SSE/MMX arithmetic, indexed by opcode 0xd0-0xff
+ */
+const byte sse_int_opcode_to_uop[3][16] = {
+/* 0x5d0: */
+/* 0        1        2        3        4          5         6         7          8           9           a          b        c           d           e          f */
+/* -------- psrlw    psrld    psrlq    paddq      pmullw    movq      pmovmskb   psubusb     psubusw     pminub     pand     paddusb     paddusw     pmaxub     pandn */
+  {0,       OP_vshr, OP_vshr, OP_vshr, OP_vadd,   OP_vmull, 0,        0,         OP_vsub_us, OP_vsub_us, OP_vmin,   OP_and,  OP_vadd_us, OP_vadd_us, OP_vmax,   OP_andnot},
+/* 0x5e0: */
+/* pavgb    psraw    psrad    pavgw    pmulhuw    pmulhw    cvttpd2dq movntdq    psubsb      psubsw      pminsw     por      paddsb      paddsw      pmaxsw     pxor */
+  {OP_vavg, OP_vsar, OP_vsar, OP_vavg, OP_vmulhu, OP_vmulh, 0,        0,         OP_vsub_ss, OP_vsub_ss, OP_vmin_s, OP_or,   OP_vadd_ss, OP_vadd_ss, OP_vmax_s, OP_xor},
+/* 0x5f0: */
+/* -------- psllw    pslld    psllq    pmuludq    pmaddwd   psadbw    maskmovdqu psubb       psubw       psubd      psubq    paddb       paddw       paddd      -------- */
+  {0,       OP_vshl, OP_vshl, OP_vshl, OP_mulhl,  OP_vmaddp,OP_vsad,  0,         OP_vsub,    OP_vsub,    OP_vsub,   OP_vsub, OP_vadd,    OP_vadd,    OP_vadd,   0},
+};
+#define B 0
+#define W 1
+#define D 2
+#define Q 3
+const byte sse_int_opcode_to_sizeshift[3][16] = {
+/* 0x5d0: */
+/* 0        1        2        3        4          5         6         7          8           9           a          b        c           d           e          f */
+/* -------- psrlw    psrld    psrlq    paddq      pmullw    movq      pmovmskb   psubusb     psubusw     pminub     pand     paddusb     paddusw     pmaxub     pandn */
+  {0,       W,       D,       Q,       Q,         W,        Q,        B,         B,          W,          B,         Q,       B,          W,          B,         Q},
+/* 0x5e0: */
+/* pavgb    psraw    psrad    pavgw    pmulhuw    pmulhw    cvttpd2dq movntdq    psubsb      psubsw      pminsw     por      paddsb      paddsw      pmaxsw     pxor */
+  {B,       W,       D,       W,       W,         W,        0,        0,         B,          W,          W,         Q,       B,          W,          W,         Q},
+/* 0x5f0: */
+/* -------- psllw    pslld    psllq    pmuludq    pmaddwd   psadbw    maskmovdqu psubb       psubw       psubd      psubq    paddb       paddw       paddd      -------- */
+  {0,       W,       D,       Q,       D,         W,        W,        0,         B,          W,          D,         Q,       B,          W,          D,         0},
+};
+#undef B
+#undef W
+#undef D
+#undef Q
 
 bool TraceDecoder::decode_sse() {
   DecodedOperand rd;
@@ -125,9 +163,7 @@ bool TraceDecoder::decode_sse() {
     byte sizetype = (op >> 8) - 2; /* put into 0x{2-5}00 -> 2-5 range, then set to 0-3 range */
     bool packed = bit(sizetype, 0);
 
-    static const byte opcode_to_uop[16] = {OP_nop, OP_fsqrt, OP_frsqrt, OP_frcp, OP_and, OP_andnot, OP_or, OP_xor, OP_fadd, OP_fmul, OP_nop, OP_nop, OP_fsub, OP_fmin, OP_fdiv, OP_fmax};
-
-    int uop = (lowbits(op, 8) == 0xc2) ? OP_fcmp : opcode_to_uop[lowbits(op, 4)];
+    int uop = (lowbits(op, 8) == 0xc2) ? OP_fcmp : sse_float_opcode_to_uop[lowbits(op, 4)];
     int datatype = sse_float_datatype_to_ptl_datatype[sizetype];
 
     int rdreg = arch_pseudo_reg_to_arch_reg[rd.reg.reg];
@@ -202,41 +238,9 @@ bool TraceDecoder::decode_sse() {
     DECODE(eform, ra, x_mode);
     EndOfDecode();
 
-    static const byte x86_opcode_to_ptl_opcode[3][16] = {
-    /* 0x5d0: */
-    /* 0        1        2        3        4          5         6         7          8           9           a          b        c           d           e          f */
-    /* -------- psrlw    psrld    psrlq    paddq      pmullw    movq      pmovmskb   psubusb     psubusw     pminub     pand     paddusb     paddusw     pmaxub     pandn */
-      {0,       OP_vshr, OP_vshr, OP_vshr, OP_vadd,   OP_vmull, 0,        0,         OP_vsub_us, OP_vsub_us, OP_vmin,   OP_and,  OP_vadd_us, OP_vadd_us, OP_vmax,   OP_andnot},
-    /* 0x5e0: */
-    /* pavgb    psraw    psrad    pavgw    pmulhuw    pmulhw    cvttpd2dq movntdq    psubsb      psubsw      pminsw     por      paddsb      paddsw      pmaxsw     pxor */
-      {OP_vavg, OP_vsar, OP_vsar, OP_vavg, OP_vmulhu, OP_vmulh, 0,        0,         OP_vsub_ss, OP_vsub_ss, OP_vmin_s, OP_or,   OP_vadd_ss, OP_vadd_ss, OP_vmax_s, OP_xor},
-    /* 0x5f0: */
-    /* -------- psllw    pslld    psllq    pmuludq    pmaddwd   psadbw    maskmovdqu psubb       psubw       psubd      psubq    paddb       paddw       paddd      -------- */
-      {0,       OP_vshl, OP_vshl, OP_vshl, OP_mulhl,  OP_vmaddp,OP_vsad,  0,         OP_vsub,    OP_vsub,    OP_vsub,   OP_vsub, OP_vadd,    OP_vadd,    OP_vadd,   0},
-    };
-#define B 0
-#define W 1
-#define D 2
-#define Q 3
-    static const byte x86_opcode_to_sizeshift[3][16] = {
-    /* 0x5d0: */
-    /* 0        1        2        3        4          5         6         7          8           9           a          b        c           d           e          f */
-    /* -------- psrlw    psrld    psrlq    paddq      pmullw    movq      pmovmskb   psubusb     psubusw     pminub     pand     paddusb     paddusw     pmaxub     pandn */
-      {0,       W,       D,       Q,       Q,         W,        Q,        B,         B,          W,          B,         Q,       B,          W,          B,         Q},
-    /* 0x5e0: */
-    /* pavgb    psraw    psrad    pavgw    pmulhuw    pmulhw    cvttpd2dq movntdq    psubsb      psubsw      pminsw     por      paddsb      paddsw      pmaxsw     pxor */
-      {B,       W,       D,       W,       W,         W,        0,        0,         B,          W,          W,         Q,       B,          W,          W,         Q},
-    /* 0x5f0: */
-    /* -------- psllw    pslld    psllq    pmuludq    pmaddwd   psadbw    maskmovdqu psubb       psubw       psubd      psubq    paddb       paddw       paddd      -------- */
-      {0,       W,       D,       Q,       D,         W,        W,        0,         B,          W,          D,         Q,       B,          W,          D,         0},
-    };
-#undef B
-#undef W
-#undef D
-#undef Q
 
-    int uop = x86_opcode_to_ptl_opcode[bits(op, 4, 4) - 0xd][lowbits(op, 4)];
-    int sizeshift = x86_opcode_to_sizeshift[bits(op, 4, 4) - 0xd][lowbits(op, 4)];
+    int uop = sse_int_opcode_to_uop[bits(op, 4, 4) - 0xd][lowbits(op, 4)];
+    int sizeshift = sse_int_opcode_to_sizeshift[bits(op, 4, 4) - 0xd][lowbits(op, 4)];
 
     assert(uop != OP_nop);
 
@@ -469,7 +473,7 @@ bool TraceDecoder::decode_sse() {
     DECODE(eform, ra, x_mode);
     EndOfDecode();
 
-    static const byte x86_opcode_to_ptl_opcode[16] = {
+    static const byte sse_int_opcode_to_uop[16] = {
     /* 0x56x: */
     /* 0          1         2         3           4         5         6         7           8           9           a          b           c           d           e          f */
     /* punpcklbw  punpcklwd punpckldq packsswb    pcmpgtb   pcmpgtw   pcmpgtd   packuswb    punpckhbw   punpckhwd   punpckhdq  packssdw    punpcklqdq  punpckhqdq  movd       movdqa */
@@ -479,7 +483,7 @@ bool TraceDecoder::decode_sse() {
 #define W 1
 #define D 2
 #define Q 3
-    static const byte x86_opcode_to_sizeshift[16] = {
+    static const byte sse_int_opcode_to_sizeshift[16] = {
     /* 0x56x: */
     /* 0          1         2         3           4         5         6         7           8           9           a          b           c           d           e          f */
     /* punpcklbw  punpcklwd punpckldq packsswb    pcmpgtb   pcmpgtw   pcmpgtd   packuswb    punpckhbw   punpckhwd   punpckhdq  packssdw    punpcklqdq  punpckhqdq  movd       movdqa */
@@ -513,8 +517,8 @@ bool TraceDecoder::decode_sse() {
 
     static const byte permute_from_high_quad[16] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 0, 0, 1, 0, 0};
 
-    int uop = x86_opcode_to_ptl_opcode[lowbits(op, 4)];
-    int sizeshift = x86_opcode_to_sizeshift[lowbits(op, 4)];
+    int uop = sse_int_opcode_to_uop[lowbits(op, 4)];
+    int sizeshift = sse_int_opcode_to_sizeshift[lowbits(op, 4)];
 
     assert(uop != OP_nop);
 
@@ -94,6 +94,16 @@ extern const char* uniform_arch_reg_names[APR_COUNT];
 
 extern const byte arch_pseudo_reg_to_arch_reg[APR_COUNT];
 
+extern const byte sse_float_datatype_to_ptl_datatype[4];
+extern const byte sse_float_opcode_to_uop[16];
+extern const byte sse_int_opcode_to_uop[3][16];
+extern const byte sse_int_opcode_to_sizeshift[3][16];
+
+/* Register holding 64-bit lane 0-3 of the YMM register whose low lane is xmmreg */
+static inline int ymm_lane_reg(int xmmreg, int lane) {
+  return (lane < 2) ? xmmreg + lane : REG_ymmhl0 + (xmmreg - REG_xmml0) + (lane - 2);
+}
+
 enum { b_mode, v_mode, w_mode, d_mode, q_mode, x_mode, dq_mode };
 
 struct ArchPseudoRegInfo {
@@ -200,6 +210,10 @@ struct TraceDecoder {
   bool addrsize_prefix;
   bool end_of_block;
   bool use_mmx;
+  bool vex;
+  byte vex_map;
+  byte vex_l;
+  byte vex_reg;
   bool is_x87;
   bool is_mmx;
   bool is_sse;
@@ -229,6 +243,7 @@ struct TraceDecoder {
 
   void reset();
   void decode_prefixes();
+  void decode_vex_prefix();
   void immediate(int rdreg, int sizeshift, W64s imm, bool issigned = true);
   void abs_code_addr_immediate(int rdreg, int sizeshift, W64 imm);
   int bias_by_segreg(int basereg);
@@ -255,8 +270,12 @@ struct TraceDecoder {
   bool decode_fast();
   bool decode_complex();
   bool decode_sse();
+  bool decode_avx();
   bool decode_x87();
 
+  void avx_source_lanes(DecodedOperand ra, int* lanes, int count, int datatype, int tempbase = REG_temp0);
+  void avx_zero_upper(int rdreg);
+
   typedef int rep_and_size_to_assist_t[3][4];
 
   bool translate();
@@ -343,6 +362,9 @@ enum {
   ASSIST_LDMXCSR,
   ASSIST_FXSAVE,
   ASSIST_FXRSTOR,
+  // AVX
+  ASSIST_VZEROUPPER,
+  ASSIST_VZEROALL,
   // Interrupts, system calls, etc.
   ASSIST_INT,
   ASSIST_SYSCALL,
@@ -417,6 +439,8 @@ enum {
   // HLT
   ASSIST_HLT,
   ASSIST_PAUSE,
+  // Simulated performance counters
+  ASSIST_RDPMC,
   ASSIST_COUNT,
 };
 
@@ -493,6 +517,9 @@ bool assist_mmx_emms(Context& ctx);
 bool assist_ldmxcsr(Context& ctx);
 bool assist_fxsave(Context& ctx);
 bool assist_fxrstor(Context& ctx);
+// AVX
+bool assist_vzeroupper(Context& ctx);
+bool assist_vzeroall(Context& ctx);
 // Interrupts, system calls, etc.
 bool assist_int(Context& ctx);
 bool assist_syscall(Context& ctx);
@@ -516,6 +543,7 @@ bool assist_popf(Context& ctx);
 bool assist_write_segreg(Context& ctx);
 bool assist_wrmsr(Context& ctx);
 bool assist_rdmsr(Context& ctx);
+bool assist_rdpmc(Context& ctx);
 bool assist_write_cr0(Context& ctx);
 bool assist_write_cr2(Context& ctx);
 bool assist_write_cr3(Context& ctx);
@@ -630,6 +658,7 @@ enum {
 struct BasicBlockCache: public SelfHashtable<RIPVirtPhys, BasicBlock, BB_CACHE_SIZE, BasicBlockHashtableLinkManager> {
   BasicBlockCache(): SelfHashtable<RIPVirtPhys, BasicBlock, BB_CACHE_SIZE, BasicBlockHashtableLinkManager>() {
       cpuid = cpuid_counter++;
+      generation = 0;
   }
 
   BasicBlock* translate(Context& ctx, const RIPVirtPhys& rvp);
@@ -645,6 +674,10 @@ struct BasicBlockCache: public SelfHashtable<RIPVirtPhys, BasicBlock, BB_CACHE_S
   W8 cpuid;
   static W8 cpuid_counter;
 
+  // Bumped whenever a basic block is freed, so pointers saved
+  // outside the cache can be checked for staleness
+  W64 generation;
+
   ostream& print(ostream& os);
 };
 
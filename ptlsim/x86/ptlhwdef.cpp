@@ -273,6 +273,11 @@ const char* arch_reg_names[TRANSREG_COUNT] = {
   "rip", "flags", "dlend", "selfrip","nextrip", "ar1", "ar2", "zero",
   // MMX
   "mmx0", "mmx1", "mmx2", "mmx3", "mmx4", "mmx5", "mmx6", "mmx7",
+  // AVX registers, upper 128 bits
+  "ymmhl0", "ymmhh0", "ymmhl1", "ymmhh1", "ymmhl2", "ymmhh2", "ymmhl3", "ymmhh3",
+  "ymmhl4", "ymmhh4", "ymmhl5", "ymmhh5", "ymmhl6", "ymmhh6", "ymmhl7", "ymmhh7",
+  "ymmhl8", "ymmhh8", "ymmhl9", "ymmhh9", "ymmhl10", "ymmhh10", "ymmhl11", "ymmhh11",
+  "ymmhl12", "ymmhh12", "ymmhl13", "ymmhh13", "ymmhl14", "ymmhh14", "ymmhl15", "ymmhh15",
   // The following are ONLY used during the translation and renaming process:
   "tr0", "tr1", "tr2", "tr3", "tr4", "tr5", "tr6", "tr7",
   "zf", "cf", "of", "imm", "mem", "tr8", "tr9", "tr10",
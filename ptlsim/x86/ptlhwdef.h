@@ -83,7 +83,7 @@ using std::map;
 //
 // Registers
 //
-#define ARCHREG_COUNT 72
+#define ARCHREG_COUNT 104
 
 #define REG_rax     0
 #define REG_rcx     1
@@ -162,25 +162,61 @@ using std::map;
 #define REG_mmx6    70
 #define REG_mmx7    71
 
+// Upper 128 bits of the YMM registers (AVX):
+
+#define REG_ymmhl0  72
+#define REG_ymmhh0  73
+#define REG_ymmhl1  74
+#define REG_ymmhh1  75
+#define REG_ymmhl2  76
+#define REG_ymmhh2  77
+#define REG_ymmhl3  78
+#define REG_ymmhh3  79
+#define REG_ymmhl4  80
+#define REG_ymmhh4  81
+#define REG_ymmhl5  82
+#define REG_ymmhh5  83
+#define REG_ymmhl6  84
+#define REG_ymmhh6  85
+#define REG_ymmhl7  86
+#define REG_ymmhh7  87
+
+#define REG_ymmhl8  88
+#define REG_ymmhh8  89
+#define REG_ymmhl9  90
+#define REG_ymmhh9  91
+#define REG_ymmhl10 92
+#define REG_ymmhh10 93
+#define REG_ymmhl11 94
+#define REG_ymmhh11 95
+#define REG_ymmhl12 96
+#define REG_ymmhh12 97
+#define REG_ymmhl13 98
+#define REG_ymmhh13 99
+#define REG_ymmhl14 100
+#define REG_ymmhh14 101
+#define REG_ymmhl15 102
+#define REG_ymmhh15 103
+
 // For renaming only:
 
-#define REG_temp0   72
-#define REG_temp1   73
-#define REG_temp2   74
-#define REG_temp3   75
-#define REG_temp4   76
-#define REG_temp5   77
-#define REG_temp6   78
-#define REG_temp7   79
-
-#define REG_zf      80
-#define REG_cf      81
-#define REG_of      82
-#define REG_imm     83
-#define REG_mem     84
-#define REG_temp8   85
-#define REG_temp9   86
-#define REG_temp10  87
+#define REG_temp0   104
+#define REG_temp1   105
+#define REG_temp2   106
+#define REG_temp3   107
+#define REG_temp4   108
+#define REG_temp5   109
+#define REG_temp6   110
+#define REG_temp7   111
+
+#define REG_zf      112
+#define REG_cf      113
+#define REG_of      114
+#define REG_imm     115
+#define REG_mem     116
+#define REG_temp8   117
+#define REG_temp9   118
+#define REG_temp10  119
 
 #define TRANSREG_COUNT (ARCHREG_COUNT+16)
 
@@ -1071,6 +1107,9 @@ struct Context: public CPUX86State {
 	  }
       else if(index <= REG_mmx7 && index >= REG_mmx0) {
           return fpregs[(index - REG_mmx0)].mmx.q;
+      }
+      else if(index <= REG_ymmhh15 && index >= REG_ymmhl0) {
+          return ymmh_regs[(index - REG_ymmhl0) / 2]._q[index % 2];
       }
 	  return invalid_reg;
   }
@@ -1143,6 +1182,9 @@ struct Context: public CPUX86State {
       else if(index <= REG_mmx7 && index >= REG_mmx0) {
           fpregs[(index - REG_mmx0)].mmx.q = value;
       }
+      else if(index <= REG_ymmhh15 && index >= REG_ymmhl0) {
+          ymmh_regs[(index - REG_ymmhl0) / 2]._q[index % 2] = value;
+      }
 
 	  return ;
   }
@@ -24,6 +24,7 @@
 #include "qemu-barrier.h"
 #ifdef MARSS_QEMU
 #include <ptl-qemu.h>
+#include "qemu-timer.h"
 #endif
 
 #if !defined(CONFIG_SOFTMMU)
@@ -246,8 +247,11 @@ int sim_cpu_exec(void)
             all_halted = 0;
             break;
         }
-    if(all_halted)
+    if(all_halted) {
+        /* sim_cycle stands still, let virtual timers catch up */
+        qemu_sim_idle_warp();
         return EXCP_HALTED;
+    }
 
 
     /* first we save global registers */
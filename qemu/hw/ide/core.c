@@ -38,8 +38,6 @@
 #include <ptl-qemu.h>
 #endif
 
-//#define MARSS_DELAY_IO
-
 static const int smart_attributes[][5] = {
     /* id,  flags, val, wrst, thrsh */
     { 0x01, 0x03, 0x64, 0x64, 0x06}, /* raw read */
@@ -402,6 +400,23 @@ static void ide_rw_error(IDEState *s) {
     ide_set_irq(s->bus);
 }
 
+#ifdef MARSS_QEMU
+/* Raise the interrupt when the simulated disk has transferred 'bytes' */
+static void ide_sim_set_irq(IDEState *s, int write, int64_t bytes)
+{
+    W64 delay = 0;
+
+    if (in_simulation)
+        delay = ptl_disk_io_delay(write, bytes);
+
+    if (delay) {
+        add_qemu_io_event((QemuIOCB)&ide_set_irq, s->bus, delay);
+    } else {
+        ide_set_irq(s->bus);
+    }
+}
+#endif
+
 void ide_sector_read(IDEState *s)
 {
     int64_t sector_num;
@@ -429,7 +444,11 @@ void ide_sector_read(IDEState *s)
             }
         }
         ide_transfer_start(s, s->io_buffer, 512 * n, ide_sector_read);
+#ifdef MARSS_QEMU
+        ide_sim_set_irq(s, 0, 512 * n);
+#else
         ide_set_irq(s->bus);
+#endif
         ide_set_sector(s, sector_num + n);
         s->nsector -= n;
     }
@@ -509,17 +528,16 @@ handle_rw_error:
         sector_num += n;
         ide_set_sector(s, sector_num);
         s->nsector -= n;
+#ifdef MARSS_QEMU
+        s->sim_dma_bytes += n * 512;
+#endif
     }
 
     /* end of transfer ? */
     if (s->nsector == 0) {
         s->status = READY_STAT | SEEK_STAT;
-#if defined MARSS_QEMU && defined MARSS_DELAY_IO
-        if (in_simulation) {
-            add_qemu_io_event((QemuIOCB)&ide_set_irq, s->bus, 20000);
-        } else {
-            ide_set_irq(s->bus);
-        }
+#ifdef MARSS_QEMU
+        ide_sim_set_irq(s, !s->is_read, s->sim_dma_bytes);
 #else
         ide_set_irq(s->bus);
 #endif
@@ -563,6 +581,9 @@ static void ide_sector_start_dma(IDEState *s, int is_read)
     s->io_buffer_index = 0;
     s->io_buffer_size = 0;
     s->is_read = is_read;
+#ifdef MARSS_QEMU
+    s->sim_dma_bytes = 0;
+#endif
     s->bus->dma->ops->start_dma(s->bus->dma, s, ide_dma_cb);
 }
 
@@ -614,7 +635,11 @@ void ide_sector_write(IDEState *s)
         qemu_mod_timer(s->sector_write_timer,
                        qemu_get_clock(vm_clock) + (get_ticks_per_sec() / 1000));
     } else {
+#ifdef MARSS_QEMU
+        ide_sim_set_irq(s, 1, 512 * n);
+#else
         ide_set_irq(s->bus);
+#endif
     }
 }
 
@@ -420,6 +420,10 @@ struct IDEState {
     /* ATA DMA state */
     int io_buffer_size;
     QEMUSGList sg;
+#ifdef MARSS_QEMU
+    /* bytes moved by current DMA command, for simulated disk timing */
+    int64_t sim_dma_bytes;
+#endif
     /* PIO transfer handling */
     int req_nb_sectors; /* number of sectors per interrupt */
     EndTransferFunc *end_transfer_func;
@@ -37,6 +37,11 @@
 #include "qemu_socket.h"
 #include "hw/qdev.h"
 
+#ifdef MARSS_QEMU
+#include "iov.h"
+#include <ptl-qemu.h>
+#endif
+
 static QTAILQ_HEAD(, VLANState) vlans;
 static QTAILQ_HEAD(, VLANClientState) non_vlan_clients;
 
@@ -524,6 +529,71 @@ void qemu_flush_queued_packets(VLANClientState *vc)
     qemu_net_queue_flush(queue);
 }
 
+#ifdef MARSS_QEMU
+/*
+ * In simulation packets are held back for their time on the simulated NIC
+ * link and sent from a simulator IO event. The sender is told the packet
+ * went out right away.
+ */
+typedef struct SimNetPacket {
+    VLANClientState *sender;
+    unsigned flags;
+    int size;
+    uint8_t data[0];
+} SimNetPacket;
+
+static int sim_net_delivering;
+
+static ssize_t qemu_send_packet_async_with_flags(VLANClientState *sender,
+                                                 unsigned flags,
+                                                 const uint8_t *buf, int size,
+                                                 NetPacketSent *sent_cb);
+
+static void sim_net_deliver(void *opaque)
+{
+    SimNetPacket *packet = opaque;
+
+    sim_net_delivering = 1;
+    qemu_send_packet_async_with_flags(packet->sender, packet->flags,
+                                      packet->data, packet->size, NULL);
+    sim_net_delivering = 0;
+
+    qemu_free(packet);
+}
+
+static int sim_net_delay(VLANClientState *sender, unsigned flags,
+                         const struct iovec *iov, int iovcnt)
+{
+    SimNetPacket *packet;
+    W64 delay;
+    size_t size = 0;
+    int i;
+
+    if (!in_simulation || sim_net_delivering) {
+        return 0;
+    }
+
+    for (i = 0; i < iovcnt; i++) {
+        size += iov[i].iov_len;
+    }
+
+    delay = ptl_net_io_delay(sender->info->type != NET_CLIENT_TYPE_NIC, size);
+    if (!delay) {
+        return 0;
+    }
+
+    packet = qemu_malloc(sizeof(SimNetPacket) + size);
+    packet->sender = sender;
+    packet->flags = flags;
+    packet->size = size;
+    iov_to_buf(iov, iovcnt, packet->data, 0, size);
+
+    add_qemu_io_event(sim_net_deliver, packet, delay);
+
+    return 1;
+}
+#endif
+
 static ssize_t qemu_send_packet_async_with_flags(VLANClientState *sender,
                                                  unsigned flags,
                                                  const uint8_t *buf, int size,
@@ -540,6 +610,16 @@ static ssize_t qemu_send_packet_async_with_flags(VLANClientState *sender,
         return size;
     }
 
+#ifdef MARSS_QEMU
+    {
+        struct iovec iov = { .iov_base = (void *)buf, .iov_len = size };
+
+        if (sim_net_delay(sender, flags, &iov, 1)) {
+            return size;
+        }
+    }
+#endif
+
     if (sender->peer) {
         queue = sender->peer->send_queue;
     } else {
@@ -661,6 +741,12 @@ ssize_t qemu_sendv_packet_async(VLANClientState *sender,
         return calc_iov_length(iov, iovcnt);
     }
 
+#ifdef MARSS_QEMU
+    if (sim_net_delay(sender, QEMU_NET_PACKET_FLAG_NONE, iov, iovcnt)) {
+        return calc_iov_length(iov, iovcnt);
+    }
+#endif
+
     if (sender->peer) {
         queue = sender->peer->send_queue;
     } else {
@@ -80,6 +80,11 @@ typedef struct TimersState {
 #ifdef MARSS_QEMU
     int64_t cpu_sim_ticks_offset;
     int64_t cpu_sim_clock_offset;
+    /* virtual time mode: rt and host clock values at sim_cycle 0 */
+    int64_t cpu_sim_rt_offset;
+    int64_t cpu_sim_host_offset;
+    /* cycles skipped while all simulated CPUs were halted */
+    int64_t cpu_sim_idle_cycles;
 #endif
 } TimersState;
 
@@ -90,7 +95,8 @@ int64_t cpu_get_ticks(void)
 {
 #ifdef MARSS_QEMU
     if(in_simulation) {
-        return timers_state.cpu_sim_ticks_offset + sim_cycle;
+        return timers_state.cpu_sim_ticks_offset + sim_cycle +
+            timers_state.cpu_sim_idle_cycles;
     }
 #endif
     if (use_icount) {
@@ -159,7 +165,31 @@ void cpu_disable_ticks(void)
 }
 
 #ifdef MARSS_QEMU
-#define freq_to_ns(freq) (1e9/freq)
+
+/* Integer conversions between simulated cycles and ns, split in seconds
+ * and remainder so long runs neither lose precision nor overflow */
+static int64_t sim_cycles_to_ns(uint64_t cycles)
+{
+    uint64_t freq = get_sim_cpu_freq();
+    uint64_t ns_per_sec = get_ticks_per_sec();
+
+    return (cycles / freq) * ns_per_sec +
+        (cycles % freq) * ns_per_sec / freq;
+}
+
+static uint64_t sim_ns_to_cycles(int64_t ns)
+{
+    uint64_t freq = get_sim_cpu_freq();
+    uint64_t ns_per_sec = get_ticks_per_sec();
+
+    return (ns / ns_per_sec) * freq + (ns % ns_per_sec) * freq / ns_per_sec;
+}
+
+/* Simulated time in ns since sim_cycle 0 */
+static int64_t cpu_get_sim_ns(void)
+{
+    return sim_cycles_to_ns(sim_cycle + timers_state.cpu_sim_idle_cycles);
+}
 
 void cpu_set_sim_ticks(void)
 {
@@ -180,10 +210,7 @@ void cpu_set_sim_ticks(void)
 
 static int64_t cpu_get_sim_clock(void)
 {
-    int64_t sim_clock_t;
-    sim_clock_t = timers_state.cpu_sim_clock_offset +
-        (int64_t)((float)(sim_cycle) * freq_to_ns(get_sim_cpu_freq()));
-    return sim_clock_t;
+    return timers_state.cpu_sim_clock_offset + cpu_get_sim_ns();
 }
 
 void qemu_take_screenshot(char *filename)
@@ -226,6 +253,12 @@ struct qemu_alarm_timer {
 
 static struct qemu_alarm_timer *alarm_timer;
 
+#ifdef MARSS_QEMU
+/* Set while simulating in virtual time mode, all clocks then follow
+ * sim_cycle and the host alarm timer is stopped */
+static int sim_virtual_clocks;
+#endif
+
 int qemu_alarm_pending(void)
 {
     return alarm_timer->pending;
@@ -559,6 +592,12 @@ int64_t qemu_get_clock(QEMUClock *clock)
 {
     switch(clock->type) {
     case QEMU_CLOCK_REALTIME:
+#ifdef MARSS_QEMU
+        if (sim_virtual_clocks) {
+            return (timers_state.cpu_sim_rt_offset + cpu_get_sim_ns()) /
+                1000000;
+        }
+#endif
         return get_clock() / 1000000;
     default:
     case QEMU_CLOCK_VIRTUAL:
@@ -573,12 +612,26 @@ int64_t qemu_get_clock(QEMUClock *clock)
             return cpu_get_clock();
         }
     case QEMU_CLOCK_HOST:
+#ifdef MARSS_QEMU
+        if (sim_virtual_clocks) {
+            return timers_state.cpu_sim_host_offset + cpu_get_sim_ns();
+        }
+#endif
         return get_clock_realtime();
     }
 }
 
 int64_t qemu_get_clock_ns(QEMUClock *clock)
 {
+#ifdef MARSS_QEMU
+    if (sim_virtual_clocks && clock->type == QEMU_CLOCK_REALTIME) {
+        return timers_state.cpu_sim_rt_offset + cpu_get_sim_ns();
+    }
+    if (sim_virtual_clocks) {
+        /* Both are already in ns */
+        return qemu_get_clock(clock);
+    }
+#endif
     switch(clock->type) {
     case QEMU_CLOCK_REALTIME:
         return get_clock();
@@ -689,6 +742,14 @@ void qemu_run_all_timers(void)
 
     qemu_run_timers(rt_clock);
     qemu_run_timers(host_clock);
+
+#ifdef MARSS_QEMU
+    /* Callbacks re-added their timers, a stale deadline would make the
+     * simulator leave its loop again for nothing */
+    if (sim_virtual_clocks) {
+        qemu_rearm_alarm_timer(alarm_timer);
+    }
+#endif
 }
 
 static int64_t qemu_next_alarm_deadline(void);
@@ -705,6 +766,12 @@ static void host_alarm_handler(int host_signum)
     if (!t)
 	return;
 
+#ifdef MARSS_QEMU
+    /* Signal queued before the host timer was stopped */
+    if (sim_virtual_clocks)
+        return;
+#endif
+
 #if 0
 #define DISP_FREQ 1000
     {
@@ -791,6 +858,145 @@ static int64_t qemu_next_alarm_deadline(void)
     return delta;
 }
 
+#ifdef MARSS_QEMU
+
+/*
+ * Virtual time alarm
+ *
+ * In virtual time mode the host alarm timer is stopped while simulating and
+ * replaced by this one. Instead of arming a host timer it converts the next
+ * timer deadline to a simulation cycle and the simulator raises the alarm
+ * from its cycle loop when sim_cycle reaches it. No signal or timer syscall
+ * is involved, so timers fire at the same cycle on every run.
+ */
+
+/* Host clock in virtual time mode when no host timer is pending,
+ * 2012-01-01 00:00:00 UTC in ns */
+#define SIM_HOST_CLOCK_EPOCH (1325376000LL * 1000000000LL)
+
+static struct qemu_alarm_timer *host_alarm_timer;
+
+static int sim_start_timer(struct qemu_alarm_timer *t)
+{
+    return 0;
+}
+
+static void sim_stop_timer(struct qemu_alarm_timer *t)
+{
+    sim_timer_deadline = (W64)-1;
+}
+
+static void sim_rearm_timer(struct qemu_alarm_timer *t)
+{
+    int64_t delta;
+
+    if (!active_timers[QEMU_CLOCK_REALTIME] &&
+        !active_timers[QEMU_CLOCK_VIRTUAL] &&
+        !active_timers[QEMU_CLOCK_HOST]) {
+        sim_timer_deadline = (W64)-1;
+        return;
+    }
+
+    delta = qemu_next_alarm_deadline();
+    if (delta < 0)
+        delta = 0;
+
+    /* Round up so the deadline has passed when the alarm is raised */
+    sim_timer_deadline = sim_cycle + sim_ns_to_cycles(delta) + 1;
+}
+
+static struct qemu_alarm_timer sim_alarm_timer = {
+    "sim", sim_start_timer, sim_stop_timer, sim_rearm_timer, NULL
+};
+
+/* Called by the simulator once sim_cycle reaches sim_timer_deadline. The
+ * main loop runs the timers as soon as the simulator returns, so the io
+ * thread is not notified. */
+void qemu_sim_alarm(void)
+{
+    sim_timer_deadline = (W64)-1;
+    sim_alarm_timer.expired = 1;
+    sim_alarm_timer.pending = 1;
+}
+
+/* Pending rt and host timers were set against host time, expire them at
+ * the switch so they restart from the simulated clocks */
+static void sim_expire_timers(QEMUClock *clock)
+{
+    QEMUTimer *ts;
+    int64_t now = qemu_get_clock(clock);
+
+    for (ts = active_timers[clock->type]; ts; ts = ts->next) {
+        if (ts->expire_time > now)
+            ts->expire_time = now;
+    }
+}
+
+/* Swap host and virtual alarm timers when simulation starts or stops */
+void qemu_sim_update_alarm(void)
+{
+    int virtual = in_simulation && get_sim_virtual_time();
+    int64_t sim_ns;
+
+    if (virtual == sim_virtual_clocks)
+        return;
+
+    if (virtual) {
+        host_alarm_timer = alarm_timer;
+        host_alarm_timer->stop(host_alarm_timer);
+
+        /* Seed the clocks from guest state only so every run of a
+         * checkpoint sees the same values. The rt clock starts at the vm
+         * clock. The host clock continues from its earliest pending timer
+         * (e.g. the RTC second update) so the guest doesn't see its wall
+         * clock jump, or from a fixed epoch if nothing is pending. */
+        sim_ns = cpu_get_sim_ns();
+        timers_state.cpu_sim_rt_offset = timers_state.cpu_sim_clock_offset;
+        if (active_timers[QEMU_CLOCK_HOST]) {
+            timers_state.cpu_sim_host_offset =
+                active_timers[QEMU_CLOCK_HOST]->expire_time - sim_ns;
+        } else {
+            timers_state.cpu_sim_host_offset = SIM_HOST_CLOCK_EPOCH - sim_ns;
+        }
+        sim_virtual_clocks = 1;
+
+        sim_expire_timers(rt_clock);
+        sim_expire_timers(host_clock);
+
+        /* Run the expired timers before simulating */
+        alarm_timer = &sim_alarm_timer;
+        alarm_timer->expired = 1;
+        alarm_timer->pending = 1;
+    } else {
+        sim_alarm_timer.stop(&sim_alarm_timer);
+        sim_virtual_clocks = 0;
+
+        alarm_timer = host_alarm_timer;
+        if (alarm_timer->start(alarm_timer)) {
+            fprintf(stderr, "Could not restart '%s' alarm timer\n",
+                    alarm_timer->name);
+            exit(1);
+        }
+        alarm_timer->pending = 1;
+    }
+}
+
+/* All simulated CPUs are halted so sim_cycle stands still, skip the clocks
+ * ahead to the next deadline to deliver the timer interrupt */
+void qemu_sim_idle_warp(void)
+{
+    if (!sim_virtual_clocks || sim_alarm_timer.pending ||
+            sim_timer_deadline == (W64)-1)
+        return;
+
+    if (sim_timer_deadline > sim_cycle)
+        timers_state.cpu_sim_idle_cycles += sim_timer_deadline - sim_cycle;
+
+    qemu_sim_alarm();
+}
+
+#endif
+
 #if defined(__linux__)
 
 #define RTC_FREQ 1024
@@ -1095,8 +1301,9 @@ static void win32_rearm_timer(struct qemu_alarm_timer *t)
 
 static void alarm_timer_on_change_state_rearm(void *opaque, int running, int reason)
 {
+    /* Active timer may be the virtual one while simulating */
     if (running)
-        qemu_rearm_alarm_timer((struct qemu_alarm_timer *) opaque);
+        qemu_rearm_alarm_timer(alarm_timer);
 }
 
 int init_timer_alarm(void)
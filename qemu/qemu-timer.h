@@ -131,6 +131,9 @@ int64_t cpu_get_icount(void);
 
 #ifdef MARSS_QEMU
 void cpu_set_sim_ticks(void);
+void qemu_sim_update_alarm(void);
+void qemu_sim_alarm(void);
+void qemu_sim_idle_warp(void);
 #endif
 
 /*******************************************/
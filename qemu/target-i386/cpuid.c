@@ -1246,4 +1246,7 @@ void cpu_x86_cpuid(CPUX86State *env, uint32_t index, uint32_t count,
         *edx = 0;
         break;
     }
+#ifdef MARSS_QEMU
+    ptl_cpuid_features(index, count, eax, ebx, ecx, edx);
+#endif
 }
@@ -1439,6 +1439,7 @@ static void main_loop(void)
                     vm_start();
             }
 
+            qemu_sim_update_alarm();
 #endif
 #ifdef CONFIG_PROFILER
             int64_t ti;
@@ -3167,6 +3168,11 @@ int main(int argc, char **argv, char **envp)
         if (load_vmstate(loadvm) < 0) {
             autostart = 0;
         }
+#ifdef MARSS_QEMU
+        else {
+            ptl_checkpoint_loaded(loadvm);
+        }
+#endif
     }
 
 #ifdef MARSS_QEMU
@@ -0,0 +1,174 @@
+#!/usr/bin/env python
+
+# marss-profile.py
+#
+# Report the precise samples that Marss writes with '-sample-file'. Samples
+# are grouped by guest RIP or, when guest binaries are given, by function.
+# Please run --help to list all the options.
+#
+# This script is provided under LGPL licence.
+#
+
+import bisect
+import struct
+import subprocess
+import sys
+
+from optparse import OptionParser
+
+# Must match sim/sampler.h
+MAGIC = b"MARSSPRF"
+HEADER = struct.Struct("<8sIIQII")
+RECORD = struct.Struct("<QQQQIIBBBBI")
+
+EVENTS = ["uops", "l2-miss", "branch-miss", "tlb-miss"]
+
+FLAG_KERNEL = (1 << 0)
+FLAGS = [(1 << 1, "l1-miss"), (1 << 2, "l2-miss"), (1 << 3, "l3-miss"),
+         (1 << 4, "tlb-miss"), (1 << 5, "mispred"), (1 << 6, "dram")]
+
+def error(msg):
+    sys.stderr.write("[ERROR] : %s\n" % msg)
+    sys.exit(1)
+
+def read_samples(filename):
+    f = open(filename, "rb")
+    data = f.read(HEADER.size)
+    if len(data) < HEADER.size:
+        error("%s is too short for a sample file" % filename)
+
+    magic, version, record_size, period, events, pad = HEADER.unpack(data)
+    if magic != MAGIC or record_size != RECORD.size:
+        error("%s is not a version 1 sample file" % filename)
+
+    header = {'version' : version, 'period' : period, 'events' : events}
+
+    samples = []
+    while True:
+        data = f.read(RECORD.size)
+        if len(data) < RECORD.size:
+            break
+        (cycle, rip, addr, cr3, latency, mem_latency, event, flags, coreid,
+                threadid, pad) = RECORD.unpack(data)
+        samples.append({'cycle' : cycle, 'rip' : rip, 'addr' : addr,
+            'cr3' : cr3, 'latency' : latency, 'mem_latency' : mem_latency,
+            'event' : event, 'flags' : flags, 'core' : coreid,
+            'thread' : threadid})
+
+    f.close()
+    return header, samples
+
+class Symbols(object):
+    """Function symbols of one binary, looked up with 'nm'"""
+
+    def __init__(self, binary, offset):
+        self.addrs = []
+        self.names = []
+
+        try:
+            out = subprocess.Popen(["nm", "-C", "-n", "--defined-only",
+                binary], stdout=subprocess.PIPE).communicate()[0]
+        except OSError:
+            error("unable to run nm on %s" % binary)
+
+        for line in out.decode("utf-8", "replace").splitlines():
+            fields = line.split(None, 2)
+            if len(fields) < 3 or fields[1] not in "tTwW":
+                continue
+            self.addrs.append(int(fields[0], 16) + offset)
+            self.names.append(fields[2])
+
+    def lookup(self, rip):
+        i = bisect.bisect_right(self.addrs, rip) - 1
+        if i < 0:
+            return None
+        return self.names[i]
+
+def flag_names(flags):
+    return ",".join([name for bit, name in FLAGS if flags & bit])
+
+def main():
+    opt = OptionParser("usage: %prog [options] sample-file")
+    opt.add_option("-b", "--binary", help="Guest user binary to symbolize")
+    opt.add_option("-o", "--offset", default="0",
+            help="Load address of the user binary, for PIE binaries")
+    opt.add_option("-k", "--kernel", help="Guest kernel image (vmlinux)")
+    opt.add_option("-e", "--event", help="Only count samples of this event")
+    opt.add_option("--cr3", help="Only count samples of this process")
+    opt.add_option("-u", "--user", action="store_true", default=False,
+            help="Only count user mode samples")
+    opt.add_option("-n", "--num", type="int", default=30,
+            help="Number of entries to print")
+    opt.add_option("-r", "--raw", action="store_true", default=False,
+            help="Print every sample instead of a report")
+
+    (options, args) = opt.parse_args()
+    if len(args) != 1:
+        opt.print_help()
+        sys.exit(1)
+
+    header, samples = read_samples(args[0])
+
+    event = None
+    if options.event:
+        if options.event not in EVENTS:
+            error("unknown event %s, expected one of %s" % (options.event,
+                ", ".join(EVENTS)))
+        event = EVENTS.index(options.event)
+
+    cr3 = int(options.cr3, 0) if options.cr3 else None
+
+    user_syms = None
+    if options.binary:
+        user_syms = Symbols(options.binary, int(options.offset, 0))
+    kernel_syms = Symbols(options.kernel, 0) if options.kernel else None
+
+    selected = []
+    for s in samples:
+        if event is not None and s['event'] != event:
+            continue
+        if cr3 is not None and s['cr3'] != cr3:
+            continue
+        if options.user and s['flags'] & FLAG_KERNEL:
+            continue
+        selected.append(s)
+
+    if options.raw:
+        print("cycle\tcore\tevent\trip\taddr\tcr3\tlatency\tmem_latency\tflags")
+        for s in selected:
+            print("%d\t%d\t%s\t0x%x\t0x%x\t0x%x\t%d\t%d\t%s" % (s['cycle'],
+                s['core'], EVENTS[s['event']], s['rip'], s['addr'],
+                s['cr3'], s['latency'], s['mem_latency'],
+                flag_names(s['flags'])))
+        return
+
+    groups = {}
+    for s in selected:
+        syms = kernel_syms if s['flags'] & FLAG_KERNEL else user_syms
+        key = syms.lookup(s['rip']) if syms else None
+        if key is None:
+            key = "0x%x" % s['rip']
+        if s['flags'] & FLAG_KERNEL:
+            key = "[k] " + key
+
+        g = groups.setdefault(key, [0, 0, 0])
+        g[0] += 1
+        g[1] += s['latency']
+        g[2] += s['mem_latency']
+
+    total = len(selected)
+    if not total:
+        print("# no samples")
+        return
+
+    print("# %d samples, one every %d events" % (total, header['period']))
+    print("# %8s %8s %10s %10s  %s" % ("overhead", "samples", "latency",
+        "mem-lat", "symbol"))
+
+    ranked = sorted(groups.items(), key=lambda kv: kv[1][0], reverse=True)
+    for key, g in ranked[:options.num]:
+        print("  %7.2f%% %8d %10.1f %10.1f  %s" % (100.0 * g[0] / total,
+            g[0], float(g[1]) / g[0], float(g[2]) / g[0], key))
+
+if __name__ == "__main__":
+    main()